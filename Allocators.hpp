@@ -0,0 +1,383 @@
+/**
+ * \file
+ * \brief Implements allocators for the heap storage of BitVectors that avoid
+ * the global allocator: a bump allocator for request-scoped work and a pool
+ * of size classes for long-lived values.
+ *
+ * Arena and WordPool are not synchronized. Give each thread its own, which
+ * also keeps the threads from contending on a shared heap. Every allocation
+ * is aligned to BITVECTOR_CACHE_LINE bytes.
+ *
+ * BitVector accepts std::pmr::polymorphic_allocator<word_t> as well, with
+ * std::pmr::monotonic_buffer_resource and unsynchronized_pool_resource
+ * playing these roles. Note that its results then come from the default
+ * resource, while ArenaAllocator keeps them in the arena.
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ALLOCATORS_HPP
+#define ALLOCATORS_HPP
+
+#include "BitVector.hpp"
+
+
+/**
+ * \def ROUND_UP_TO_CACHE_LINE(n)
+ * \brief Rounds a number of bytes up to a multiple of BITVECTOR_CACHE_LINE
+ */
+#define ROUND_UP_TO_CACHE_LINE(n) \
+  (CEILDIV((n), BITVECTOR_CACHE_LINE) * BITVECTOR_CACHE_LINE)
+
+
+/**
+ * Arena
+ *
+ * \brief A bump allocator that frees everything at once
+ *
+ * Allocation moves a cursor through a chunk of memory, taking a new chunk
+ * twice the size of the last when it runs out. Freeing only takes effect for
+ * the most recent allocation, which covers the temporaries of an expression;
+ * everything else is kept until reset().
+ */
+class Arena
+{
+public:
+  /**
+   * \param chunkBytes - the size of the first chunk
+   */
+  explicit Arena(size_t chunkBytes = 64 << 10)
+    : chunks(NULL), cursor(NULL), limit(NULL), nextChunkBytes(chunkBytes)
+  {
+  }
+  
+  ~Arena()
+  {
+    release(NULL);
+  }
+  
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  
+  /**
+   * \returns memory for the given number of bytes, aligned to a cache line
+   */
+  void *allocate(size_t bytes)
+  {
+    bytes = ROUND_UP_TO_CACHE_LINE(bytes);
+    if (bytes > (size_t)(limit - cursor))
+      grow(bytes);
+    
+    void *p = cursor;
+    cursor += bytes;
+    return p;
+  }
+  
+  /**
+   * \brief Returns memory to the arena if it was the most recent allocation,
+   * and otherwise does nothing
+   */
+  void deallocate(void *p, size_t bytes)
+  {
+    if ((char *)p + ROUND_UP_TO_CACHE_LINE(bytes) == cursor)
+      cursor = (char *)p;
+  }
+  
+  /**
+   * \brief Frees every allocation at once
+   *
+   * The largest chunk is kept for reuse, so an arena reset at the end of each
+   * request stops allocating once it has grown to fit one.
+   */
+  void reset()
+  {
+    if (!chunks)
+      return;
+    
+    release(chunks);
+    cursor = (char *)chunks + ROUND_UP_TO_CACHE_LINE(sizeof(Chunk));
+  }
+
+protected:
+  /**
+   * \brief Header at the start of every chunk
+   */
+  struct Chunk
+  {
+    Chunk *next;
+  };
+  
+  /**
+   * \brief Starts a new chunk with room for at least the given number of
+   * bytes
+   */
+  void grow(size_t bytes)
+  {
+    size_t header = ROUND_UP_TO_CACHE_LINE(sizeof(Chunk));
+    size_t size = header + bytes;
+    if (size < nextChunkBytes)
+      size = nextChunkBytes;
+    nextChunkBytes = 2 * size;
+    
+    Chunk *chunk = (Chunk *)allocateAligned(size, BITVECTOR_CACHE_LINE);
+    chunk->next = chunks;
+    chunks = chunk;
+    cursor = (char *)chunk + header;
+    limit = (char *)chunk + size;
+  }
+  
+  /**
+   * \brief Frees every chunk except keep, which may be NULL
+   */
+  void release(Chunk *keep)
+  {
+    for (Chunk *chunk = chunks; chunk; )
+    {
+      Chunk *next = chunk->next;
+      if (chunk != keep)
+        freeAligned(chunk);
+      chunk = next;
+    }
+    
+    if (keep)
+      keep->next = NULL;
+    chunks = keep;
+  }
+  
+  /**
+   * \brief The chunks, most recent (and largest) first
+   */
+  Chunk *chunks;
+  
+  /**
+   * \brief The free range of the most recent chunk
+   */
+  char *cursor;
+  char *limit;
+  
+  /**
+   * \brief The minimum size of the next chunk
+   */
+  size_t nextChunkBytes;
+};
+
+
+/**
+ * \def WORD_POOL_CLASSES
+ * \brief Number of size classes in a WordPool
+ *
+ * Class c holds blocks of BITVECTOR_CACHE_LINE << c bytes, so the default
+ * classes run from 512 to 65536 bits. Larger requests go to
+ * allocateAligned().
+ */
+#ifndef WORD_POOL_CLASSES
+#define WORD_POOL_CLASSES 8
+#endif
+
+/**
+ * WordPool
+ *
+ * \brief A pool of blocks in power-of-two size classes
+ *
+ * Blocks are carved out of large slabs and kept on a free list per size class
+ * when they are freed, so a steady state of allocations and frees never
+ * reaches the global allocator. Memory is only returned when the pool is
+ * destroyed.
+ */
+class WordPool
+{
+public:
+  /**
+   * \param slabBytes - the size of the slabs blocks are carved from
+   */
+  explicit WordPool(size_t slabBytes = 256 << 10)
+    : cursor(NULL), limit(NULL), slabBytes(slabBytes)
+  {
+    for (size_t c = 0; c < WORD_POOL_CLASSES; c ++)
+      freeLists[c] = NULL;
+  }
+  
+  ~WordPool()
+  {
+    for (size_t i = 0; i < slabs.size(); i ++)
+      freeAligned(slabs[i]);
+  }
+  
+  WordPool(const WordPool &) = delete;
+  WordPool &operator=(const WordPool &) = delete;
+  
+  /**
+   * \returns memory for the given number of bytes, aligned to a cache line
+   */
+  void *allocate(size_t bytes)
+  {
+    size_t c = sizeClass(bytes);
+    if (c >= WORD_POOL_CLASSES)
+      return allocateAligned(bytes, BITVECTOR_CACHE_LINE);
+    
+    FreeBlock *block = freeLists[c];
+    if (block)
+    {
+      freeLists[c] = block->next;
+      return block;
+    }
+    
+    size_t size = (size_t)BITVECTOR_CACHE_LINE << c;
+    if (size > (size_t)(limit - cursor))
+    {
+      size_t slab = (slabBytes > size) ? slabBytes : size;
+      cursor = (char *)allocateAligned(slab, BITVECTOR_CACHE_LINE);
+      limit = cursor + slab;
+      slabs.push_back(cursor);
+    }
+    
+    void *p = cursor;
+    cursor += size;
+    return p;
+  }
+  
+  /**
+   * \brief Returns memory to the free list of its size class
+   *
+   * \param bytes - the size passed to allocate()
+   */
+  void deallocate(void *p, size_t bytes)
+  {
+    size_t c = sizeClass(bytes);
+    if (c >= WORD_POOL_CLASSES)
+    {
+      freeAligned(p);
+      return;
+    }
+    
+    FreeBlock *block = (FreeBlock *)p;
+    block->next = freeLists[c];
+    freeLists[c] = block;
+  }
+
+protected:
+  /**
+   * \brief A block on a free list
+   */
+  struct FreeBlock
+  {
+    FreeBlock *next;
+  };
+  
+  /**
+   * \returns the smallest size class that fits the given number of bytes
+   */
+  static size_t sizeClass(size_t bytes)
+  {
+    return BITS_PER_WORD -
+      countLeadingZeros((word_t)((bytes - (bytes > 0)) / BITVECTOR_CACHE_LINE));
+  }
+  
+  /**
+   * \brief The free blocks of each size class
+   */
+  FreeBlock *freeLists[WORD_POOL_CLASSES];
+  
+  /**
+   * \brief The part of the newest slab that has not been carved into blocks
+   */
+  char *cursor;
+  char *limit;
+  
+  /**
+   * \brief The minimum size of a slab
+   */
+  size_t slabBytes;
+  
+  /**
+   * \brief Every slab, for freeing them with the pool
+   */
+  std::vector<void *> slabs;
+};
+
+
+/**
+ * \def DEFINE_RESOURCE_ALLOCATOR(name, Resource)
+ * \brief Defines a standard allocator that forwards to a resource object with
+ * allocate(bytes) and deallocate(p, bytes) methods
+ *
+ * Copies of the allocator, including the ones BitVector makes for the
+ * results of operations, share the resource. Two allocators are equal if
+ * they share a resource, so a BitVector is only moved into another by
+ * stealing its storage when both use the same resource.
+ *
+ * \param name - name of the allocator template
+ * \param Resource - type of the resource
+ */
+#define DEFINE_RESOURCE_ALLOCATOR(name, Resource) \
+  \
+  template<typename T> \
+  class name \
+  { \
+  public: \
+    typedef T value_type; \
+    \
+    name(Resource &r) : resource(&r) { } \
+    \
+    template<typename U> \
+    name(const name<U> &other) : resource(other.resource) { } \
+    \
+    T *allocate(size_t n) \
+    { \
+      return (T *)resource->allocate(n * sizeof(T)); \
+    } \
+    \
+    void deallocate(T *p, size_t n) \
+    { \
+      resource->deallocate(p, n * sizeof(T)); \
+    } \
+    \
+    Resource *resource; \
+  }; \
+  \
+  template<typename T, typename U> \
+  bool operator==(const name<T> &a, const name<U> &b) \
+  { \
+    return a.resource == b.resource; \
+  } \
+  \
+  template<typename T, typename U> \
+  bool operator!=(const name<T> &a, const name<U> &b) \
+  { \
+    return a.resource != b.resource; \
+  }
+
+/**
+ * ArenaAllocator
+ *
+ * \brief A standard allocator drawing from an Arena
+ */
+DEFINE_RESOURCE_ALLOCATOR(ArenaAllocator, Arena)
+
+/**
+ * PoolAllocator
+ *
+ * \brief A standard allocator drawing from a WordPool
+ */
+DEFINE_RESOURCE_ALLOCATOR(PoolAllocator, WordPool)
+
+#endif // ALLOCATORS_HPP
@@ -0,0 +1,312 @@
+/**
+ * \file
+ * \brief Implements AtomicBitSpan, a view of the words of a BitVector whose
+ * bit operations are atomic, so that many threads can share one bitmap
+ * without a lock.
+ *
+ * Each operation is a single atomic read-modify-write of the word holding the
+ * bit, through std::atomic_ref when compiled as C++20 and the GCC __atomic
+ * builtins otherwise. The words stay plain word_t, so the same storage can be
+ * used as an ordinary BitVector before and after the concurrent phase.
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ATOMICBITSPAN_HPP
+#define ATOMICBITSPAN_HPP
+
+#include "BitVector.hpp"
+
+#include <atomic>
+
+
+/**
+ * \def BITVECTOR_ATOMIC_REF
+ * \brief Defined when the atomic operations go through std::atomic_ref
+ * rather than the GCC __atomic builtins
+ */
+#if defined(__cpp_lib_atomic_ref)
+#define BITVECTOR_ATOMIC_REF 1
+#elif !defined(__GNUC__)
+#error "AtomicBitSpan needs std::atomic_ref or the GCC __atomic builtins"
+#endif
+
+
+/**
+ * AtomicBitSpan
+ *
+ * \brief A view of the bits of a BitVector, or of any array of words, that
+ * reads and updates them atomically
+ *
+ * The view does not own the words, which must outlive it, and the width of a
+ * viewed BitVector must not change while the view is in use. Plain accesses
+ * to the same words from other threads, including through the BitVector, are
+ * data races.
+ *
+ * Updates that set or clear bits are release operations and reads are
+ * acquire operations, so data written before a bit is set is visible to a
+ * thread that sees it set. The operations that return the previous value are
+ * both, so that exactly one thread wins a claim and sees what the previous
+ * owner published.
+ */
+class AtomicBitSpan
+{
+public:
+  /**
+   * \brief Views the first length bits of words
+   */
+  AtomicBitSpan(word_t *words, size_t length)
+    : words(words), length(length)
+  {
+  }
+  
+  /**
+   * \brief Views all of the bits of a BitVector
+   */
+  template<size_t N, typename A>
+  AtomicBitSpan(BitVector<N, A> &v)
+    : words(v.data()), length(v.width())
+  {
+  }
+  
+  size_t width() const
+  {
+    return length;
+  }
+  
+  size_t wordCount() const
+  {
+    return BITS_TO_WORDS(length);
+  }
+  
+  word_t *data() const
+  {
+    return words;
+  }
+  
+  /**
+   * \returns word i, read atomically
+   */
+  word_t getWord(size_t i) const
+  {
+    return load(i, std::memory_order_acquire);
+  }
+  
+  /**
+   * \returns the truth value of the specified bit
+   */
+  bool getBit(size_t index) const
+  {
+    return (getWord(WORD_INDEX_FOR_BIT_IN_ARRAY(index)) &
+      MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index))) != 0;
+  }
+  
+  /**
+   * \brief Sets the specified bit
+   */
+  void atomicSet(size_t index)
+  {
+    fetchOr(WORD_INDEX_FOR_BIT_IN_ARRAY(index),
+      MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index)),
+      std::memory_order_release);
+  }
+  
+  /**
+   * \brief Clears the specified bit
+   */
+  void atomicClear(size_t index)
+  {
+    fetchAnd(WORD_INDEX_FOR_BIT_IN_ARRAY(index),
+      ~MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index)),
+      std::memory_order_release);
+  }
+  
+  /**
+   * \brief Flips the specified bit
+   *
+   * \returns the previous value of the bit
+   */
+  bool atomicFlip(size_t index)
+  {
+    word_t mask = MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index));
+    return (fetchXor(WORD_INDEX_FOR_BIT_IN_ARRAY(index), mask) & mask) != 0;
+  }
+  
+  /**
+   * \brief Sets the specified bit
+   *
+   * A bit that is already set is only read, so threads revisiting the same
+   * bits do not take the cache line away from each other.
+   *
+   * \returns the previous value of the bit: false if this call set it
+   */
+  bool testAndSet(size_t index)
+  {
+    size_t i = WORD_INDEX_FOR_BIT_IN_ARRAY(index);
+    word_t mask = MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index));
+    if (load(i, std::memory_order_acquire) & mask)
+      return true;
+    return (fetchOr(i, mask) & mask) != 0;
+  }
+  
+  /**
+   * \brief Clears the specified bit
+   *
+   * \returns the previous value of the bit: true if this call cleared it
+   */
+  bool testAndClear(size_t index)
+  {
+    size_t i = WORD_INDEX_FOR_BIT_IN_ARRAY(index);
+    word_t mask = MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index));
+    if (!(load(i, std::memory_order_acquire) & mask))
+      return false;
+    return (fetchAnd(i, ~mask) & mask) != 0;
+  }
+  
+  /**
+   * \brief Computes word i |= x atomically
+   *
+   * \returns the previous value of the word
+   */
+  word_t fetchOr(size_t i, word_t x,
+    std::memory_order order = std::memory_order_acq_rel)
+  {
+#ifdef BITVECTOR_ATOMIC_REF
+    return std::atomic_ref<word_t>(words[i]).fetch_or(x, order);
+#else
+    return __atomic_fetch_or(&words[i], x, atomicOrder(order));
+#endif
+  }
+  
+  /**
+   * \brief Computes word i &= x atomically
+   *
+   * \returns the previous value of the word
+   */
+  word_t fetchAnd(size_t i, word_t x,
+    std::memory_order order = std::memory_order_acq_rel)
+  {
+#ifdef BITVECTOR_ATOMIC_REF
+    return std::atomic_ref<word_t>(words[i]).fetch_and(x, order);
+#else
+    return __atomic_fetch_and(&words[i], x, atomicOrder(order));
+#endif
+  }
+  
+  /**
+   * \brief Computes word i ^= x atomically
+   *
+   * \returns the previous value of the word
+   */
+  word_t fetchXor(size_t i, word_t x,
+    std::memory_order order = std::memory_order_acq_rel)
+  {
+#ifdef BITVECTOR_ATOMIC_REF
+    return std::atomic_ref<word_t>(words[i]).fetch_xor(x, order);
+#else
+    return __atomic_fetch_xor(&words[i], x, atomicOrder(order));
+#endif
+  }
+  
+  /**
+   * \brief Finds a clear bit at or above from and sets it, so that each bit
+   * is claimed by exactly one thread
+   *
+   * Full words are skipped with relaxed loads. In a word with clear bits,
+   * the lowest one is found with a trailing zero count and set with an
+   * atomic OR of that bit alone, which compiles to lock bts on x86; if
+   * another thread set it first, the word is reloaded and the search goes
+   * on. Unlike a compare-and-swap of the whole word, the OR never fails
+   * because a different bit of the word changed.
+   *
+   * \returns the index of the claimed bit, or width() if every bit at or
+   *   above from is set
+   */
+  size_t claimNextFree(size_t from = 0)
+  {
+    if (from >= length)
+      return length;
+    
+    size_t n = wordCount();
+    size_t i = WORD_INDEX_FOR_BIT_IN_ARRAY(from);
+    word_t allowed = ~MASK_WITH_LOWER_BITS(BIT_POSITION_FOR_BIT_IN_WORD(from));
+    for (; i < n; i ++)
+    {
+      if (i == n - 1)
+        allowed &= MASK_FOR_MOST_SIGNIFICANT_WORD(length);
+      word_t free = ~load(i, std::memory_order_relaxed) & allowed;
+      while (free != 0)
+      {
+        unsigned bit = countTrailingZeros(free);
+        word_t mask = MASK_WITH_BIT(bit);
+        if ((fetchOr(i, mask) & mask) == 0)
+          return WORDS_TO_BITS(i) + bit;
+        free = ~load(i, std::memory_order_relaxed) & allowed;
+      }
+      allowed = ~(word_t)0;
+    }
+    return length;
+  }
+
+protected:
+  /**
+   * \returns word i, read atomically
+   */
+  word_t load(size_t i, std::memory_order order) const
+  {
+#ifdef BITVECTOR_ATOMIC_REF
+    return std::atomic_ref<word_t>(words[i]).load(order);
+#else
+    return __atomic_load_n(&words[i], atomicOrder(order));
+#endif
+  }
+
+#ifndef BITVECTOR_ATOMIC_REF
+  /**
+   * \returns the __atomic memory model for a std::memory_order
+   */
+  static int atomicOrder(std::memory_order order)
+  {
+    switch (order)
+    {
+      case std::memory_order_relaxed: return __ATOMIC_RELAXED;
+      case std::memory_order_consume: return __ATOMIC_CONSUME;
+      case std::memory_order_acquire: return __ATOMIC_ACQUIRE;
+      case std::memory_order_release: return __ATOMIC_RELEASE;
+      case std::memory_order_acq_rel: return __ATOMIC_ACQ_REL;
+      default: return __ATOMIC_SEQ_CST;
+    }
+  }
+#endif
+  
+  /**
+   * \brief The viewed words
+   */
+  word_t *words;
+  
+  /**
+   * \brief The number of viewed bits
+   */
+  size_t length;
+};
+
+#endif // ATOMICBITSPAN_HPP
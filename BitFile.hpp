@@ -0,0 +1,665 @@
+/**
+ * \file
+ * \brief Implements a binary file format for bit vectors, with functions to
+ * save and load it through streams and to map it into memory.
+ *
+ * A file starts with a BitFileHeader, which records the width, the byte order
+ * of the writer and checksums of the other sections. The words of the bits
+ * follow at a page boundary, and an optional RankSelect index after them at a
+ * cache line boundary. Words are stored in the byte order of the writer; load()
+ * converts them, while mmapOpen() only accepts files in the native order.
+ *
+ * Mapping a file reads nothing but the header: the bits and the index are
+ * used in place from the page cache, so opening a file of many gigabytes takes
+ * no time and no private memory. The checksums are only checked by load() and
+ * MappedBitFile::verify().
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef BITFILE_HPP
+#define BITFILE_HPP
+
+#include "BitSpan.hpp"
+#include "RankSelect.hpp"
+
+#include <istream>
+#include <ostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * \def BITFILE_MAGIC
+ * \brief The eight bytes every file starts with
+ */
+#define BITFILE_MAGIC "BITVECTR"
+
+/**
+ * \def BITFILE_VERSION
+ * \brief The version of the format written, and the only one read
+ */
+#define BITFILE_VERSION 1
+
+/**
+ * \def BITFILE_BYTE_ORDER
+ * \brief Written in the byte order of the writer, which readers detect by
+ * comparing it with this value and its byte swap
+ */
+#define BITFILE_BYTE_ORDER ((word_t)0x0102030405060708ULL)
+
+/**
+ * \def BITFILE_HAS_INDEX
+ * \brief Flag for files with a RankSelect index section
+ */
+#define BITFILE_HAS_INDEX 1
+
+/**
+ * \def BITFILE_PAYLOAD_ALIGNMENT
+ * \brief Offset of the bits in a file, so that they start on a page when it
+ * is mapped
+ */
+#define BITFILE_PAYLOAD_ALIGNMENT 4096
+
+
+/**
+ * BitFileHeader
+ *
+ * \brief The start of a file. Offsets are in bytes from the start of the file;
+ * sizes are in words.
+ */
+struct BitFileHeader
+{
+  char magic[8];
+  word_t version;
+  word_t flags;
+  word_t byteOrder;
+  word_t width;
+  word_t payloadOffset;
+  word_t payloadWords;
+  word_t indexOffset;
+  word_t indexWords;
+  word_t payloadChecksum;
+  word_t indexChecksum;
+  
+  /**
+   * \brief The checksum of the fields from version to indexChecksum
+   */
+  word_t headerChecksum;
+};
+
+
+/**
+ * BitFileChecksum
+ *
+ * \brief A 64-bit checksum of a sequence of words, computed in pieces
+ *
+ * The words are mixed into four lanes with the round function of xxHash64,
+ * which keeps the checksum as fast as reading the words.
+ */
+class BitFileChecksum
+{
+public:
+  BitFileChecksum() : count(0)
+  {
+    lanes[0] = PRIME1 + PRIME2;
+    lanes[1] = PRIME2;
+    lanes[2] = 0;
+    lanes[3] = (word_t)0 - PRIME1;
+  }
+  
+  /**
+   * \brief Mixes n more words into the checksum
+   */
+  void add(const word_t *w, size_t n)
+  {
+    size_t i = 0;
+    for (; i < n && (count & 3) != 0; i ++, count ++)
+      round(lanes[count & 3], w[i]);
+    for (; i + 4 <= n; i += 4, count += 4)
+    {
+      round(lanes[0], w[i]);
+      round(lanes[1], w[i + 1]);
+      round(lanes[2], w[i + 2]);
+      round(lanes[3], w[i + 3]);
+    }
+    for (; i < n; i ++, count ++)
+      round(lanes[count & 3], w[i]);
+  }
+  
+  /**
+   * \returns the checksum of the words so far
+   */
+  word_t value() const
+  {
+    word_t h = rotate(lanes[0], 1) + rotate(lanes[1], 7) +
+      rotate(lanes[2], 12) + rotate(lanes[3], 18) + count;
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+  }
+
+protected:
+  static const word_t PRIME1 = 0x9e3779b185ebca87ULL;
+  static const word_t PRIME2 = 0xc2b2ae3d27d4eb4fULL;
+  static const word_t PRIME3 = 0x165667b19e3779f9ULL;
+  
+  static word_t rotate(word_t x, unsigned n)
+  {
+    return (x << n) | (x >> (BITS_PER_WORD - n));
+  }
+  
+  static void round(word_t &lane, word_t x)
+  {
+    lane = rotate(lane + x * PRIME2, 31) * PRIME1;
+  }
+  
+  word_t lanes[4];
+  word_t count;
+};
+
+
+/**
+ * \returns the word with its bytes in the opposite order
+ */
+inline word_t byteSwapWord(word_t x)
+{
+#ifdef __GNUC__
+  return __builtin_bswap64(x);
+#else
+  x = ((x & 0x00ff00ff00ff00ffULL) << 8) | ((x >> 8) & 0x00ff00ff00ff00ffULL);
+  x = ((x & 0x0000ffff0000ffffULL) << 16) |
+    ((x >> 16) & 0x0000ffff0000ffffULL);
+  return (x << 32) | (x >> 32);
+#endif
+}
+
+/**
+ * \returns the checksum stored in BitFileHeader::headerChecksum
+ */
+inline word_t bitFileHeaderChecksum(const BitFileHeader &header)
+{
+  const word_t fields[] = {
+    header.version, header.flags, header.byteOrder, header.width,
+    header.payloadOffset, header.payloadWords, header.indexOffset,
+    header.indexWords, header.payloadChecksum, header.indexChecksum
+  };
+  BitFileChecksum sum;
+  sum.add(fields, sizeof(fields) / sizeof(fields[0]));
+  return sum.value();
+}
+
+/**
+ * \brief Checks a header read from a file and brings its fields into the
+ * native byte order
+ *
+ * \param fileBytes - the size of the file, or 0 if it is unknown
+ * \param swapped - set to true if the file was written in the opposite byte
+ *   order
+ * \returns false if the header is damaged, of another version, or describes
+ *   sections that don't fit in the file or in memory
+ */
+inline bool readBitFileHeader(BitFileHeader &header, word_t fileBytes,
+  bool &swapped)
+{
+  if (memcmp(header.magic, BITFILE_MAGIC, sizeof(header.magic)) != 0)
+    return false;
+  
+  swapped = (header.byteOrder != BITFILE_BYTE_ORDER);
+  if (swapped)
+  {
+    if (header.byteOrder != byteSwapWord(BITFILE_BYTE_ORDER))
+      return false;
+    
+    word_t *fields[] = {
+      &header.version, &header.flags, &header.byteOrder, &header.width,
+      &header.payloadOffset, &header.payloadWords, &header.indexOffset,
+      &header.indexWords, &header.payloadChecksum, &header.indexChecksum,
+      &header.headerChecksum
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i ++)
+      *fields[i] = byteSwapWord(*fields[i]);
+  }
+  
+  if (header.version != BITFILE_VERSION ||
+    header.headerChecksum != bitFileHeaderChecksum(header) ||
+    (header.flags & ~(word_t)BITFILE_HAS_INDEX) != 0)
+    return false;
+  
+  // The sections must be word-aligned and in order, and each must fit in the
+  // address space. Comparing word counts against limits in words keeps the
+  // arithmetic from overflowing.
+  const word_t maxWords = (word_t)(size_t)-1 / BYTES_PER_WORD;
+  word_t payloadEnd = header.payloadOffset +
+    WORDS_TO_BYTES(header.payloadWords);
+  if (header.width > (word_t)(size_t)-1 ||
+    header.payloadWords != BITS_TO_WORDS(header.width) ||
+    header.payloadOffset < sizeof(BitFileHeader) ||
+    header.payloadOffset % BYTES_PER_WORD != 0 ||
+    header.payloadOffset > maxWords || header.payloadWords > maxWords ||
+    payloadEnd < header.payloadOffset ||
+    (fileBytes != 0 && payloadEnd > fileBytes))
+    return false;
+  
+  if (header.flags & BITFILE_HAS_INDEX)
+  {
+    word_t indexEnd = header.indexOffset + WORDS_TO_BYTES(header.indexWords);
+    if (header.indexOffset < payloadEnd ||
+      header.indexOffset % BYTES_PER_WORD != 0 ||
+      header.indexOffset > maxWords || header.indexWords > maxWords ||
+      indexEnd < header.indexOffset ||
+      (fileBytes != 0 && indexEnd > fileBytes))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * \brief Passes the words of a span to f(const word_t *, size_t n) in
+ * pieces, shifted to start on a word and with the bits beyond its width
+ * cleared
+ */
+template<typename F>
+void forEachSpanChunk(const ConstBitSpan &bits, F f)
+{
+  word_t chunk[512];
+  size_t n = bits.wordCount();
+  for (size_t i = 0; i < n; )
+  {
+    size_t count = (n - i < 512) ? n - i : 512;
+    for (size_t j = 0; j < count; j ++)
+      chunk[j] = bits.word(i + j);
+    i += count;
+    if (i == n)
+      chunk[count - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(bits.width());
+    f(chunk, count);
+  }
+}
+
+/**
+ * \brief Writes the bits of a span into a file stream
+ *
+ * The span may start at any bit; it is written as if it started on a word,
+ * with the bits beyond its width cleared. A BitVector converts to a span
+ * implicitly.
+ *
+ * \param index - if not NULL, an index over the same bits to save with them
+ * \returns false if writing to the stream failed
+ */
+inline bool save(std::ostream &out, ConstBitSpan bits,
+  const RankSelect *index = NULL)
+{
+  assert((!index || index->width() == bits.width()) &&
+    "Index must cover the bits");
+  
+  BitFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BITFILE_MAGIC, sizeof(header.magic));
+  header.version = BITFILE_VERSION;
+  header.byteOrder = BITFILE_BYTE_ORDER;
+  header.width = bits.width();
+  header.payloadOffset = BITFILE_PAYLOAD_ALIGNMENT;
+  header.payloadWords = bits.wordCount();
+  
+  BitFileChecksum payloadSum;
+  forEachSpanChunk(bits,
+    [&](const word_t *w, size_t n) { payloadSum.add(w, n); });
+  header.payloadChecksum = payloadSum.value();
+  
+  word_t payloadEnd = header.payloadOffset +
+    WORDS_TO_BYTES(header.payloadWords);
+  if (index)
+  {
+    BitFileChecksum indexSum;
+    index->writeTables([&](const word_t *w, size_t n) { indexSum.add(w, n); });
+    header.flags |= BITFILE_HAS_INDEX;
+    header.indexOffset = CEILDIV(payloadEnd, BITVECTOR_CACHE_LINE) *
+      BITVECTOR_CACHE_LINE;
+    header.indexWords = index->tableWords();
+    header.indexChecksum = indexSum.value();
+  }
+  header.headerChecksum = bitFileHeaderChecksum(header);
+  
+  static const char zeros[BITFILE_PAYLOAD_ALIGNMENT] = { 0 };
+  auto write = [&](const word_t *w, size_t n)
+  {
+    out.write((const char *)w, (std::streamsize)WORDS_TO_BYTES(n));
+  };
+  
+  out.write((const char *)&header, sizeof(header));
+  out.write(zeros, (std::streamsize)(header.payloadOffset - sizeof(header)));
+  forEachSpanChunk(bits, write);
+  if (index)
+  {
+    out.write(zeros, (std::streamsize)(header.indexOffset - payloadEnd));
+    index->writeTables(write);
+  }
+  return out.good();
+}
+
+/**
+ * \brief Reads bits written by save() from a file stream
+ *
+ * \param v - receives the bits, resized to their width
+ * \param index - if not NULL, receives an index over the bits of v, read from
+ *   the file if it has one and built otherwise
+ * \returns false if reading failed or the file is damaged, leaving v and
+ *   index unchanged
+ */
+template<size_t N, typename A>
+bool load(std::istream &in, BitVector<N, A> &v, RankSelect *index = NULL)
+{
+  BitFileHeader header;
+  bool swapped;
+  if (!in.read((char *)&header, sizeof(header)) ||
+    !readBitFileHeader(header, 0, swapped))
+    return false;
+  
+  // Read the words straight into their new storage
+  BitVector<N, A> bits((size_t)header.width, false, v.get_allocator());
+  word_t *w = bits.data();
+  size_t n = (size_t)header.payloadWords;
+  if (!in.ignore((std::streamsize)(header.payloadOffset - sizeof(header))) ||
+    !in.read((char *)w, (std::streamsize)WORDS_TO_BYTES(n)))
+    return false;
+  if (swapped)
+    for (size_t i = 0; i < n; i ++)
+      w[i] = byteSwapWord(w[i]);
+  
+  BitFileChecksum payloadSum;
+  payloadSum.add(w, n);
+  if (payloadSum.value() != header.payloadChecksum)
+    return false;
+  
+  std::vector<word_t> tables;
+  if (index && (header.flags & BITFILE_HAS_INDEX))
+  {
+    tables.resize((size_t)header.indexWords);
+    word_t payloadEnd = header.payloadOffset + WORDS_TO_BYTES(n);
+    if (!in.ignore((std::streamsize)(header.indexOffset - payloadEnd)) ||
+      !in.read((char *)tables.data(),
+        (std::streamsize)WORDS_TO_BYTES(tables.size())))
+      return false;
+    if (swapped)
+      for (size_t i = 0; i < tables.size(); i ++)
+        tables[i] = byteSwapWord(tables[i]);
+    
+    BitFileChecksum indexSum;
+    indexSum.add(tables.data(), tables.size());
+    RankSelect check;
+    if (indexSum.value() != header.indexChecksum ||
+      !check.readTables(w, bits.width(), tables.data(), tables.size(), false))
+      return false;
+  }
+  
+  v = std::move(bits);
+  if (index && !tables.empty())
+    index->readTables(v.data(), v.width(), tables.data(), tables.size(), true);
+  else if (index)
+    index->rebuild(v);
+  return true;
+}
+
+
+#ifndef _WIN32
+
+/**
+ * MappedBitFile
+ *
+ * \brief A file written by save(), mapped read-only into memory
+ *
+ * The bits and the index are read from the page cache as they are used, so
+ * opening a file costs the same whatever its size, and processes mapping the
+ * same file share its memory. Not available on Windows, where load() reads
+ * the file instead.
+ */
+class MappedBitFile
+{
+public:
+  MappedBitFile()
+    : mapping(NULL), mappingBytes(0), header(NULL), indexed(false)
+  {
+  }
+  
+  ~MappedBitFile()
+  {
+    close();
+  }
+  
+  MappedBitFile(const MappedBitFile &) = delete;
+  MappedBitFile &operator=(const MappedBitFile &) = delete;
+  
+  MappedBitFile(MappedBitFile &&other)
+    : mapping(NULL), mappingBytes(0), header(NULL), indexed(false)
+  {
+    swap(other);
+  }
+  
+  MappedBitFile &operator=(MappedBitFile &&other)
+  {
+    if (this != &other)
+    {
+      close();
+      swap(other);
+    }
+    return *this;
+  }
+  
+  /**
+   * \brief Exchanges two mapped files
+   */
+  void swap(MappedBitFile &other)
+  {
+    std::swap(mapping, other.mapping);
+    std::swap(mappingBytes, other.mappingBytes);
+    std::swap(header, other.header);
+    std::swap(indexed, other.indexed);
+    rankIndex.swap(other.rankIndex);
+  }
+  
+  /**
+   * \brief Maps a file, closing the one mapped before
+   *
+   * Only the header is read and checked. The file must be in the native byte
+   * order.
+   *
+   * \returns false if the file couldn't be mapped or isn't a valid file
+   */
+  bool open(const char *path)
+  {
+    close();
+    
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      return false;
+    
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (word_t)st.st_size >= sizeof(BitFileHeader) &&
+      (word_t)st.st_size <= (word_t)(size_t)-1)
+      p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+      return false;
+    
+    mapping = p;
+    mappingBytes = (size_t)st.st_size;
+    
+    // Check a copy, as the header is swapped in place when it is read
+    BitFileHeader copy;
+    bool swapped;
+    memcpy(&copy, mapping, sizeof(copy));
+    if (!readBitFileHeader(copy, mappingBytes, swapped) || swapped)
+    {
+      close();
+      return false;
+    }
+    header = (const BitFileHeader *)mapping;
+    
+    if (header->flags & BITFILE_HAS_INDEX)
+    {
+      const word_t *tables = (const word_t *)
+        ((const char *)mapping + header->indexOffset);
+      if (!rankIndex.readTables(payload(), width(), tables,
+        (size_t)header->indexWords, false))
+      {
+        close();
+        return false;
+      }
+      indexed = true;
+    }
+    return true;
+  }
+  
+  /**
+   * \brief Unmaps the file, if any
+   */
+  void close()
+  {
+    if (mapping)
+      munmap(mapping, mappingBytes);
+    mapping = NULL;
+    mappingBytes = 0;
+    header = NULL;
+    indexed = false;
+    rankIndex = RankSelect();
+  }
+  
+  /**
+   * \returns true if a file is mapped
+   */
+  bool isOpen() const
+  {
+    return header != NULL;
+  }
+  
+  /**
+   * \returns the number of bits in the file
+   */
+  size_t width() const
+  {
+    return header ? (size_t)header->width : 0;
+  }
+  
+  /**
+   * \returns a view of the bits in the file
+   */
+  ConstBitSpan bits() const
+  {
+    return ConstBitSpan(payload(), 0, width());
+  }
+  
+  /**
+   * \returns true if the file has an index
+   */
+  bool hasIndex() const
+  {
+    return indexed;
+  }
+  
+  /**
+   * \returns the index saved with the bits, which reads its tables from the
+   *   file; only valid if hasIndex()
+   */
+  const RankSelect &index() const
+  {
+    return rankIndex;
+  }
+  
+  /**
+   * \brief Reads the whole file to compare it against its checksums
+   *
+   * \returns true if the bits and the index are intact
+   */
+  bool verify() const
+  {
+    if (!header)
+      return false;
+    
+    BitFileChecksum payloadSum;
+    payloadSum.add(payload(), (size_t)header->payloadWords);
+    if (payloadSum.value() != header->payloadChecksum)
+      return false;
+    
+    if (header->flags & BITFILE_HAS_INDEX)
+    {
+      BitFileChecksum indexSum;
+      indexSum.add((const word_t *)
+        ((const char *)mapping + header->indexOffset),
+        (size_t)header->indexWords);
+      if (indexSum.value() != header->indexChecksum)
+        return false;
+    }
+    return true;
+  }
+
+protected:
+  /**
+   * \returns the words of the bits in the file
+   */
+  const word_t *payload() const
+  {
+    return header ? (const word_t *)
+      ((const char *)mapping + header->payloadOffset) : NULL;
+  }
+  
+  /**
+   * \brief The mapped file
+   */
+  void *mapping;
+  size_t mappingBytes;
+  
+  /**
+   * \brief The header at the start of the mapping, once it is checked
+   */
+  const BitFileHeader *header;
+  
+  /**
+   * \brief The index saved with the bits, and whether there is one
+   */
+  RankSelect rankIndex;
+  bool indexed;
+};
+
+/**
+ * \brief Maps a file written by save() into memory
+ *
+ * \returns the mapped file, which isOpen() only if mapping succeeded
+ */
+inline MappedBitFile mmapOpen(const char *path)
+{
+  MappedBitFile file;
+  file.open(path);
+  return file;
+}
+
+#endif // _WIN32
+
+#endif // BITFILE_HPP
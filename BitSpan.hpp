@@ -0,0 +1,612 @@
+/**
+ * \file
+ * \brief Implements ConstBitSpan and BitSpan, non-owning views of a range of
+ * bits in memory that the caller owns, such as a network buffer, a mapped
+ * file or a part of a larger BitVector.
+ *
+ * A span is a word pointer, a starting bit offset and a width. The offset
+ * does not have to fall on a word boundary; unaligned spans read and write
+ * each of their words as two shifted halves. Bit 0 of a word is its least
+ * significant bit, and a span over bytes treats them as the little-endian
+ * encoding of the words.
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef BITSPAN_HPP
+#define BITSPAN_HPP
+
+#include "BitVector.hpp"
+
+
+/**
+ * ConstBitSpan
+ *
+ * \brief A read-only view of a range of bits
+ *
+ * The span is only valid as long as the memory it views. A BitVector
+ * converts to a span of all of its bits implicitly, without copying.
+ */
+class ConstBitSpan
+{
+public:
+  /**
+   * \brief Creates an empty span
+   */
+  ConstBitSpan()
+    : base(NULL), offset(0), length(0)
+  {
+  }
+  
+  /**
+   * \param words - the words holding the bits
+   * \param offset - the index of the first bit of the span in words
+   * \param length - the width of the span
+   */
+  ConstBitSpan(const word_t *words, size_t offset, size_t length)
+    : base(words + WORD_INDEX_FOR_BIT_IN_ARRAY(offset)),
+      offset(BIT_POSITION_FOR_BIT_IN_WORD(offset)), length(length)
+  {
+  }
+  
+  /**
+   * \brief Creates a span over bytes holding little-endian words
+   *
+   * The span reads the whole aligned words that contain its bits, which may
+   * include a few bytes on either side of the range. Those bytes are never
+   * changed, but they must be readable.
+   *
+   * \param bytes - the bytes holding the bits, with any alignment
+   * \param offset - the index of the first bit of the span in bytes
+   * \param length - the width of the span
+   */
+  ConstBitSpan(const void *bytes, size_t offset, size_t length)
+    : base(NULL), offset(0), length(length)
+  {
+    uintptr_t address = (uintptr_t)bytes;
+    size_t misalignment = address % BYTES_PER_WORD;
+    offset += BYTES_TO_BITS(misalignment);
+    base = (const word_t *)(address - misalignment) +
+      WORD_INDEX_FOR_BIT_IN_ARRAY(offset);
+    this->offset = BIT_POSITION_FOR_BIT_IN_WORD(offset);
+  }
+  
+  /**
+   * \brief Creates a span of all of the bits of a BitVector
+   */
+  template<size_t N, typename A>
+  ConstBitSpan(const BitVector<N, A> &v)
+    : base(v.data()), offset(0), length(v.width())
+  {
+  }
+  
+  /**
+   * \returns the number of bits in the span
+   */
+  size_t width() const
+  {
+    return length;
+  }
+  
+  /**
+   * \returns the number of words needed to hold the bits of the span
+   */
+  size_t wordCount() const
+  {
+    return BITS_TO_WORDS(length);
+  }
+  
+  /**
+   * \returns bits [64 * i, 64 * i + 64) of the span, where the bits beyond
+   *   the end of the span are undefined
+   */
+  word_t word(size_t i) const
+  {
+    word_t x = base[i] >> offset;
+    if (offset != 0 && WORDS_TO_BITS(i + 1) < offset + length)
+      x |= base[i + 1] << (BITS_PER_WORD - offset);
+    return x;
+  }
+  
+  /**
+   * \returns the truth value of the specified bit
+   */
+  bool getBit(size_t index) const
+  {
+    index += offset;
+    return (base[WORD_INDEX_FOR_BIT_IN_ARRAY(index)] &
+      MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index))) != 0;
+  }
+  
+  /**
+   * \returns the truth value of the specified bit
+   */
+  bool operator[](size_t index) const
+  {
+    return getBit(index);
+  }
+  
+  /**
+   * \returns a span of bits [pos, pos + len) of this span
+   */
+  ConstBitSpan subspan(size_t pos, size_t len) const
+  {
+    assert(pos + len <= length && "Subspan must lie within the span");
+    return ConstBitSpan(base, offset + pos, len);
+  }
+  
+  /**
+   * \returns the number of set bits
+   */
+  size_t popcount() const
+  {
+    return countBits(base, offset, offset + length);
+  }
+  
+  /**
+   * \returns the index of the lowest set bit, or width() if there is none
+   */
+  size_t findFirstSet() const
+  {
+    return findNext(0, 0);
+  }
+  
+  /**
+   * \returns the index of the lowest set bit at or above pos, or width() if
+   *   there is none
+   */
+  size_t findNextSet(size_t pos) const
+  {
+    return findNext(pos, 0);
+  }
+  
+  /**
+   * \returns the index of the highest set bit, or width() if there is none
+   */
+  size_t findLastSet() const
+  {
+    return findLast(0);
+  }
+  
+  /**
+   * \returns the index of the lowest clear bit, or width() if there is none
+   */
+  size_t findFirstClear() const
+  {
+    return findNext(0, ~(word_t)0);
+  }
+  
+  /**
+   * \returns the index of the lowest clear bit at or above pos, or width() if
+   *   there is none
+   */
+  size_t findNextClear(size_t pos) const
+  {
+    return findNext(pos, ~(word_t)0);
+  }
+  
+  /**
+   * \returns the index of the highest clear bit, or width() if there is none
+   */
+  size_t findLastClear() const
+  {
+    return findLast(~(word_t)0);
+  }
+  
+  /**
+   * \returns the number of bits needed to represent the value of the span,
+   *   that is, one more than the index of the highest set bit, or 0
+   */
+  size_t bitLength() const
+  {
+    size_t last = findLast(0);
+    return (last == length) ? 0 : last + 1;
+  }
+  
+  friend bool operator==(const ConstBitSpan &lhs, const ConstBitSpan &rhs)
+  {
+    assert(lhs.length == rhs.length && "Operands must have equal widths");
+    
+    if (lhs.length == 0)
+      return true;
+    
+    // Spans with the same alignment compare their words in place, with the
+    // partial words at either end masked
+    if (lhs.offset == rhs.offset)
+    {
+      const word_t *a = lhs.base;
+      const word_t *b = rhs.base;
+      size_t lastidx = lhs.lastIndex();
+      word_t head = lhs.headMask();
+      word_t tail = lhs.tailMask();
+      if (lastidx == 0)
+        return ((a[0] ^ b[0]) & head & tail) == 0;
+      return ((a[0] ^ b[0]) & head) == 0 &&
+        ((a[lastidx] ^ b[lastidx]) & tail) == 0 &&
+        wordKernels().equalWords(a + 1, b + 1, lastidx - 1);
+    }
+    
+    size_t lastidx = lhs.wordCount() - 1;
+    word_t mask = MASK_FOR_MOST_SIGNIFICANT_WORD(lhs.length);
+    if (((lhs.word(lastidx) ^ rhs.word(lastidx)) & mask) != 0)
+      return false;
+    for (size_t i = 0; i < lastidx; i ++)
+      if (lhs.word(i) != rhs.word(i))
+        return false;
+    return true;
+  }
+  
+  friend bool operator!=(const ConstBitSpan &lhs, const ConstBitSpan &rhs)
+  {
+    return !(lhs == rhs);
+  }
+  
+  /**
+   * \brief Compares the spans as unsigned integers, like BitVector
+   */
+  friend bool operator<(const ConstBitSpan &lhs, const ConstBitSpan &rhs)
+  {
+    assert(lhs.length == rhs.length && "Operands must have equal widths");
+    
+    if (lhs.length == 0)
+      return false;
+    
+    // Spans with the same alignment start with the most significant word in
+    // place and let the kernel find the highest word that differs below it
+    if (lhs.offset == rhs.offset)
+    {
+      const word_t *a = lhs.base;
+      const word_t *b = rhs.base;
+      size_t lastidx = lhs.lastIndex();
+      word_t mask = lhs.tailMask();
+      if (lastidx == 0)
+        mask &= lhs.headMask();
+      word_t x = a[lastidx] & mask;
+      word_t y = b[lastidx] & mask;
+      if (x != y || lastidx == 0)
+        return x < y;
+      
+      size_t i = wordKernels().lastDifference(a + 1, b + 1, lastidx - 1);
+      if (i != 0)
+        return a[i] < b[i];
+      
+      mask = lhs.headMask();
+      return (a[0] & mask) < (b[0] & mask);
+    }
+    
+    size_t i = lhs.wordCount() - 1;
+    word_t mask = MASK_FOR_MOST_SIGNIFICANT_WORD(lhs.length);
+    word_t x = lhs.word(i) & mask;
+    word_t y = rhs.word(i) & mask;
+    while (x == y && i > 0)
+    {
+      -- i;
+      x = lhs.word(i);
+      y = rhs.word(i);
+    }
+    return x < y;
+  }
+  
+  friend bool operator<=(const ConstBitSpan &lhs, const ConstBitSpan &rhs)
+  {
+    return !(rhs < lhs);
+  }
+  
+  friend bool operator>(const ConstBitSpan &lhs, const ConstBitSpan &rhs)
+  {
+    return rhs < lhs;
+  }
+  
+  friend bool operator>=(const ConstBitSpan &lhs, const ConstBitSpan &rhs)
+  {
+    return !(lhs < rhs);
+  }
+
+protected:
+  /**
+   * \returns the index of the word of base holding the last bit
+   */
+  size_t lastIndex() const
+  {
+    return WORD_INDEX_FOR_BIT_IN_ARRAY(offset + length - 1);
+  }
+  
+  /**
+   * \returns bitmask of the bits of the span in base[0]
+   */
+  word_t headMask() const
+  {
+    return ~MASK_WITH_LOWER_BITS(offset);
+  }
+  
+  /**
+   * \returns bitmask of the bits of the span in base[lastIndex()]
+   */
+  word_t tailMask() const
+  {
+    return MASK_FOR_MOST_SIGNIFICANT_WORD(offset + length);
+  }
+  
+  /**
+   * \brief Finds the lowest bit at or above pos that differs from the bits of
+   * fill
+   *
+   * \returns the index of the bit, or width() if there is none
+   */
+  size_t findNext(size_t pos, word_t fill) const
+  {
+    if (pos >= length)
+      return length;
+    return findNextBit(base, offset + pos, offset + length, fill) - offset;
+  }
+  
+  /**
+   * \brief Finds the highest bit that differs from the bits of fill
+   *
+   * \returns the index of the bit, or width() if there is none
+   */
+  size_t findLast(word_t fill) const
+  {
+    return findLastBit(base, offset, offset + length, fill) - offset;
+  }
+  
+  /**
+   * \brief The word holding the first bit of the span
+   */
+  const word_t *base;
+  
+  /**
+   * \brief The index of the first bit of the span in base[0], less than
+   * BITS_PER_WORD
+   */
+  size_t offset;
+  
+  /**
+   * \brief The number of bits in the span
+   */
+  size_t length;
+  
+  friend class BitSpan;
+};
+
+
+/**
+ * BitSpan
+ *
+ * \brief A view of a range of bits that can change them
+ *
+ * Changing the bits of a span leaves the bits around it as they were, but
+ * the partial words at either end are rewritten whole. Two threads may
+ * therefore not change disjoint spans that share a word.
+ *
+ * Assigning one span to another makes it view the same bits, as with other
+ * views; use assign() to copy the bits. The operand of a compound assignment
+ * must not overlap the span unless the two are the same.
+ */
+class BitSpan : public ConstBitSpan
+{
+public:
+  /**
+   * \brief Creates an empty span
+   */
+  BitSpan()
+  {
+  }
+  
+  /**
+   * \param words - the words holding the bits
+   * \param offset - the index of the first bit of the span in words
+   * \param length - the width of the span
+   */
+  BitSpan(word_t *words, size_t offset, size_t length)
+    : ConstBitSpan(words, offset, length)
+  {
+  }
+  
+  /**
+   * \brief Creates a span over bytes holding little-endian words
+   *
+   * \see ConstBitSpan::ConstBitSpan(const void *, size_t, size_t)
+   */
+  BitSpan(void *bytes, size_t offset, size_t length)
+    : ConstBitSpan((const void *)bytes, offset, length)
+  {
+  }
+  
+  /**
+   * \brief Creates a span of all of the bits of a BitVector
+   */
+  template<size_t N, typename A>
+  BitSpan(BitVector<N, A> &v)
+    : ConstBitSpan(v.data(), 0, v.width())
+  {
+  }
+  
+  /**
+   * \returns a span of bits [pos, pos + len) of this span
+   */
+  BitSpan subspan(size_t pos, size_t len) const
+  {
+    assert(pos + len <= length && "Subspan must lie within the span");
+    return BitSpan(words(), offset + pos, len);
+  }
+  
+  /**
+   * \brief Replaces bits [64 * i, 64 * i + 64) of the span, or as many of
+   * them as the span has
+   */
+  void setWord(size_t i, word_t x)
+  {
+    word_t *w = words();
+    size_t remaining = length - WORDS_TO_BITS(i);
+    word_t mask = (remaining >= BITS_PER_WORD) ? ~(word_t)0
+      : MASK_WITH_LOWER_BITS(remaining);
+    x &= mask;
+    
+    w[i] = (w[i] & ~(mask << offset)) | (x << offset);
+    if (offset != 0 && (mask >> (BITS_PER_WORD - offset)) != 0)
+    {
+      size_t shift = BITS_PER_WORD - offset;
+      w[i + 1] = (w[i + 1] & ~(mask >> shift)) | (x >> shift);
+    }
+  }
+  
+  /**
+   * \param index - the index of the bit
+   * \param x - true if the bit should be set to 1, false otherwise
+   */
+  void setBit(size_t index, bool x)
+  {
+    index += offset;
+    word_t &w = words()[WORD_INDEX_FOR_BIT_IN_ARRAY(index)];
+    if (x)
+      w |= MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index));
+    else
+      w &= ~MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index));
+  }
+  
+  /**
+   * \param index - the index of the bit
+   */
+  void flipBit(size_t index)
+  {
+    index += offset;
+    words()[WORD_INDEX_FOR_BIT_IN_ARRAY(index)] ^=
+      MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index));
+  }
+  
+  /**
+   * \brief Copies the bits of a span of equal width into this one
+   */
+  BitSpan &assign(const ConstBitSpan &rhs)
+  {
+    combine(rhs, copyWords, [](word_t, word_t y) { return y; });
+    return *this;
+  }
+  
+  BitSpan &operator|=(const ConstBitSpan &rhs)
+  {
+    combine(rhs, wordKernels().orWords,
+      [](word_t x, word_t y) { return x | y; });
+    return *this;
+  }
+  
+  BitSpan &operator&=(const ConstBitSpan &rhs)
+  {
+    combine(rhs, wordKernels().andWords,
+      [](word_t x, word_t y) { return x & y; });
+    return *this;
+  }
+  
+  BitSpan &operator^=(const ConstBitSpan &rhs)
+  {
+    combine(rhs, wordKernels().xorWords,
+      [](word_t x, word_t y) { return x ^ y; });
+    return *this;
+  }
+  
+  /**
+   * \brief Flips every bit of the span
+   */
+  BitSpan &complement()
+  {
+    if (length == 0)
+      return *this;
+    
+    word_t *w = words();
+    size_t lastidx = lastIndex();
+    word_t head = headMask();
+    word_t tail = tailMask();
+    if (lastidx == 0)
+    {
+      w[0] ^= head & tail;
+      return *this;
+    }
+    
+    w[0] ^= head;
+    wordKernels().notWords(w + 1, lastidx - 1);
+    w[lastidx] ^= tail;
+    return *this;
+  }
+
+protected:
+  /**
+   * \returns the word holding the first bit of the span
+   */
+  word_t *words() const
+  {
+    return const_cast<word_t *>(base);
+  }
+  
+  /**
+   * \brief Copies n words, as the kernel for assign()
+   */
+  static void copyWords(word_t *dst, const word_t *src, size_t n)
+  {
+    memmove(dst, src, WORDS_TO_BYTES(n));
+  }
+  
+  /**
+   * \brief Replaces the bits of the span with op(bits, bits of rhs)
+   *
+   * When the spans have the same alignment the partial words at either end
+   * are merged under a mask and the whole words in between go to the word
+   * kernel. Otherwise every word of rhs is shifted into place first.
+   *
+   * \param kernel - applies the operation to n whole words in place
+   * \param op - applies the operation to one word
+   */
+  template<typename Op>
+  void combine(const ConstBitSpan &rhs,
+    void (*kernel)(word_t *, const word_t *, size_t), Op op)
+  {
+    assert(length == rhs.width() && "Operands must have equal widths");
+    
+    if (length == 0)
+      return;
+    
+    if (offset == rhs.offset)
+    {
+      word_t *a = words();
+      const word_t *b = rhs.base;
+      size_t lastidx = lastIndex();
+      word_t head = headMask();
+      word_t tail = tailMask();
+      if (lastidx == 0)
+      {
+        word_t mask = head & tail;
+        a[0] = (a[0] & ~mask) | (op(a[0], b[0]) & mask);
+        return;
+      }
+      
+      a[0] = (a[0] & ~head) | (op(a[0], b[0]) & head);
+      a[lastidx] = (a[lastidx] & ~tail) | (op(a[lastidx], b[lastidx]) & tail);
+      kernel(a + 1, b + 1, lastidx - 1);
+      return;
+    }
+    
+    for (size_t i = 0; i < wordCount(); i ++)
+      setWord(i, op(word(i), rhs.word(i)));
+  }
+};
+
+#endif // BITSPAN_HPP
@@ -29,10 +29,25 @@
  * THE SOFTWARE.
  */
 
+#ifndef BITVECTOR_HPP
+#define BITVECTOR_HPP
+
 #include <string>
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 
 /**
@@ -143,9 +158,6 @@ typedef uint32_t halfword_t;
  * \def WORD_INDEX_FOR_BIT_IN_ARRAY(n)
  * \brief Returns the index of the word in the array that contains this bit
  *
- * Note that this index may exceed the in-object storage and may need to be
- * converted to an offset within the additional heap storage.
- *
  * For example, the 1 bit is in the 7th word, in position 3:
  *
  * <PRE>
@@ -173,646 +185,6187 @@ typedef uint32_t halfword_t;
 #define BIT_POSITION_FOR_BIT_IN_WORD(n) ((n) % BITS_PER_WORD)
 
 /**
- * \def OFFSET_OF_WORD_IN_HEAP(n)
- * \brief Computes the offset of a word relative to heap storage
- * \param n - the word index
- * \returns the offset of the word from the start of heap storage, or a
- * negative number if the word is not on the heap
- */
-#define OFFSET_OF_WORD_IN_HEAP(n) (ssize_t)((n) - BITS_TO_WORDS(N))
-
-/**
- * \def WORD_FROM(v, n)
- * \brief Used to refer to a word by its index without caring where that word
- * is stored
+ * \def MASK_FOR_MOST_SIGNIFICANT_WORD(n)
+ * \brief Creates a bitmask selecting the bits of the most significant word
+ * that are in use by an n-bit BitVector
  *
- * \param v - BitVector object containing this word
- * \param n - the word index
- * \returns when used as an R-value, the contents of the word at index n
- */
-#define WORD_FROM(v, n) \
-  (*((OFFSET_OF_WORD_IN_HEAP(n) < 0) \
-    ? (v).words + (n) \
-    : (v).morewords + OFFSET_OF_WORD_IN_HEAP(n)))
-
-/**
- * \def WORD(n)
- * \brief Shortcut for WORD_FROM(*this, n)
- * \see WORD_FROM(n)
+ * Unlike MASK_WITH_LOWER_BITS(n % BITS_PER_WORD), this selects the whole word
+ * when n is a multiple of the word size.
+ *
+ * \param n - the width of the BitVector in bits
+ * \returns bitmask of the used bits in the most significant word
  */
-#define WORD(n) WORD_FROM(*this, (n))
+#define MASK_FOR_MOST_SIGNIFICANT_WORD(n) \
+  (BIT_POSITION_FOR_BIT_IN_WORD(n) == 0 \
+    ? ~(word_t)0 \
+    : MASK_WITH_LOWER_BITS(BIT_POSITION_FOR_BIT_IN_WORD(n)))
 
 /**
- * \def HEAP_SIZE_IN_WORDS(n)
- * \brief Computes the number of words allocated on the heap
+ * \def BITVECTOR_X86_KERNELS
+ * \brief Defined when the SSE2, AVX2 and AVX-512 word kernels are compiled
  *
- * Will be a bogus value if there is no heap storage, so check that the pointer
- * is non-NULL also.
- * 
- * \params n - the size of the vector in bits
- * \returns the size of the heap storage in words
+ * The kernels are built with per-function target attributes, so the header
+ * does not need to be compiled with -mavx2 and friends; the best kernel set
+ * for the running CPU is chosen at runtime. Define BITVECTOR_NO_SIMD to only
+ * use the portable scalar kernels.
  */
-#define HEAP_SIZE_IN_WORDS(n) (BITS_TO_WORDS(n) - BITS_TO_WORDS(N))
+#if !defined(BITVECTOR_NO_SIMD) && defined(__GNUC__) && \
+  (defined(__x86_64__) || defined(__i386__))
+#define BITVECTOR_X86_KERNELS 1
+#include <immintrin.h>
+#endif
 
 
 /**
- * BitVector
+ * WordKernels
  *
- * \brief A fixed-length array of bits that supports efficient arithmetic
- * operations.
+ * \brief A table of functions implementing the bulk operations on contiguous
+ * words, all written for one instruction set
  *
- * The array is created with some number of bits (N) in-object, which allows it
- * to avoid heap allocation when the actual number of elements is below that
- * threshold. This allows normal "small" cases to be fast without losing
- * generality for large inputs.
+ * The operations work on whole words. Callers are responsible for masking the
+ * unused bits of a partial most significant word where it matters, as in
+ * BitVector::operator==.
  *
- * Words are ordered least significant to most significant. Ordering of bits
- * within words is architecture dependent.
+ * Use wordKernels() to get the table best suited to the running CPU.
  */
-template<size_t N>
-class BitVector
+struct WordKernels
 {
-public:
-  
-  
   /**
-   * BitRef
-   *
-   * \brief Like std::bitset::reference, allows reading and setting a single
-   * bit within the BitVector.
-   *
-   * These wrap BitVector::getBit, BitVector::setBit, and BitVector::flipBit.
+   * \brief Name of the instruction set, for diagnostics and benchmarks
    */
-  class BitRef
-  {
-  public:
-    BitRef &operator=(bool x)
-    {
-      bv.setBit(index, x);
-    }
-    
-    BitRef &operator=(const BitRef &other)
-    {
-      bv.setBit(index, (bool)other);
-    }
-    
-    void flip()
-    {
-      bv.flipBit(index);
-    }
-    
-    operator bool() const
-    {
-      return ((const BitVector<N> &)bv).operator[](index);
-    }
-    
-  private:
-    friend class BitVector;
-    
-    BitRef() { }
-    BitRef(BitVector<N> &BV, size_t Index) : bv(BV), index(Index) { }
-    
-    /**
-     * \brief The BitVector this BitRef refers to
-     */
-    BitVector<N> &bv;
-    
-    /**
-     * \brief The position of the referenced bit within the BitVector
-     */
-    size_t index;
-  };
-  
+  const char *name;
   
   /**
-   * \brief Constructs a BitVector with the capacity for n bits
-   *
-   * If n is greater than N, the remaining required space is allocated on the
-   * heap. Choose N wisely to avoid this allocation.
-   *
-   * \param n - the length of the BitVector
-   * \param clear - if set, memory allocated on the heap is cleared. Pass false
-   *   if the data on the heap is going to be overwritten immediately.
+   * \brief Computes dst[i] |= src[i] for i < n
    */
-  BitVector(size_t n, bool clear = true) : length(0), morewords(nullptr)
-  {
-    // Unset all bits; the default value of a BitVector is 0
-    memset(words, 0, sizeof(words));
-    
-    // Resize to the specified size to allocate additional storage on the heap
-    resize(n, clear);
-  }
-  
-  BitVector(const BitVector &other) : length(0), morewords(nullptr)
-  {
-    copyFrom(other);
-  }
+  void (*orWords)(word_t *dst, const word_t *src, size_t n);
   
   /**
-   * \brief Constructs a BitVector from a string
-   *
-   * Only base 2 (binary) strings with no prefix are currently supported.
-   *
-   * \param string - a C string containing digits
-   * \param radix - the base of the digits in the string (must be 2)
+   * \brief Computes dst[i] &= src[i] for i < n
    */
-  BitVector(const char *string, int radix) : length(0), morewords(nullptr)
-  {
-    assert(radix == 2 && "Only binary is supported");
-    
-    // Resize to one bit per character
-    resize(strlen(string), false);
-    if (length == 0)
-      return;
-    
-    // Copy bits from the string
-    const char *c = string + length - 1;
-    for (size_t i = 0; i <= length; ++i, --c)
-      setBit(i, *c == '1');
-  }
-  
-  ~BitVector()
-  {
-    delete [] morewords;
-  }
-  
-  size_t width() const
-  {
-    return length;
-  }
+  void (*andWords)(word_t *dst, const word_t *src, size_t n);
   
   /**
-   * \brief Generates a string representing the BitVector
-   * 
-   * Only base 2 (binary) strings are currently supported. Prefixes are not
-   * prepended to the output.
-   *
-   * \param radix - the base to output in (must be 2)
+   * \brief Computes dst[i] ^= src[i] for i < n
    */
-  std::string toString(int radix = 2) const
-  {
-    // The output is guaranteed to be at most this long
-    char *s = new char[length + 1];
-    
-    if (radix == 2)
-    {
-      // Output bits from most to least significant
-      for (size_t i = length, j = 0; i >= 2; --i, ++j)
-        s[i] = getBit(j) ? '1' : '0';
-      s[length] = '\0';
-    }
-    else
-    {
-      assert(false && "Not a supported radix");
-    }
-    
-    // Return the string as a std::string
-    std::string str(s);
-    delete [] s;
-    return str;
-  }
+  void (*xorWords)(word_t *dst, const word_t *src, size_t n);
   
   /**
-   * \param index - the index of the bit
-   * \returns true if the bit is 1, false otherwise
+   * \brief Computes dst[i] = ~dst[i] for i < n
    */
-  bool getBit(size_t index) const
-  {
-    size_t wordidx = WORD_INDEX_FOR_BIT_IN_ARRAY(index);
-    size_t position = BIT_POSITION_FOR_BIT_IN_WORD(index);
-    return (WORD(wordidx) & MASK_WITH_BIT(position)) != 0;
-  }
+  void (*notWords)(word_t *dst, size_t n);
   
   /**
-   * \param index - the index of the bit
-   * \param x - true if the bit should be set to 1, false otherwise
+   * \returns true if a[i] == b[i] for all i < n
    */
-  void setBit(size_t index, bool x)
-  {
-    size_t wordidx = WORD_INDEX_FOR_BIT_IN_ARRAY(index);
-    size_t position = BIT_POSITION_FOR_BIT_IN_WORD(index);
-    if (x)
-      WORD(wordidx) |= MASK_WITH_BIT(position);
-    else
-      WORD(wordidx) &= ~(MASK_WITH_BIT(position));
-  }
+  bool (*equalWords)(const word_t *a, const word_t *b, size_t n);
   
   /**
-   * \param index - the index of the bit
+   * \returns one more than the highest index i < n where a[i] != b[i], or 0
+   *   if the words are all equal
    */
-  void flipBit(size_t index)
-  {
-    size_t wordidx = WORD_INDEX_FOR_BIT_IN_ARRAY(index);
-    size_t position = BIT_POSITION_FOR_BIT_IN_WORD(index);
-    WORD(wordidx) ^= MASK_WITH_BIT(position);
-  }
+  size_t (*lastDifference)(const word_t *a, const word_t *b, size_t n);
   
   /**
-   * \returns the truth value of the specified bit
+   * \returns the lowest index i < n where w[i] != fill, or n if there is none
    */
-  bool operator[](size_t index) const
-  {
-    return getBit(index);
-  }
+  size_t (*skipFillForward)(const word_t *w, size_t n, word_t fill);
   
   /**
-   * \returns a BitRef for the specified bit, supporting assignment
+   * \returns one more than the highest index i < n where w[i] != fill, or 0 if
+   *   there is none
    */
-  BitRef operator[](size_t index)
-  {
-    return BitRef(*this, index);
-  }
-  
-  BitVector &operator|=(const BitVector &rhs)
-  {
-    assert(length == rhs.length && "Operands must have equal widths");
-    
-    for (size_t i = 0; i < BITS_TO_WORDS(length); i ++)
-      WORD(i) |= WORD_FROM(rhs, i);
-  }
-  
-  BitVector operator|(const BitVector &rhs) const
-  {
-    BitVector result(*this);
-    result.operator|=(rhs);
-    return result;
-  }
-  
-  BitVector &operator&=(const BitVector &rhs)
-  {
-    assert(length == rhs.length && "Operands must have equal widths");
-    
-    for (size_t i = 0; i < BITS_TO_WORDS(length); i ++)
-      WORD(i) &= WORD_FROM(rhs, i);
-  }
-  
-  BitVector operator&(const BitVector &rhs) const
-  {
-    BitVector result(*this);
-    result.operator&=(rhs);
-    return result;
-  }
-  
-  BitVector &operator^=(const BitVector &rhs)
-  {
-    assert(length == rhs.length && "Operands must have equal widths");
-    
-    for (size_t i = 0; i < BITS_TO_WORDS(length); i ++)
-      WORD(i) &= WORD_FROM(rhs, i);
-  }
-  
-  BitVector operator^(const BitVector &rhs) const
-  {
-    BitVector result(*this);
-    result.operator^=(rhs);
-    return result;
-  }
+  size_t (*skipFillBackward)(const word_t *w, size_t n, word_t fill);
   
   /**
-   * \brief Logical left shift
+   * \brief Accumulates n stripes of HASH_STRIPE_WORDS words into the eight
+   * lanes of acc, numbering the first stripe first
    *
-   * The endianness of storage confuses things a little bit here. Left shift
-   * slides bits towards the more significant end.
+   * See hashStripesScalar() for the computation, which every kernel performs
+   * identically.
    */
-  BitVector &operator<<=(size_t count)
+  void (*hashStripes)(word_t *acc, const word_t *w, size_t n, size_t first);
+};
+
+/**
+ * \def HASH_STRIPE_WORDS
+ * \brief Number of words hashed together by WordKernels::hashStripes
+ */
+#define HASH_STRIPE_WORDS 8
+
+/**
+ * \def HASH_BLOCK_STRIPES
+ * \brief Number of stripes between scrambles of the hash accumulators
+ */
+#define HASH_BLOCK_STRIPES 16
+
+/**
+ * \returns HASH_BLOCK_STRIPES + HASH_STRIPE_WORDS pseudo-random words used as
+ * keys by hashStripes and hashBits()
+ */
+inline const word_t *hashSecret()
+{
+  static const word_t secret[HASH_BLOCK_STRIPES + HASH_STRIPE_WORDS] = {
+    0x2CB0F69F4ABEA221ULL, 0x9417034723148989ULL, 0xDD555950609DFE03ULL,
+    0xDBAFB150DEB12800ULL, 0x7E789B2E6C442CB6ULL, 0xF41E5636C7E4F8C4ULL,
+    0x0959D150F8FBA7E4ULL, 0xA97316F13CDB9EEAULL, 0x74CD8258F9520068ULL,
+    0x55C74A62E116868BULL, 0xD2F4C799A2023CBDULL, 0xDF98CB79A37B51B9ULL,
+    0x396F5885524F3905ULL, 0xAF1D56386CA3B276ULL, 0xA9FFBE6B5104E85AULL,
+    0x6BD0C51B9FD533B3ULL, 0x980CE91C50AB4B56ULL, 0x28AC395780FE62C5ULL,
+    0x768912E3A6BCEDC7ULL, 0x50B3E8C9332C7C88ULL, 0xCE3BBFE520BD47DAULL,
+    0xCBA6C8E8E0BB7C4FULL, 0xBF194DB8434A346DULL, 0x7D8F2A7B60416D7FULL
+  };
+  return secret;
+}
+
+/**
+ * \brief Portable implementations of the WordKernels
+ */
+inline void orWordsScalar(word_t *dst, const word_t *src, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
+    dst[i] |= src[i];
+}
+
+inline void andWordsScalar(word_t *dst, const word_t *src, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
+    dst[i] &= src[i];
+}
+
+inline void xorWordsScalar(word_t *dst, const word_t *src, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
+    dst[i] ^= src[i];
+}
+
+inline void notWordsScalar(word_t *dst, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
+    dst[i] = ~dst[i];
+}
+
+inline bool equalWordsScalar(const word_t *a, const word_t *b, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
   {
-    if (count == 0)
-      return;
-    
-    // Easy case: count is a multiple of 8, so we can just slide bytes around
-    if (count % BITS_PER_BYTE == 0)
+    if (a[i] != b[i])
+      return false;
+  }
+  return true;
+}
+
+inline size_t lastDifferenceScalar(const word_t *a, const word_t *b, size_t n)
+{
+  while (n > 0 && a[n - 1] == b[n - 1])
+    -- n;
+  return n;
+}
+
+inline size_t skipFillForwardScalar(const word_t *w, size_t n, word_t fill)
+{
+  size_t i = 0;
+  while (i < n && w[i] == fill)
+    ++ i;
+  return i;
+}
+
+inline size_t skipFillBackwardScalar(const word_t *w, size_t n, word_t fill)
+{
+  while (n > 0 && w[n - 1] == fill)
+    -- n;
+  return n;
+}
+
+/**
+ * \brief Accumulates stripes of words into eight lanes, in the manner of XXH3
+ *
+ * Word j of stripe s is XORed with key word (s % HASH_BLOCK_STRIPES) + j, and
+ * the product of the two halves of the result is added to lane j, while the
+ * word itself is added to lane j ^ 1. Every lane only needs a 32 x 32-bit
+ * multiplication, which vector units do several at a time. After the last
+ * stripe of each block, the lanes are scrambled with the final key words.
+ */
+inline void hashStripesScalar(word_t *acc, const word_t *w, size_t n,
+  size_t first)
+{
+  const word_t *secret = hashSecret();
+  for (size_t s = 0; s < n; s ++, w += HASH_STRIPE_WORDS)
+  {
+    size_t stripe = (first + s) % HASH_BLOCK_STRIPES;
+    for (size_t j = 0; j < HASH_STRIPE_WORDS; j ++)
     {
-      slideBytesRight(count / 8); // Yes, _right_.
+      word_t d = w[j] ^ secret[stripe + j];
+      acc[j ^ 1] += w[j];
+      acc[j] += (d & 0xFFFFFFFF) * (d >> 32);
     }
-    else
+    if (stripe == HASH_BLOCK_STRIPES - 1)
     {
-      assert(false && "Shift amount is not supported yet");
+      for (size_t j = 0; j < HASH_STRIPE_WORDS; j ++)
+      {
+        word_t a = acc[j] ^ (acc[j] >> 47);
+        acc[j] = (a ^ secret[HASH_BLOCK_STRIPES + j]) * 0x9E3779B1;
+      }
     }
-    
-    return *this;
   }
-  
-  BitVector operator<<(size_t count)
-  {
-    BitVector result(*this);
-    result <<= count;
-    return result;
+}
+
+#ifdef BITVECTOR_X86_KERNELS
+
+/**
+ * \def DEFINE_WORD_KERNELS(isa, isaTarget, vec_t, load, store, opOr, opAnd,
+ *   opXor, ones, broadcast, isZero)
+ * \brief Defines the WordKernels functions for one x86 vector extension
+ *
+ * Every kernel processes two vectors per iteration and finishes the remaining
+ * words with the scalar kernels.
+ *
+ * \param isa - suffix of the generated function names
+ * \param isaTarget - the target attribute the functions are compiled for
+ * \param vec_t - the vector register type
+ * \param load - unaligned load intrinsic
+ * \param store - unaligned store intrinsic
+ * \param opOr, opAnd, opXor - bitwise intrinsics
+ * \param ones - expression producing a vector with all bits set
+ * \param broadcast - intrinsic filling a vector with copies of a word
+ * \param isZero - expression testing whether the vector v is all zeros
+ */
+#define DEFINE_WORD_KERNELS(isa, isaTarget, vec_t, load, store, opOr, opAnd, \
+  opXor, ones, broadcast, isZero) \
+  \
+  static const size_t WORDS_PER_VECTOR_##isa = sizeof(vec_t) / BYTES_PER_WORD; \
+  \
+  __attribute__((target(isaTarget))) \
+  inline void orWords##isa(word_t *dst, const word_t *src, size_t n) \
+  { \
+    size_t i = 0; \
+    for (; i + 2 * WORDS_PER_VECTOR_##isa <= n; i += 2 * WORDS_PER_VECTOR_##isa) \
+    { \
+      vec_t *d = (vec_t *)(dst + i); \
+      const vec_t *s = (const vec_t *)(src + i); \
+      vec_t x0 = opOr(load(d), load(s)); \
+      vec_t x1 = opOr(load(d + 1), load(s + 1)); \
+      store(d, x0); \
+      store(d + 1, x1); \
+    } \
+    orWordsScalar(dst + i, src + i, n - i); \
+  } \
+  \
+  __attribute__((target(isaTarget))) \
+  inline void andWords##isa(word_t *dst, const word_t *src, size_t n) \
+  { \
+    size_t i = 0; \
+    for (; i + 2 * WORDS_PER_VECTOR_##isa <= n; i += 2 * WORDS_PER_VECTOR_##isa) \
+    { \
+      vec_t *d = (vec_t *)(dst + i); \
+      const vec_t *s = (const vec_t *)(src + i); \
+      vec_t x0 = opAnd(load(d), load(s)); \
+      vec_t x1 = opAnd(load(d + 1), load(s + 1)); \
+      store(d, x0); \
+      store(d + 1, x1); \
+    } \
+    andWordsScalar(dst + i, src + i, n - i); \
+  } \
+  \
+  __attribute__((target(isaTarget))) \
+  inline void xorWords##isa(word_t *dst, const word_t *src, size_t n) \
+  { \
+    size_t i = 0; \
+    for (; i + 2 * WORDS_PER_VECTOR_##isa <= n; i += 2 * WORDS_PER_VECTOR_##isa) \
+    { \
+      vec_t *d = (vec_t *)(dst + i); \
+      const vec_t *s = (const vec_t *)(src + i); \
+      vec_t x0 = opXor(load(d), load(s)); \
+      vec_t x1 = opXor(load(d + 1), load(s + 1)); \
+      store(d, x0); \
+      store(d + 1, x1); \
+    } \
+    xorWordsScalar(dst + i, src + i, n - i); \
+  } \
+  \
+  __attribute__((target(isaTarget))) \
+  inline void notWords##isa(word_t *dst, size_t n) \
+  { \
+    vec_t m = ones; \
+    size_t i = 0; \
+    for (; i + 2 * WORDS_PER_VECTOR_##isa <= n; i += 2 * WORDS_PER_VECTOR_##isa) \
+    { \
+      vec_t *d = (vec_t *)(dst + i); \
+      vec_t x0 = opXor(load(d), m); \
+      vec_t x1 = opXor(load(d + 1), m); \
+      store(d, x0); \
+      store(d + 1, x1); \
+    } \
+    notWordsScalar(dst + i, n - i); \
+  } \
+  \
+  __attribute__((target(isaTarget))) \
+  inline bool equalWords##isa(const word_t *a, const word_t *b, size_t n) \
+  { \
+    size_t i = 0; \
+    for (; i + 2 * WORDS_PER_VECTOR_##isa <= n; i += 2 * WORDS_PER_VECTOR_##isa) \
+    { \
+      const vec_t *x = (const vec_t *)(a + i); \
+      const vec_t *y = (const vec_t *)(b + i); \
+      vec_t v = opOr(opXor(load(x), load(y)), opXor(load(x + 1), load(y + 1))); \
+      if (!(isZero)) \
+        return false; \
+    } \
+    return equalWordsScalar(a + i, b + i, n - i); \
+  } \
+  \
+  __attribute__((target(isaTarget))) \
+  inline size_t lastDifference##isa(const word_t *a, const word_t *b, size_t n) \
+  { \
+    while (n >= WORDS_PER_VECTOR_##isa) \
+    { \
+      const vec_t *x = (const vec_t *)(a + n - WORDS_PER_VECTOR_##isa); \
+      const vec_t *y = (const vec_t *)(b + n - WORDS_PER_VECTOR_##isa); \
+      vec_t v = opXor(load(x), load(y)); \
+      if (!(isZero)) \
+        break; \
+      n -= WORDS_PER_VECTOR_##isa; \
+    } \
+    return lastDifferenceScalar(a, b, n); \
+  } \
+  \
+  __attribute__((target(isaTarget))) \
+  inline size_t skipFillForward##isa(const word_t *w, size_t n, word_t fill) \
+  { \
+    vec_t f = broadcast((long long)fill); \
+    size_t i = 0; \
+    for (; i + 2 * WORDS_PER_VECTOR_##isa <= n; i += 2 * WORDS_PER_VECTOR_##isa) \
+    { \
+      const vec_t *x = (const vec_t *)(w + i); \
+      vec_t v = opOr(opXor(load(x), f), opXor(load(x + 1), f)); \
+      if (!(isZero)) \
+        break; \
+    } \
+    return i + skipFillForwardScalar(w + i, n - i, fill); \
+  } \
+  \
+  __attribute__((target(isaTarget))) \
+  inline size_t skipFillBackward##isa(const word_t *w, size_t n, word_t fill) \
+  { \
+    vec_t f = broadcast((long long)fill); \
+    while (n >= WORDS_PER_VECTOR_##isa) \
+    { \
+      const vec_t *x = (const vec_t *)(w + n - WORDS_PER_VECTOR_##isa); \
+      vec_t v = opXor(load(x), f); \
+      if (!(isZero)) \
+        break; \
+      n -= WORDS_PER_VECTOR_##isa; \
+    } \
+    return skipFillBackwardScalar(w, n, fill); \
   }
-  
-  BitVector &operator++()
-  {
-    // If incrementing a lower-order word causes an overflow to 0, then we need
-    // to increment the next word as well to carry.
-    for (size_t i = 0; i < BITS_TO_WORDS(length); i ++)
-    {
-      if ((++ WORD(i)) != 0)
+
+DEFINE_WORD_KERNELS(SSE2, "sse2", __m128i,
+  _mm_loadu_si128, _mm_storeu_si128, _mm_or_si128, _mm_and_si128,
+  _mm_xor_si128, _mm_set1_epi32(-1), _mm_set1_epi64x,
+  _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF)
+
+DEFINE_WORD_KERNELS(AVX2, "avx2", __m256i,
+  _mm256_loadu_si256, _mm256_storeu_si256, _mm256_or_si256, _mm256_and_si256,
+  _mm256_xor_si256, _mm256_set1_epi32(-1), _mm256_set1_epi64x,
+  _mm256_testz_si256(v, v))
+
+DEFINE_WORD_KERNELS(AVX512, "avx512f", __m512i,
+  _mm512_loadu_si512, _mm512_storeu_si512, _mm512_or_si512, _mm512_and_si512,
+  _mm512_xor_si512, _mm512_set1_epi32(-1), _mm512_set1_epi64,
+  _mm512_test_epi64_mask(v, v) == 0)
+
+/**
+ * \def DEFINE_HASH_KERNEL(isa, isaTarget, vec_t, load, store, opXor, add64,
+ *   mul32, shuffle32, shiftRight64, shiftLeft64, broadcast)
+ * \brief Defines WordKernels::hashStripes for one x86 vector extension
+ *
+ * The lanes stay in registers across stripes. Swapping the words of each
+ * 128-bit half of a vector moves word j to lane j ^ 1.
+ *
+ * \param mul32 - intrinsic multiplying the low 32 bits of each word
+ * \param shuffle32 - intrinsic permuting the 32-bit parts of each 128 bits
+ */
+#define DEFINE_HASH_KERNEL(isa, isaTarget, vec_t, load, store, opXor, add64, \
+  mul32, shuffle32, shiftRight64, shiftLeft64, broadcast) \
+  \
+  __attribute__((target(isaTarget))) \
+  inline void hashStripes##isa(word_t *acc, const word_t *w, size_t n, \
+    size_t first) \
+  { \
+    static const size_t VECTORS = HASH_STRIPE_WORDS / WORDS_PER_VECTOR_##isa; \
+    const word_t *secret = hashSecret(); \
+    vec_t prime = broadcast(0x9E3779B1); \
+    vec_t a[VECTORS]; \
+    for (size_t v = 0; v < VECTORS; v ++) \
+      a[v] = load((const vec_t *)acc + v); \
+    for (size_t s = 0; s < n; s ++, w += HASH_STRIPE_WORDS) \
+    { \
+      size_t stripe = (first + s) % HASH_BLOCK_STRIPES; \
+      for (size_t v = 0; v < VECTORS; v ++) \
+      { \
+        vec_t x = load((const vec_t *)w + v); \
+        vec_t d = opXor(x, load((const vec_t *)(secret + stripe) + v)); \
+        vec_t product = mul32(d, shiftRight64(d, 32)); \
+        a[v] = add64(a[v], add64(product, shuffle32(x, _MM_PERM_BADC))); \
+      } \
+      if (stripe == HASH_BLOCK_STRIPES - 1) \
+      { \
+        for (size_t v = 0; v < VECTORS; v ++) \
+        { \
+          vec_t x = opXor(a[v], shiftRight64(a[v], 47)); \
+          const vec_t *key = (const vec_t *)(secret + HASH_BLOCK_STRIPES); \
+          x = opXor(x, load(key + v)); \
+          a[v] = add64(mul32(x, prime), \
+            shiftLeft64(mul32(shiftRight64(x, 32), prime), 32)); \
+        } \
+      } \
+    } \
+    for (size_t v = 0; v < VECTORS; v ++) \
+      store((vec_t *)acc + v, a[v]); \
+  }
+
+DEFINE_HASH_KERNEL(SSE2, "sse2", __m128i,
+  _mm_loadu_si128, _mm_storeu_si128, _mm_xor_si128, _mm_add_epi64,
+  _mm_mul_epu32, _mm_shuffle_epi32, _mm_srli_epi64, _mm_slli_epi64,
+  _mm_set1_epi64x)
+
+DEFINE_HASH_KERNEL(AVX2, "avx2", __m256i,
+  _mm256_loadu_si256, _mm256_storeu_si256, _mm256_xor_si256, _mm256_add_epi64,
+  _mm256_mul_epu32, _mm256_shuffle_epi32, _mm256_srli_epi64, _mm256_slli_epi64,
+  _mm256_set1_epi64x)
+
+// GCC's AVX-512 intrinsics pass an intentionally undefined vector as the
+// unused merge source, which -Wmaybe-uninitialized reports once inlined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+DEFINE_HASH_KERNEL(AVX512, "avx512f", __m512i,
+  _mm512_loadu_si512, _mm512_storeu_si512, _mm512_xor_si512, _mm512_add_epi64,
+  _mm512_mul_epu32, _mm512_shuffle_epi32, _mm512_srli_epi64, _mm512_slli_epi64,
+  _mm512_set1_epi64)
+#pragma GCC diagnostic pop
+
+#endif
+
+/**
+ * \brief Lists the WordKernels for every instruction set supported by the
+ * running CPU, from the portable scalar kernels to the best one
+ *
+ * Normal code should use wordKernels(); this is mostly useful for comparing
+ * the kernels against each other.
+ */
+inline std::vector<const WordKernels *> supportedWordKernels()
+{
+  static const WordKernels scalar = {
+    "scalar", orWordsScalar, andWordsScalar, xorWordsScalar, notWordsScalar,
+    equalWordsScalar, lastDifferenceScalar, skipFillForwardScalar,
+    skipFillBackwardScalar, hashStripesScalar
+  };
+  std::vector<const WordKernels *> supported(1, &scalar);
+  
+#ifdef BITVECTOR_X86_KERNELS
+  static const WordKernels sse2 = {
+    "sse2", orWordsSSE2, andWordsSSE2, xorWordsSSE2, notWordsSSE2,
+    equalWordsSSE2, lastDifferenceSSE2, skipFillForwardSSE2,
+    skipFillBackwardSSE2, hashStripesSSE2
+  };
+  static const WordKernels avx2 = {
+    "avx2", orWordsAVX2, andWordsAVX2, xorWordsAVX2, notWordsAVX2,
+    equalWordsAVX2, lastDifferenceAVX2, skipFillForwardAVX2,
+    skipFillBackwardAVX2, hashStripesAVX2
+  };
+  static const WordKernels avx512 = {
+    "avx512", orWordsAVX512, andWordsAVX512, xorWordsAVX512, notWordsAVX512,
+    equalWordsAVX512, lastDifferenceAVX512, skipFillForwardAVX512,
+    skipFillBackwardAVX512, hashStripesAVX512
+  };
+  
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2"))
+    supported.push_back(&sse2);
+  if (__builtin_cpu_supports("avx2"))
+    supported.push_back(&avx2);
+  if (__builtin_cpu_supports("avx512f"))
+    supported.push_back(&avx512);
+#endif
+  
+  return supported;
+}
+
+/**
+ * \returns the WordKernels for the best instruction set supported by the
+ * running CPU
+ *
+ * The CPU is only inspected on the first call; afterwards this is a load of
+ * an already initialized static.
+ */
+inline const WordKernels &wordKernels()
+{
+  static const WordKernels &best = *supportedWordKernels().back();
+  return best;
+}
+
+/**
+ * \def BITVECTOR_X86_64_CARRY
+ * \brief Defined when addWithCarry() and subtractWithBorrow() are built on the
+ * _addcarry_u64 and _subborrow_u64 intrinsics, which compile to adc and sbb
+ */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BITVECTOR_X86_64_CARRY 1
+#include <immintrin.h>
+#endif
+
+/**
+ * \def BITVECTOR_HAS_INT128
+ * \brief Defined when the compiler provides unsigned __int128, which is used
+ * as a double-width word where the intrinsics aren't available
+ */
+#if defined(__SIZEOF_INT128__)
+#define BITVECTOR_HAS_INT128 1
+#endif
+
+/**
+ * \def BITVECTOR_CONSTEXPR
+ * \brief Expands to constexpr when the compiler accepts loops and assignments
+ * in constexpr functions, as of C++14, and to nothing otherwise
+ *
+ * \def BITVECTOR_IS_CONSTANT_EVALUATED()
+ * \brief True while a BITVECTOR_CONSTEXPR function is evaluated at compile
+ * time, so that it can use intrinsics only at runtime
+ *
+ * Without compiler support it is always true in C++14, and the portable code
+ * is used everywhere. Before C++14 nothing is evaluated at compile time.
+ */
+#if __cplusplus >= 201402L
+#define BITVECTOR_CONSTEXPR constexpr
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define BITVECTOR_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+#ifndef BITVECTOR_IS_CONSTANT_EVALUATED
+#define BITVECTOR_IS_CONSTANT_EVALUATED() true
+#endif
+#else
+#define BITVECTOR_CONSTEXPR
+#define BITVECTOR_IS_CONSTANT_EVALUATED() false
+#endif
+
+/**
+ * \brief Computes x + y + carry
+ *
+ * \param carry - the incoming carry, which must be 0 or 1
+ * \param sum - receives the low word of the sum
+ * \returns the outgoing carry, 0 or 1
+ */
+inline unsigned char addWithCarry(word_t x, word_t y, unsigned char carry,
+  word_t *sum)
+{
+#if defined(BITVECTOR_X86_64_CARRY)
+  unsigned long long s;
+  carry = _addcarry_u64(carry, x, y, &s);
+  *sum = s;
+  return carry;
+#elif defined(BITVECTOR_HAS_INT128)
+  unsigned __int128 s = (unsigned __int128)x + y + carry;
+  *sum = (word_t)s;
+  return (unsigned char)(s >> BITS_PER_WORD);
+#else
+  word_t s = x + carry;
+  unsigned char c = s < carry;
+  s += y;
+  *sum = s;
+  return c | (s < y);
+#endif
+}
+
+/**
+ * \brief Computes x - y - borrow
+ *
+ * \param borrow - the incoming borrow, which must be 0 or 1
+ * \param difference - receives the low word of the difference
+ * \returns the outgoing borrow, 0 or 1
+ */
+inline unsigned char subtractWithBorrow(word_t x, word_t y,
+  unsigned char borrow, word_t *difference)
+{
+#if defined(BITVECTOR_X86_64_CARRY)
+  unsigned long long d;
+  borrow = _subborrow_u64(borrow, x, y, &d);
+  *difference = d;
+  return borrow;
+#elif defined(BITVECTOR_HAS_INT128)
+  unsigned __int128 d = (unsigned __int128)x - y - borrow;
+  *difference = (word_t)d;
+  return (unsigned char)(d >> (2 * BITS_PER_WORD - 1));
+#else
+  word_t d = x - y;
+  unsigned char b = x < y;
+  *difference = d - borrow;
+  return b | (d < borrow);
+#endif
+}
+
+/**
+ * \brief Computes dst = a + b + carry over n words
+ *
+ * The carry chain is unrolled four words per step so that it compiles to a
+ * run of adc instructions. dst may be the same as a or b, but must not
+ * otherwise overlap them.
+ *
+ * \param carry - the incoming carry, which must be 0 or 1
+ * \returns the carry out of the most significant word
+ */
+inline word_t addWords(word_t *dst, const word_t *a, const word_t *b,
+  size_t n, word_t carry = 0)
+{
+  unsigned char c = (unsigned char)carry;
+  size_t i = 0;
+  for (; i < n - n % 4; i += 4)
+  {
+    word_t s0, s1, s2, s3;
+    c = addWithCarry(a[i], b[i], c, &s0);
+    c = addWithCarry(a[i + 1], b[i + 1], c, &s1);
+    c = addWithCarry(a[i + 2], b[i + 2], c, &s2);
+    c = addWithCarry(a[i + 3], b[i + 3], c, &s3);
+    dst[i] = s0;
+    dst[i + 1] = s1;
+    dst[i + 2] = s2;
+    dst[i + 3] = s3;
+  }
+  for (; i < n; i ++)
+    c = addWithCarry(a[i], b[i], c, dst + i);
+  return c;
+}
+
+/**
+ * \brief Computes dst = a - b - borrow over n words
+ *
+ * dst may be the same as a or b, but must not otherwise overlap them.
+ *
+ * \param borrow - the incoming borrow, which must be 0 or 1
+ * \returns the borrow out of the most significant word
+ */
+inline word_t subtractWords(word_t *dst, const word_t *a, const word_t *b,
+  size_t n, word_t borrow = 0)
+{
+  unsigned char c = (unsigned char)borrow;
+  size_t i = 0;
+  for (; i < n - n % 4; i += 4)
+  {
+    word_t s0, s1, s2, s3;
+    c = subtractWithBorrow(a[i], b[i], c, &s0);
+    c = subtractWithBorrow(a[i + 1], b[i + 1], c, &s1);
+    c = subtractWithBorrow(a[i + 2], b[i + 2], c, &s2);
+    c = subtractWithBorrow(a[i + 3], b[i + 3], c, &s3);
+    dst[i] = s0;
+    dst[i + 1] = s1;
+    dst[i + 2] = s2;
+    dst[i + 3] = s3;
+  }
+  for (; i < n; i ++)
+    c = subtractWithBorrow(a[i], b[i], c, dst + i);
+  return c;
+}
+
+/**
+ * \brief Computes dst = a + x over n words
+ *
+ * The carry usually dies out after the first word, so this stops propagating
+ * as soon as it does. If dst is a, the remaining words aren't touched at all.
+ *
+ * \returns the carry out of the most significant word
+ */
+inline word_t addWord(word_t *dst, const word_t *a, size_t n, word_t x)
+{
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t s = a[i] + x;
+    dst[i] = s;
+    if (s >= x)
+    {
+      if (dst != a)
+        memcpy(dst + i + 1, a + i + 1, WORDS_TO_BYTES(n - i - 1));
+      return 0;
+    }
+    x = 1;
+  }
+  return x;
+}
+
+/**
+ * \brief Computes dst = a - x over n words
+ *
+ * Like addWord(), this stops as soon as the borrow dies out.
+ *
+ * \returns the borrow out of the most significant word
+ */
+inline word_t subtractWord(word_t *dst, const word_t *a, size_t n, word_t x)
+{
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t d = a[i] - x;
+    bool borrow = a[i] < x;
+    dst[i] = d;
+    if (!borrow)
+    {
+      if (dst != a)
+        memcpy(dst + i + 1, a + i + 1, WORDS_TO_BYTES(n - i - 1));
+      return 0;
+    }
+    x = 1;
+  }
+  return x;
+}
+
+/**
+ * \brief Adds 1 to n words in place
+ *
+ * If incrementing a lower-order word causes an overflow to 0, then we need to
+ * increment the next word as well to carry. Otherwise we stop.
+ *
+ * \returns the carry out of the most significant word
+ */
+inline word_t incrementWords(word_t *w, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
+  {
+    if ((++ w[i]) != 0)
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * \brief Subtracts 1 from n words in place
+ *
+ * If a lower-order word is zero and we decrement causing an underflow, we
+ * need to borrow from the next word. Otherwise we stop.
+ *
+ * \returns the borrow out of the most significant word
+ */
+inline word_t decrementWords(word_t *w, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
+  {
+    if ((w[i] --) != 0)
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * \brief Compares two numbers of n words each
+ *
+ * \returns a negative number, zero, or a positive number if a is less than,
+ *   equal to, or greater than b
+ */
+inline int compareWords(const word_t *a, const word_t *b, size_t n)
+{
+  size_t i = wordKernels().lastDifference(a, b, n);
+  if (i == 0)
+    return 0;
+  return a[i - 1] < b[i - 1] ? -1 : 1;
+}
+
+/**
+ * \brief Computes dst = |x - y|, where x has xn words and y has yn <= xn
+ * words
+ *
+ * \param dst - receives xn words
+ * \returns true if x < y
+ */
+inline bool absoluteDifference(word_t *dst, const word_t *x, size_t xn,
+  const word_t *y, size_t yn)
+{
+  // If x has non-zero words above the top of y, then x is larger
+  bool less = false;
+  size_t top = xn;
+  while (top > yn && x[top - 1] == 0)
+    -- top;
+  if (top == yn)
+    less = compareWords(x, y, yn) < 0;
+  
+  if (less)
+  {
+    subtractWords(dst, y, x, yn);
+    memset(dst + yn, 0, WORDS_TO_BYTES(xn - yn));
+  }
+  else
+  {
+    word_t borrow = subtractWords(dst, x, y, yn);
+    subtractWord(dst + yn, x + yn, xn - yn, borrow);
+  }
+  return less;
+}
+
+/**
+ * \brief Shifts n words left (toward the most significant end) by count bits,
+ * where 0 < count < BITS_PER_WORD
+ *
+ * dst may be the same as src.
+ *
+ * \returns the bits shifted out of the most significant word, in the low bits
+ */
+inline word_t shiftLeftWords(word_t *dst, const word_t *src, size_t n,
+  unsigned count)
+{
+  if (n == 0)
+    return 0;
+  
+  word_t out = src[n - 1] >> (BITS_PER_WORD - count);
+  for (size_t i = n - 1; i > 0; -- i)
+    dst[i] = (src[i] << count) | (src[i - 1] >> (BITS_PER_WORD - count));
+  dst[0] = src[0] << count;
+  return out;
+}
+
+/**
+ * \brief Shifts n words right (toward the least significant end) by count
+ * bits, where 0 < count < BITS_PER_WORD
+ *
+ * dst may be the same as src.
+ *
+ * \param fill - word whose high count bits are shifted in at the top, e.g.
+ *   all ones for an arithmetic shift of a negative number
+ * \returns the bits shifted out of the least significant word, in the high
+ *   bits
+ */
+inline word_t shiftRightWords(word_t *dst, const word_t *src, size_t n,
+  unsigned count, word_t fill = 0)
+{
+  if (n == 0)
+    return 0;
+  
+  word_t out = src[0] << (BITS_PER_WORD - count);
+  for (size_t i = 0; i + 1 < n; i ++)
+    dst[i] = (src[i] >> count) | (src[i + 1] << (BITS_PER_WORD - count));
+  dst[n - 1] = (src[n - 1] >> count) | (fill << (BITS_PER_WORD - count));
+  return out;
+}
+
+/**
+ * \brief Computes dst = src << count over n words, shifting in zeros
+ *
+ * The count is split into a move by whole words and a funnel shift of each
+ * pair of adjacent words, like shld. dst may be the same as src; otherwise
+ * the two must not overlap.
+ */
+inline void shiftLeftBits(word_t *dst, const word_t *src, size_t n,
+  size_t count)
+{
+  size_t w = count / BITS_PER_WORD;
+  unsigned b = count % BITS_PER_WORD;
+  if (w >= n)
+  {
+    memset(dst, 0, WORDS_TO_BYTES(n));
+    return;
+  }
+  
+  // shiftLeftWords() runs from the top down, so it never reads a word it
+  // has already overwritten, even though dst + w is ahead of src
+  if (b == 0)
+    memmove(dst + w, src, WORDS_TO_BYTES(n - w));
+  else
+    shiftLeftWords(dst + w, src, n - w, b);
+  memset(dst, 0, WORDS_TO_BYTES(w));
+}
+
+/**
+ * \brief Computes dst = src >> count, where src is width bits wide
+ *
+ * Bits at and above width are taken to be the fill, not what is stored in
+ * the unused bits of the most significant word. Like shiftLeftBits(), this
+ * is a move by whole words and a funnel shift, like shrd. dst may be the
+ * same as src; otherwise the two must not overlap.
+ *
+ * \param fill - all zeros for a logical shift, or all ones for an arithmetic
+ *   shift of a negative number
+ */
+inline void shiftRightBits(word_t *dst, const word_t *src, size_t width,
+  size_t count, word_t fill = 0)
+{
+  size_t n = BITS_TO_WORDS(width);
+  if (n == 0)
+    return;
+  
+  // The most significant word, with its unused bits replaced by the fill
+  word_t top = src[n - 1];
+  if (width % BITS_PER_WORD != 0)
+  {
+    word_t mask = MASK_WITH_LOWER_BITS(width % BITS_PER_WORD);
+    top = (top & mask) | (fill & ~mask);
+  }
+  
+  size_t w = count / BITS_PER_WORD;
+  unsigned b = count % BITS_PER_WORD;
+  if (w >= n)
+  {
+    for (size_t i = 0; i < n; i ++)
+      dst[i] = fill;
+    return;
+  }
+  
+  // The bulk of the words only involve stored words below the top one
+  size_t i = 0;
+  if (w + 1 < n)
+  {
+    size_t bulk = n - w - 1;
+    if (b == 0)
+    {
+      memmove(dst, src + w, WORDS_TO_BYTES(bulk));
+      i = bulk;
+    }
+    else
+    {
+      for (; i + 1 < bulk; i ++)
+        dst[i] = (src[i + w] >> b) | (src[i + w + 1] << (BITS_PER_WORD - b));
+    }
+  }
+  
+  // The rest straddle the top word and the fill
+  for (; i < n; i ++)
+  {
+    size_t j = i + w;
+    word_t lo = j < n - 1 ? src[j] : j == n - 1 ? top : fill;
+    word_t hi = j + 1 < n - 1 ? src[j + 1] : j + 1 == n - 1 ? top : fill;
+    dst[i] = b == 0 ? lo : (lo >> b) | (hi << (BITS_PER_WORD - b));
+  }
+}
+
+/**
+ * \brief Reads BITS_PER_WORD bits of src starting at bit position pos, where
+ * src is width bits wide and bits at and above width read as zero
+ */
+inline word_t extractWord(const word_t *src, size_t width, size_t pos)
+{
+  if (pos >= width)
+    return 0;
+  
+  size_t w = pos / BITS_PER_WORD;
+  unsigned b = pos % BITS_PER_WORD;
+  word_t value = src[w] >> b;
+  if (b != 0 && w + 1 < BITS_TO_WORDS(width))
+    value |= src[w + 1] << (BITS_PER_WORD - b);
+  if (width - pos < BITS_PER_WORD)
+    value &= MASK_WITH_LOWER_BITS(width - pos);
+  return value;
+}
+
+/**
+ * \brief ORs the low bits of src into n words of dst, starting at bit
+ * position pos of dst
+ *
+ * Bits that would land beyond the n words are dropped.
+ */
+inline void orBitsAt(word_t *dst, size_t n, const word_t *src, size_t bits,
+  size_t pos)
+{
+  for (size_t i = 0; i < BITS_TO_WORDS(bits); i ++)
+  {
+    word_t value = extractWord(src, bits, i * BITS_PER_WORD);
+    size_t p = pos + i * BITS_PER_WORD;
+    size_t w = p / BITS_PER_WORD;
+    unsigned b = p % BITS_PER_WORD;
+    if (w >= n)
+      break;
+    dst[w] |= value << b;
+    if (b != 0 && w + 1 < n)
+      dst[w + 1] |= value >> (BITS_PER_WORD - b);
+  }
+}
+
+/**
+ * \brief Copies bits [pos, pos + len) of src to the low bits of dst
+ *
+ * dst receives BITS_TO_WORDS(len) words, with the unused bits of its most
+ * significant word cleared. Each word is a funnel shift of the two source
+ * words it straddles; no word at or beyond BITS_TO_WORDS(pos + len) is read.
+ */
+inline void extractBits(word_t *dst, const word_t *src, size_t pos,
+  size_t len)
+{
+  size_t n = BITS_TO_WORDS(len);
+  if (n == 0)
+    return;
+  
+  src += pos / BITS_PER_WORD;
+  unsigned b = pos % BITS_PER_WORD;
+  if (b == 0)
+    memcpy(dst, src, WORDS_TO_BYTES(n));
+  else
+  {
+    // Never read past the word holding the last bit of the range
+    size_t last = BITS_TO_WORDS(b + len) - 1;
+    for (size_t i = 0; i < n; i ++)
+    {
+      dst[i] = src[i] >> b;
+      if (i + 1 <= last)
+        dst[i] |= src[i + 1] << (BITS_PER_WORD - b);
+    }
+  }
+  dst[n - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(len);
+}
+
+/**
+ * \brief Overwrites bits [pos, pos + len) of dst with the low len bits of src
+ *
+ * Bits of dst outside of the range are unchanged. Only the first and last
+ * destination words are merged with masks; the words between them are
+ * written whole, each a funnel shift of two source words.
+ */
+inline void insertBits(word_t *dst, size_t pos, const word_t *src,
+  size_t len)
+{
+  if (len == 0)
+    return;
+  
+  dst += pos / BITS_PER_WORD;
+  unsigned b = pos % BITS_PER_WORD;
+  size_t n = BITS_TO_WORDS(len);
+  size_t last = (b + len - 1) / BITS_PER_WORD;
+  if (last == 0)
+  {
+    word_t mask = MASK_FOR_MOST_SIGNIFICANT_WORD(len) << b;
+    dst[0] = (dst[0] & ~mask) | ((src[0] << b) & mask);
+    return;
+  }
+  
+  dst[0] = (dst[0] & MASK_WITH_LOWER_BITS(b)) | (src[0] << b);
+  if (b == 0)
+    memcpy(dst + 1, src + 1, WORDS_TO_BYTES(last - 1));
+  else
+  {
+    for (size_t i = 1; i < last; i ++)
+      dst[i] = (src[i] << b) | (src[i - 1] >> (BITS_PER_WORD - b));
+  }
+  
+  // The last word may only hold bits shifted out of the word below it
+  word_t value = (last < n) ? src[last] << b : 0;
+  if (b != 0)
+    value |= src[last - 1] >> (BITS_PER_WORD - b);
+  word_t mask = MASK_FOR_MOST_SIGNIFICANT_WORD(b + len);
+  dst[last] = (dst[last] & ~mask) | (value & mask);
+}
+
+/**
+ * \brief Computes the double-width product x * y
+ *
+ * Without unsigned __int128, the product is assembled from four products of
+ * halfword_t halves.
+ *
+ * \param hi - receives the high word of the product
+ * \returns the low word of the product
+ */
+inline BITVECTOR_CONSTEXPR word_t mulWide(word_t x, word_t y, word_t *hi)
+{
+#if defined(BITVECTOR_HAS_INT128)
+  unsigned __int128 p = (unsigned __int128)x * y;
+  *hi = (word_t)(p >> BITS_PER_WORD);
+  return (word_t)p;
+#else
+  const unsigned half = BITS_PER_WORD / 2;
+  word_t x0 = (halfword_t)x, x1 = x >> half;
+  word_t y0 = (halfword_t)y, y1 = y >> half;
+  word_t p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+  word_t mid = (p00 >> half) + (halfword_t)p01 + (halfword_t)p10;
+  *hi = p11 + (p01 >> half) + (p10 >> half) + (mid >> half);
+  return (mid << half) | (halfword_t)p00;
+#endif
+}
+
+/**
+ * \brief Computes dst = a * b, where a has n words
+ *
+ * dst may be the same as a.
+ *
+ * \returns the most significant word of the product, which doesn't fit in dst
+ */
+inline word_t mulWord(word_t *dst, const word_t *a, size_t n, word_t b)
+{
+  word_t carry = 0;
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t hi;
+    word_t lo = mulWide(a[i], b, &hi);
+    lo += carry;
+    hi += lo < carry;
+    dst[i] = lo;
+    carry = hi;
+  }
+  return carry;
+}
+
+/**
+ * \brief Computes dst += a * b, where dst and a have n words
+ *
+ * \returns the word carried out of the top of dst
+ */
+inline word_t addMulWord(word_t *dst, const word_t *a, size_t n, word_t b)
+{
+  word_t carry = 0;
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t hi;
+    word_t lo = mulWide(a[i], b, &hi);
+    lo += carry;
+    hi += lo < carry;
+    lo += dst[i];
+    hi += lo < dst[i];
+    dst[i] = lo;
+    carry = hi;
+  }
+  return carry;
+}
+
+/**
+ * \def DEFINE_MULTIPLY_BASECASE(isa, attributes)
+ * \brief Defines the quadratic schoolbook multiplication for one instruction
+ * set
+ *
+ * The word products come from mulWide(), which the compiler turns into mulx
+ * when the functions are compiled for BMI2.
+ *
+ * \param isa - suffix of the generated function names
+ * \param attributes - attributes the functions are compiled with
+ */
+#define DEFINE_MULTIPLY_BASECASE(isa, attributes) \
+  \
+  attributes \
+  inline void multiplyBasecase##isa(word_t *dst, const word_t *a, size_t an, \
+    const word_t *b, size_t bn) \
+  { \
+    dst[an] = mulWord(dst, a, an, b[0]); \
+    for (size_t j = 1; j < bn; j ++) \
+      dst[an + j] = addMulWord(dst + j, a, an, b[j]); \
+  } \
+  \
+  attributes \
+  inline void multiplyLowBasecase##isa(word_t *dst, const word_t *a, \
+    const word_t *b, size_t n) \
+  { \
+    mulWord(dst, a, n, b[0]); \
+    for (size_t j = 1; j < n; j ++) \
+      addMulWord(dst + j, a, n - j, b[j]); \
+  }
+
+DEFINE_MULTIPLY_BASECASE(Generic, )
+
+#if defined(BITVECTOR_X86_KERNELS) && defined(BITVECTOR_HAS_INT128)
+DEFINE_MULTIPLY_BASECASE(BMI2, __attribute__((target("bmi2"))))
+#endif
+
+/**
+ * MultiplyKernels
+ *
+ * \brief The schoolbook multiplication routines for one instruction set
+ *
+ * Use multiplyKernels() to get the routines suited to the running CPU.
+ */
+struct MultiplyKernels
+{
+  /**
+   * \brief Name of the instruction set, for diagnostics and benchmarks
+   */
+  const char *name;
+  
+  /**
+   * \brief Computes the an + bn word product dst = a * b
+   *
+   * dst must not overlap a or b, and bn must be at least 1.
+   */
+  void (*multiply)(word_t *dst, const word_t *a, size_t an, const word_t *b,
+    size_t bn);
+  
+  /**
+   * \brief Computes the low n words of a * b, where a and b have n words
+   *
+   * dst must not overlap a or b, and n must be at least 1.
+   */
+  void (*multiplyLow)(word_t *dst, const word_t *a, const word_t *b, size_t n);
+};
+
+/**
+ * \returns the MultiplyKernels best suited to the running CPU
+ */
+inline const MultiplyKernels &multiplyKernels()
+{
+  static const MultiplyKernels generic = {
+    "generic", multiplyBasecaseGeneric, multiplyLowBasecaseGeneric
+  };
+
+#if defined(BITVECTOR_X86_KERNELS) && defined(BITVECTOR_HAS_INT128)
+  static const MultiplyKernels bmi2 = {
+    "bmi2", multiplyBasecaseBMI2, multiplyLowBasecaseBMI2
+  };
+  
+  static const MultiplyKernels &best = []() -> const MultiplyKernels &
+  {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2") ? bmi2 : generic;
+  }();
+  return best;
+#else
+  return generic;
+#endif
+}
+
+/**
+ * \def BITVECTOR_KARATSUBA_THRESHOLD
+ * \brief Default word count at which multiplication switches from schoolbook
+ * to Karatsuba
+ */
+#ifndef BITVECTOR_KARATSUBA_THRESHOLD
+#define BITVECTOR_KARATSUBA_THRESHOLD 24
+#endif
+
+/**
+ * \def BITVECTOR_TOOM3_THRESHOLD
+ * \brief Default word count at which multiplication switches from Karatsuba
+ * to Toom-3
+ */
+#ifndef BITVECTOR_TOOM3_THRESHOLD
+#define BITVECTOR_TOOM3_THRESHOLD 256
+#endif
+
+/**
+ * \def BITVECTOR_NTT_THRESHOLD
+ * \brief Default word count at which multiplication switches from Toom-3 to
+ * the number-theoretic transform
+ */
+#ifndef BITVECTOR_NTT_THRESHOLD
+#define BITVECTOR_NTT_THRESHOLD 32768
+#endif
+
+/**
+ * MultiplyThresholds
+ *
+ * \brief Word counts at which multiplication moves to the next algorithm
+ *
+ * The defaults come from the BITVECTOR_*_THRESHOLD macros. They can be tuned
+ * for a machine by running bitvector_multiply_bench and either defining the
+ * macros or assigning the fields of multiplyThresholds() at startup. The
+ * fields must not change while a multiplication is running.
+ */
+struct MultiplyThresholds
+{
+  size_t karatsuba;
+  size_t toom3;
+  size_t ntt;
+};
+
+/**
+ * \returns the thresholds used by multiplyWords()
+ */
+inline MultiplyThresholds &multiplyThresholds()
+{
+  static MultiplyThresholds thresholds = {
+    BITVECTOR_KARATSUBA_THRESHOLD,
+    BITVECTOR_TOOM3_THRESHOLD,
+    BITVECTOR_NTT_THRESHOLD
+  };
+  return thresholds;
+}
+
+/**
+ * \brief The algorithms multiplyWords() chooses between
+ */
+enum MultiplyAlgorithm
+{
+  MULTIPLY_BASECASE,
+  MULTIPLY_KARATSUBA,
+  MULTIPLY_TOOM3,
+  MULTIPLY_NTT
+};
+
+/**
+ * \returns the algorithm multiplyWords() uses for n-word operands
+ */
+inline MultiplyAlgorithm multiplyAlgorithm(size_t n)
+{
+  // Below these sizes the splitting algorithms don't make progress
+  const MultiplyThresholds &t = multiplyThresholds();
+  if (n < t.karatsuba || n < 2)
+    return MULTIPLY_BASECASE;
+  if (n < t.toom3 || n < 7)
+    return MULTIPLY_KARATSUBA;
+  if (n < t.ntt)
+    return MULTIPLY_TOOM3;
+  return MULTIPLY_NTT;
+}
+
+inline size_t nttScratchSize(size_t n);
+
+/**
+ * \returns the number of words of scratch space multiplyWords() needs for
+ * n-word operands
+ */
+inline size_t multiplyScratchSize(size_t n)
+{
+  switch (multiplyAlgorithm(n))
+  {
+  case MULTIPLY_KARATSUBA:
+  {
+    size_t h = CEILDIV(n, 2);
+    return 6 * h + 1 + multiplyScratchSize(h);
+  }
+  case MULTIPLY_TOOM3:
+  {
+    size_t k = CEILDIV(n, 3);
+    return 12 * k + 15 + multiplyScratchSize(k + 1);
+  }
+  case MULTIPLY_NTT:
+    return nttScratchSize(n);
+  default:
+    return 0;
+  }
+}
+
+inline void multiplyWords(word_t *dst, const word_t *a, const word_t *b,
+  size_t n, word_t *scratch);
+
+/**
+ * \brief Karatsuba multiplication of n-word operands into 2n words of dst
+ *
+ * With a = a1 * B^h + a0 and b = b1 * B^h + b0, three half-size products
+ * suffice, since a0 * b1 + a1 * b0 = a0 * b0 + a1 * b1 - (a0 - a1)(b0 - b1).
+ * The differences are computed as magnitudes with a separate sign, so none of
+ * the products needs an extra word for a carry.
+ *
+ * The half-size products recurse through multiplyWords().
+ *
+ * \param scratch - at least multiplyScratchSize(n) words
+ */
+inline void multiplyKaratsuba(word_t *dst, const word_t *a, const word_t *b,
+  size_t n, word_t *scratch)
+{
+  size_t h = CEILDIV(n, 2);
+  size_t l = n - h;
+  
+  word_t *da = scratch;
+  word_t *db = da + h;
+  word_t *t = db + h;
+  word_t *m = t + 2 * h;
+  word_t *rest = m + 2 * h + 1;
+  
+  // z0 = a0 * b0 and z2 = a1 * b1 go straight to their places in dst
+  multiplyWords(dst, a, b, h, rest);
+  multiplyWords(dst + 2 * h, a + h, b + h, l, rest);
+  
+  // t = |a0 - a1| * |b0 - b1|
+  bool negative = absoluteDifference(da, a, h, a + h, l) !=
+    absoluteDifference(db, b, h, b + h, l);
+  multiplyWords(t, da, db, h, rest);
+  
+  // m = z0 + z2 - (a0 - a1)(b0 - b1)
+  memcpy(m, dst, WORDS_TO_BYTES(2 * h));
+  m[2 * h] = addWord(m + 2 * l, m + 2 * l, 2 * (h - l),
+    addWords(m, m, dst + 2 * h, 2 * l));
+  if (negative)
+    m[2 * h] += addWords(m, m, t, 2 * h);
+  else
+    m[2 * h] -= subtractWords(m, m, t, 2 * h);
+  
+  // Add the middle term in at B^h
+  size_t len = 2 * n - h;
+  size_t mlen = len < 2 * h + 1 ? len : 2 * h + 1;
+  word_t carry = addWords(dst + h, dst + h, m, mlen);
+  addWord(dst + h + mlen, dst + h + mlen, len - mlen, carry);
+}
+
+/**
+ * \brief Adds or subtracts an xn-word number into an n-word two's complement
+ * number, where xn <= n
+ */
+inline void addExtended(word_t *dst, size_t n, const word_t *x, size_t xn)
+{
+  word_t carry = addWords(dst, dst, x, xn);
+  addWord(dst + xn, dst + xn, n - xn, carry);
+}
+
+inline void subtractExtended(word_t *dst, size_t n, const word_t *x, size_t xn)
+{
+  word_t borrow = subtractWords(dst, dst, x, xn);
+  subtractWord(dst + xn, dst + xn, n - xn, borrow);
+}
+
+/**
+ * \brief Negates an n-word two's complement number in place
+ */
+inline void negateWords(word_t *w, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
+    w[i] = ~w[i];
+  incrementWords(w, n);
+}
+
+/**
+ * \brief Divides an n-word two's complement number by 3 in place, where the
+ * division is known to be exact
+ *
+ * Exact division is multiplication by the inverse of 3 modulo 2^64, carried
+ * across words, so it needs no trial quotients.
+ */
+inline void divideExactBy3(word_t *w, size_t n)
+{
+  const word_t inverse = (~(word_t)0 / 3) * 2 + 1;
+  const word_t oneThird = ~(word_t)0 / 3 + 1;
+  const word_t twoThirds = (~(word_t)0 / 3) * 2 + 1;
+  
+  word_t carry = 0;
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t s = w[i] - carry;
+    word_t borrow = w[i] < carry;
+    word_t q = s * inverse;
+    w[i] = q;
+    carry = borrow + (q >= oneThird) + (q >= twoThirds);
+  }
+}
+
+/**
+ * \brief Evaluates the three k-word limbs x0, x1, x2 (x2 has r words) of a
+ * Toom-3 operand at 1, -1 and -2
+ *
+ * Results are e = k + 1 word two's complement numbers. The value at 1 is
+ * never negative, so it is returned as is; the others are returned as
+ * magnitudes with their signs in negM1 and negM2.
+ */
+inline void toom3Evaluate(word_t *p1, word_t *pm1, word_t *pm2,
+  bool *negM1, bool *negM2, const word_t *x, size_t k, size_t r)
+{
+  size_t e = k + 1;
+  const word_t *x0 = x, *x1 = x + k, *x2 = x + 2 * k;
+  
+  // p1 = x0 + x2 + x1, pm1 = x0 + x2 - x1
+  memcpy(p1, x0, WORDS_TO_BYTES(k));
+  p1[k] = 0;
+  addExtended(p1, e, x2, r);
+  memcpy(pm1, p1, WORDS_TO_BYTES(e));
+  addExtended(p1, e, x1, k);
+  subtractExtended(pm1, e, x1, k);
+  
+  // pm2 = (2 * x2 - x1) * 2 + x0
+  memcpy(pm2, x2, WORDS_TO_BYTES(r));
+  memset(pm2 + r, 0, WORDS_TO_BYTES(e - r));
+  shiftLeftWords(pm2, pm2, e, 1);
+  subtractExtended(pm2, e, x1, k);
+  shiftLeftWords(pm2, pm2, e, 1);
+  addExtended(pm2, e, x0, k);
+  
+  *negM1 = (pm1[k] >> (BITS_PER_WORD - 1)) != 0;
+  if (*negM1)
+    negateWords(pm1, e);
+  *negM2 = (pm2[k] >> (BITS_PER_WORD - 1)) != 0;
+  if (*negM2)
+    negateWords(pm2, e);
+}
+
+/**
+ * \brief Toom-3 multiplication of n-word operands into 2n words of dst
+ *
+ * Each operand is split into three limbs of k words, making it a polynomial
+ * of degree 2 in B^k. The product polynomial is recovered from its values at
+ * 0, 1, -1, -2 and infinity using the interpolation sequence of Bodrato and
+ * Zanoni ("Integer and Polynomial Multiplication: Towards Optimal Toom-Cook
+ * Matrices", 2007). The intermediate values are kept as two's complement
+ * numbers, so the signed steps of the interpolation are plain modular
+ * arithmetic.
+ *
+ * The five products recurse through multiplyWords().
+ *
+ * \param scratch - at least multiplyScratchSize(n) words
+ */
+inline void multiplyToom3(word_t *dst, const word_t *a, const word_t *b,
+  size_t n, word_t *scratch)
+{
+  size_t k = CEILDIV(n, 3);
+  size_t r = n - 2 * k;
+  size_t e = k + 1;
+  size_t L = 2 * e + 1;
+  
+  word_t *pa1 = scratch, *pam1 = pa1 + e, *pam2 = pam1 + e;
+  word_t *pb1 = pam2 + e, *pbm1 = pb1 + e, *pbm2 = pbm1 + e;
+  word_t *w1 = pbm2 + e, *w2 = w1 + L, *w3 = w2 + L;
+  word_t *rest = w3 + L;
+  
+  bool negAm1, negAm2, negBm1, negBm2;
+  toom3Evaluate(pa1, pam1, pam2, &negAm1, &negAm2, a, k, r);
+  toom3Evaluate(pb1, pbm1, pbm2, &negBm1, &negBm2, b, k, r);
+  
+  // r0 = a0 * b0 and rinf = a2 * b2 go straight to their places in dst
+  word_t *r0 = dst;
+  word_t *rinf = dst + 4 * k;
+  multiplyWords(r0, a, b, k, rest);
+  multiplyWords(rinf, a + 2 * k, b + 2 * k, r, rest);
+  
+  // w1 = r1, w2 = rm1, w3 = rm2, sign-extended to L words
+  multiplyWords(w1, pa1, pb1, e, rest);
+  w1[L - 1] = 0;
+  multiplyWords(w2, pam1, pbm1, e, rest);
+  w2[L - 1] = 0;
+  if (negAm1 != negBm1)
+    negateWords(w2, L);
+  multiplyWords(w3, pam2, pbm2, e, rest);
+  w3[L - 1] = 0;
+  if (negAm2 != negBm2)
+    negateWords(w3, L);
+  
+  // Interpolate
+  subtractWords(w3, w3, w1, L);         // w3 = (rm2 - r1) / 3
+  divideExactBy3(w3, L);
+  subtractWords(w1, w1, w2, L);         // w1 = (r1 - rm1) / 2
+  shiftRightWords(w1, w1, L, 1, 0 - (w1[L - 1] >> (BITS_PER_WORD - 1)));
+  subtractExtended(w2, L, r0, 2 * k);   // w2 = rm1 - r0
+  subtractWords(w3, w2, w3, L);         // w3 = (w2 - w3) / 2 + 2 * rinf
+  shiftRightWords(w3, w3, L, 1, 0 - (w3[L - 1] >> (BITS_PER_WORD - 1)));
+  addExtended(w3, L, rinf, 2 * r);
+  addExtended(w3, L, rinf, 2 * r);
+  addWords(w2, w2, w1, L);              // w2 = w2 + w1 - rinf
+  subtractExtended(w2, L, rinf, 2 * r);
+  subtractWords(w1, w1, w3, L);         // w1 = w1 - w3
+  
+  // Recompose; w1, w2 and w3 are now the (non-negative) coefficients of B^k,
+  // B^2k and B^3k
+  memset(dst + 2 * k, 0, WORDS_TO_BYTES(2 * k));
+  word_t *coefficients[] = { w1, w2, w3 };
+  for (size_t i = 0; i < 3; i ++)
+  {
+    size_t offset = (i + 1) * k;
+    size_t len = 2 * n - offset;
+    addExtended(dst + offset, len, coefficients[i], len < L ? len : L);
+  }
+}
+
+/**
+ * \brief Arithmetic modulo the prime 2^64 - 2^32 + 1 used by the NTT
+ *
+ * The multiplicative group of this field has elements of order 2^32, so it
+ * supports power-of-two transforms up to that length, and reduction modulo it
+ * needs only shifts and adds.
+ */
+struct NTTField
+{
+  static word_t prime()
+  {
+    return ~(word_t)0 - MASK_WITH_LOWER_BITS(32) + 1;
+  }
+  
+  // The reductions below select with masks rather than branches, which would
+  // be mispredicted half of the time on transformed data. Since 2^64 = 2^32 - 1
+  // (mod p), adding epsilon = 2^32 - 1 is the same as subtracting p.
+  
+  static word_t add(word_t x, word_t y)
+  {
+    const word_t epsilon = MASK_WITH_LOWER_BITS(32);
+    word_t s = x + y;
+    s += epsilon & (0 - (word_t)(s < x));
+    return s + (epsilon & (0 - (word_t)(s >= prime())));
+  }
+  
+  static word_t subtract(word_t x, word_t y)
+  {
+    const word_t epsilon = MASK_WITH_LOWER_BITS(32);
+    word_t d = x - y;
+    return d - (epsilon & (0 - (word_t)(x < y)));
+  }
+  
+  static word_t multiply(word_t x, word_t y)
+  {
+    // With p = 2^64 - 2^32 + 1, 2^64 = 2^32 - 1 and 2^96 = -1 (mod p)
+    const word_t epsilon = MASK_WITH_LOWER_BITS(32);
+    word_t hi;
+    word_t lo = mulWide(x, y, &hi);
+    word_t t0 = lo - (hi >> 32);
+    t0 -= epsilon & (0 - (word_t)(lo < (hi >> 32)));
+    word_t t1 = (hi & epsilon) * epsilon;
+    word_t t2 = t0 + t1;
+    t2 += epsilon & (0 - (word_t)(t2 < t1));
+    return t2 + (epsilon & (0 - (word_t)(t2 >= prime())));
+  }
+  
+  static word_t power(word_t x, word_t e)
+  {
+    word_t result = 1;
+    for (; e != 0; e >>= 1, x = multiply(x, x))
+    {
+      if (e & 1)
+        result = multiply(result, x);
+    }
+    return result;
+  }
+  
+  /**
+   * \returns a primitive root of unity of order n, a power of two
+   */
+  static word_t rootOfUnity(size_t n)
+  {
+    // 7 generates the multiplicative group
+    return power(7, (prime() - 1) / n);
+  }
+};
+
+/**
+ * \brief Computes the twiddle factors of every stage of a transform of
+ * length n, a power of two
+ *
+ * The factors of the stage of length 2h are w^0 ... w^(h-1) for the
+ * primitive root w of order 2h, and are stored at roots + h.
+ *
+ * \param roots - receives n words
+ * \param inverse - if set, uses the inverse roots
+ */
+inline void nttRoots(word_t *roots, size_t n, bool inverse)
+{
+  for (size_t half = 1; half < n; half <<= 1)
+  {
+    word_t w = NTTField::rootOfUnity(2 * half);
+    if (inverse)
+      w = NTTField::power(w, NTTField::prime() - 2);
+    
+    roots[half] = 1;
+    for (size_t j = 1; j < half; j ++)
+      roots[half + j] = NTTField::multiply(roots[half + j - 1], w);
+  }
+}
+
+/**
+ * \brief In-place number-theoretic transform of length n, a power of two
+ *
+ * The forward transform takes coefficients in natural order and leaves the
+ * result in bit-reversed order, and the inverse transform undoes this, so a
+ * convolution never has to permute its data.
+ *
+ * \param inverse - if set, computes the inverse transform, including the
+ *   division by n
+ * \param roots - n words of scratch space for the twiddle factors
+ */
+inline void nttTransform(word_t *f, size_t n, bool inverse, word_t *roots)
+{
+  nttRoots(roots, n, inverse);
+  
+  if (!inverse)
+  {
+    // Decimation in frequency
+    for (size_t half = n / 2; half >= 1; half >>= 1)
+    {
+      const word_t *w = roots + half;
+      for (size_t i = 0; i < n; i += 2 * half)
+      {
+        for (size_t j = 0; j < half; j ++)
+        {
+          word_t u = f[i + j];
+          word_t v = f[i + j + half];
+          f[i + j] = NTTField::add(u, v);
+          f[i + j + half] = NTTField::multiply(NTTField::subtract(u, v), w[j]);
+        }
+      }
+    }
+    return;
+  }
+  
+  // Decimation in time
+  for (size_t half = 1; half < n; half <<= 1)
+  {
+    const word_t *w = roots + half;
+    for (size_t i = 0; i < n; i += 2 * half)
+    {
+      for (size_t j = 0; j < half; j ++)
+      {
+        word_t u = f[i + j];
+        word_t v = NTTField::multiply(f[i + j + half], w[j]);
+        f[i + j] = NTTField::add(u, v);
+        f[i + j + half] = NTTField::subtract(u, v);
+      }
+    }
+  }
+  
+  word_t scale = NTTField::power(n, NTTField::prime() - 2);
+  for (size_t i = 0; i < n; i ++)
+    f[i] = NTTField::multiply(f[i], scale);
+}
+
+/**
+ * \brief Reads the digitBits-bit digit at bit position pos of n words
+ */
+inline word_t nttDigit(const word_t *a, size_t n, size_t pos,
+  unsigned digitBits)
+{
+  size_t w = WORD_INDEX_FOR_BIT_IN_ARRAY(pos);
+  unsigned offset = BIT_POSITION_FOR_BIT_IN_WORD(pos);
+  word_t digit = a[w] >> offset;
+  if (offset + digitBits > BITS_PER_WORD && w + 1 < n)
+    digit |= a[w + 1] << (BITS_PER_WORD - offset);
+  return digit & MASK_WITH_LOWER_BITS(digitBits);
+}
+
+/**
+ * \brief How a number-theoretic transform multiplication cuts its operands
+ *
+ * The operands are cut into digits small enough that every coefficient of
+ * the cyclic convolution (at most digits * 2^(2 * digitBits)) is below the
+ * prime and comes out exact. Of the digit sizes that allow this, the one
+ * giving the shortest transform is used.
+ */
+struct NTTLayout
+{
+  unsigned digitBits;
+  size_t digits;
+  size_t size;
+};
+
+/**
+ * \returns the layout of the transforms for n-word operands
+ */
+inline NTTLayout nttLayout(size_t n)
+{
+  size_t bits = WORDS_TO_BITS(n);
+  NTTLayout layout = { 0, 0, 0 };
+  for (unsigned d = 16; d < 32; d ++)
+  {
+    size_t m = CEILDIV(bits, d);
+    unsigned logm = 0;
+    while (((size_t)1 << logm) < m)
+      ++ logm;
+    if (logm + 2 * d > 63)
+      break;
+    
+    size_t s = 1;
+    while (s < 2 * m)
+      s <<= 1;
+    if (layout.size == 0 || s < layout.size)
+    {
+      layout.digitBits = d;
+      layout.digits = m;
+      layout.size = s;
+    }
+  }
+  return layout;
+}
+
+/**
+ * \returns the number of words of scratch space multiplyNTT() needs: two
+ *   transforms and the twiddle factors
+ */
+inline size_t nttScratchSize(size_t n)
+{
+  return 3 * nttLayout(n).size;
+}
+
+/**
+ * \brief Multiplication of n-word operands into 2n words of dst with the
+ * number-theoretic transform
+ *
+ * The convolution is computed with three transforms, or two when squaring.
+ *
+ * \param scratch - at least nttScratchSize(n) words
+ */
+inline void multiplyNTT(word_t *dst, const word_t *a, const word_t *b,
+  size_t n, word_t *scratch)
+{
+  NTTLayout layout = nttLayout(n);
+  unsigned digitBits = layout.digitBits;
+  size_t digits = layout.digits, size = layout.size;
+  word_t *fa = scratch;
+  word_t *fb = scratch + size;
+  word_t *roots = scratch + 2 * size;
+  
+  memset(fa, 0, WORDS_TO_BYTES(size));
+  for (size_t i = 0; i < digits; i ++)
+    fa[i] = nttDigit(a, n, i * digitBits, digitBits);
+  nttTransform(fa, size, false, roots);
+  
+  if (a == b)
+  {
+    for (size_t i = 0; i < size; i ++)
+      fa[i] = NTTField::multiply(fa[i], fa[i]);
+  }
+  else
+  {
+    memset(fb, 0, WORDS_TO_BYTES(size));
+    for (size_t i = 0; i < digits; i ++)
+      fb[i] = nttDigit(b, n, i * digitBits, digitBits);
+    nttTransform(fb, size, false, roots);
+    for (size_t i = 0; i < size; i ++)
+      fa[i] = NTTField::multiply(fa[i], fb[i]);
+  }
+  nttTransform(fa, size, true, roots);
+  
+  // Propagate carries between digits through a two-word accumulator, and
+  // pack the digits back into words
+  word_t lo = 0, hi = 0;
+  word_t packed = 0;
+  unsigned filled = 0;
+  size_t w = 0;
+  for (size_t i = 0; i < 2 * digits && w < 2 * n; i ++)
+  {
+    lo += fa[i];
+    hi += lo < fa[i];
+    word_t digit = lo & MASK_WITH_LOWER_BITS(digitBits);
+    lo = (lo >> digitBits) | (hi << (BITS_PER_WORD - digitBits));
+    hi >>= digitBits;
+    
+    packed |= digit << filled;
+    filled += digitBits;
+    if (filled >= BITS_PER_WORD)
+    {
+      dst[w ++] = packed;
+      filled -= BITS_PER_WORD;
+      packed = filled != 0 ? digit >> (digitBits - filled) : 0;
+    }
+  }
+  if (w < 2 * n)
+  {
+    dst[w ++] = packed;
+    memset(dst + w, 0, WORDS_TO_BYTES(2 * n - w));
+  }
+}
+
+/**
+ * \brief Computes the 2n-word product dst = a * b of n-word operands
+ *
+ * The algorithm is chosen by multiplyAlgorithm(). dst must not overlap a or b.
+ *
+ * \param scratch - at least multiplyScratchSize(n) words
+ */
+inline void multiplyWords(word_t *dst, const word_t *a, const word_t *b,
+  size_t n, word_t *scratch)
+{
+  switch (multiplyAlgorithm(n))
+  {
+  case MULTIPLY_BASECASE:
+    if (n > 0)
+      multiplyKernels().multiply(dst, a, n, b, n);
+    break;
+  case MULTIPLY_KARATSUBA:
+    multiplyKaratsuba(dst, a, b, n, scratch);
+    break;
+  case MULTIPLY_TOOM3:
+    multiplyToom3(dst, a, b, n, scratch);
+    break;
+  case MULTIPLY_NTT:
+    multiplyNTT(dst, a, b, n, scratch);
+    break;
+  }
+}
+
+/**
+ * \returns count words of scratch space belonging to the calling thread,
+ *   valid until the next call on the same thread
+ *
+ * The buffer only grows, so repeated operations of similar size allocate
+ * once. It serves the functions below that do not take a scratch argument,
+ * none of which calls another of them while using it.
+ */
+inline word_t *threadScratchWords(size_t count)
+{
+  static thread_local std::vector<word_t> scratch;
+  if (scratch.size() < count)
+    scratch.resize(count);
+  return scratch.data();
+}
+
+/**
+ * \brief Computes the 2n-word product dst = a * b of n-word operands, with
+ * the scratch space of the calling thread
+ */
+inline void multiplyWords(word_t *dst, const word_t *a, const word_t *b,
+  size_t n)
+{
+  multiplyWords(dst, a, b, n, threadScratchWords(multiplyScratchSize(n)));
+}
+
+/**
+ * \returns the number of words of scratch space multiplyLowWords() needs for
+ * n-word operands
+ */
+inline size_t multiplyLowScratchSize(size_t n)
+{
+  if (multiplyAlgorithm(n) == MULTIPLY_BASECASE)
+    return 0;
+  return 2 * n + multiplyScratchSize(n);
+}
+
+/**
+ * \brief Computes the low n words of a * b, where a and b have n words
+ *
+ * Below the Karatsuba threshold this skips the partial products that only
+ * affect the high half. dst must not overlap a or b.
+ *
+ * \param scratch - at least multiplyLowScratchSize(n) words
+ */
+inline void multiplyLowWords(word_t *dst, const word_t *a, const word_t *b,
+  size_t n, word_t *scratch)
+{
+  if (n == 0)
+    return;
+  if (multiplyAlgorithm(n) == MULTIPLY_BASECASE)
+  {
+    multiplyKernels().multiplyLow(dst, a, b, n);
+    return;
+  }
+  
+  multiplyWords(scratch, a, b, n, scratch + 2 * n);
+  memcpy(dst, scratch, WORDS_TO_BYTES(n));
+}
+
+/**
+ * \brief Computes the low n words of a * b with the scratch space of the
+ * calling thread
+ */
+inline void multiplyLowWords(word_t *dst, const word_t *a, const word_t *b,
+  size_t n)
+{
+  multiplyLowWords(dst, a, b, n,
+    threadScratchWords(multiplyLowScratchSize(n)));
+}
+
+/**
+ * \brief Counts the leading zero bits of a word
+ *
+ * \returns BITS_PER_WORD if x is zero
+ */
+inline BITVECTOR_CONSTEXPR unsigned countLeadingZeros(word_t x)
+{
+  if (x == 0)
+    return BITS_PER_WORD;
+#ifdef __GNUC__
+  return __builtin_clzll(x);
+#else
+  unsigned count = 0;
+  for (; !(x & MASK_WITH_BIT(BITS_PER_WORD - 1)); x <<= 1)
+    ++ count;
+  return count;
+#endif
+}
+
+/**
+ * \brief Counts the trailing zero bits of a word
+ *
+ * \returns BITS_PER_WORD if x is zero
+ */
+inline BITVECTOR_CONSTEXPR unsigned countTrailingZeros(word_t x)
+{
+  if (x == 0)
+    return BITS_PER_WORD;
+#ifdef __GNUC__
+  return __builtin_ctzll(x);
+#else
+  unsigned count = 0;
+  for (; !(x & 1); x >>= 1)
+    ++ count;
+  return count;
+#endif
+}
+
+/**
+ * \brief Counts the set bits of a word
+ *
+ * Functions compiled with the popcnt target attribute get the single
+ * instruction when this is inlined into them.
+ */
+inline BITVECTOR_CONSTEXPR unsigned countOnes(word_t x)
+{
+#ifdef __GNUC__
+  return __builtin_popcountll(x);
+#else
+  x -= (x >> 1) & 0x5555555555555555ULL;
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (unsigned)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * \def DEFINE_POPCOUNT_WORDS(isa, attributes)
+ * \brief Defines a function counting the set bits of n words for one
+ * instruction set
+ *
+ * \param isa - suffix of the generated function name
+ * \param attributes - attributes the function is compiled with
+ */
+#define DEFINE_POPCOUNT_WORDS(isa, attributes) \
+  \
+  attributes \
+  inline size_t popcountWords##isa(const word_t *w, size_t n) \
+  { \
+    size_t count = 0; \
+    for (size_t i = 0; i < n; i ++) \
+      count += countOnes(w[i]); \
+    return count; \
+  }
+
+DEFINE_POPCOUNT_WORDS(Generic, )
+
+#ifdef BITVECTOR_X86_KERNELS
+DEFINE_POPCOUNT_WORDS(POPCNT, __attribute__((target("popcnt"))))
+#endif
+
+/**
+ * \returns the number of set bits in n words, counted with the popcnt
+ *   instruction if the running CPU has it
+ */
+inline size_t popcountWords(const word_t *w, size_t n)
+{
+#ifdef BITVECTOR_X86_KERNELS
+  static size_t (*const best)(const word_t *, size_t) = []()
+  {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("popcnt") ? popcountWordsPOPCNT
+      : popcountWordsGeneric;
+  }();
+  return best(w, n);
+#else
+  return popcountWordsGeneric(w, n);
+#endif
+}
+
+/**
+ * \brief Counts the set bits at positions [begin, end) of a word array
+ */
+inline size_t countBits(const word_t *w, size_t begin, size_t end)
+{
+  if (begin >= end)
+    return 0;
+  
+  size_t first = WORD_INDEX_FOR_BIT_IN_ARRAY(begin);
+  size_t last = WORD_INDEX_FOR_BIT_IN_ARRAY(end - 1);
+  word_t head = w[first] &
+    ~MASK_WITH_LOWER_BITS(BIT_POSITION_FOR_BIT_IN_WORD(begin));
+  word_t tail = MASK_FOR_MOST_SIGNIFICANT_WORD(end);
+  if (first == last)
+    return countOnes(head & tail);
+  return countOnes(head) + popcountWords(w + first + 1, last - first - 1) +
+    countOnes(w[last] & tail);
+}
+
+/**
+ * \brief Finds the lowest bit at positions [begin, end) of a word array that
+ * differs from the bits of fill
+ *
+ * Runs of words equal to fill are skipped with the WordKernels. This is the
+ * search behind the find functions of BitVector and the bit spans.
+ *
+ * \param fill - 0 to find a set bit, or all ones to find a clear bit
+ * \returns the position of the bit, or end if there is none
+ */
+inline size_t findNextBit(const word_t *w, size_t begin, size_t end,
+  word_t fill)
+{
+  if (begin >= end)
+    return end;
+  
+  // Check the rest of the first word, then skip the words equal to fill. A
+  // hit at or beyond end is the same as no hit.
+  size_t i = WORD_INDEX_FOR_BIT_IN_ARRAY(begin);
+  size_t n = WORD_INDEX_FOR_BIT_IN_ARRAY(end - 1) + 1;
+  word_t x = (w[i] ^ fill) &
+    ~MASK_WITH_LOWER_BITS(BIT_POSITION_FOR_BIT_IN_WORD(begin));
+  if (x == 0)
+  {
+    ++ i;
+    i += wordKernels().skipFillForward(w + i, n - i, fill);
+    if (i == n)
+      return end;
+    x = w[i] ^ fill;
+  }
+  
+  size_t found = WORDS_TO_BITS(i) + countTrailingZeros(x);
+  return (found < end) ? found : end;
+}
+
+/**
+ * \brief Finds the highest bit at positions [begin, end) of a word array that
+ * differs from the bits of fill
+ *
+ * \param fill - 0 to find a set bit, or all ones to find a clear bit
+ * \returns the position of the bit, or end if there is none
+ */
+inline size_t findLastBit(const word_t *w, size_t begin, size_t end,
+  word_t fill)
+{
+  if (begin >= end)
+    return end;
+  
+  // Check the bits of the last word below end, then skip the words equal to
+  // fill. A hit below begin is the same as no hit.
+  size_t first = WORD_INDEX_FOR_BIT_IN_ARRAY(begin);
+  size_t i = WORD_INDEX_FOR_BIT_IN_ARRAY(end - 1);
+  word_t x = (w[i] ^ fill) & MASK_FOR_MOST_SIGNIFICANT_WORD(end);
+  if (x == 0)
+  {
+    size_t n = wordKernels().skipFillBackward(w + first, i - first, fill);
+    if (n == 0)
+      return end;
+    i = first + n - 1;
+    x = w[i] ^ fill;
+  }
+  
+  size_t found = WORDS_TO_BITS(i) + BITS_PER_WORD - 1 - countLeadingZeros(x);
+  return (found >= begin) ? found : end;
+}
+
+/**
+ * \returns the two halves of the 128-bit product a * b XORed together
+ */
+inline word_t mixWords(word_t a, word_t b)
+{
+  word_t hi;
+  word_t lo = mulWide(a, b, &hi);
+  return lo ^ hi;
+}
+
+/**
+ * \brief Computes a 64-bit hash of the low width bits of a word array
+ *
+ * The unused bits of the most significant word are ignored, as they are by
+ * BitVector::operator==, so equal values have equal hashes. Up to
+ * HASH_STRIPE_WORDS words are mixed in pairs by 128-bit multiplications, as
+ * in wyhash. Longer arrays are accumulated by WordKernels::hashStripes and
+ * the lanes are mixed at the end, as in XXH3. The result is the same for
+ * every kernel, but is not meant to be stable between releases.
+ */
+inline word_t hashBits(const word_t *w, size_t width, word_t seed = 0)
+{
+  const word_t *secret = hashSecret();
+  size_t n = BITS_TO_WORDS(width);
+  
+  // Copy the stripe that holds the most significant word, zero-padded and
+  // masked, so that the kernels only see whole stripes
+  size_t stripes = (n > 0) ? (n - 1) / HASH_STRIPE_WORDS : 0;
+  size_t rest = n - stripes * HASH_STRIPE_WORDS;
+  word_t tail[HASH_STRIPE_WORDS] = { 0 };
+  if (n > 0)
+  {
+    memcpy(tail, w + stripes * HASH_STRIPE_WORDS, WORDS_TO_BYTES(rest));
+    tail[rest - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(width);
+  }
+  
+  if (stripes == 0)
+  {
+    word_t h = mixWords(seed ^ secret[0], (word_t)width ^ secret[1]);
+    for (size_t i = 0; i < rest; i += 2)
+      h = mixWords(tail[i] ^ secret[i + 2], tail[i + 1] ^ h);
+    return mixWords(h ^ secret[0], (word_t)width ^ secret[1]);
+  }
+  
+  word_t acc[HASH_STRIPE_WORDS];
+  for (size_t j = 0; j < HASH_STRIPE_WORDS; j ++)
+    acc[j] = secret[HASH_BLOCK_STRIPES + j] ^ seed;
+  const WordKernels &kernels = wordKernels();
+  kernels.hashStripes(acc, w, stripes, 0);
+  kernels.hashStripes(acc, tail, 1, stripes);
+  
+  word_t h = (word_t)width * 0x9E3779B97F4A7C15ULL;
+  for (size_t j = 0; j < HASH_STRIPE_WORDS; j += 2)
+    h += mixWords(acc[j] ^ secret[j], acc[j + 1] ^ secret[j + 1]);
+  h ^= h >> 37;
+  h *= 0x165667919E3779F9ULL;
+  return h ^ (h >> 32);
+}
+
+/**
+ * \brief Computes dst -= a * b, where dst and a have n words
+ *
+ * \returns the word borrowed from above the top of dst
+ */
+inline word_t subtractMulWord(word_t *dst, const word_t *a, size_t n,
+  word_t b)
+{
+  word_t borrow = 0;
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t hi;
+    word_t lo = mulWide(a[i], b, &hi);
+    lo += borrow;
+    hi += lo < borrow;
+    hi += dst[i] < lo;
+    dst[i] -= lo;
+    borrow = hi;
+  }
+  return borrow;
+}
+
+/**
+ * \brief Computes the reciprocal floor((2^128 - 1) / d) - 2^64 of a
+ * normalized word d, whose most significant bit is set
+ *
+ * This is the reciprocal divideWide() multiplies by instead of dividing.
+ */
+inline word_t reciprocalWord(word_t d)
+{
+  assert((d & MASK_WITH_BIT(BITS_PER_WORD - 1)) && "Divisor must be normalized");
+  
+#if defined(BITVECTOR_HAS_INT128)
+  unsigned __int128 numerator =
+    ((unsigned __int128)~d << BITS_PER_WORD) | ~(word_t)0;
+  return (word_t)(numerator / d);
+#else
+  // Bit-serial long division of (~d, ~0) by d. This is slow, but it runs
+  // once per divisor.
+  word_t hi = ~d, lo = ~(word_t)0, q = 0;
+  for (unsigned i = 0; i < BITS_PER_WORD; i ++)
+  {
+    word_t top = hi >> (BITS_PER_WORD - 1);
+    hi = (hi << 1) | (lo >> (BITS_PER_WORD - 1));
+    lo <<= 1;
+    q <<= 1;
+    if (top || hi >= d)
+    {
+      hi -= d;
+      q |= 1;
+    }
+  }
+  return q;
+#endif
+}
+
+/**
+ * \brief Divides the two-word number (u1, u0) by a normalized word d, using
+ * its reciprocal v = reciprocalWord(d)
+ *
+ * This is the 2-by-1 division of Moller and Granlund, which replaces the
+ * hardware divide with two multiplications. u1 must be less than d.
+ *
+ * \param r - receives the remainder
+ * \returns the quotient
+ */
+inline word_t divideWide(word_t u1, word_t u0, word_t d, word_t v, word_t *r)
+{
+  word_t q1;
+  word_t q0 = mulWide(v, u1, &q1);
+  q0 += u0;
+  q1 += u1 + (q0 < u0);
+  ++ q1;
+  
+  // The first correction is taken about half of the time, so it selects
+  // with a mask rather than a branch; the second is rare
+  word_t rem = u0 - q1 * d;
+  word_t mask = 0 - (word_t)(rem > q0);
+  q1 += mask;
+  rem += mask & d;
+  if (rem >= d)
+  {
+    ++ q1;
+    rem -= d;
+  }
+  *r = rem;
+  return q1;
+}
+
+/**
+ * \brief Computes q = a / d, where a has n words, with the divisor
+ * normalized on the fly
+ *
+ * \param q - receives n words of quotient, or may be NULL; may be the same
+ *   as a
+ * \param d - the divisor shifted left by shift bits, so that its most
+ *   significant bit is set
+ * \param v - reciprocalWord(d)
+ * \returns the remainder a % (d >> shift)
+ */
+inline word_t divideByWord(word_t *q, const word_t *a, size_t n, word_t d,
+  word_t v, unsigned shift)
+{
+  if (n == 0)
+    return 0;
+  
+  word_t r = shift ? a[n - 1] >> (BITS_PER_WORD - shift) : 0;
+  for (size_t i = n; i -- > 0; )
+  {
+    word_t u = a[i] << shift;
+    if (shift && i > 0)
+      u |= a[i - 1] >> (BITS_PER_WORD - shift);
+    word_t digit = divideWide(r, u, d, v, &r);
+    if (q)
+      q[i] = digit;
+  }
+  return r >> shift;
+}
+
+/**
+ * WordDivisor
+ *
+ * \brief A single-word divisor, normalized and with its reciprocal
+ * precomputed, for dividing many numbers by the same word
+ */
+struct WordDivisor
+{
+  /**
+   * \param d - the divisor, which must not be zero
+   */
+  explicit WordDivisor(word_t d)
+  {
+    assert(d != 0 && "Division by zero");
+    shift = countLeadingZeros(d);
+    divisor = d << shift;
+    reciprocal = reciprocalWord(divisor);
+  }
+  
+  /**
+   * \brief Computes q = a / d, where a has n words
+   *
+   * q may be the same as a.
+   *
+   * \returns the remainder a % d
+   */
+  word_t divide(word_t *q, const word_t *a, size_t n) const
+  {
+    return divideByWord(q, a, n, divisor, reciprocal, shift);
+  }
+  
+  /**
+   * \returns the remainder a % d, where a has n words
+   */
+  word_t remainder(const word_t *a, size_t n) const
+  {
+    return divideByWord(NULL, a, n, divisor, reciprocal, shift);
+  }
+  
+  /**
+   * \brief The divisor, shifted left until its most significant bit is set
+   */
+  word_t divisor;
+  
+  /**
+   * \brief reciprocalWord(divisor)
+   */
+  word_t reciprocal;
+  
+  /**
+   * \brief The number of bits the divisor was shifted left by
+   */
+  unsigned shift;
+};
+
+/**
+ * \brief Divides u by d with Knuth's algorithm D, leaving the remainder in u
+ *
+ * The divisor must be normalized, and the dividend shifted left by the same
+ * amount. The quotient digits are estimated with divideWide() from the top
+ * word of the divisor and corrected with the second word, so at most one
+ * add-back is needed.
+ *
+ * \param q - receives un - dn + 1 words of quotient, or may be NULL
+ * \param u - un + 1 words, the dividend with one extra zero word at the top;
+ *   receives the remainder in its low dn words
+ * \param d - dn >= 2 words, with the most significant bit set
+ * \param v - reciprocalWord(d[dn - 1])
+ */
+inline void divideKnuth(word_t *q, word_t *u, size_t un, const word_t *d,
+  size_t dn, word_t v)
+{
+  word_t d1 = d[dn - 1], d0 = d[dn - 2];
+  
+  for (size_t j = un - dn + 1; j -- > 0; )
+  {
+    word_t *top = u + j + dn;
+    word_t qhat, rhat;
+    bool rhatOverflow = false;
+    
+    if (top[0] == d1)
+    {
+      // The estimate would overflow a word, so use the largest digit
+      qhat = ~(word_t)0;
+      rhat = top[-1] + d1;
+      rhatOverflow = rhat < d1;
+    }
+    else
+    {
+      qhat = divideWide(top[0], top[-1], d1, v, &rhat);
+    }
+    
+    // The estimate is at most two too large; the second divisor word catches
+    // almost every case where it is
+    while (!rhatOverflow)
+    {
+      word_t hi;
+      word_t lo = mulWide(qhat, d0, &hi);
+      if (hi < rhat || (hi == rhat && lo <= top[-2]))
         break;
+      -- qhat;
+      rhat += d1;
+      rhatOverflow = rhat < d1;
+    }
+    
+    word_t borrow = subtractMulWord(u + j, d, dn, qhat);
+    if (top[0] < borrow)
+    {
+      -- qhat;
+      top[0] += addWords(u + j, u + j, d, dn);
+    }
+    top[0] -= borrow;
+    
+    if (q)
+      q[j] = qhat;
+  }
+}
+
+/**
+ * \brief Computes the an + bn word product dst = a * b, where an >= bn >= 1
+ *
+ * The longer operand is cut into pieces of bn words, so that each piece can
+ * be multiplied with the algorithm multiplyWords() picks for bn words. dst
+ * must not overlap a or b.
+ */
+inline void multiplyUnbalancedWords(word_t *dst, const word_t *a, size_t an,
+  const word_t *b, size_t bn)
+{
+  if (multiplyAlgorithm(bn) == MULTIPLY_BASECASE)
+  {
+    multiplyKernels().multiply(dst, a, an, b, bn);
+    return;
+  }
+  
+  memset(dst, 0, WORDS_TO_BYTES(an + bn));
+  std::vector<word_t> product(2 * bn);
+  std::vector<word_t> scratch(multiplyScratchSize(bn));
+  for (size_t i = 0; i < an; i += bn)
+  {
+    // A short last piece becomes the shorter operand of its own product,
+    // rather than being padded to bn words
+    size_t len = an - i < bn ? an - i : bn;
+    if (len == bn)
+      multiplyWords(product.data(), a + i, b, bn, scratch.data());
+    else
+      multiplyUnbalancedWords(product.data(), b, bn, a + i, len);
+    
+    word_t carry = addWords(dst + i, dst + i, product.data(), len + bn);
+    addWord(dst + i + len + bn, dst + i + len + bn, an - i - len, carry);
+  }
+}
+
+/**
+ * \def BITVECTOR_BARRETT_THRESHOLD
+ * \brief Default divisor word count at which division switches from Knuth's
+ * algorithm D to multiplying by a reciprocal computed with Newton's method
+ */
+#ifndef BITVECTOR_BARRETT_THRESHOLD
+#define BITVECTOR_BARRETT_THRESHOLD 1024
+#endif
+
+/**
+ * \brief Computes x = floor(B^(2k) / d), where B = 2^BITS_PER_WORD and d is
+ * normalized
+ *
+ * Small divisors are handled by Knuth's algorithm D. Larger ones get the
+ * reciprocal of their top half recursively, and one Newton iteration doubles
+ * its precision; the result is then corrected to the exact floor. Each level
+ * costs a few multiplications of its size, so the whole reciprocal costs a
+ * small multiple of one k-word multiplication.
+ *
+ * \param x - receives k + 1 words
+ * \param d - k words, with the most significant bit set
+ */
+inline void reciprocalWords(word_t *x, const word_t *d, size_t k)
+{
+  if (k < BITVECTOR_BARRETT_THRESHOLD || k < 4)
+  {
+    std::vector<word_t> u(2 * k + 2, 0), q(k + 2);
+    u[2 * k] = 1;
+    if (k == 1)
+    {
+      WordDivisor divisor(d[0]);
+      divisor.divide(q.data(), u.data(), 2 * k + 1);
+    }
+    else
+    {
+      divideKnuth(q.data(), u.data(), 2 * k + 1, d, k,
+        reciprocalWord(d[k - 1]));
+    }
+    memcpy(x, q.data(), WORDS_TO_BYTES(k + 1));
+    return;
+  }
+  
+  // x0 = y * B^(k - h), where y is the reciprocal of the top h words
+  size_t h = k - k / 2, l = k - h;
+  std::vector<word_t> y(h + 1);
+  reciprocalWords(y.data(), d + l, h);
+  
+  // e = B^(2k) - d * x0, which is small compared to B^(2k)
+  std::vector<word_t> e(2 * k + 1, 0);
+  multiplyUnbalancedWords(e.data() + l, d, k, y.data(), h + 1);
+  negateWords(e.data(), 2 * k + 1);
+  ++ e[2 * k];
+  bool negative = e[2 * k] != 0;
+  if (negative)
+    negateWords(e.data(), 2 * k + 1);
+  
+  // x1 = x0 + x0 * e / B^(2k) = x0 + y * e / B^(k + h)
+  size_t en = 2 * k;
+  while (en > 0 && e[en - 1] == 0)
+    -- en;
+  memset(x, 0, WORDS_TO_BYTES(l));
+  memcpy(x + l, y.data(), WORDS_TO_BYTES(h + 1));
+  if (en > 0)
+  {
+    std::vector<word_t> t(en + h + 1);
+    if (en >= h + 1)
+      multiplyUnbalancedWords(t.data(), e.data(), en, y.data(), h + 1);
+    else
+      multiplyUnbalancedWords(t.data(), y.data(), h + 1, e.data(), en);
+    
+    std::vector<word_t> c(k + 1, 0);
+    if (t.size() > k + h)
+    {
+      size_t count = t.size() - (k + h);
+      memcpy(c.data(), t.data() + k + h,
+        WORDS_TO_BYTES(count < k + 1 ? count : k + 1));
+    }
+    if (negative)
+    {
+      subtractWords(x, x, c.data(), k + 1);
+      subtractWord(x, x, k + 1, 1);
+    }
+    else
+    {
+      addWords(x, x, c.data(), k + 1);
+    }
+  }
+  
+  // Correct to the exact floor with the remainder r = B^(2k) - d * x1, which
+  // is within a few multiples of d
+  std::vector<word_t> r(2 * k + 2, 0);
+  multiplyUnbalancedWords(r.data(), x, k + 1, d, k);
+  r[2 * k + 1] = 0;
+  negateWords(r.data(), 2 * k + 2);
+  addWord(r.data() + 2 * k, r.data() + 2 * k, 2, 1);
+  
+  while (r[2 * k + 1] != 0)
+  {
+    subtractWord(x, x, k + 1, 1);
+    word_t carry = addWords(r.data(), r.data(), d, k);
+    addWord(r.data() + k, r.data() + k, k + 2, carry);
+  }
+  for (;;)
+  {
+    bool high = false;
+    for (size_t i = k; i < 2 * k + 2 && !high; i ++)
+      high = r[i] != 0;
+    if (!high && compareWords(r.data(), d, k) < 0)
+      break;
+    
+    addWord(x, x, k + 1, 1);
+    word_t borrow = subtractWords(r.data(), r.data(), d, k);
+    subtractWord(r.data() + k, r.data() + k, k + 2, borrow);
+  }
+}
+
+/**
+ * \def WORD_FROM(v, n)
+ * \brief Used to refer to a word by its index without caring where that word
+ * is stored
+ *
+ * All words of a BitVector are kept in one contiguous range, whether that
+ * range is the in-object buffer or heap storage, so this is a plain index.
+ *
+ * \param v - BitVector object containing this word
+ * \param n - the word index
+ * \returns the word at index n, usable as an L-value
+ */
+#define WORD_FROM(v, n) ((v).storage[(n)])
+
+/**
+ * \def WORD(n)
+ * \brief Shortcut for WORD_FROM(*this, n)
+ * \see WORD_FROM(n)
+ */
+#define WORD(n) WORD_FROM(*this, (n))
+
+
+/**
+ * \def BITVECTOR_CACHE_LINE
+ * \brief Alignment in bytes of the heap storage handed out by
+ * CacheAlignedAllocator and the allocators of Allocators.hpp
+ *
+ * Aligned words keep the vector kernels from splitting loads across cache
+ * lines.
+ */
+#ifndef BITVECTOR_CACHE_LINE
+#define BITVECTOR_CACHE_LINE 64
+#endif
+
+/**
+ * \brief Allocates memory aligned to a power of two
+ *
+ * \throws std::bad_alloc if the memory can't be allocated
+ */
+inline void *allocateAligned(size_t bytes, size_t alignment)
+{
+  void *p;
+#ifdef _WIN32
+  p = _aligned_malloc(bytes ? bytes : 1, alignment);
+#else
+  if (posix_memalign(&p, alignment, bytes ? bytes : 1) != 0)
+    p = NULL;
+#endif
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+/**
+ * \brief Frees memory returned by allocateAligned()
+ */
+inline void freeAligned(void *p)
+{
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
+
+/**
+ * CacheAlignedAllocator
+ *
+ * \brief The default allocator of BitVector, which aligns each allocation to
+ * BITVECTOR_CACHE_LINE bytes
+ */
+template<typename T>
+struct CacheAlignedAllocator
+{
+  typedef T value_type;
+  
+  CacheAlignedAllocator() { }
+  
+  template<typename U>
+  CacheAlignedAllocator(const CacheAlignedAllocator<U> &) { }
+  
+  T *allocate(size_t n)
+  {
+    return (T *)allocateAligned(n * sizeof(T), BITVECTOR_CACHE_LINE);
+  }
+  
+  void deallocate(T *p, size_t)
+  {
+    freeAligned(p);
+  }
+};
+
+template<typename T, typename U>
+bool operator==(const CacheAlignedAllocator<T> &,
+  const CacheAlignedAllocator<U> &)
+{
+  return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const CacheAlignedAllocator<T> &,
+  const CacheAlignedAllocator<U> &)
+{
+  return false;
+}
+
+
+/**
+ * \def BITVECTOR_STATS
+ * \brief Define to count the heap allocations, copies and moves of every
+ * BitVector, for choosing N
+ *
+ * The counters are per thread; read them with bitVectorStats(). Without this
+ * macro the recording points compile to nothing.
+ */
+#ifdef BITVECTOR_STATS
+
+#include <atomic>
+
+/**
+ * \brief The events recorded by the BitVector instrumentation
+ */
+enum BitVectorEvent
+{
+  /** \brief Heap storage allocated; SPILL or REALLOCATE follows */
+  BITVECTOR_EVENT_ALLOCATE,
+  /** \brief The allocation replaces smaller heap storage */
+  BITVECTOR_EVENT_REALLOCATE,
+  /** \brief Heap storage freed, including storage that was replaced */
+  BITVECTOR_EVENT_FREE,
+  /** \brief A deep copy of another BitVector's words */
+  BITVECTOR_EVENT_COPY,
+  /** \brief Heap storage taken over from another BitVector */
+  BITVECTOR_EVENT_MOVE,
+  /** \brief The allocation moves a BitVector off its in-object words */
+  BITVECTOR_EVENT_SPILL
+};
+
+/**
+ * BitVectorStats
+ *
+ * \brief Counts of BitVector events on one thread
+ */
+struct BitVectorStats
+{
+  /**
+   * \brief The number of each BitVectorEvent
+   */
+  uint64_t allocations;
+  uint64_t reallocations;
+  uint64_t frees;
+  uint64_t copies;
+  uint64_t moves;
+  uint64_t spills;
+  
+  /**
+   * \brief Heap words allocated minus heap words freed on this thread
+   *
+   * Storage freed on another thread than it was allocated on moves this
+   * between the two threads' counts, so one of them can be negative.
+   */
+  int64_t liveHeapWords;
+  
+  /**
+   * \brief The greatest value of liveHeapWords since the last reset
+   */
+  int64_t peakHeapWords;
+  
+  /**
+   * \brief widths[k] counts the widths given to resize(), which includes
+   * every constructor, that are at least 2^(k-1) and less than 2^k
+   */
+  uint64_t widths[BITS_PER_WORD + 1];
+};
+
+/**
+ * \brief A function called on every event, on the thread where it happens
+ *
+ * \param words - the number of heap words allocated, freed, copied or moved
+ */
+typedef void (*BitVectorStatsHook)(BitVectorEvent event, size_t words);
+
+/**
+ * \returns the counters of the calling thread
+ */
+inline BitVectorStats &threadBitVectorStats()
+{
+  static thread_local BitVectorStats stats = BitVectorStats();
+  return stats;
+}
+
+inline std::atomic<BitVectorStatsHook> &bitVectorStatsHook()
+{
+  static std::atomic<BitVectorStatsHook> hook(NULL);
+  return hook;
+}
+
+/**
+ * \returns a snapshot of the counters of the calling thread
+ */
+inline BitVectorStats bitVectorStats()
+{
+  return threadBitVectorStats();
+}
+
+/**
+ * \brief Clears the counters of the calling thread
+ *
+ * The live heap words are kept, as that storage is still allocated, and
+ * become the new peak.
+ */
+inline void resetBitVectorStats()
+{
+  BitVectorStats &stats = threadBitVectorStats();
+  int64_t live = stats.liveHeapWords;
+  stats = BitVectorStats();
+  stats.liveHeapWords = stats.peakHeapWords = live;
+}
+
+/**
+ * \brief Installs a function to be called on every event, for all threads,
+ * or removes it if hook is NULL
+ */
+inline void setBitVectorStatsHook(BitVectorStatsHook hook)
+{
+  bitVectorStatsHook().store(hook, std::memory_order_release);
+}
+
+inline void recordBitVectorEvent(BitVectorEvent event, size_t words)
+{
+  BitVectorStats &stats = threadBitVectorStats();
+  switch (event)
+  {
+  case BITVECTOR_EVENT_ALLOCATE:
+    stats.allocations ++;
+    break;
+  case BITVECTOR_EVENT_REALLOCATE:
+    stats.reallocations ++;
+    break;
+  case BITVECTOR_EVENT_FREE:
+    stats.frees ++;
+    break;
+  case BITVECTOR_EVENT_COPY:
+    stats.copies ++;
+    break;
+  case BITVECTOR_EVENT_MOVE:
+    stats.moves ++;
+    break;
+  case BITVECTOR_EVENT_SPILL:
+    stats.spills ++;
+    break;
+  }
+  
+  if (event == BITVECTOR_EVENT_ALLOCATE)
+  {
+    stats.liveHeapWords += (int64_t)words;
+    if (stats.liveHeapWords > stats.peakHeapWords)
+      stats.peakHeapWords = stats.liveHeapWords;
+  }
+  else if (event == BITVECTOR_EVENT_FREE)
+  {
+    stats.liveHeapWords -= (int64_t)words;
+  }
+  
+  BitVectorStatsHook hook =
+    bitVectorStatsHook().load(std::memory_order_acquire);
+  if (hook)
+    hook(event, words);
+}
+
+inline void recordBitVectorWidth(size_t width)
+{
+  threadBitVectorStats().widths[BITS_PER_WORD - countLeadingZeros(width)] ++;
+}
+
+/**
+ * \def BITVECTOR_RECORD(event, words)
+ * \brief Records an event in the instrumentation, if it is enabled
+ */
+#define BITVECTOR_RECORD(event, words) recordBitVectorEvent((event), (words))
+
+/**
+ * \def BITVECTOR_RECORD_WIDTH(width)
+ * \brief Records a width in the histogram, if the instrumentation is enabled
+ */
+#define BITVECTOR_RECORD_WIDTH(width) recordBitVectorWidth(width)
+
+#else
+
+#define BITVECTOR_RECORD(event, words) ((void)0)
+#define BITVECTOR_RECORD_WIDTH(width) ((void)0)
+
+#endif // BITVECTOR_STATS
+
+
+/**
+ * \def BITVECTOR_SCRATCH_WORDS
+ * \brief The most words of temporary space an operation takes from the stack
+ * before it allocates them from the allocator of the BitVector instead
+ */
+#ifndef BITVECTOR_SCRATCH_WORDS
+#define BITVECTOR_SCRATCH_WORDS 64
+#endif
+
+template<size_t N, typename Allocator = CacheAlignedAllocator<word_t> >
+class BitVector;
+
+
+/**
+ * BarrettReducer
+ *
+ * \brief A divisor prepared once for dividing many numbers by it, as in
+ * repeated x % m with the same modulus m
+ *
+ * The divisor is normalized when the reducer is made, and the state of the
+ * algorithm suited to its size is precomputed:
+ *
+ *   - a single word gets the reciprocal for 2-by-1 division, divideWide()
+ *   - below BITVECTOR_BARRETT_THRESHOLD words, the divisor uses Knuth's
+ *     algorithm D with the reciprocal of its top word
+ *   - larger divisors get floor(B^(2k) / d) from reciprocalWords(), and
+ *     each k words of dividend then cost two k-word multiplications and at
+ *     most two corrective subtractions (Barrett reduction)
+ *
+ * A BitVector converts to a BarrettReducer implicitly, so a / b and a % b
+ * work directly; keep the reducer around to skip the precomputation.
+ */
+class BarrettReducer
+{
+public:
+  /**
+   * \param d - the divisor, n words, which must not be zero
+   */
+  BarrettReducer(const word_t *d, size_t n)
+  {
+    init(d, n);
+  }
+  
+  /**
+   * \param modulus - the divisor, which must not be zero
+   */
+  template<size_t N, typename A>
+  BarrettReducer(const BitVector<N, A> &modulus)
+  {
+    std::vector<word_t> d(modulus.data(), modulus.data() + modulus.wordCount());
+    if (!d.empty())
+      d.back() &= MASK_FOR_MOST_SIGNIFICANT_WORD(modulus.width());
+    init(d.data(), d.size());
+  }
+  
+  /**
+   * \returns the number of significant words of the divisor
+   */
+  size_t wordCount() const
+  {
+    return divisor.size();
+  }
+  
+  /**
+   * \brief Computes q = x / d and r = x % d, where x has xn words
+   *
+   * \param q - receives xn words of quotient, or may be NULL; may be the
+   *   same as x
+   * \param r - receives wordCount() words of remainder, or may be NULL; may
+   *   be the same as x
+   */
+  void divide(word_t *q, word_t *r, const word_t *x, size_t xn) const
+  {
+    size_t k = wordCount();
+    
+    // Leading zero words only make the dividend look longer
+    size_t xt = xn;
+    while (xt > 0 && x[xt - 1] == 0)
+      -- xt;
+    
+    if (xt < k)
+    {
+      if (r)
+      {
+        memmove(r, x, WORDS_TO_BYTES(xt));
+        memset(r + xt, 0, WORDS_TO_BYTES(k - xt));
+      }
+      if (q)
+        memset(q, 0, WORDS_TO_BYTES(xn));
+      return;
+    }
+    
+    if (k == 1)
+    {
+      word_t rem = divideByWord(q, x, xt, divisor[0], reciprocal, shift);
+      if (q)
+        memset(q + xt, 0, WORDS_TO_BYTES(xn - xt));
+      if (r)
+        r[0] = rem;
+      return;
+    }
+    
+    // Normalize the dividend by the shift of the divisor, with room for the
+    // extra word this produces and the zero word Knuth's algorithm D expects
+    size_t un = xt + 1;
+    size_t chunks = CEILDIV(un, k);
+    std::vector<word_t> u(chunks * k + 1, 0);
+    if (shift)
+      u[xt] = shiftLeftWords(u.data(), x, xt, shift);
+    else
+      memcpy(u.data(), x, WORDS_TO_BYTES(xt));
+    
+    std::vector<word_t> quotient;
+    if (q)
+      quotient.resize(chunks * k + 1);
+    
+    if (inverse.empty())
+      divideKnuth(q ? quotient.data() : NULL, u.data(), un, divisor.data(),
+        k, reciprocal);
+    else
+      divideBarrett(q ? quotient.data() : NULL, u.data(), chunks);
+    
+    // The quotient is no longer than the dividend
+    if (q)
+    {
+      memcpy(q, quotient.data(), WORDS_TO_BYTES(xt));
+      memset(q + xt, 0, WORDS_TO_BYTES(xn - xt));
+    }
+    if (r)
+    {
+      if (shift)
+        shiftRightWords(r, u.data(), k, shift);
+      else
+        memcpy(r, u.data(), WORDS_TO_BYTES(k));
+    }
+  }
+  
+protected:
+  void init(const word_t *d, size_t n)
+  {
+    while (n > 0 && d[n - 1] == 0)
+      -- n;
+    assert(n > 0 && "Division by zero");
+    
+    shift = countLeadingZeros(d[n - 1]);
+    divisor.resize(n);
+    if (shift)
+      shiftLeftWords(divisor.data(), d, n, shift);
+    else
+      memcpy(divisor.data(), d, WORDS_TO_BYTES(n));
+    reciprocal = reciprocalWord(divisor[n - 1]);
+    
+    if (n >= BITVECTOR_BARRETT_THRESHOLD)
+    {
+      inverse.resize(n + 1);
+      reciprocalWords(inverse.data(), divisor.data(), n);
+    }
+  }
+  
+  /**
+   * \brief Divides the normalized dividend u of chunks * k words by Barrett
+   * reduction, k words at a time from the top
+   *
+   * \param q - receives chunks * k words of quotient, or may be NULL
+   * \param u - receives the remainder in its low k words
+   */
+  void divideBarrett(word_t *q, word_t *u, size_t chunks) const
+  {
+    size_t k = wordCount();
+    std::vector<word_t> d(divisor);
+    d.push_back(0);
+    
+    std::vector<word_t> v(2 * k), product(2 * k + 2), estimate(k + 1);
+    std::vector<word_t> scratch(multiplyScratchSize(k + 1));
+    
+    // The top chunk is below B^k, which is at most 2d, so its quotient is 0
+    // or 1 and needs no multiplication
+    word_t *top = u + (chunks - 1) * k;
+    word_t topQuotient = 0;
+    if (compareWords(top, divisor.data(), k) >= 0)
+    {
+      subtractWords(top, top, divisor.data(), k);
+      topQuotient = 1;
+    }
+    if (q)
+    {
+      memset(q + (chunks - 1) * k, 0, WORDS_TO_BYTES(k));
+      q[(chunks - 1) * k] = topQuotient;
+    }
+    
+    // The running remainder r is below d, so each v = r * B^k + chunk is
+    // below d * B^k and its quotient fits in k words
+    memcpy(v.data() + k, top, WORDS_TO_BYTES(k));
+    for (size_t c = chunks - 1; c -- > 0; )
+    {
+      memcpy(v.data(), u + c * k, WORDS_TO_BYTES(k));
+      
+      // The estimate floor(floor(v / B^(k-1)) * inverse / B^(k+1)) is at
+      // most two below the quotient
+      multiplyWords(product.data(), v.data() + k - 1, inverse.data(), k + 1,
+        scratch.data());
+      memcpy(estimate.data(), product.data() + k + 1, WORDS_TO_BYTES(k + 1));
+      
+      // The remainder is below 3d, so k + 1 words of it are enough
+      multiplyLowWords(product.data(), estimate.data(), d.data(), k + 1);
+      subtractWords(v.data(), v.data(), product.data(), k + 1);
+      
+      while (v[k] != 0 || compareWords(v.data(), d.data(), k) >= 0)
+      {
+        v[k] -= subtractWords(v.data(), v.data(), d.data(), k);
+        incrementWords(estimate.data(), k + 1);
+      }
+      
+      if (q)
+        memcpy(q + c * k, estimate.data(), WORDS_TO_BYTES(k));
+      memcpy(v.data() + k, v.data(), WORDS_TO_BYTES(k));
+    }
+    memcpy(u, v.data() + k, WORDS_TO_BYTES(k));
+  }
+  
+  /**
+   * \brief The divisor without leading zero words, shifted left until its
+   * most significant bit is set
+   */
+  std::vector<word_t> divisor;
+  
+  /**
+   * \brief floor(B^(2k) / divisor) for Barrett reduction, or empty if the
+   * divisor is small enough for Knuth's algorithm D
+   */
+  std::vector<word_t> inverse;
+  
+  /**
+   * \brief reciprocalWord() of the most significant word of the divisor
+   */
+  word_t reciprocal;
+  
+  /**
+   * \brief The number of bits the divisor was shifted left by
+   */
+  unsigned shift;
+};
+
+/**
+ * \def BITVECTOR_TO_DECIMAL_THRESHOLD
+ * \brief Default word count at which conversion to decimal switches from
+ * dividing by 10^19 repeatedly to dividing and conquering with powers of ten
+ */
+#ifndef BITVECTOR_TO_DECIMAL_THRESHOLD
+#define BITVECTOR_TO_DECIMAL_THRESHOLD 64
+#endif
+
+/**
+ * \def BITVECTOR_FROM_DECIMAL_THRESHOLD
+ * \brief Default word count at which conversion from decimal switches from
+ * multiplying by 10^19 repeatedly to dividing and conquering with powers of
+ * ten
+ */
+#ifndef BITVECTOR_FROM_DECIMAL_THRESHOLD
+#define BITVECTOR_FROM_DECIMAL_THRESHOLD 3072
+#endif
+
+/**
+ * \brief The number of decimal digits that fit in a word, and 10 to that
+ * power
+ */
+#define DECIMAL_DIGITS_PER_WORD 19
+#define DECIMAL_WORD_BASE ((word_t)10000000000000000000ULL)
+
+/**
+ * \returns the value of a digit character in bases up to 16, or 16 if the
+ * character is not a digit
+ */
+inline unsigned digitValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return 16;
+}
+
+/**
+ * \returns true for the radixes that strings can be read and written in:
+ *   2, 8, 10 and 16
+ */
+inline bool isSupportedRadix(int radix)
+{
+  return radix == 2 || radix == 8 || radix == 10 || radix == 16;
+}
+
+/**
+ * \returns the number of bits each digit stands for in a power-of-two
+ * radix, or 0 for base 10 and for unsupported radixes
+ */
+inline unsigned bitsPerDigit(int radix)
+{
+  switch (radix)
+  {
+  case 2:
+    return 1;
+  case 8:
+    return 3;
+  case 16:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * \returns an upper bound on the number of decimal digits of a width-bit
+ * number, which is at least 1
+ */
+inline size_t decimalLength(size_t width)
+{
+  // log10(2) rounded up
+  return width / 100000 * 30103 + (width % 100000) * 30103 / 100000 + 1;
+}
+
+/**
+ * \returns the number of bits that can hold any number of the given number
+ * of decimal digits
+ */
+inline size_t decimalBits(size_t digits)
+{
+  // log2(10) rounded up
+  return digits / 1000 * 3322 + CEILDIV(digits % 1000 * 3322, 1000);
+}
+
+/**
+ * \returns the number of words that can hold any number of the given number
+ * of decimal digits
+ */
+inline size_t decimalWords(size_t digits)
+{
+  return BITS_TO_WORDS(decimalBits(digits));
+}
+
+/**
+ * \brief Writes a word as 16 hexadecimal digits, most significant first
+ *
+ * On little-endian machines, the nibbles of each half word are spread into
+ * the bytes of a word and turned into characters all at once, eight digits
+ * per step.
+ */
+inline void writeHexWord(char *out, word_t x)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  const word_t ones = 0x0101010101010101ULL;
+  for (int half = 0; half < 2; half ++)
+  {
+    word_t v = half == 0 ? x >> 32 : x & MASK_WITH_LOWER_BITS(32);
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v << 8)) & 0x00FF00FF00FF00FFULL;
+    v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    
+    // Nibble i is now in byte i, but the most significant digit goes first
+    v = __builtin_bswap64(v);
+    word_t letters = ((v + 6 * ones) >> 4) & ones;
+    v += '0' * ones + letters * ('a' - '0' - 10);
+    memcpy(out + 8 * half, &v, sizeof(v));
+  }
+#else
+  for (int i = 15; i >= 0; i --, x >>= 4)
+    out[i] = "0123456789abcdef"[x & 15];
+#endif
+}
+
+/**
+ * \brief Writes the eight bits of a byte as binary digits, most significant
+ * first
+ */
+inline void writeBinaryByte(char *out, unsigned char x)
+{
+  // Each byte's eight digits, as they are laid out in memory
+  static const struct Table
+  {
+    Table()
+    {
+      for (unsigned b = 0; b < 256; b ++)
+        for (unsigned j = 0; j < 8; j ++)
+          digits[b][j] = (b >> (7 - j)) & 1 ? '1' : '0';
+    }
+    char digits[256][8];
+  } table;
+  
+  memcpy(out, table.digits[x], 8);
+}
+
+/**
+ * \brief Writes x < 10^19 as exactly count <= 19 decimal digits, with
+ * leading zeros, ending just before end
+ */
+inline void writeDecimalWord(char *end, word_t x, size_t count)
+{
+  static const char pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+  
+  for (; count >= 2; count -= 2)
+  {
+    word_t pair = x % 100;
+    x /= 100;
+    *-- end = pairs[2 * pair + 1];
+    *-- end = pairs[2 * pair];
+  }
+  if (count)
+    *-- end = (char)('0' + x % 10);
+}
+
+/**
+ * \brief A power of ten, 10^(19 * 2^k), for splitting numbers in decimal
+ * conversion
+ */
+struct DecimalPower
+{
+  /**
+   * \brief The value of the power
+   */
+  std::vector<word_t> value;
+  
+  /**
+   * \brief The exponent 19 * 2^k, which is the number of digits the power
+   * splits off
+   */
+  size_t digits;
+  
+  /**
+   * \brief A reducer for dividing by the power, if it was asked for
+   */
+  std::vector<BarrettReducer> reducer;
+};
+
+/**
+ * \returns the powers 10^19, 10^38, 10^76, ... with at most half the given
+ * number of digits, each the square of the previous one
+ *
+ * \param divide - if set, prepare a BarrettReducer for each power
+ */
+inline std::vector<DecimalPower> decimalPowers(size_t digits, bool divide)
+{
+  std::vector<DecimalPower> powers;
+  std::vector<word_t> value(1, DECIMAL_WORD_BASE);
+  for (size_t d = DECIMAL_DIGITS_PER_WORD; 2 * d <= digits; d *= 2)
+  {
+    DecimalPower power;
+    power.value = value;
+    power.digits = d;
+    if (divide)
+      power.reducer.push_back(BarrettReducer(value.data(), value.size()));
+    powers.push_back(power);
+    
+    std::vector<word_t> square(2 * value.size());
+    multiplyWords(square.data(), value.data(), value.data(), value.size());
+    while (square.back() == 0)
+      square.pop_back();
+    value.swap(square);
+  }
+  return powers;
+}
+
+/**
+ * \brief Writes x < 10^digits as exactly that many decimal digits, with
+ * leading zeros
+ *
+ * Small numbers are divided by 10^19 repeatedly, which is quadratic. Larger
+ * ones are split by the largest power of ten with at most half the digits,
+ * and both halves are converted recursively, so the cost is that of the
+ * divisions, O(M(n) log n).
+ *
+ * \param x - n words, which are overwritten
+ * \param powers - decimalPowers() of at least digits, with reducers, or
+ *   empty if n is below BITVECTOR_TO_DECIMAL_THRESHOLD
+ */
+inline void wordsToDecimal(char *out, size_t digits, word_t *x, size_t n,
+  const std::vector<DecimalPower> &powers)
+{
+  while (n > 0 && x[n - 1] == 0)
+    -- n;
+  
+  size_t k = powers.size();
+  while (k > 0 && 2 * powers[k - 1].digits > digits)
+    -- k;
+  
+  if (n >= BITVECTOR_TO_DECIMAL_THRESHOLD && k > 0)
+  {
+    const DecimalPower &p = powers[k - 1];
+    const BarrettReducer &reducer = p.reducer[0];
+    std::vector<word_t> q(n), r(reducer.wordCount());
+    reducer.divide(q.data(), r.data(), x, n);
+    wordsToDecimal(out, digits - p.digits, q.data(), n, powers);
+    wordsToDecimal(out + digits - p.digits, p.digits, r.data(), r.size(),
+      powers);
+    return;
+  }
+  
+  WordDivisor base(DECIMAL_WORD_BASE);
+  char *end = out + digits;
+  while (end > out)
+  {
+    if (n == 0)
+    {
+      memset(out, '0', end - out);
+      break;
+    }
+    
+    word_t chunk = base.divide(x, x, n);
+    while (n > 0 && x[n - 1] == 0)
+      -- n;
+    
+    size_t count = (size_t)(end - out) < DECIMAL_DIGITS_PER_WORD ?
+      (size_t)(end - out) : DECIMAL_DIGITS_PER_WORD;
+    writeDecimalWord(end, chunk, count);
+    end -= count;
+  }
+}
+
+/**
+ * \brief Parses count decimal digits into x
+ *
+ * This mirrors wordsToDecimal(): short strings are read 19 digits at a time,
+ * and longer ones are split so that the low part has as many digits as one
+ * of the powers, which then joins the converted halves with one
+ * multiplication.
+ *
+ * \param x - decimalWords(count) words
+ * \returns the number of words of x in use
+ */
+inline size_t decimalToWords(word_t *x, const char *s, size_t count,
+  const std::vector<DecimalPower> &powers)
+{
+  size_t k = powers.size();
+  while (k > 0 && 2 * powers[k - 1].digits > count)
+    -- k;
+  
+  if (count >= DECIMAL_DIGITS_PER_WORD * BITVECTOR_FROM_DECIMAL_THRESHOLD &&
+    k > 0)
+  {
+    const DecimalPower &p = powers[k - 1];
+    size_t highCount = count - p.digits;
+    std::vector<word_t> high(decimalWords(highCount));
+    std::vector<word_t> low(decimalWords(p.digits));
+    size_t hn = decimalToWords(high.data(), s, highCount, powers);
+    size_t ln = decimalToWords(low.data(), s + highCount, p.digits, powers);
+    
+    // The word counts of the factors may add up to one more than x has
+    size_t pn = p.value.size();
+    std::vector<word_t> product(hn + pn + 1, 0);
+    if (hn >= pn)
+      multiplyUnbalancedWords(product.data(), high.data(), hn,
+        p.value.data(), pn);
+    else if (hn > 0)
+      multiplyUnbalancedWords(product.data(), p.value.data(), pn,
+        high.data(), hn);
+    
+    word_t carry = addWords(product.data(), product.data(), low.data(), ln);
+    addWord(product.data() + ln, product.data() + ln, product.size() - ln,
+      carry);
+    
+    size_t n = product.size();
+    while (n > 0 && product[n - 1] == 0)
+      -- n;
+    memcpy(x, product.data(), WORDS_TO_BYTES(n));
+    return n;
+  }
+  
+  static const word_t powersOfTen[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+  };
+  
+  size_t n = 0;
+  size_t chunk = count % DECIMAL_DIGITS_PER_WORD;
+  if (chunk == 0)
+    chunk = DECIMAL_DIGITS_PER_WORD;
+  for (size_t i = 0; i < count; i += chunk, chunk = DECIMAL_DIGITS_PER_WORD)
+  {
+    word_t value = 0;
+    for (size_t j = 0; j < chunk; j ++)
+      value = value * 10 + (s[i + j] - '0');
+    
+    // x = x * 10^chunk + value
+    word_t top = mulWord(x, x, n, powersOfTen[chunk]);
+    top += addWord(x, x, n, value);
+    if (top)
+      x[n ++] = top;
+  }
+  return n;
+}
+
+
+/**
+ * BitExpression
+ *
+ * \brief Base class of the lazily evaluated bitwise expressions built by the
+ * |, & and ^ and ~ operators.
+ *
+ * Combining BitVectors with these operators does not compute anything.
+ * Instead it builds a tree of expression nodes whose shape is known at compile
+ * time. Only when the tree is assigned to a BitVector (or used as the operand
+ * of a compound assignment) is it evaluated, in a single pass over the words
+ * with no intermediate storage. Each node provides:
+ *
+ *   - word(i), the value of the i-th word of the result
+ *   - width(), the width of the result in bits
+ *   - value_type, the BitVector type it evaluates to when no other type is
+ *     asked for, which is that of its leftmost operand
+ *   - get_allocator(), the allocator of its leftmost operand, which the
+ *     result is allocated with
+ *
+ * An expression can also be read like a BitVector: getBit(), popcount() and
+ * the comparison operators work a word at a time without evaluating it,
+ * and the other read-only members evaluate it into a temporary first.
+ *
+ * Nodes refer to the storage of the BitVectors they were built from, and
+ * read it when they are evaluated, not when they are built. An expression
+ * kept in an \c auto variable therefore sees later changes to its operands
+ * and must not outlive them; call evaluate() to keep the current value.
+ *
+ * Operations where a word depends on lower-order words (addition, negation)
+ * can't be computed one word at a time; they evaluate their expression
+ * operands into a BitVector first.
+ */
+template<typename E>
+class BitExpression
+{
+public:
+  const E &expression() const
+  {
+    return static_cast<const E &>(*this);
+  }
+  
+  word_t word(size_t i) const
+  {
+    return expression().word(i);
+  }
+  
+  size_t width() const
+  {
+    return expression().width();
+  }
+  
+  /**
+   * \returns the value of the expression as a new value_type
+   *
+   * The template parameter only delays naming E::value_type until E is a
+   * complete type.
+   */
+  template<typename V = E>
+  typename V::value_type evaluate() const
+  {
+    return typename V::value_type(*this);
+  }
+  
+  /**
+   * \returns the truth value of the specified bit
+   */
+  bool getBit(size_t index) const
+  {
+    return (word(WORD_INDEX_FOR_BIT_IN_ARRAY(index)) &
+      MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index))) != 0;
+  }
+  
+  bool operator[](size_t index) const
+  {
+    return getBit(index);
+  }
+  
+  /**
+   * \returns the number of set bits
+   */
+  size_t popcount() const
+  {
+    size_t n = BITS_TO_WORDS(width());
+    if (n == 0)
+      return 0;
+    
+    size_t count = 0;
+    for (size_t i = 0; i < n - 1; i ++)
+      count += countOnes(word(i));
+    return count + countOnes(word(n - 1) &
+      MASK_FOR_MOST_SIGNIFICANT_WORD(width()));
+  }
+  
+  size_t bitLength() const
+  {
+    return evaluate().bitLength();
+  }
+  
+  size_t findFirstSet() const
+  {
+    return evaluate().findFirstSet();
+  }
+  
+  size_t findLastSet() const
+  {
+    return evaluate().findLastSet();
+  }
+  
+  word_t hash(word_t seed = 0) const
+  {
+    return evaluate().hash(seed);
+  }
+  
+  std::string toString(int radix = 2) const
+  {
+    return evaluate().toString(radix);
+  }
+};
+
+/**
+ * BitVectorOperand
+ *
+ * \brief Leaf of a BitExpression tree referring to the words of a BitVector
+ */
+template<size_t N, typename A>
+class BitVectorOperand : public BitExpression<BitVectorOperand<N, A> >
+{
+public:
+  typedef BitVector<N, A> value_type;
+  
+  BitVectorOperand(const BitVector<N, A> &bv)
+    : words(bv.data()), length(bv.width()), source(&bv) { }
+  
+  word_t word(size_t i) const
+  {
+    return words[i];
+  }
+  
+  size_t width() const
+  {
+    return length;
+  }
+  
+  A get_allocator() const
+  {
+    return source->get_allocator();
+  }
+  
+private:
+  const word_t *words;
+  size_t length;
+  const BitVector<N, A> *source;
+};
+
+/**
+ * \brief Word-wise operations used by BitBinaryExpression
+ */
+struct BitOr
+{
+  static word_t apply(word_t x, word_t y) { return x | y; }
+};
+
+struct BitAnd
+{
+  static word_t apply(word_t x, word_t y) { return x & y; }
+};
+
+struct BitXor
+{
+  static word_t apply(word_t x, word_t y) { return x ^ y; }
+};
+
+/**
+ * BitBinaryExpression
+ *
+ * \brief Expression node combining two operands word-by-word with Op
+ */
+template<typename Op, typename L, typename R>
+class BitBinaryExpression : public BitExpression<BitBinaryExpression<Op, L, R> >
+{
+public:
+  typedef typename L::value_type value_type;
+  
+  BitBinaryExpression(const L &Lhs, const R &Rhs) : lhs(Lhs), rhs(Rhs)
+  {
+    assert(lhs.width() == rhs.width() && "Operands must have equal widths");
+  }
+  
+  word_t word(size_t i) const
+  {
+    return Op::apply(lhs.word(i), rhs.word(i));
+  }
+  
+  size_t width() const
+  {
+    return lhs.width();
+  }
+  
+  typename value_type::allocator_type get_allocator() const
+  {
+    return lhs.get_allocator();
+  }
+  
+private:
+  L lhs;
+  R rhs;
+};
+
+/**
+ * BitComplementExpression
+ *
+ * \brief Expression node computing the one's complement of its operand
+ */
+template<typename E>
+class BitComplementExpression : public BitExpression<BitComplementExpression<E> >
+{
+public:
+  typedef typename E::value_type value_type;
+  
+  explicit BitComplementExpression(const E &Operand) : operand(Operand) { }
+  
+  word_t word(size_t i) const
+  {
+    return ~operand.word(i);
+  }
+  
+  size_t width() const
+  {
+    return operand.width();
+  }
+  
+  typename value_type::allocator_type get_allocator() const
+  {
+    return operand.get_allocator();
+  }
+  
+private:
+  E operand;
+};
+
+/**
+ * BitExpressionNode
+ *
+ * \brief Maps an operand type to the node type stored for it in an
+ * expression tree: BitVectors become a BitVectorOperand, and expressions are
+ * stored as themselves.
+ *
+ * The member \c lazy is true when the operand may be referenced lazily. A
+ * BitVector that is about to expire is not; the operators evaluate such
+ * expressions eagerly into its storage instead.
+ */
+template<typename T, typename = void>
+struct BitExpressionNode
+{
+  static const bool lazy = false;
+  typedef void type;
+};
+
+template<size_t N, typename A>
+struct BitExpressionNode<BitVector<N, A> &>
+{
+  static const bool lazy = true;
+  typedef BitVectorOperand<N, A> type;
+};
+
+template<size_t N, typename A>
+struct BitExpressionNode<const BitVector<N, A> &>
+  : BitExpressionNode<BitVector<N, A> &>
+{
+};
+
+template<typename T>
+struct BitExpressionNode<T,
+  typename std::enable_if<std::is_base_of<BitExpression<
+    typename std::decay<T>::type>, typename std::decay<T>::type>::value>::type>
+{
+  static const bool lazy = true;
+  typedef typename std::decay<T>::type type;
+};
+
+/**
+ * \brief Result type of a lazy binary operator, or a substitution failure if
+ * either operand can't be referenced lazily
+ */
+template<typename Op, typename L, typename R>
+struct BitBinaryResult
+  : std::enable_if<BitExpressionNode<L>::lazy && BitExpressionNode<R>::lazy,
+      BitBinaryExpression<Op, typename BitExpressionNode<L>::type,
+        typename BitExpressionNode<R>::type> >
+{
+};
+
+
+/**
+ * BitVector
+ *
+ * \brief A fixed-length array of bits that supports efficient arithmetic
+ * operations.
+ *
+ * The array is created with some number of bits (N) in-object, which allows it
+ * to avoid heap allocation when the actual number of elements is below that
+ * threshold. This allows normal "small" cases to be fast without losing
+ * generality for large inputs.
+ *
+ * Once the width exceeds N, every word (not only the ones that don't fit
+ * in-object) moves to a single heap allocation. Either way the words are
+ * reached through one pointer to a contiguous range, so loops over the words
+ * never need to ask where a particular word lives.
+ *
+ * Heap storage comes from the Allocator, which may be any allocator of
+ * word_t meeting the standard allocator requirements, including
+ * std::pmr::polymorphic_allocator<word_t>. The default aligns it to a cache
+ * line, and Allocators.hpp offers an arena and a size-class pool. Results of
+ * operations are allocated with the allocator the copy constructor would
+ * choose, so those of a std::pmr allocator come from the default resource,
+ * while those of an ArenaAllocator come from the same arena.
+ *
+ * Words are ordered least significant to most significant. Ordering of bits
+ * within words is architecture dependent.
+ */
+template<size_t N, typename Allocator>
+class BitVector : private Allocator
+{
+  typedef std::allocator_traits<Allocator> AllocatorTraits;
+  
+  static_assert(std::is_same<typename AllocatorTraits::value_type,
+    word_t>::value, "The allocator must allocate word_t");
+  static_assert(std::is_same<typename AllocatorTraits::pointer,
+    word_t *>::value, "The allocator must return plain pointers");
+  
+public:
+  typedef Allocator allocator_type;
+  
+  
+  /**
+   * BitRef
+   *
+   * \brief Like std::bitset::reference, allows reading and setting a single
+   * bit within the BitVector.
+   *
+   * These wrap BitVector::getBit, BitVector::setBit, and BitVector::flipBit.
+   */
+  class BitRef
+  {
+  public:
+    BitRef &operator=(bool x)
+    {
+      bv.setBit(index, x);
+      return *this;
+    }
+    
+    BitRef &operator=(const BitRef &other)
+    {
+      bv.setBit(index, (bool)other);
+      return *this;
+    }
+    
+    void flip()
+    {
+      bv.flipBit(index);
+    }
+    
+    operator bool() const
+    {
+      return ((const BitVector &)bv).operator[](index);
+    }
+    
+  private:
+    friend class BitVector;
+    
+    BitRef() { }
+    BitRef(BitVector &BV, size_t Index) : bv(BV), index(Index) { }
+    
+    /**
+     * \brief The BitVector this BitRef refers to
+     */
+    BitVector &bv;
+    
+    /**
+     * \brief The position of the referenced bit within the BitVector
+     */
+    size_t index;
+  };
+  
+  
+  /**
+   * \brief Constructs a BitVector with the capacity for n bits
+   *
+   * If n is greater than N, the remaining required space is allocated on the
+   * heap. Choose N wisely to avoid this allocation.
+   *
+   * \param n - the length of the BitVector
+   * \param clear - if set, memory allocated on the heap is cleared. Pass false
+   *   if the data on the heap is going to be overwritten immediately.
+   * \param allocator - the allocator for heap storage
+   */
+  BitVector(size_t n, bool clear = true,
+    const Allocator &allocator = Allocator())
+    : Allocator(allocator), length(0), storage(words), heapWords(0)
+  {
+    // Unset all bits; the default value of a BitVector is 0
+    memset(words, 0, sizeof(words));
+    
+    // Resize to the specified size to allocate additional storage on the heap
+    resize(n, clear);
+  }
+  
+  BitVector(const BitVector &other)
+    : Allocator(AllocatorTraits::select_on_container_copy_construction(
+        other.get_allocator())),
+      length(0), storage(words), heapWords(0)
+  {
+    copyFrom(other);
+  }
+  
+  BitVector(const BitVector &other, const Allocator &allocator)
+    : Allocator(allocator), length(0), storage(words), heapWords(0)
+  {
+    copyFrom(other);
+  }
+  
+  /**
+   * \brief Constructs a BitVector by taking over the storage of another
+   *
+   * Heap storage is stolen without copying; in-object words are copied. The
+   * other BitVector is left with a width of 0.
+   */
+  BitVector(BitVector &&other) noexcept
+    : Allocator(other.get_allocator()), length(0), storage(words),
+      heapWords(0)
+  {
+    moveFrom(other);
+  }
+  
+  /**
+   * \brief Constructs a BitVector by evaluating a BitExpression
+   *
+   * This is what makes <tt>BitVector<N> x = (a & b) | ~c;</tt> run as a
+   * single pass over the words.
+   */
+  template<typename E>
+  BitVector(const BitExpression<E> &expr)
+    : Allocator(AllocatorTraits::select_on_container_copy_construction(
+        expr.expression().get_allocator())),
+      length(0), storage(words), heapWords(0)
+  {
+    resize(expr.width(), false);
+    assign(expr.expression());
+  }
+  
+  template<typename E>
+  BitVector(const BitExpression<E> &expr, const Allocator &allocator)
+    : Allocator(allocator), length(0), storage(words), heapWords(0)
+  {
+    resize(expr.width(), false);
+    assign(expr.expression());
+  }
+  
+  /**
+   * \brief Constructs a BitVector from a string
+   *
+   * The width is the number of bits the digits can represent: one, three or
+   * four per digit in bases 2, 8 and 16, and enough for any number of as
+   * many digits in base 10. The string must not have a prefix or sign.
+   *
+   * \param string - a C string containing digits
+   * \param radix - the base of the digits in the string: 2, 8, 10 or 16
+   * \param allocator - the allocator for heap storage
+   */
+  BitVector(const char *string, int radix,
+    const Allocator &allocator = Allocator())
+    : Allocator(allocator), length(0), storage(words), heapWords(0)
+  {
+    size_t count = strlen(string);
+    unsigned bits = bitsPerDigit(radix);
+    resize(bits ? count * bits : decimalBits(count), false);
+    
+    bool valid = fromString(string, count, radix);
+    assert(valid && "String is not a number in a supported radix");
+    (void)valid;
+  }
+  
+  ~BitVector()
+  {
+    releaseHeap();
+  }
+  
+  /**
+   * \returns a copy of the allocator for heap storage
+   */
+  Allocator get_allocator() const
+  {
+    return *this;
+  }
+  
+  size_t width() const
+  {
+    return length;
+  }
+  
+  /**
+   * \returns the number of words used to store the BitVector
+   */
+  size_t wordCount() const
+  {
+    return BITS_TO_WORDS(length);
+  }
+  
+  /**
+   * \brief Direct access to the contiguous word storage
+   *
+   * Words are ordered least significant first. Bits above width() in the most
+   * significant word are unspecified.
+   */
+  word_t *data()
+  {
+    return storage;
+  }
+  
+  const word_t *data() const
+  {
+    return storage;
+  }
+  
+  /**
+   * \returns the length of toString(radix) in bases 2, 8 and 16, which
+   * always have one digit per one, three or four bits of the width, an
+   * upper bound on it in base 10, or 0 for an unsupported radix
+   */
+  size_t stringLength(int radix) const
+  {
+    if (!isSupportedRadix(radix))
+      return 0;
+    unsigned bits = bitsPerDigit(radix);
+    return bits ? CEILDIV(length, bits) : decimalLength(length);
+  }
+  
+  /**
+   * \brief Writes the digits of the BitVector into a buffer, followed by a
+   * null terminator
+   *
+   * Bases 2, 8 and 16 keep leading zeros, so that the output has exactly
+   * stringLength(radix) digits; base 10 has none. Prefixes are not
+   * prepended to the output. Any other radix writes no digits.
+   *
+   * \param buffer - receives the digits
+   * \param size - the size of buffer, at least stringLength(radix) + 1
+   * \param radix - the base to output in: 2, 8, 10 or 16
+   * \returns the number of digits written, not counting the terminator
+   */
+  size_t toChars(char *buffer, size_t size, int radix = 2) const
+  {
+    assert(size > stringLength(radix) && "Buffer is too small");
+    (void)size;
+    
+    size_t count = writeDigits(buffer, radix);
+    buffer[count] = '\0';
+    return count;
+  }
+  
+  /**
+   * \brief Writes the digits of the BitVector into a string, reusing its
+   * storage if it has the capacity
+   *
+   * \see toChars()
+   */
+  void toString(std::string &out, int radix = 2) const
+  {
+    out.resize(stringLength(radix));
+    if (!out.empty())
+      out.resize(writeDigits(&out[0], radix));
+  }
+  
+  /**
+   * \brief Generates a string representing the BitVector
+   *
+   * \see toChars()
+   */
+  std::string toString(int radix = 2) const
+  {
+    std::string str;
+    toString(str, radix);
+    return str;
+  }
+  
+  /**
+   * \brief Sets the value from a string of digits, keeping the width
+   *
+   * Digits beyond the width are discarded, as if the value were reduced
+   * modulo 2^width(). Hexadecimal digits may be either case.
+   *
+   * \param string - count digits with no prefix or sign
+   * \param radix - the base of the digits: 2, 8, 10 or 16
+   * \returns false, leaving the value unchanged, if the radix is not one of
+   *   those or the string contains a character that isn't a digit in it
+   */
+  bool fromString(const char *string, size_t count, int radix)
+  {
+    if (!isSupportedRadix(radix))
+      return false;
+    
+    unsigned bits = bitsPerDigit(radix);
+    for (size_t i = 0; i < count; i ++)
+    {
+      if (digitValue(string[i]) >= (unsigned)radix)
+        return false;
+    }
+    
+    size_t n = wordCount();
+    if (bits)
+    {
+      // Place each digit's bits, from the least significant digit up
+      memset(storage, 0, WORDS_TO_BYTES(n));
+      for (size_t i = 0; i < count; i ++)
+      {
+        size_t pos = bits * i;
+        if (pos >= WORDS_TO_BITS(n))
+          break;
+        
+        word_t value = digitValue(string[count - 1 - i]);
+        size_t w = pos / BITS_PER_WORD;
+        unsigned b = pos % BITS_PER_WORD;
+        storage[w] |= value << b;
+        if (b + bits > BITS_PER_WORD && w + 1 < n)
+          storage[w + 1] |= value >> (BITS_PER_WORD - b);
+      }
+      return true;
+    }
+    
+    std::vector<DecimalPower> powers;
+    if (count >= DECIMAL_DIGITS_PER_WORD * BITVECTOR_FROM_DECIMAL_THRESHOLD)
+      powers = decimalPowers(count, false);
+    std::vector<word_t> x(decimalWords(count));
+    size_t used = decimalToWords(x.data(), string, count, powers);
+    
+    if (used > n)
+      used = n;
+    memcpy(storage, x.data(), WORDS_TO_BYTES(used));
+    memset(storage + used, 0, WORDS_TO_BYTES(n - used));
+    return true;
+  }
+  
+  bool fromString(const char *string, int radix)
+  {
+    return fromString(string, strlen(string), radix);
+  }
+  
+  /**
+   * \param index - the index of the bit
+   * \returns true if the bit is 1, false otherwise
+   */
+  bool getBit(size_t index) const
+  {
+    size_t wordidx = WORD_INDEX_FOR_BIT_IN_ARRAY(index);
+    size_t position = BIT_POSITION_FOR_BIT_IN_WORD(index);
+    return (WORD(wordidx) & MASK_WITH_BIT(position)) != 0;
+  }
+  
+  /**
+   * \param index - the index of the bit
+   * \param x - true if the bit should be set to 1, false otherwise
+   */
+  void setBit(size_t index, bool x)
+  {
+    size_t wordidx = WORD_INDEX_FOR_BIT_IN_ARRAY(index);
+    size_t position = BIT_POSITION_FOR_BIT_IN_WORD(index);
+    if (x)
+      WORD(wordidx) |= MASK_WITH_BIT(position);
+    else
+      WORD(wordidx) &= ~(MASK_WITH_BIT(position));
+  }
+  
+  /**
+   * \param index - the index of the bit
+   */
+  void flipBit(size_t index)
+  {
+    size_t wordidx = WORD_INDEX_FOR_BIT_IN_ARRAY(index);
+    size_t position = BIT_POSITION_FOR_BIT_IN_WORD(index);
+    WORD(wordidx) ^= MASK_WITH_BIT(position);
+  }
+  
+  /**
+   * \returns the truth value of the specified bit
+   */
+  bool operator[](size_t index) const
+  {
+    return getBit(index);
+  }
+  
+  /**
+   * \returns a BitRef for the specified bit, supporting assignment
+   */
+  BitRef operator[](size_t index)
+  {
+    return BitRef(*this, index);
+  }
+  
+  /**
+   * \returns the index of the lowest set bit, or width() if there is none
+   */
+  size_t findFirstSet() const
+  {
+    return findNext(0, 0);
+  }
+  
+  /**
+   * \returns the index of the lowest set bit at or above pos, or width() if
+   *   there is none
+   */
+  size_t findNextSet(size_t pos) const
+  {
+    return findNext(pos, 0);
+  }
+  
+  /**
+   * \returns the index of the highest set bit, or width() if there is none
+   */
+  size_t findLastSet() const
+  {
+    return findLast(0);
+  }
+  
+  /**
+   * \returns the index of the lowest clear bit, or width() if there is none
+   */
+  size_t findFirstClear() const
+  {
+    return findNext(0, ~(word_t)0);
+  }
+  
+  /**
+   * \returns the index of the lowest clear bit at or above pos, or width() if
+   *   there is none
+   */
+  size_t findNextClear(size_t pos) const
+  {
+    return findNext(pos, ~(word_t)0);
+  }
+  
+  /**
+   * \returns the index of the highest clear bit, or width() if there is none
+   */
+  size_t findLastClear() const
+  {
+    return findLast(~(word_t)0);
+  }
+  
+  /**
+   * \returns the number of bits needed to represent the value, i.e. one more
+   *   than the index of the highest set bit, or 0 if the value is zero
+   */
+  size_t bitLength() const
+  {
+    size_t last = findLast(0);
+    return (last == length) ? 0 : last + 1;
+  }
+  
+  /**
+   * \returns the number of set bits
+   */
+  size_t popcount() const
+  {
+    return countBits(storage, 0, length);
+  }
+  
+  /**
+   * \returns a 64-bit hash of the bits, which is equal for equal vectors of
+   *   equal width
+   *
+   * \see hashBits()
+   */
+  word_t hash(word_t seed = 0) const
+  {
+    return hashBits(storage, length, seed);
+  }
+  
+  /**
+   * SetBitIterator
+   *
+   * \brief A forward iterator over the indices of the set bits, in
+   * increasing order
+   *
+   * The iterator keeps the remaining bits of the current word, so advancing
+   * within a word clears the lowest bit and advancing past it skips the
+   * following zero words in bulk. It is invalidated when the BitVector is
+   * modified.
+   */
+  class SetBitIterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef size_t value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const size_t *pointer;
+    typedef size_t reference;
+    
+    size_t operator*() const
+    {
+      return WORDS_TO_BITS(index) + countTrailingZeros(current);
+    }
+    
+    SetBitIterator &operator++()
+    {
+      current &= current - 1;
+      if (current == 0)
+        advance(index + 1);
+      return *this;
+    }
+    
+    SetBitIterator operator++(int)
+    {
+      SetBitIterator old = *this;
+      ++ *this;
+      return old;
+    }
+    
+    bool operator==(const SetBitIterator &other) const
+    {
+      return index == other.index && current == other.current;
+    }
+    
+    bool operator!=(const SetBitIterator &other) const
+    {
+      return !(*this == other);
+    }
+    
+  private:
+    friend class BitVector;
+    
+    /**
+     * \brief Positions the iterator at the first set bit in or after word i
+     */
+    SetBitIterator(const BitVector &BV, size_t i) : bv(&BV), current(0)
+    {
+      advance(i);
+    }
+    
+    /**
+     * \brief Moves to the first word from i on that has any set bits, or to
+     * the end if there is none
+     */
+    void advance(size_t i)
+    {
+      // In dense vectors the next word usually has set bits, so only call
+      // the kernel to skip a run of zero words. The most significant word is
+      // left out of the skip, as it must be masked.
+      size_t n = bv->wordCount();
+      if (i + 1 < n && bv->storage[i] == 0)
+        i += wordKernels().skipFillForward(bv->storage + i, n - 1 - i, 0);
+      
+      index = i;
+      current = 0;
+      if (i + 1 < n)
+        current = bv->storage[i];
+      else if (i + 1 == n)
+        current = bv->storage[i] & MASK_FOR_MOST_SIGNIFICANT_WORD(bv->length);
+      if (current == 0)
+        index = n;
+    }
+    
+    /**
+     * \brief The BitVector being iterated over
+     */
+    const BitVector *bv;
+    
+    /**
+     * \brief The index of the current word, or wordCount() at the end
+     */
+    size_t index;
+    
+    /**
+     * \brief The bits of the current word that have not been visited yet
+     */
+    word_t current;
+  };
+  
+  /**
+   * SetBitRange
+   *
+   * \brief The indices of the set bits of a BitVector, for use in range-based
+   * for loops
+   */
+  class SetBitRange
+  {
+  public:
+    SetBitIterator begin() const
+    {
+      return SetBitIterator(bv, 0);
+    }
+    
+    SetBitIterator end() const
+    {
+      return SetBitIterator(bv, bv.wordCount());
+    }
+    
+  private:
+    friend class BitVector;
+    
+    SetBitRange(const BitVector &BV) : bv(BV) { }
+    
+    /**
+     * \brief The BitVector whose set bits are listed
+     */
+    const BitVector &bv;
+  };
+  
+  /**
+   * \returns the indices of the set bits in increasing order, as in
+   *
+   *     for (size_t i : v.setBitIndices())
+   *       ...
+   */
+  SetBitRange setBitIndices() const
+  {
+    return SetBitRange(*this);
+  }
+  
+  BitVector &operator|=(const BitVector &rhs)
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    wordKernels().orWords(storage, rhs.storage, wordCount());
+    return *this;
+  }
+  
+  template<typename E>
+  BitVector &operator|=(const BitExpression<E> &rhs)
+  {
+    assert(length == rhs.width() && "Operands must have equal widths");
+    
+    word_t *dst = storage;
+    const E &src = rhs.expression();
+    for (size_t i = 0, n = wordCount(); i < n; i ++)
+      dst[i] |= src.word(i);
+    return *this;
+  }
+  
+  /**
+   * \brief Computes the OR into the storage of this expiring operand, so
+   * that chained expressions only allocate for the first temporary
+   *
+   * When neither operand is expiring, the | operator instead builds a lazy
+   * BitExpression (see the free operator templates below the class).
+   */
+  BitVector operator|(const BitVector &rhs) &&
+  {
+    this->operator|=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector operator|(BitVector &&rhs) const &
+  {
+    rhs.operator|=(*this);
+    return std::move(rhs);
+  }
+  
+  BitVector operator|(BitVector &&rhs) &&
+  {
+    this->operator|=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector &operator&=(const BitVector &rhs)
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    wordKernels().andWords(storage, rhs.storage, wordCount());
+    return *this;
+  }
+  
+  template<typename E>
+  BitVector &operator&=(const BitExpression<E> &rhs)
+  {
+    assert(length == rhs.width() && "Operands must have equal widths");
+    
+    word_t *dst = storage;
+    const E &src = rhs.expression();
+    for (size_t i = 0, n = wordCount(); i < n; i ++)
+      dst[i] &= src.word(i);
+    return *this;
+  }
+  
+  /**
+   * \brief Computes the AND into the storage of this expiring operand, so
+   * that chained expressions only allocate for the first temporary
+   *
+   * When neither operand is expiring, the & operator instead builds a lazy
+   * BitExpression (see the free operator templates below the class).
+   */
+  BitVector operator&(const BitVector &rhs) &&
+  {
+    this->operator&=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector operator&(BitVector &&rhs) const &
+  {
+    rhs.operator&=(*this);
+    return std::move(rhs);
+  }
+  
+  BitVector operator&(BitVector &&rhs) &&
+  {
+    this->operator&=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector &operator^=(const BitVector &rhs)
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    wordKernels().xorWords(storage, rhs.storage, wordCount());
+    return *this;
+  }
+  
+  template<typename E>
+  BitVector &operator^=(const BitExpression<E> &rhs)
+  {
+    assert(length == rhs.width() && "Operands must have equal widths");
+    
+    word_t *dst = storage;
+    const E &src = rhs.expression();
+    for (size_t i = 0, n = wordCount(); i < n; i ++)
+      dst[i] ^= src.word(i);
+    return *this;
+  }
+  
+  /**
+   * \brief Computes the XOR into the storage of this expiring operand, so
+   * that chained expressions only allocate for the first temporary
+   *
+   * When neither operand is expiring, the ^ operator instead builds a lazy
+   * BitExpression (see the free operator templates below the class).
+   */
+  BitVector operator^(const BitVector &rhs) &&
+  {
+    this->operator^=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector operator^(BitVector &&rhs) const &
+  {
+    rhs.operator^=(*this);
+    return std::move(rhs);
+  }
+  
+  BitVector operator^(BitVector &&rhs) &&
+  {
+    this->operator^=(rhs);
+    return std::move(*this);
+  }
+  
+  /**
+   * \brief Logical left shift
+   *
+   * Left shift slides bits towards the more significant end. Shifting by the
+   * width or more clears every bit.
+   */
+  BitVector &operator<<=(size_t count)
+  {
+    shiftLeftBits(storage, storage, wordCount(), count);
+    return *this;
+  }
+  
+  BitVector operator<<(size_t count) const &
+  {
+    BitVector result(length, false, resultAllocator());
+    shiftLeftBits(result.storage, storage, wordCount(), count);
+    return result;
+  }
+  
+  BitVector operator<<(size_t count) &&
+  {
+    this->operator<<=(count);
+    return std::move(*this);
+  }
+  
+  /**
+   * \brief Logical right shift
+   *
+   * Right shift slides bits towards the less significant end, shifting in
+   * zeros. Shifting by the width or more clears every bit.
+   */
+  BitVector &operator>>=(size_t count)
+  {
+    shiftRightBits(storage, storage, length, count);
+    return *this;
+  }
+  
+  BitVector operator>>(size_t count) const &
+  {
+    BitVector result(length, false, resultAllocator());
+    shiftRightBits(result.storage, storage, length, count);
+    return result;
+  }
+  
+  BitVector operator>>(size_t count) &&
+  {
+    this->operator>>=(count);
+    return std::move(*this);
+  }
+  
+  /**
+   * \brief Arithmetic right shift, in place
+   *
+   * Like operator>>=(), but copies of the most significant bit are shifted
+   * in, treating the value as two's complement.
+   */
+  BitVector &arithmeticShiftRight(size_t count)
+  {
+    shiftRightBits(storage, storage, length, count, signFill());
+    return *this;
+  }
+  
+  /**
+   * \brief Arithmetic right shift into a new BitVector
+   */
+  BitVector ashr(size_t count) const
+  {
+    BitVector result(length, false, resultAllocator());
+    shiftRightBits(result.storage, storage, length, count, signFill());
+    return result;
+  }
+  
+  /**
+   * \brief Rotates left by count bits, in place
+   *
+   * Bits shifted out of the most significant end come back in at the least
+   * significant end. Only the smaller of the two parts of the rotation is
+   * copied aside; the rest is shifted in place.
+   */
+  BitVector &rotateLeft(size_t count)
+  {
+    if (length == 0 || (count %= length) == 0)
+      return *this;
+    if (count > length / 2)
+      return rotateRight(length - count);
+    
+    // Set the top count bits aside; the left shift clears their destination
+    size_t n = BITS_TO_WORDS(count);
+    ScratchWords wrapped(*this, n);
+    for (size_t i = 0; i < n; i ++)
+      wrapped.data()[i] = extractWord(storage, length, length - count +
+        i * BITS_PER_WORD);
+    
+    shiftLeftBits(storage, storage, wordCount(), count);
+    for (size_t i = 0; i < n; i ++)
+      storage[i] |= wrapped.data()[i];
+    return *this;
+  }
+  
+  /**
+   * \brief Rotates right by count bits, in place
+   *
+   * Bits shifted out of the least significant end come back in at the most
+   * significant end.
+   */
+  BitVector &rotateRight(size_t count)
+  {
+    if (length == 0 || (count %= length) == 0)
+      return *this;
+    if (count > length / 2)
+      return rotateLeft(length - count);
+    
+    // Set the low count bits aside; the right shift clears their destination
+    size_t n = BITS_TO_WORDS(count);
+    ScratchWords wrapped(*this, n);
+    for (size_t i = 0; i < n; i ++)
+      wrapped.data()[i] = extractWord(storage, count, i * BITS_PER_WORD);
+    
+    shiftRightBits(storage, storage, length, count);
+    orBitsAt(storage, wordCount(), wrapped.data(), count, length - count);
+    return *this;
+  }
+  
+  /**
+   * \brief Rotates left into a new BitVector, in a single pass over the
+   * words plus one over the wrapped bits
+   */
+  BitVector rotl(size_t count) const
+  {
+    if (length == 0 || (count %= length) == 0)
+      return *this;
+    
+    BitVector result(length, false, resultAllocator());
+    shiftLeftBits(result.storage, storage, wordCount(), count);
+    for (size_t i = 0; i < BITS_TO_WORDS(count); i ++)
+      result.storage[i] |= extractWord(storage, length, length - count +
+        i * BITS_PER_WORD);
+    return result;
+  }
+  
+  /**
+   * \brief Rotates right into a new BitVector
+   */
+  BitVector rotr(size_t count) const
+  {
+    if (length == 0 || (count %= length) == 0)
+      return *this;
+    
+    BitVector result(length, false, resultAllocator());
+    shiftRightBits(result.storage, storage, length, count);
+    orBitsAt(result.storage, wordCount(), storage, count, length - count);
+    return result;
+  }
+  
+  /**
+   * \returns bits [pos, pos + len) in the low bits of a word, where len is at
+   *   most BITS_PER_WORD
+   */
+  word_t getBits(size_t pos, size_t len) const
+  {
+    assert(len <= BITS_PER_WORD && pos + len <= length &&
+      "Field must fit in a word and in the BitVector");
+    if (len == 0)
+      return 0;
+    
+    size_t w = WORD_INDEX_FOR_BIT_IN_ARRAY(pos);
+    unsigned b = BIT_POSITION_FOR_BIT_IN_WORD(pos);
+    word_t value = storage[w] >> b;
+    if (b + len > BITS_PER_WORD)
+      value |= storage[w + 1] << (BITS_PER_WORD - b);
+    return value & MASK_FOR_MOST_SIGNIFICANT_WORD(len);
+  }
+  
+  /**
+   * \brief Overwrites bits [pos, pos + len) with the low len bits of value,
+   * where len is at most BITS_PER_WORD
+   */
+  void setBits(size_t pos, size_t len, word_t value)
+  {
+    assert(len <= BITS_PER_WORD && pos + len <= length &&
+      "Field must fit in a word and in the BitVector");
+    insertBits(storage, pos, &value, len);
+  }
+  
+  /**
+   * \returns bits [pos, pos + len) as a new len-bit BitVector
+   */
+  BitVector extract(size_t pos, size_t len) const
+  {
+    assert(pos + len <= length && "Range must be within the BitVector");
+    BitVector result(len, false, resultAllocator());
+    extractBits(result.storage, storage, pos, len);
+    return result;
+  }
+  
+  /**
+   * \returns bits [begin, end) as a new BitVector, like extract()
+   */
+  BitVector slice(size_t begin, size_t end) const
+  {
+    assert(begin <= end && "Range must not be reversed");
+    return extract(begin, end - begin);
+  }
+  
+  /**
+   * \brief Overwrites bits [pos, pos + src.width()) with the bits of src
+   */
+  BitVector &insert(size_t pos, const BitVector &src)
+  {
+    assert(pos + src.length <= length && "Range must be within the BitVector");
+    insertBits(storage, pos, src.storage, src.length);
+    return *this;
+  }
+  
+  /**
+   * \returns a copy widened to width bits, with zeros above the old width
+   */
+  BitVector zeroExtend(size_t width) const
+  {
+    return extend(width, 0);
+  }
+  
+  /**
+   * \returns a copy widened to width bits, with copies of the most
+   *   significant bit above the old width
+   */
+  BitVector signExtend(size_t width) const
+  {
+    return extend(width, signFill());
+  }
+  
+  /**
+   * \returns a copy narrowed to the low width bits
+   */
+  BitVector truncate(size_t width) const
+  {
+    assert(width <= length && "Truncation must not widen");
+    BitVector result(width, false, resultAllocator());
+    memcpy(result.storage, storage, WORDS_TO_BYTES(result.wordCount()));
+    return result;
+  }
+  
+  BitVector &operator++()
+  {
+    incrementWords(storage, wordCount());
+    return *this;
+  }
+  
+  BitVector operator++(int)
+  {
+    BitVector result(*this);
+    this->operator++();
+    return result;
+  }
+  
+  BitVector &operator--()
+  {
+    decrementWords(storage, wordCount());
+    return *this;
+  }
+  
+  BitVector operator--(int)
+  {
+    BitVector result(*this);
+    this->operator--();
+    return result;
+  }
+  
+  /**
+   * \brief Adds modulo 2^width(); the carry out of the top bit is discarded
+   */
+  BitVector &operator+=(const BitVector &rhs)
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    addWords(storage, storage, rhs.storage, wordCount());
+    return *this;
+  }
+  
+  /**
+   * \brief Adds a single word, stopping as soon as the carry dies out
+   */
+  BitVector &operator+=(word_t rhs)
+  {
+    addWord(storage, storage, wordCount(), rhs);
+    return *this;
+  }
+  
+  /**
+   * \brief Subtracts modulo 2^width(); the borrow out of the top bit is
+   * discarded
+   */
+  BitVector &operator-=(const BitVector &rhs)
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    subtractWords(storage, storage, rhs.storage, wordCount());
+    return *this;
+  }
+  
+  /**
+   * \brief Subtracts a single word, stopping as soon as the borrow dies out
+   */
+  BitVector &operator-=(word_t rhs)
+  {
+    subtractWord(storage, storage, wordCount(), rhs);
+    return *this;
+  }
+  
+  BitVector operator+(const BitVector &rhs) const &
+  {
+    BitVector result(*this);
+    result.operator+=(rhs);
+    return result;
+  }
+  
+  /**
+   * \brief Computes the sum into the storage of this expiring operand, so
+   * that chained expressions only allocate for the first temporary
+   */
+  BitVector operator+(const BitVector &rhs) &&
+  {
+    this->operator+=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector operator+(BitVector &&rhs) const &
+  {
+    rhs.operator+=(*this);
+    return std::move(rhs);
+  }
+  
+  BitVector operator+(BitVector &&rhs) &&
+  {
+    this->operator+=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector operator+(word_t rhs) const &
+  {
+    BitVector result(*this);
+    result.operator+=(rhs);
+    return result;
+  }
+  
+  BitVector operator+(word_t rhs) &&
+  {
+    this->operator+=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector operator-(const BitVector &rhs) const &
+  {
+    BitVector result(*this);
+    result.operator-=(rhs);
+    return result;
+  }
+  
+  /**
+   * \brief Computes the difference into the storage of this expiring operand
+   */
+  BitVector operator-(const BitVector &rhs) &&
+  {
+    this->operator-=(rhs);
+    return std::move(*this);
+  }
+  
+  /**
+   * \brief Computes the difference into the storage of the expiring right
+   * operand
+   */
+  BitVector operator-(BitVector &&rhs) const &
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    subtractWords(rhs.storage, storage, rhs.storage, wordCount());
+    return std::move(rhs);
+  }
+  
+  BitVector operator-(BitVector &&rhs) &&
+  {
+    this->operator-=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector operator-(word_t rhs) const &
+  {
+    BitVector result(*this);
+    result.operator-=(rhs);
+    return result;
+  }
+  
+  BitVector operator-(word_t rhs) &&
+  {
+    this->operator-=(rhs);
+    return std::move(*this);
+  }
+  
+  /**
+   * \brief Multiplies modulo 2^width(); the high half of the product is
+   * discarded
+   *
+   * The algorithm depends on the width; see multiplyWords().
+   */
+  BitVector &operator*=(const BitVector &rhs)
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    size_t n = wordCount();
+    ScratchWords scratch(*this, n + multiplyLowScratchSize(n));
+    multiplyLowWords(scratch.data(), storage, rhs.storage, n,
+      scratch.data() + n);
+    memcpy(storage, scratch.data(), WORDS_TO_BYTES(n));
+    return *this;
+  }
+  
+  /**
+   * \brief Multiplies by a single word modulo 2^width()
+   */
+  BitVector &operator*=(word_t rhs)
+  {
+    mulWord(storage, storage, wordCount(), rhs);
+    return *this;
+  }
+  
+  BitVector operator*(const BitVector &rhs) const &
+  {
+    BitVector result(*this);
+    result.operator*=(rhs);
+    return result;
+  }
+  
+  BitVector operator*(const BitVector &rhs) &&
+  {
+    this->operator*=(rhs);
+    return std::move(*this);
+  }
+  
+  BitVector operator*(word_t rhs) const &
+  {
+    BitVector result(*this);
+    result.operator*=(rhs);
+    return result;
+  }
+  
+  BitVector operator*(word_t rhs) &&
+  {
+    this->operator*=(rhs);
+    return std::move(*this);
+  }
+  
+  /**
+   * \brief Computes the full product without discarding the high half
+   *
+   * \returns a BitVector of width 2 * width()
+   */
+  BitVector mulFull(const BitVector &rhs) const
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    size_t n = wordCount();
+    BitVector result(2 * length, false, resultAllocator());
+    if (n == 0)
+      return result;
+    
+    // The scratch space holds the masked operands, the product and the
+    // space multiplyWords() needs, in that order
+    ScratchWords scratch(*this, 4 * n + multiplyScratchSize(n));
+    word_t *masked = scratch.data();
+    word_t *product = masked + 2 * n;
+    
+    // The unused bits of the most significant words must not contribute to
+    // the product. Squaring is detected by the NTT, so keep a == b then.
+    const word_t *a = storage;
+    const word_t *b = rhs.storage;
+    if (BIT_POSITION_FOR_BIT_IN_WORD(length) != 0)
+    {
+      memcpy(masked, storage, WORDS_TO_BYTES(n));
+      memcpy(masked + n, rhs.storage, WORDS_TO_BYTES(n));
+      masked[n - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(length);
+      masked[2 * n - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(length);
+      a = masked;
+      b = (this == &rhs ? a : a + n);
     }
     
+    // The product may need one word less than 2n words
+    if (result.wordCount() == 2 * n)
+      product = result.storage;
+    multiplyWords(product, a, b, n, masked + 4 * n);
+    if (product != result.storage)
+      memcpy(result.storage, product, WORDS_TO_BYTES(result.wordCount()));
+    return result;
+  }
+  
+  /**
+   * \brief Divides, rounding toward zero
+   *
+   * Both operands are unsigned and may have different widths. Pass a
+   * BarrettReducer to divide by the same number repeatedly.
+   */
+  BitVector &operator/=(const BarrettReducer &divisor)
+  {
+    clearUnusedBits();
+    divisor.divide(storage, NULL, storage, wordCount());
+    return *this;
+  }
+  
+  /**
+   * \brief Divides by a single word, rounding toward zero
+   */
+  BitVector &operator/=(word_t divisor)
+  {
+    clearUnusedBits();
+    WordDivisor(divisor).divide(storage, storage, wordCount());
+    return *this;
+  }
+  
+  /**
+   * \brief Replaces the value with the remainder of dividing it
+   *
+   * Both operands are unsigned and may have different widths. Pass a
+   * BarrettReducer to reduce by the same modulus repeatedly.
+   */
+  BitVector &operator%=(const BarrettReducer &divisor)
+  {
+    clearUnusedBits();
+    size_t n = wordCount(), k = divisor.wordCount();
+    
+    // A divisor with more words than this is larger than it
+    if (k > n)
+      return *this;
+    
+    divisor.divide(NULL, storage, storage, n);
+    memset(storage + k, 0, WORDS_TO_BYTES(n - k));
+    return *this;
+  }
+  
+  /**
+   * \brief Replaces the value with the remainder of dividing it by a single
+   * word
+   */
+  BitVector &operator%=(word_t divisor)
+  {
+    clearUnusedBits();
+    size_t n = wordCount();
+    if (n == 0)
+      return *this;
+    
+    word_t r = WordDivisor(divisor).remainder(storage, n);
+    memset(storage, 0, WORDS_TO_BYTES(n));
+    storage[0] = r;
+    return *this;
+  }
+  
+  BitVector operator/(const BarrettReducer &divisor) const &
+  {
+    BitVector result(*this);
+    result.operator/=(divisor);
+    return result;
+  }
+  
+  BitVector operator/(const BarrettReducer &divisor) &&
+  {
+    this->operator/=(divisor);
+    return std::move(*this);
+  }
+  
+  BitVector operator/(word_t divisor) const &
+  {
+    BitVector result(*this);
+    result.operator/=(divisor);
+    return result;
+  }
+  
+  BitVector operator/(word_t divisor) &&
+  {
+    this->operator/=(divisor);
+    return std::move(*this);
+  }
+  
+  BitVector operator%(const BarrettReducer &divisor) const &
+  {
+    BitVector result(*this);
+    result.operator%=(divisor);
+    return result;
+  }
+  
+  BitVector operator%(const BarrettReducer &divisor) &&
+  {
+    this->operator%=(divisor);
+    return std::move(*this);
+  }
+  
+  BitVector operator%(word_t divisor) const &
+  {
+    BitVector result(*this);
+    result.operator%=(divisor);
+    return result;
+  }
+  
+  BitVector operator%(word_t divisor) &&
+  {
+    this->operator%=(divisor);
+    return std::move(*this);
+  }
+  
+  /**
+   * \brief Computes the quotient and remainder of one division at once
+   *
+   * Both results have the width of this BitVector. Either may be the same
+   * object as this one.
+   */
+  void divMod(const BarrettReducer &divisor, BitVector &quotient,
+    BitVector &remainder) const
+  {
+    size_t n = wordCount(), k = divisor.wordCount();
+    std::vector<word_t> x(storage, storage + n);
+    if (n > 0)
+      x[n - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(length);
+    
+    std::vector<word_t> r(k > n ? k : n, 0);
+    quotient.resize(length, false);
+    divisor.divide(quotient.storage, r.data(), x.data(), n);
+    
+    remainder.resize(length, false);
+    memcpy(remainder.storage, r.data(), WORDS_TO_BYTES(n));
+  }
+  
+  BitVector operator~() &&
+  {
+    complement();
+    return std::move(*this);
+  }
+  
+  /**
+   * \brief Computes the one's complement in-object
+   * \returns a reference to the same BitVector
+   */
+  BitVector &complement()
+  {
+    wordKernels().notWords(storage, wordCount());
     return *this;
   }
   
-  BitVector operator++(int)
+  BitVector operator-() const &
   {
-    BitVector<N> result(*this);
-    this->operator++();
+    BitVector result(*this);
+    result.negate();
+    return result;
+  }
+  
+  BitVector operator-() &&
+  {
+    negate();
+    return std::move(*this);
+  }
+  
+  BitVector operator+() const
+  {
+    // Not sure why anyone would use this!
+    BitVector result(*this);
     return result;
   }
   
-  BitVector &operator--()
+  /**
+   * \brief Computes the two's complement in-object
+   * \returns a reference to the same BitVector
+   */
+  BitVector &negate()
+  {
+    return this->complement().operator++();
+  }
+  
+  BitVector &operator=(const BitVector &other)
+  {
+    if (this != &other)
+      adoptAllocator(other.allocator(),
+        typename AllocatorTraits::propagate_on_container_copy_assignment());
+    copyFrom(other);
+    return *this;
+  }
+  
+  /**
+   * \brief Takes over the contents of another BitVector, leaving it with a
+   * width of 0
+   *
+   * The heap storage is stolen if the allocators allow it. Otherwise the words
+   * are copied, which may allocate.
+   */
+  BitVector &operator=(BitVector &&other)
+    noexcept(AllocatorTraits::propagate_on_container_move_assignment::value ||
+      std::is_empty<Allocator>::value)
+  {
+    if (this != &other)
+      adoptAllocator(other.allocator(),
+        typename AllocatorTraits::propagate_on_container_move_assignment());
+    moveFrom(other);
+    return *this;
+  }
+  
+  /**
+   * \brief Evaluates a BitExpression into this BitVector
+   *
+   * The expression may refer to this BitVector, since each word of the result
+   * only depends on the same word of the operands.
+   */
+  template<typename E>
+  BitVector &operator=(const BitExpression<E> &expr)
+  {
+    // Resizing could free storage the expression refers to, so evaluate into
+    // a new BitVector instead
+    if (expr.width() != length)
+      return operator=(BitVector(expr));
+    
+    assign(expr.expression());
+    return *this;
+  }
+  
+  bool operator==(const BitVector &rhs) const
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    // Compare all but the most significant word, which may be partial
+    if (length == 0)
+      return true;
+    
+    // We'll mask out the unused portion of the most significant word, which
+    // may be partial
+    const word_t *a = storage;
+    const word_t *b = rhs.storage;
+    size_t lastidx = wordCount() - 1;
+    word_t mask = MASK_FOR_MOST_SIGNIFICANT_WORD(length);
+    if ((a[lastidx] & mask) != (b[lastidx] & mask))
+      return false;
+    
+    // Compare the rest
+    return wordKernels().equalWords(a, b, lastidx);
+  }
+  
+  bool operator!=(const BitVector &rhs) const
+  {
+    return !(this->operator==(rhs));
+  }
+  
+  bool operator<(const BitVector &rhs) const
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    if (length == 0)
+      return false;
+    
+    // Start by comparing the most significant word
+    const word_t *a = storage;
+    const word_t *b = rhs.storage;
+    size_t lastidx = wordCount() - 1;
+    word_t mask = MASK_FOR_MOST_SIGNIFICANT_WORD(length);
+    word_t x = a[lastidx] & mask;
+    word_t y = b[lastidx] & mask;
+    if (x != y)
+      return x < y;
+    
+    // Now the most significant word that differs decides. The index is off by
+    // one intentionally, sorry.
+    size_t i = wordKernels().lastDifference(a, b, lastidx);
+    return i != 0 && a[i - 1] < b[i - 1];
+  }
+  
+  bool operator<=(const BitVector &rhs) const
+  {
+    return !(this->operator>(rhs));
+  }
+  
+  bool operator>(const BitVector &rhs) const
+  {
+    return rhs.operator<(*this);
+  }
+  
+  bool operator>=(const BitVector &rhs) const
+  {
+    return !(this->operator<(rhs));
+  }
+  
+  /**
+   * \returns the number of bits the BitVector can be widened to without
+   *   reallocating: N while the words are in-object, otherwise the size of
+   *   the heap allocation
+   */
+  size_t capacity() const
+  {
+    return isInline() ? N : WORDS_TO_BITS(heapWords);
+  }
+  
+  /**
+   * \brief Makes room for at least bits bits, without changing the width
+   * or contents
+   *
+   * Like std::vector::reserve(), this never shrinks the storage.
+   */
+  void reserve(size_t bits)
+  {
+    if (bits > capacity())
+      reallocate(BITS_TO_WORDS(bits));
+  }
+  
+  /**
+   * \brief Releases unused capacity, moving the words back in-object if the
+   * width is at most N
+   */
+  void shrink_to_fit()
+  {
+    if (isInline())
+      return;
+    if (length <= N)
+    {
+      memcpy(words, storage, WORDS_TO_BYTES(wordCount()));
+      releaseHeap();
+    }
+    else if (heapWords > wordCount())
+      reallocate(wordCount());
+  }
+  
+  /**
+   * \brief Appends a bit above the most significant bit, widening by one
+   *
+   * The capacity grows geometrically, so a sequence of appends takes
+   * amortized constant time per bit.
+   */
+  void pushBack(bool x)
+  {
+    if (length == capacity())
+      reserveForAppend(length + 1);
+    size_t index = length ++;
+    setBit(index, x);
+  }
+  
+  /**
+   * \brief Appends the low count bits of value above the most significant
+   * bit, where count is at most BITS_PER_WORD
+   */
+  void appendBits(word_t value, size_t count)
+  {
+    assert(count <= BITS_PER_WORD && "Cannot append more than a word");
+    if (length + count > capacity())
+      reserveForAppend(length + count);
+    insertBits(storage, length, &value, count);
+    length += count;
+  }
+  
+  /**
+   * \brief Appends a whole word above the most significant bit
+   */
+  void appendWord(word_t value)
+  {
+    appendBits(value, BITS_PER_WORD);
+  }
+
+protected:
+  /**
+   * ScratchWords
+   *
+   * \brief Temporary words for one operation, on the stack when there are at
+   * most BITVECTOR_SCRATCH_WORDS of them and otherwise allocated from the
+   * allocator of the BitVector, and recorded as its storage is
+   */
+  class ScratchWords
+  {
+  public:
+    ScratchWords(const BitVector &owner, size_t count)
+      : allocator(owner.allocator()), count(count), words(local)
+    {
+      if (count > BITVECTOR_SCRATCH_WORDS)
+      {
+        words = AllocatorTraits::allocate(allocator, count);
+        BITVECTOR_RECORD(BITVECTOR_EVENT_ALLOCATE, count);
+      }
+    }
+    
+    ~ScratchWords()
+    {
+      if (words != local)
+      {
+        AllocatorTraits::deallocate(allocator, words, count);
+        BITVECTOR_RECORD(BITVECTOR_EVENT_FREE, count);
+      }
+    }
+    
+    word_t *data() const
+    {
+      return words;
+    }
+    
+  private:
+    ScratchWords(const ScratchWords &);
+    ScratchWords &operator=(const ScratchWords &);
+    
+    Allocator allocator;
+    size_t count;
+    word_t *words;
+    word_t local[BITVECTOR_SCRATCH_WORDS];
+  };
+  
+  /**
+   * \brief Resizes the BitVector to the desired width
+   *
+   * Storage is only reallocated when the width exceeds capacity(), and then
+   * to exactly the width; heap storage is kept when the width shrinks, even
+   * to N bits or fewer, so that later widening or assignment can reuse it.
+   * The appends grow the capacity geometrically instead.
+   *
+   * \param width - the new width
+   * \param clear - if set, zero out any bits added beyond the old width. Pass
+   *   false if the data is going to be overwritten immediately.
+   */
+  void resize(size_t width, bool clear = true)
+  {
+    size_t wordsNeeded = BITS_TO_WORDS(width);
+    size_t wordsCurrent = wordCount();
+    BITVECTOR_RECORD_WIDTH(width);
+    
+    if (width > capacity())
+      reallocate(wordsNeeded);
+    
+    // Zero-extend: clear the unused bits of the old most significant word and
+    // every word after it
+    if (clear && width > length)
+    {
+      if (length % BITS_PER_WORD != 0)
+        storage[wordsCurrent - 1] &=
+          MASK_WITH_LOWER_BITS(length % BITS_PER_WORD);
+      if (wordsNeeded > wordsCurrent)
+        memset(storage + wordsCurrent, 0,
+          WORDS_TO_BYTES(wordsNeeded - wordsCurrent));
+    }
+    
+    length = width;
+  }
+  
+  /**
+   * \brief Copies the width and contents of another BitVector into this one,
+   * overwriting previous contents and allocating memory if necessary
+   *
+   * \param other - the BitVector to copy from
+   */
+  void copyFrom(const BitVector &other)
+  {
+    // Do nothing if this is copying from itself
+    if (this == &other)
+      return;
+    
+    // Resize to the new length, then copy every word in one go
+    resize(other.length, false);
+    memcpy(storage, other.storage, WORDS_TO_BYTES(wordCount()));
+    BITVECTOR_RECORD(BITVECTOR_EVENT_COPY, wordCount());
+  }
+  
+  /**
+   * \brief Overwrites every word with the corresponding word of an expression
+   * of the same width
+   */
+  template<typename E>
+  void assign(const E &expr)
+  {
+    word_t *dst = storage;
+    for (size_t i = 0, n = wordCount(); i < n; i ++)
+      dst[i] = expr.word(i);
+  }
+  
+  /**
+   * \brief Takes over the width and contents of another BitVector, leaving
+   * it with a width of 0
+   *
+   * If the other BitVector keeps its words on the heap and both allocators
+   * are equal, the allocation is stolen outright. Otherwise the words are
+   * copied.
+   *
+   * \param other - the BitVector to move from
+   */
+  void moveFrom(BitVector &other)
+  {
+    // Do nothing if this is moving from itself
+    if (this == &other)
+      return;
+    
+    if (other.isInline() || !(allocator() == other.allocator()))
+    {
+      copyFrom(other);
+    }
+    else
+    {
+      releaseHeap();
+      BITVECTOR_RECORD(BITVECTOR_EVENT_MOVE, other.heapWords);
+      storage = other.storage;
+      heapWords = other.heapWords;
+      other.storage = other.words;
+      other.heapWords = 0;
+      length = other.length;
+    }
+    other.length = 0;
+  }
+  
+  /**
+   * \brief Moves the words to a new heap allocation of count words, keeping
+   * as many of the current words as fit
+   */
+  void reallocate(size_t count)
+  {
+    size_t keep = wordCount() < count ? wordCount() : count;
+    word_t *newwords = AllocatorTraits::allocate(allocator(), count);
+    memcpy(newwords, storage, WORDS_TO_BYTES(keep));
+    
+    BITVECTOR_RECORD(BITVECTOR_EVENT_ALLOCATE, count);
+    BITVECTOR_RECORD(isInline() ? BITVECTOR_EVENT_SPILL
+      : BITVECTOR_EVENT_REALLOCATE, count);
+    releaseHeap();
+    storage = newwords;
+    heapWords = count;
+  }
+  
+  /**
+   * \brief Reserves room for width bits by at least doubling the capacity
+   */
+  void reserveForAppend(size_t width)
+  {
+    size_t doubled = 2 * capacity();
+    reserve(width > doubled ? width : doubled);
+  }
+  
+  /**
+   * \brief Frees the heap storage, if any, and returns to the in-object words
+   *
+   * The contents of the words are lost.
+   */
+  void releaseHeap()
+  {
+    if (!isInline())
+    {
+      AllocatorTraits::deallocate(allocator(), storage, heapWords);
+      BITVECTOR_RECORD(BITVECTOR_EVENT_FREE, heapWords);
+    }
+    storage = words;
+    heapWords = 0;
+  }
+  
+  /**
+   * \brief Switches to the allocator of another BitVector being assigned from,
+   * if the allocator propagates on assignment
+   */
+  void adoptAllocator(const Allocator &other, std::true_type)
+  {
+    releaseHeap();
+    allocator() = other;
+  }
+  
+  void adoptAllocator(const Allocator &, std::false_type)
+  {
+  }
+  
+  /**
+   * \returns the allocator for heap storage
+   */
+  Allocator &allocator()
+  {
+    return *this;
+  }
+  
+  const Allocator &allocator() const
+  {
+    return *this;
+  }
+  
+  /**
+   * \returns the allocator for the result of an operation on this BitVector,
+   *   the same one a copy would use
+   */
+  Allocator resultAllocator() const
+  {
+    return AllocatorTraits::select_on_container_copy_construction(allocator());
+  }
+  
+  /**
+   * \brief Writes stringLength(radix) digits in bases 2, 8 and 16, or the
+   * decimal digits without leading zeros, with no terminator
+   *
+   * \returns the number of digits written, which is 0 for an unsupported
+   *   radix
+   */
+  size_t writeDigits(char *out, int radix) const
   {
-    // If a lower-order word is zero and we decrement causing an underflow, we
-    // need to borrow from the next word.
-    for (size_t i = 0; i < BITS_TO_WORDS(length); i ++)
+    if (!isSupportedRadix(radix))
+      return 0;
+    
+    unsigned bits = bitsPerDigit(radix);
+    if (bits == 0)
+      return writeDecimal(out);
+    
+    size_t digits = CEILDIV(length, bits);
+    char *end = out + digits;
+    switch (radix)
     {
-      if ((WORD(i) --) != 0)
-        return;
+    case 2:
+      // A byte at a time; every byte below the top one is entirely in range
+      for (size_t i = 0; i < digits / 8; i ++)
+      {
+        word_t word = storage[i / BYTES_PER_WORD];
+        writeBinaryByte(end - 8 * (i + 1),
+          (unsigned char)(word >> (BITS_PER_BYTE * (i % BYTES_PER_WORD))));
+      }
+      for (size_t i = digits / 8 * 8; i < digits; i ++)
+        end[-1 - (ptrdiff_t)i] = getBit(i) ? '1' : '0';
+      break;
+      
+    case 16:
+      // A word at a time, then the digits of the partial top word
+      for (size_t i = 0; i < digits / 16; i ++)
+        writeHexWord(end - 16 * (i + 1),
+          extractWord(storage, length, i * BITS_PER_WORD));
+      if (digits % 16)
+      {
+        word_t top = extractWord(storage, length,
+          digits / 16 * BITS_PER_WORD);
+        for (size_t i = digits % 16; i -- > 0; top >>= 4)
+          out[i] = "0123456789abcdef"[top & 15];
+      }
+      break;
+      
+    case 8:
+      for (size_t i = 0; i < digits; i ++)
+      {
+        word_t digit = extractWord(storage, length, 3 * i) & 7;
+        end[-1 - (ptrdiff_t)i] = (char)('0' + digit);
+      }
+      break;
     }
+    return digits;
   }
   
-  BitVector operator--(int)
+  /**
+   * \brief Writes the decimal digits without leading zeros, with no
+   * terminator
+   *
+   * \returns the number of digits written
+   */
+  size_t writeDecimal(char *out) const
   {
-    BitVector<N> result(*this);
-    this->operator--();
-    return result;
-  }
-  
-  BitVector &operator+=(const BitVector &rhs)
-  { 
-    assert(length == rhs.length && "Operands must have equal widths");
-    
-    // Implementation of the full adder algorithm from the Wikipedia article
-    // "Adder (electronics)"
-    word_t carry = 0;
-    for (size_t i = 0; i < BITS_TO_WORDS(length); i ++)
+    // Convert a masked copy, which wordsToDecimal() consumes. Small values
+    // stay on the stack.
+    size_t n = wordCount();
+    word_t local[16];
+    std::vector<word_t> heap;
+    word_t *x = local;
+    if (n > sizeof(local) / sizeof(local[0]))
     {
-      word_t x = WORD(i);
-      word_t y = WORD_FROM(rhs, i);
-      WORD(i) = x + y + carry;
-      
-      word_t highx = EXTRACT_BIT(x, BITS_PER_WORD - 1);
-      word_t highy = EXTRACT_BIT(y, BITS_PER_WORD - 1);
-      carry = (highx & highy) ^ (carry & (highx ^ highy));
+      heap.resize(n);
+      x = heap.data();
+    }
+    if (n > 0)
+    {
+      memcpy(x, storage, WORDS_TO_BYTES(n));
+      x[n - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(length);
     }
     
-    return *this;
+    size_t bound = decimalLength(length);
+    std::vector<DecimalPower> powers;
+    if (n >= BITVECTOR_TO_DECIMAL_THRESHOLD)
+      powers = decimalPowers(bound, true);
+    wordsToDecimal(out, bound, x, n, powers);
+    
+    // Keep at least one digit
+    size_t skip = 0;
+    while (skip + 1 < bound && out[skip] == '0')
+      ++ skip;
+    memmove(out, out + skip, bound - skip);
+    return bound - skip;
   }
   
-  BitVector operator+(const BitVector &rhs) const
+  /**
+   * \returns the word to fill with when shifting right arithmetically: all
+   * ones if the most significant bit is set, otherwise zero
+   */
+  word_t signFill() const
   {
-    BitVector result(*this);
-    result.operator+=(rhs);
-    return result;
+    if (length == 0)
+      return 0;
+    return EXTRACT_BIT(storage[wordCount() - 1],
+      BIT_POSITION_FOR_BIT_IN_WORD(length - 1)) ? ~(word_t)0 : 0;
   }
   
-  BitVector operator~() const
+  /**
+   * \returns a copy widened to width bits, filling the new bits with fill
+   */
+  BitVector extend(size_t width, word_t fill) const
   {
-    BitVector result(*this);
-    result.complement();
+    assert(width >= length && "Extension must not narrow");
+    BitVector result(width, false, resultAllocator());
+    size_t n = wordCount();
+    memcpy(result.storage, storage, WORDS_TO_BYTES(n));
+    if (length % BITS_PER_WORD != 0)
+    {
+      word_t mask = MASK_WITH_LOWER_BITS(length % BITS_PER_WORD);
+      result.storage[n - 1] = (storage[n - 1] & mask) | (fill & ~mask);
+    }
+    for (size_t i = n; i < result.wordCount(); i ++)
+      result.storage[i] = fill;
     return result;
   }
   
   /**
-   * \brief Computes the one's complement in-object
-   * \returns a reference to the same BitVector
+   * \brief Clears the unused bits of the most significant word, which
+   * otherwise hold unspecified values
    */
-  BitVector &complement()
+  void clearUnusedBits()
   {
-    for (size_t i = 0; i < BITS_TO_WORDS(length); i ++)
-      WORD(i) ^= ~(word_t)0;
-    return *this;
+    if (length % BITS_PER_WORD != 0)
+      storage[wordCount() - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(length);
   }
   
-  BitVector operator-() const
+  /**
+   * \brief Finds the lowest bit at or above pos that differs from the bits of
+   * fill
+   *
+   * \param fill - 0 to find a set bit, or all ones to find a clear bit
+   * \returns the index of the bit, or width() if there is none
+   */
+  size_t findNext(size_t pos, word_t fill) const
   {
-    BitVector result(*this);
-    result.negate();
-    return result;
+    return findNextBit(storage, pos, length, fill);
   }
   
-  BitVector operator+() const
+  /**
+   * \brief Finds the highest bit that differs from the bits of fill
+   *
+   * \param fill - 0 to find a set bit, or all ones to find a clear bit
+   * \returns the index of the bit, or width() if there is none
+   */
+  size_t findLast(word_t fill) const
   {
-    // Not sure why anyone would use this!
-    BitVector result(*this);
-    return result;
+    return findLastBit(storage, 0, length, fill);
   }
   
   /**
-   * \brief Computes the two's complement in-object
-   * \returns a reference to the same BitVector
+   * \returns true if the words are stored in-object rather than on the heap
    */
-  BitVector &negate()
+  bool isInline() const
   {
-    return this->complement().operator++();
+    return storage == words;
   }
   
-  BitVector &operator=(const BitVector &other)
-  {
-    copyFrom(other);
-    return *this;
-  }
+  /**
+   * \brief The length of the BitVector in bits
+   */
+  size_t length;
   
-  bool operator==(const BitVector &rhs) const
-  {
-    assert(length == rhs.length && "Operands must have equal widths");
-    
-    // Compare all but the most significant word, which may be partial
-    size_t lastidx = BITS_TO_WORDS(length) - 1;
-    for (size_t i = 0; i < lastidx; ++i)
-    {
-      if (WORD(i) != WORD_FROM(rhs, i))
-        return false;
-    }
-    
-    // We'll mask out the unused portion of the most significant word
-    word_t mask = MASK_WITH_LOWER_BITS(length % BITS_PER_WORD);
-    return (WORD(lastidx) & mask) == (WORD_FROM(rhs, lastidx) & mask);
-  }
+  /**
+   * \brief Pointer to the storage of all words, which is either the in-object
+   * buffer words or a heap allocation of at least wordCount() words
+   */
+  word_t *storage;
   
-  bool operator!=(const BitVector &rhs) const
+  /**
+   * \brief The number of words in the heap allocation, or 0 while the words
+   * are in-object
+   */
+  size_t heapWords;
+  
+  /**
+   * \brief In-object storage of words, used until the width first exceeds N
+   * and again after shrink_to_fit()
+   */
+  word_t words[BITS_TO_WORDS(N)];
+};
+
+
+/**
+ * \brief Lazy bitwise operators over BitVectors and BitExpressions
+ *
+ * These only apply when both operands can be referenced lazily; an expiring
+ * BitVector operand is instead used as the storage for an eager result.
+ */
+template<typename L, typename R>
+typename BitBinaryResult<BitOr, L, R>::type operator|(L &&lhs, R &&rhs)
+{
+  return typename BitBinaryResult<BitOr, L, R>::type(lhs, rhs);
+}
+
+template<typename L, typename R>
+typename BitBinaryResult<BitAnd, L, R>::type operator&(L &&lhs, R &&rhs)
+{
+  return typename BitBinaryResult<BitAnd, L, R>::type(lhs, rhs);
+}
+
+template<typename L, typename R>
+typename BitBinaryResult<BitXor, L, R>::type operator^(L &&lhs, R &&rhs)
+{
+  return typename BitBinaryResult<BitXor, L, R>::type(lhs, rhs);
+}
+
+template<typename E>
+typename std::enable_if<BitExpressionNode<E>::lazy,
+  BitComplementExpression<typename BitExpressionNode<E>::type> >::type
+operator~(E &&operand)
+{
+  return BitComplementExpression<typename BitExpressionNode<E>::type>(operand);
+}
+
+/**
+ * \returns -1, 0 or 1 as the value of lhs is below, equal to or above that of
+ *   rhs, comparing a word of each at a time from the most significant
+ */
+template<typename L, typename R>
+int compareExpressions(const BitExpression<L> &lhs,
+  const BitExpression<R> &rhs)
+{
+  assert(lhs.width() == rhs.width() && "Operands must have equal widths");
+  
+  size_t n = BITS_TO_WORDS(lhs.width());
+  if (n == 0)
+    return 0;
+  
+  word_t mask = MASK_FOR_MOST_SIGNIFICANT_WORD(lhs.width());
+  word_t x = lhs.word(n - 1) & mask;
+  word_t y = rhs.word(n - 1) & mask;
+  for (size_t i = n - 1; x == y && i > 0; i --)
   {
-    return !(this->operator==(rhs));
+    x = lhs.word(i - 1);
+    y = rhs.word(i - 1);
+  }
+  return (x < y) ? -1 : (x > y);
+}
+
+/**
+ * \def DEFINE_EXPRESSION_COMPARISON(op)
+ * \brief Defines a comparison operator between two expressions and between
+ * an expression and a BitVector, in either order, none of which evaluates
+ * the expressions
+ */
+#define DEFINE_EXPRESSION_COMPARISON(op) \
+  \
+  template<typename L, typename R> \
+  bool operator op(const BitExpression<L> &lhs, const BitExpression<R> &rhs) \
+  { \
+    return compareExpressions(lhs, rhs) op 0; \
+  } \
+  \
+  template<typename E, size_t N, typename A> \
+  bool operator op(const BitExpression<E> &lhs, const BitVector<N, A> &rhs) \
+  { \
+    return compareExpressions(lhs, BitVectorOperand<N, A>(rhs)) op 0; \
+  } \
+  \
+  template<size_t N, typename A, typename E> \
+  bool operator op(const BitVector<N, A> &lhs, const BitExpression<E> &rhs) \
+  { \
+    return compareExpressions(BitVectorOperand<N, A>(lhs), rhs) op 0; \
   }
+
+DEFINE_EXPRESSION_COMPARISON(==)
+DEFINE_EXPRESSION_COMPARISON(!=)
+DEFINE_EXPRESSION_COMPARISON(<)
+DEFINE_EXPRESSION_COMPARISON(<=)
+DEFINE_EXPRESSION_COMPARISON(>)
+DEFINE_EXPRESSION_COMPARISON(>=)
+
+/**
+ * \brief Evaluates an expression into the storage of an expiring BitVector
+ */
+template<size_t N, typename A, typename E>
+BitVector<N, A> operator|(BitVector<N, A> &&lhs, const BitExpression<E> &rhs)
+{
+  lhs |= rhs;
+  return std::move(lhs);
+}
+
+template<typename E, size_t N, typename A>
+BitVector<N, A> operator|(const BitExpression<E> &lhs, BitVector<N, A> &&rhs)
+{
+  rhs |= lhs;
+  return std::move(rhs);
+}
+
+template<size_t N, typename A, typename E>
+BitVector<N, A> operator&(BitVector<N, A> &&lhs, const BitExpression<E> &rhs)
+{
+  lhs &= rhs;
+  return std::move(lhs);
+}
+
+template<typename E, size_t N, typename A>
+BitVector<N, A> operator&(const BitExpression<E> &lhs, BitVector<N, A> &&rhs)
+{
+  rhs &= lhs;
+  return std::move(rhs);
+}
+
+template<size_t N, typename A, typename E>
+BitVector<N, A> operator^(BitVector<N, A> &&lhs, const BitExpression<E> &rhs)
+{
+  lhs ^= rhs;
+  return std::move(lhs);
+}
+
+template<typename E, size_t N, typename A>
+BitVector<N, A> operator^(const BitExpression<E> &lhs, BitVector<N, A> &&rhs)
+{
+  rhs ^= lhs;
+  return std::move(rhs);
+}
+
+/**
+ * \brief Addition is a fusion barrier: carries run across words, so the
+ * expression operand is evaluated into the result first
+ */
+template<typename E, size_t N, typename A>
+BitVector<N, A> operator+(const BitExpression<E> &lhs,
+  const BitVector<N, A> &rhs)
+{
+  BitVector<N, A> result(lhs, rhs.get_allocator());
+  result += rhs;
+  return result;
+}
+
+template<size_t N, typename A, typename E>
+BitVector<N, A> operator+(const BitVector<N, A> &lhs,
+  const BitExpression<E> &rhs)
+{
+  BitVector<N, A> result(rhs, lhs.get_allocator());
+  result += lhs;
+  return result;
+}
+
+template<typename L, typename R>
+typename L::value_type operator+(const BitExpression<L> &lhs,
+  const BitExpression<R> &rhs)
+{
+  typename L::value_type result(lhs);
+  result += typename R::value_type(rhs);
+  return result;
+}
+
+/**
+ * \brief Subtraction is a fusion barrier, like addition
+ */
+template<typename E, size_t N, typename A>
+BitVector<N, A> operator-(const BitExpression<E> &lhs,
+  const BitVector<N, A> &rhs)
+{
+  BitVector<N, A> result(lhs, rhs.get_allocator());
+  result -= rhs;
+  return result;
+}
+
+template<size_t N, typename A, typename E>
+BitVector<N, A> operator-(const BitVector<N, A> &lhs,
+  const BitExpression<E> &rhs)
+{
+  assert(lhs.width() == rhs.width() && "Operands must have equal widths");
   
-  bool operator<(const BitVector &rhs) const
+  BitVector<N, A> result(rhs, lhs.get_allocator());
+  subtractWords(result.data(), lhs.data(), result.data(), result.wordCount());
+  return result;
+}
+
+template<typename L, typename R>
+typename L::value_type operator-(const BitExpression<L> &lhs,
+  const BitExpression<R> &rhs)
+{
+  typename L::value_type result(lhs);
+  result -= typename R::value_type(rhs);
+  return result;
+}
+
+/**
+ * \returns the bits of high followed by the bits of low, in a BitVector of
+ *   their combined width with low in the least significant bits
+ */
+template<size_t N, typename A>
+BitVector<N, A> concat(const BitVector<N, A> &high, const BitVector<N, A> &low)
+{
+  BitVector<N, A> result(high.width() + low.width(), false,
+    high.get_allocator());
+  word_t *dst = result.data();
+  size_t n = low.wordCount();
+  memcpy(dst, low.data(), WORDS_TO_BYTES(n));
+  memset(dst + n, 0, WORDS_TO_BYTES(result.wordCount() - n));
+  insertBits(dst, low.width(), high.data(), high.width());
+  return result;
+}
+
+/**
+ * \brief Multiplication is a fusion barrier, like addition
+ */
+template<typename E, size_t N, typename A>
+BitVector<N, A> operator*(const BitExpression<E> &lhs,
+  const BitVector<N, A> &rhs)
+{
+  BitVector<N, A> result(lhs, rhs.get_allocator());
+  result *= rhs;
+  return result;
+}
+
+template<size_t N, typename A, typename E>
+BitVector<N, A> operator*(const BitVector<N, A> &lhs,
+  const BitExpression<E> &rhs)
+{
+  BitVector<N, A> result(rhs, lhs.get_allocator());
+  result *= lhs;
+  return result;
+}
+
+template<typename L, typename R>
+typename L::value_type operator*(const BitExpression<L> &lhs,
+  const BitExpression<R> &rhs)
+{
+  typename L::value_type result(lhs);
+  result *= typename R::value_type(rhs);
+  return result;
+}
+
+/**
+ * \brief Division is a fusion barrier, like multiplication
+ */
+template<typename E>
+typename E::value_type operator/(const BitExpression<E> &lhs,
+  const BarrettReducer &rhs)
+{
+  typename E::value_type result(lhs);
+  result /= rhs;
+  return result;
+}
+
+template<typename E>
+typename E::value_type operator%(const BitExpression<E> &lhs,
+  const BarrettReducer &rhs)
+{
+  typename E::value_type result(lhs);
+  result %= rhs;
+  return result;
+}
+
+template<typename E>
+typename E::value_type operator-(const BitExpression<E> &operand)
+{
+  typename E::value_type result(operand);
+  result.negate();
+  return result;
+}
+
+
+/**
+ * \brief Hashes BitVectors with BitVector::hash(), so that they can be the
+ * keys of unordered containers
+ */
+namespace std
+{
+  template<size_t N, typename A>
+  struct hash<BitVector<N, A> >
   {
-    assert(length == rhs.length && "Operands must have equal widths");
-    
-    // Start by comparing the most significant word
-    size_t lastidx = BITS_TO_WORDS(length) - 1;
-    word_t mask = MASK_WITH_LOWER_BITS(length % BITS_PER_WORD);
-    if ((WORD(lastidx) & mask) < (WORD_FROM(rhs, lastidx) & mask))
-      return true;
-    
-    // Now compare the rest, in reverse order. The indices are off by one
-    // intentionally, sorry.
-    for (size_t i = lastidx; i >= 1; --i)
+    size_t operator()(const BitVector<N, A> &v) const
     {
-      if (WORD(i - 1) < WORD_FROM(rhs, i - 1))
-        return true;
+      return (size_t)v.hash();
     }
-    
-    return false;
-  }
-  
-  bool operator<=(const BitVector &rhs) const
+  };
+}
+
+
+/**
+ * IncrementalHash
+ *
+ * \brief A hash of the set bits of a BitVector that is updated in constant
+ * time when a bit changes
+ *
+ * The hash is the XOR of bitHash(i) over the set bits i, so changing bit i
+ * changes the hash by bitHash(i) whatever the other bits are. Computing it
+ * from scratch visits every set bit, which is slower than BitVector::hash(),
+ * and the two give different values; use it for vectors that change a few
+ * bits at a time between lookups. The width is not part of the hash.
+ */
+class IncrementalHash
+{
+public:
+  /**
+   * \brief Starts from the hash of a vector with no set bits
+   */
+  explicit IncrementalHash(word_t seed = 0)
+    : seed(seed), hash(0)
   {
-    return !(this->operator>(rhs));
   }
   
-  bool operator>(const BitVector &rhs) const
+  /**
+   * \brief Computes the hash of the set bits of v
+   */
+  template<size_t N, typename A>
+  explicit IncrementalHash(const BitVector<N, A> &v, word_t seed = 0)
+    : seed(seed), hash(0)
   {
-    return rhs.operator<(*this);
+    for (size_t i : v.setBitIndices())
+      hash ^= bitHash(i);
   }
   
-  bool operator>=(const BitVector &rhs) const
+  /**
+   * \returns the hash
+   */
+  word_t value() const
   {
-    return !(this->operator<(rhs));
+    return hash;
   }
   
-protected:
   /**
-   * \brief Resizes the BitVector to the desired width
-   *
-   * This isn't recommended for performance reasons.
-   * 
-   * This doesn't try to manage heap storage very carefully; you may end up
-   * with some redundant allocation and copying if you resize a BitVector often.
-   * The class was not designed with this in mind, so it is not recommended.
-   * 
-   * \param width - the new width
-   * \param clear - if set, zero out heap storage. Pass false
-   *   if the data on the heap is going to be overwritten immediately.
+   * \returns the pseudo-random word that bit index contributes when set
    */
-  void resize(size_t width, bool clear = true)
+  word_t bitHash(size_t index) const
   {
-    // The number of words on the heap needed to represent BitVectors of this
-    // size
-    size_t heapWordsNeeded = (width > N ? HEAP_SIZE_IN_WORDS(width) : 0);
-    
-    // The number of words that are currently on the heap
-    size_t heapWordsCurrent =
-      (morewords == nullptr ? 0 : HEAP_SIZE_IN_WORDS(length));
-    
-    // If the new width can fit entirely in-object, we can free the heap storage
-    if (width <= N)
-    {
-      delete [] morewords;
-      morewords = nullptr;
-    }
-    
-    // Otherwise, we may need to expand the heap storage, which is expensive
-    else if (width > N && heapWordsNeeded > heapWordsCurrent)
-    {
-      word_t *newwords = new word_t[heapWordsNeeded];
-      memcpy(newwords, morewords, WORDS_TO_BYTES(heapWordsCurrent));
-      
-      if (clear)
-      {
-        size_t remaining = WORDS_TO_BYTES(heapWordsNeeded) - \
-          WORDS_TO_BYTES(heapWordsCurrent);
-        memset(newwords + WORDS_TO_BYTES(heapWordsCurrent), 0, remaining);
-      }
-      
-      delete [] morewords;
-      morewords = newwords;
-    }
-    
-    // The case (width > N && needed == current) is ignored because no change to
-    // the heap is needed.
-    
-    // The case (width > N && needed < current) is ignored because while there
-    // is now unused storage on the heap, releasing it would require copying.
-    
-    length = width;
+    // The splitmix64 finalizer
+    word_t z = seed + ((word_t)index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
   }
   
   /**
-   * \brief Copies the width and contents of another BitVector into this one,
-   * overwriting previous contents and allocating memory if necessary
-   *
-   * \param other - the BitVector to copy from
+   * \brief Updates the hash for a flip of bit index, which the caller has
+   * made or will make to the vector
    */
-  void copyFrom(const BitVector &other)
+  void flipBit(size_t index)
   {
-    // Do nothing if this is copying from itself
-    if (this == &other)
-      return;
-    
-    // Resize to the new length
-    resize(other.length, false);
-    
-    // Copy the in-object words
-    memcpy(words, other.words, sizeof(words));
-    
-    // Allocate any additional storage needed on the heap, and copy to it
-    size_t heapWordsNeeded = HEAP_SIZE_IN_WORDS(length);
-    if (heapWordsNeeded > 0)
-    {
-      morewords = new word_t[heapWordsNeeded];
-      memcpy(morewords, other.morewords, WORDS_TO_BYTES(heapWordsNeeded));
-    }
+    hash ^= bitHash(index);
   }
   
   /**
-   * \brief Slides stored bytes to to the right (toward MSB)
-   *
-   * \param slide - the number of bytes to slide by
-   * \param fill - the byte to fill in with on the left
+   * \brief Updates the hash for a word of the vector being XORed with changed,
+   * for changes made directly to the words
    */
-  void slideBytesRight(size_t slide, unsigned char fill = 0)
+  void xorWord(size_t wordIndex, word_t changed)
   {
-    // Slide bytes on the heap first, filling in on the left from in-object
-    // storage
-    if (morewords)
-    {
-      memmove(morewords + slide, morewords, HEAP_SIZE_IN_WORDS(length) - slide);
-      memcpy(morewords, words + BITS_TO_WORDS(N) - slide, slide);
-    }
-    
-    // Slide bytes in in-object storage, filling in on the left
-    memmove(words + slide, words, BITS_TO_WORDS(N) - slide);
-    memset(words, fill, slide);
+    for (; changed != 0; changed &= changed - 1)
+      flipBit(WORDS_TO_BITS(wordIndex) + countTrailingZeros(changed));
   }
   
   /**
-   * \brief Slides stored bytes to to the left (toward LSB)
-   *
-   * \param slide - the number of bytes to slide by
-   * \param fill - the byte to fill in with on the right
+   * \brief Sets bit index of v to x, updating the hash if the bit changes
    */
-  void slideBytesLeft(size_t slide, unsigned char fill = 0)
+  template<size_t N, typename A>
+  void setBit(BitVector<N, A> &v, size_t index, bool x)
   {
-    // Slide in-object bytes first
-    memmove(words, words + slide, HEAP_SIZE_IN_WORDS(length) - slide);
-    
-    // Fill on the right or copy bytes from the heap
-    if (!morewords)
-    {
-      memset(words + slide, fill, slide);
-    }
-    else
+    if (v.getBit(index) != x)
     {
-      memcpy(words + slide, morewords, slide);
-      
-      // Now slide words on the heap and fill
-      memmove(morewords, morewords + slide, HEAP_SIZE_IN_WORDS(length) - slide);
-      memset(morewords + slide, fill, slide);
+      v.flipBit(index);
+      flipBit(index);
     }
   }
   
   /**
-   * \brief The length of the BitVector in bits
+   * \brief Flips bit index of v and updates the hash
    */
-  size_t length;
-  
+  template<size_t N, typename A>
+  void flipBit(BitVector<N, A> &v, size_t index)
+  {
+    v.flipBit(index);
+    flipBit(index);
+  }
+
+protected:
   /**
-   * \brief In-object storage of words
+   * \brief Seed mixed into every bitHash()
    */
-  word_t words[BITS_TO_WORDS(N)];
+  word_t seed;
   
   /**
-   * \brief Additional heap storage if the length exceeds N words
+   * \brief XOR of bitHash(i) over the set bits i
    */
-  word_t *morewords;
+  word_t hash;
 };
+
+#endif // BITVECTOR_HPP
@@ -0,0 +1,718 @@
+/**
+ * \file
+ * \brief Implements BitVectorBatch, a container of many values of the same
+ * width stored as a structure of arrays, for running one operation on all of
+ * them with every SIMD lane busy.
+ *
+ * Word k of every value is stored contiguously, so the k-th words of
+ * consecutive values fill the lanes of a vector register. Carries and
+ * comparisons then move from one row of words to the next instead of along a
+ * single value, and the bitwise operations run over the whole storage with
+ * the WordKernels.
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef BITVECTORBATCH_HPP
+#define BITVECTORBATCH_HPP
+
+#include "BitVector.hpp"
+
+
+/**
+ * \def BITVECTOR_BATCH_BLOCK
+ * \brief Number of values whose carries or comparison results are tracked at
+ * once while walking the rows of a batch
+ */
+#ifndef BITVECTOR_BATCH_BLOCK
+#define BITVECTOR_BATCH_BLOCK 256
+#endif
+
+
+/**
+ * BatchKernels
+ *
+ * \brief A table of functions implementing the operations on one row of a
+ * BitVectorBatch, all written for one instruction set
+ *
+ * Carries, borrows and comparison results are kept as one mask word per
+ * value, either 0 or all ones, so that they can be combined with the words
+ * lane by lane.
+ *
+ * Use batchKernels() to get the table best suited to the running CPU.
+ */
+struct BatchKernels
+{
+  /**
+   * \brief The name of the instruction set, for diagnostics and benchmarks
+   */
+  const char *name;
+  
+  /**
+   * \brief Computes d[i] = a[i] + b[i] + carry[i] for i < n and replaces
+   * carry[i] with the outgoing carry
+   */
+  void (*addLanes)(word_t *d, const word_t *a, const word_t *b, word_t *carry,
+    size_t n);
+  
+  /**
+   * \brief Computes d[i] = a[i] - b[i] - borrow[i] for i < n and replaces
+   * borrow[i] with the outgoing borrow
+   */
+  void (*subtractLanes)(word_t *d, const word_t *a, const word_t *b,
+    word_t *borrow, size_t n);
+  
+  /**
+   * \brief Folds one row into a comparison running from the most significant
+   * row down: less[i] |= equal[i] & (a[i] < b[i]) and
+   * equal[i] &= (a[i] == b[i]), with both words masked by mask first
+   */
+  void (*lessLanes)(word_t *less, word_t *equal, const word_t *a,
+    const word_t *b, size_t n, word_t mask);
+  
+  /**
+   * \brief Like lessLanes, comparing every a[i] against the same word b
+   */
+  void (*lessScalarLanes)(word_t *less, word_t *equal, const word_t *a,
+    word_t b, size_t n, word_t mask);
+  
+  /**
+   * \brief Adds the number of set bits of a[i] & mask to counts[i] for i < n
+   */
+  void (*popcountLanes)(unsigned *counts, const word_t *a, size_t n,
+    word_t mask);
+};
+
+inline void addLanesScalar(word_t *d, const word_t *a, const word_t *b,
+  word_t *carry, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t x = a[i];
+    word_t s = x + b[i];
+    word_t t = s - carry[i];
+    carry[i] = (word_t)0 - (word_t)((s < x) | (t < s));
+    d[i] = t;
+  }
+}
+
+inline void subtractLanesScalar(word_t *d, const word_t *a, const word_t *b,
+  word_t *borrow, size_t n)
+{
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t x = a[i];
+    word_t y = b[i];
+    word_t s = x - y;
+    word_t t = s + borrow[i];
+    borrow[i] = (word_t)0 - (word_t)((x < y) | (s < t));
+    d[i] = t;
+  }
+}
+
+inline void lessLanesScalar(word_t *less, word_t *equal, const word_t *a,
+  const word_t *b, size_t n, word_t mask)
+{
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t x = a[i] & mask;
+    word_t y = b[i] & mask;
+    less[i] |= equal[i] & ((word_t)0 - (word_t)(x < y));
+    equal[i] &= (word_t)0 - (word_t)(x == y);
+  }
+}
+
+inline void lessScalarLanesScalar(word_t *less, word_t *equal,
+  const word_t *a, word_t b, size_t n, word_t mask)
+{
+  word_t y = b & mask;
+  for (size_t i = 0; i < n; i ++)
+  {
+    word_t x = a[i] & mask;
+    less[i] |= equal[i] & ((word_t)0 - (word_t)(x < y));
+    equal[i] &= (word_t)0 - (word_t)(x == y);
+  }
+}
+
+inline void popcountLanesScalar(unsigned *counts, const word_t *a, size_t n,
+  word_t mask)
+{
+  for (size_t i = 0; i < n; i ++)
+    counts[i] += countOnes(a[i] & mask);
+}
+
+#ifdef BITVECTOR_X86_KERNELS
+
+/**
+ * \brief Flips the sign bits of four words, so that signed comparisons of
+ * the results order the words as unsigned
+ */
+#define BATCH_AVX2_UNSIGNED(x) \
+  _mm256_xor_si256((x), _mm256_set1_epi64x((long long)MASK_WITH_BIT(63)))
+
+/**
+ * \brief Compares four pairs of words as unsigned, giving all ones where
+ * x < y
+ */
+#define BATCH_AVX2_LESS(x, y) \
+  _mm256_cmpgt_epi64(BATCH_AVX2_UNSIGNED(y), BATCH_AVX2_UNSIGNED(x))
+
+__attribute__((target("avx2")))
+inline void addLanesAVX2(word_t *d, const word_t *a, const word_t *b,
+  word_t *carry, size_t n)
+{
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+    __m256i c = _mm256_loadu_si256((const __m256i *)(carry + i));
+    __m256i s = _mm256_add_epi64(x, y);
+    __m256i t = _mm256_sub_epi64(s, c);
+    c = _mm256_or_si256(BATCH_AVX2_LESS(s, x), BATCH_AVX2_LESS(t, s));
+    _mm256_storeu_si256((__m256i *)(d + i), t);
+    _mm256_storeu_si256((__m256i *)(carry + i), c);
+  }
+  addLanesScalar(d + i, a + i, b + i, carry + i, n - i);
+}
+
+__attribute__((target("avx2")))
+inline void subtractLanesAVX2(word_t *d, const word_t *a, const word_t *b,
+  word_t *borrow, size_t n)
+{
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+    __m256i c = _mm256_loadu_si256((const __m256i *)(borrow + i));
+    __m256i s = _mm256_sub_epi64(x, y);
+    __m256i t = _mm256_add_epi64(s, c);
+    c = _mm256_or_si256(BATCH_AVX2_LESS(x, y), BATCH_AVX2_LESS(s, t));
+    _mm256_storeu_si256((__m256i *)(d + i), t);
+    _mm256_storeu_si256((__m256i *)(borrow + i), c);
+  }
+  subtractLanesScalar(d + i, a + i, b + i, borrow + i, n - i);
+}
+
+__attribute__((target("avx2")))
+inline void lessLanesAVX2(word_t *less, word_t *equal, const word_t *a,
+  const word_t *b, size_t n, word_t mask)
+{
+  __m256i m = _mm256_set1_epi64x((long long)mask);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256i x = _mm256_and_si256(m,
+      _mm256_loadu_si256((const __m256i *)(a + i)));
+    __m256i y = _mm256_and_si256(m,
+      _mm256_loadu_si256((const __m256i *)(b + i)));
+    __m256i lt = _mm256_loadu_si256((const __m256i *)(less + i));
+    __m256i eq = _mm256_loadu_si256((const __m256i *)(equal + i));
+    lt = _mm256_or_si256(lt, _mm256_and_si256(eq, BATCH_AVX2_LESS(x, y)));
+    eq = _mm256_and_si256(eq, _mm256_cmpeq_epi64(x, y));
+    _mm256_storeu_si256((__m256i *)(less + i), lt);
+    _mm256_storeu_si256((__m256i *)(equal + i), eq);
+  }
+  lessLanesScalar(less + i, equal + i, a + i, b + i, n - i, mask);
+}
+
+__attribute__((target("avx2")))
+inline void lessScalarLanesAVX2(word_t *less, word_t *equal,
+  const word_t *a, word_t b, size_t n, word_t mask)
+{
+  __m256i m = _mm256_set1_epi64x((long long)mask);
+  __m256i y = _mm256_set1_epi64x((long long)(b & mask));
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256i x = _mm256_and_si256(m,
+      _mm256_loadu_si256((const __m256i *)(a + i)));
+    __m256i lt = _mm256_loadu_si256((const __m256i *)(less + i));
+    __m256i eq = _mm256_loadu_si256((const __m256i *)(equal + i));
+    lt = _mm256_or_si256(lt, _mm256_and_si256(eq, BATCH_AVX2_LESS(x, y)));
+    eq = _mm256_and_si256(eq, _mm256_cmpeq_epi64(x, y));
+    _mm256_storeu_si256((__m256i *)(less + i), lt);
+    _mm256_storeu_si256((__m256i *)(equal + i), eq);
+  }
+  lessScalarLanesScalar(less + i, equal + i, a + i, b, n - i, mask);
+}
+
+/**
+ * \brief Counts with the popcnt instruction, which beats a vectorized count
+ * at one word per lane
+ */
+__attribute__((target("popcnt")))
+inline void popcountLanesPOPCNT(unsigned *counts, const word_t *a, size_t n,
+  word_t mask)
+{
+  for (size_t i = 0; i < n; i ++)
+    counts[i] += (unsigned)__builtin_popcountll(a[i] & mask);
+}
+
+#endif // BITVECTOR_X86_KERNELS
+
+/**
+ * \returns the BatchKernels for the best instruction set supported by the
+ * running CPU
+ */
+inline const BatchKernels &batchKernels()
+{
+  static const BatchKernels scalar = {
+    "scalar", addLanesScalar, subtractLanesScalar, lessLanesScalar,
+    lessScalarLanesScalar, popcountLanesScalar
+  };
+
+#ifdef BITVECTOR_X86_KERNELS
+  static const BatchKernels avx2 = {
+    "avx2", addLanesAVX2, subtractLanesAVX2, lessLanesAVX2,
+    lessScalarLanesAVX2, popcountLanesPOPCNT
+  };
+  static const BatchKernels &best = []() -> const BatchKernels &
+  {
+    __builtin_cpu_init();
+    return (__builtin_cpu_supports("avx2") &&
+      __builtin_cpu_supports("popcnt")) ? avx2 : scalar;
+  }();
+  return best;
+#else
+  return scalar;
+#endif
+}
+
+
+/**
+ * BitVectorBatch
+ *
+ * \brief A fixed number of values of Width bits each, stored row by row
+ *
+ * Row k holds word k of every value, padded to a whole number of cache
+ * lines. The operations apply element by element to batches of the same
+ * size; like BitVector, the unused bits of the most significant row are
+ * ignored where they would matter.
+ *
+ * The allocator stays with the batch: assignment copies the values into the
+ * existing storage, or storage from the same allocator.
+ */
+template<size_t Width, typename Allocator = CacheAlignedAllocator<word_t> >
+class BitVectorBatch : private Allocator
+{
+  typedef std::allocator_traits<Allocator> AllocatorTraits;
+  
+  static_assert(BITVECTOR_BATCH_BLOCK % BITS_PER_WORD == 0,
+    "BITVECTOR_BATCH_BLOCK must be a multiple of the word size");
+
+public:
+  typedef Allocator allocator_type;
+  
+  /**
+   * \brief The number of words in each value, and of rows in the batch
+   */
+  static const size_t ROWS = BITS_TO_WORDS(Width);
+  
+  /**
+   * \brief Creates a batch of count values, all zero
+   */
+  explicit BitVectorBatch(size_t count,
+    const Allocator &allocator = Allocator())
+    : Allocator(allocator), count(count), stride(strideFor(count)),
+      storage(NULL)
+  {
+    allocate();
+    memset(storage, 0, WORDS_TO_BYTES(ROWS * stride));
+  }
+  
+  BitVectorBatch(const BitVectorBatch &other)
+    : Allocator(AllocatorTraits::select_on_container_copy_construction(
+        other.get_allocator())),
+      count(other.count), stride(other.stride), storage(NULL)
+  {
+    allocate();
+    memcpy(storage, other.storage, WORDS_TO_BYTES(ROWS * stride));
+  }
+  
+  BitVectorBatch(BitVectorBatch &&other) noexcept
+    : Allocator(std::move(other.allocator())), count(other.count),
+      stride(other.stride), storage(other.storage)
+  {
+    other.count = 0;
+    other.stride = 0;
+    other.storage = NULL;
+  }
+  
+  ~BitVectorBatch()
+  {
+    release();
+  }
+  
+  BitVectorBatch &operator=(const BitVectorBatch &other)
+  {
+    if (this == &other)
+      return *this;
+    
+    if (stride != other.stride)
+    {
+      release();
+      stride = other.stride;
+      allocate();
+    }
+    count = other.count;
+    memcpy(storage, other.storage, WORDS_TO_BYTES(ROWS * stride));
+    return *this;
+  }
+  
+  BitVectorBatch &operator=(BitVectorBatch &&other)
+  {
+    if (this == &other)
+      return *this;
+    
+    if (allocator() != other.allocator())
+      return operator=((const BitVectorBatch &)other);
+    
+    release();
+    count = other.count;
+    stride = other.stride;
+    storage = other.storage;
+    other.count = 0;
+    other.stride = 0;
+    other.storage = NULL;
+    return *this;
+  }
+  
+  allocator_type get_allocator() const
+  {
+    return allocator();
+  }
+  
+  /**
+   * \returns the number of values
+   */
+  size_t size() const
+  {
+    return count;
+  }
+  
+  /**
+   * \returns the number of bits in each value
+   */
+  static size_t width()
+  {
+    return Width;
+  }
+  
+  /**
+   * \returns the words of row k, one per value, at least size() of them
+   */
+  word_t *row(size_t k)
+  {
+    return storage + k * stride;
+  }
+  
+  const word_t *row(size_t k) const
+  {
+    return storage + k * stride;
+  }
+  
+  /**
+   * \brief Replaces value i with the bits of a BitVector of width Width
+   */
+  template<size_t N, typename A>
+  void set(size_t i, const BitVector<N, A> &v)
+  {
+    assert(v.width() == Width && "Operands must have equal widths");
+    
+    set(i, v.data());
+  }
+  
+  /**
+   * \brief Replaces value i with ROWS words
+   */
+  void set(size_t i, const word_t *words)
+  {
+    assert(i < count);
+    
+    for (size_t k = 0; k < ROWS; k ++)
+      storage[k * stride + i] = words[k];
+  }
+  
+  /**
+   * \brief Copies value i into a BitVector of width Width
+   */
+  template<size_t N, typename A>
+  void get(size_t i, BitVector<N, A> &v) const
+  {
+    assert(v.width() == Width && "Operands must have equal widths");
+    
+    get(i, v.data());
+  }
+  
+  /**
+   * \brief Copies value i into ROWS words
+   */
+  void get(size_t i, word_t *words) const
+  {
+    assert(i < count);
+    
+    for (size_t k = 0; k < ROWS; k ++)
+      words[k] = storage[k * stride + i];
+  }
+  
+  /**
+   * \returns a copy of value i
+   */
+  BitVector<Width> get(size_t i) const
+  {
+    BitVector<Width> v(Width, false);
+    get(i, v.data());
+    return v;
+  }
+  
+  BitVectorBatch &operator|=(const BitVectorBatch &rhs)
+  {
+    assert(count == rhs.count && "Batches must have equal sizes");
+    
+    wordKernels().orWords(storage, rhs.storage, ROWS * stride);
+    return *this;
+  }
+  
+  BitVectorBatch &operator&=(const BitVectorBatch &rhs)
+  {
+    assert(count == rhs.count && "Batches must have equal sizes");
+    
+    wordKernels().andWords(storage, rhs.storage, ROWS * stride);
+    return *this;
+  }
+  
+  BitVectorBatch &operator^=(const BitVectorBatch &rhs)
+  {
+    assert(count == rhs.count && "Batches must have equal sizes");
+    
+    wordKernels().xorWords(storage, rhs.storage, ROWS * stride);
+    return *this;
+  }
+  
+  /**
+   * \brief Computes the one's complement of every value in-object
+   */
+  BitVectorBatch &complement()
+  {
+    wordKernels().notWords(storage, ROWS * stride);
+    return *this;
+  }
+  
+  /**
+   * \brief Adds element by element modulo 2^Width
+   */
+  BitVectorBatch &operator+=(const BitVectorBatch &rhs)
+  {
+    assert(count == rhs.count && "Batches must have equal sizes");
+    
+    carryThroughRows(rhs, batchKernels().addLanes);
+    return *this;
+  }
+  
+  /**
+   * \brief Subtracts element by element modulo 2^Width
+   */
+  BitVectorBatch &operator-=(const BitVectorBatch &rhs)
+  {
+    assert(count == rhs.count && "Batches must have equal sizes");
+    
+    carryThroughRows(rhs, batchKernels().subtractLanes);
+    return *this;
+  }
+  
+  /**
+   * \brief Counts the set bits of every value
+   *
+   * \param counts - receives size() counts
+   */
+  void popcount(unsigned *counts) const
+  {
+    memset(counts, 0, count * sizeof(unsigned));
+    for (size_t k = 0; k < ROWS; k ++)
+      batchKernels().popcountLanes(counts, row(k), count, rowMask(k));
+  }
+  
+  /**
+   * \brief Compares element by element as unsigned integers
+   *
+   * \param less - receives bit i set if value i is less than value i of rhs;
+   *   must have size() bits
+   * \param equal - if not NULL, receives bit i set if they are equal
+   */
+  template<size_t N, typename A>
+  void compare(const BitVectorBatch &rhs, BitVector<N, A> &less,
+    BitVector<N, A> *equal = NULL) const
+  {
+    assert(count == rhs.count && "Batches must have equal sizes");
+    
+    compareRows(less, equal,
+      [&](word_t *lt, word_t *eq, size_t k, size_t begin, size_t n)
+      {
+        batchKernels().lessLanes(lt, eq, row(k) + begin,
+          rhs.row(k) + begin, n, rowMask(k));
+      });
+  }
+  
+  /**
+   * \brief Compares every value against the same threshold as unsigned
+   * integers
+   *
+   * \param threshold - a BitVector of width Width
+   * \param less - receives bit i set if value i is less than threshold; must
+   *   have size() bits
+   * \param equal - if not NULL, receives bit i set if they are equal
+   */
+  template<size_t M, typename B, size_t N, typename A>
+  void compare(const BitVector<M, B> &threshold, BitVector<N, A> &less,
+    BitVector<N, A> *equal = NULL) const
+  {
+    assert(threshold.width() == Width && "Operands must have equal widths");
+    
+    const word_t *t = threshold.data();
+    compareRows(less, equal,
+      [&](word_t *lt, word_t *eq, size_t k, size_t begin, size_t n)
+      {
+        batchKernels().lessScalarLanes(lt, eq, row(k) + begin, t[k], n,
+          rowMask(k));
+      });
+  }
+
+protected:
+  /**
+   * \returns the number of words in a row for count values, a whole number
+   *   of cache lines
+   */
+  static size_t strideFor(size_t count)
+  {
+    const size_t lineWords = BYTES_TO_WORDS(BITVECTOR_CACHE_LINE);
+    return CEILDIV(count, lineWords) * lineWords;
+  }
+  
+  /**
+   * \returns the mask of the used bits of the words in row k
+   */
+  static word_t rowMask(size_t k)
+  {
+    return (k + 1 == ROWS) ? MASK_FOR_MOST_SIGNIFICANT_WORD(Width)
+      : ~(word_t)0;
+  }
+  
+  /**
+   * \brief Applies an add or subtract lane kernel row by row, from the least
+   * significant up, a block of values at a time
+   */
+  void carryThroughRows(const BitVectorBatch &rhs,
+    void (*kernel)(word_t *, const word_t *, const word_t *, word_t *, size_t))
+  {
+    word_t carry[BITVECTOR_BATCH_BLOCK];
+    for (size_t begin = 0; begin < count; begin += BITVECTOR_BATCH_BLOCK)
+    {
+      size_t n = (count - begin < BITVECTOR_BATCH_BLOCK) ? count - begin
+        : BITVECTOR_BATCH_BLOCK;
+      memset(carry, 0, WORDS_TO_BYTES(n));
+      for (size_t k = 0; k < ROWS; k ++)
+        kernel(row(k) + begin, row(k) + begin, rhs.row(k) + begin, carry, n);
+    }
+  }
+  
+  /**
+   * \brief Runs a comparison from the most significant row down, a block of
+   * values at a time, and packs the resulting masks into bits
+   *
+   * \param fold - folds row k of the n values from begin into the masks
+   */
+  template<size_t N, typename A, typename F>
+  void compareRows(BitVector<N, A> &less, BitVector<N, A> *equal,
+    F fold) const
+  {
+    assert(less.width() == count && "Result must have a bit per value");
+    assert((!equal || equal->width() == count) &&
+      "Result must have a bit per value");
+    
+    word_t lt[BITVECTOR_BATCH_BLOCK];
+    word_t eq[BITVECTOR_BATCH_BLOCK];
+    for (size_t begin = 0; begin < count; begin += BITVECTOR_BATCH_BLOCK)
+    {
+      size_t n = (count - begin < BITVECTOR_BATCH_BLOCK) ? count - begin
+        : BITVECTOR_BATCH_BLOCK;
+      memset(lt, 0, WORDS_TO_BYTES(n));
+      memset(eq, 0xff, WORDS_TO_BYTES(n));
+      for (size_t k = ROWS; k -- > 0; )
+        fold(lt, eq, k, begin, n);
+      
+      // The block size is a multiple of the word size, so the results of a
+      // block fill whole words
+      for (size_t i = 0; i < n; i += BITS_PER_WORD)
+      {
+        word_t x = 0, y = 0;
+        size_t m = (n - i < BITS_PER_WORD) ? n - i : BITS_PER_WORD;
+        for (size_t j = 0; j < m; j ++)
+        {
+          x |= (lt[i + j] & 1) << j;
+          y |= (eq[i + j] & 1) << j;
+        }
+        size_t w = WORD_INDEX_FOR_BIT_IN_ARRAY(begin + i);
+        less.data()[w] = x;
+        if (equal)
+          equal->data()[w] = y;
+      }
+    }
+  }
+  
+  void allocate()
+  {
+    storage = stride ? AllocatorTraits::allocate(allocator(), ROWS * stride)
+      : NULL;
+  }
+  
+  void release()
+  {
+    if (storage)
+      AllocatorTraits::deallocate(allocator(), storage, ROWS * stride);
+    storage = NULL;
+  }
+  
+  Allocator &allocator()
+  {
+    return *this;
+  }
+  
+  const Allocator &allocator() const
+  {
+    return *this;
+  }
+  
+  /**
+   * \brief The number of values, and of words in each row including padding
+   */
+  size_t count;
+  size_t stride;
+  
+  /**
+   * \brief The rows, one after another
+   */
+  word_t *storage;
+};
+
+#endif // BITVECTORBATCH_HPP
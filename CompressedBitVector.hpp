@@ -0,0 +1,1278 @@
+/**
+ * \file
+ * \brief Implements CompressedBitVector, a compressed bit vector for sparse
+ * sets and long runs, after Roaring bitmaps.
+ *
+ * The bits are split into chunks of 2^16. Chunks without set bits take no
+ * space; every other chunk is stored in whichever of three forms is smallest:
+ *
+ *   - an array of the positions of its set bits, up to 4096 of them
+ *   - a bitmap of all 2^16 bits, as 1024 words
+ *   - an array of runs of set bits, as (start, length - 1) pairs
+ *
+ * Operations between chunks use merges of the arrays where they can, and
+ * otherwise expand both chunks to bitmaps and apply the word kernels, choosing
+ * the form of the result afresh.
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef COMPRESSEDBITVECTOR_HPP
+#define COMPRESSEDBITVECTOR_HPP
+
+#include "BitSpan.hpp"
+
+#include <algorithm>
+
+
+/**
+ * \def COMPRESSED_CHUNK_BITS
+ * \brief The number of bits covered by each container
+ */
+#define COMPRESSED_CHUNK_BITS 65536
+
+/**
+ * \def COMPRESSED_CHUNK_WORDS
+ * \brief The number of words in a bitmap container
+ */
+#define COMPRESSED_CHUNK_WORDS BITS_TO_WORDS(COMPRESSED_CHUNK_BITS)
+
+/**
+ * \def COMPRESSED_ARRAY_MAX
+ * \brief The most positions an array container holds; beyond this a bitmap
+ * is smaller
+ */
+#define COMPRESSED_ARRAY_MAX 4096
+
+
+/**
+ * CompressedBitVector
+ *
+ * \brief A fixed-length array of bits stored as compressed chunks
+ *
+ * The width is fixed at construction, as for BitVector, and the operands of
+ * the bitwise operations must have equal widths. Dense operands are taken as
+ * a ConstBitSpan, so a BitVector can be passed directly.
+ *
+ * setBit() keeps a chunk in array or bitmap form as it changes; call
+ * optimize() after many updates to turn long runs back into run containers.
+ */
+class CompressedBitVector
+{
+protected:
+  struct Container;
+
+public:
+  /**
+   * \brief The forms of a container
+   */
+  enum ContainerType
+  {
+    ARRAY_CONTAINER,
+    BITMAP_CONTAINER,
+    RUN_CONTAINER
+  };
+  
+  /**
+   * \brief Creates a CompressedBitVector of the given width with every bit
+   * clear
+   */
+  explicit CompressedBitVector(size_t width = 0)
+    : length(width)
+  {
+  }
+  
+  /**
+   * \brief Compresses the bits of a span or BitVector
+   */
+  explicit CompressedBitVector(const ConstBitSpan &bits)
+    : length(bits.width())
+  {
+    word_t buffer[COMPRESSED_CHUNK_WORDS];
+    for (size_t pos = bits.findFirstSet(); pos < length; )
+    {
+      size_t key = pos / COMPRESSED_CHUNK_BITS;
+      loadChunk(bits, key, buffer);
+      
+      Chunk chunk;
+      chunk.key = key;
+      fromBitmap(buffer, chunk.container);
+      chunks.push_back(std::move(chunk));
+      
+      size_t next = (key + 1) * COMPRESSED_CHUNK_BITS;
+      pos = (next < length) ? bits.findNextSet(next) : length;
+    }
+  }
+  
+  /**
+   * \returns the number of bits
+   */
+  size_t width() const
+  {
+    return length;
+  }
+  
+  /**
+   * \returns the number of set bits
+   */
+  size_t popcount() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < chunks.size(); i ++)
+      count += chunks[i].container.cardinality;
+    return count;
+  }
+  
+  /**
+   * \returns the number of chunks that have set bits
+   */
+  size_t containerCount() const
+  {
+    return chunks.size();
+  }
+  
+  /**
+   * \returns the form of the i-th chunk that has set bits
+   */
+  ContainerType containerType(size_t i) const
+  {
+    return (ContainerType)chunks[i].container.type;
+  }
+  
+  /**
+   * \returns the number of bytes of memory used, including the object
+   */
+  size_t storageBytes() const
+  {
+    size_t bytes = sizeof(*this) + chunks.capacity() * sizeof(Chunk);
+    for (size_t i = 0; i < chunks.size(); i ++)
+    {
+      const Container &c = chunks[i].container;
+      bytes += c.values.capacity() * sizeof(uint16_t) +
+        WORDS_TO_BYTES(c.bits.capacity());
+    }
+    return bytes;
+  }
+  
+  /**
+   * \param index - the index of the bit
+   * \returns true if the bit is 1, false otherwise
+   */
+  bool getBit(size_t index) const
+  {
+    assert(index < length);
+    
+    const Chunk *chunk = findChunk(index / COMPRESSED_CHUNK_BITS);
+    return chunk && contains(chunk->container,
+      (uint16_t)(index % COMPRESSED_CHUNK_BITS));
+  }
+  
+  /**
+   * \returns the truth value of the specified bit
+   */
+  bool operator[](size_t index) const
+  {
+    return getBit(index);
+  }
+  
+  /**
+   * \param index - the index of the bit
+   * \param x - true if the bit should be set to 1, false otherwise
+   */
+  void setBit(size_t index, bool x)
+  {
+    assert(index < length);
+    
+    size_t key = index / COMPRESSED_CHUNK_BITS;
+    uint16_t pos = (uint16_t)(index % COMPRESSED_CHUNK_BITS);
+    std::vector<Chunk>::iterator it = lowerBound(key);
+    if (it == chunks.end() || it->key != key)
+    {
+      if (!x)
+        return;
+      
+      Chunk chunk;
+      chunk.key = key;
+      chunk.container.type = ARRAY_CONTAINER;
+      chunk.container.cardinality = 1;
+      chunk.container.values.assign(1, pos);
+      chunks.insert(it, std::move(chunk));
+      return;
+    }
+    
+    Container &c = it->container;
+    if (c.type == ARRAY_CONTAINER)
+    {
+      std::vector<uint16_t>::iterator v =
+        std::lower_bound(c.values.begin(), c.values.end(), pos);
+      bool present = (v != c.values.end() && *v == pos);
+      if (x == present)
+        return;
+      
+      if (!x)
+      {
+        c.values.erase(v);
+        c.cardinality --;
+      }
+      else if (c.cardinality < COMPRESSED_ARRAY_MAX)
+      {
+        c.values.insert(v, pos);
+        c.cardinality ++;
+      }
+      else
+      {
+        word_t buffer[COMPRESSED_CHUNK_WORDS];
+        toBitmap(c, buffer);
+        buffer[pos / BITS_PER_WORD] |= MASK_WITH_BIT(pos % BITS_PER_WORD);
+        makeBitmap(buffer, c.cardinality + 1, c);
+      }
+    }
+    else
+    {
+      // Runs are updated in bitmap form and the form is chosen again
+      if (c.type == RUN_CONTAINER)
+      {
+        if (contains(c, pos) == x)
+          return;
+        
+        word_t buffer[COMPRESSED_CHUNK_WORDS];
+        toBitmap(c, buffer);
+        makeBitmap(buffer, c.cardinality, c);
+      }
+      
+      word_t &w = c.bits[pos / BITS_PER_WORD];
+      word_t mask = MASK_WITH_BIT(pos % BITS_PER_WORD);
+      if (((w & mask) != 0) == x)
+        return;
+      
+      w ^= mask;
+      c.cardinality += x ? 1 : -1;
+      if (c.cardinality <= COMPRESSED_ARRAY_MAX)
+        fromBitmap(c.bits.data(), c);
+    }
+    
+    if (c.cardinality == 0)
+      chunks.erase(it);
+  }
+  
+  /**
+   * \brief Chooses the smallest form for every chunk again
+   */
+  void optimize()
+  {
+    word_t buffer[COMPRESSED_CHUNK_WORDS];
+    for (size_t i = 0; i < chunks.size(); i ++)
+    {
+      Container &c = chunks[i].container;
+      if (c.type == ARRAY_CONTAINER)
+      {
+        fromArray(c);
+      }
+      else
+      {
+        fromBitmap(bitmapOf(c, buffer), c);
+      }
+    }
+  }
+  
+  /**
+   * \brief Copies the bits into a span or BitVector of the same width
+   */
+  void copyTo(BitSpan dst) const
+  {
+    assert(dst.width() == length && "Operands must have equal widths");
+    
+    word_t buffer[COMPRESSED_CHUNK_WORDS];
+    size_t next = 0;
+    for (size_t i = 0; i <= chunks.size(); i ++)
+    {
+      // Clear the words of the empty chunks before this one
+      size_t key = (i < chunks.size()) ? chunks[i].key
+        : CEILDIV(length, COMPRESSED_CHUNK_BITS);
+      size_t end = std::min(key * COMPRESSED_CHUNK_WORDS, dst.wordCount());
+      for (size_t w = next * COMPRESSED_CHUNK_WORDS; w < end; w ++)
+        dst.setWord(w, 0);
+      if (i == chunks.size())
+        break;
+      
+      const word_t *words = bitmapOf(chunks[i].container, buffer);
+      forChunkWords(dst, key, [&](size_t w, size_t j)
+      {
+        dst.setWord(w, words[j]);
+      });
+      next = key + 1;
+    }
+  }
+  
+  /**
+   * \returns the bits as a BitVector
+   */
+  template<size_t N = 64>
+  BitVector<N> toBitVector() const
+  {
+    BitVector<N> v(length, false);
+    copyTo(v);
+    return v;
+  }
+  
+  CompressedBitVector &operator|=(const CompressedBitVector &rhs)
+  {
+    return combine(rhs, OP_OR);
+  }
+  
+  CompressedBitVector &operator&=(const CompressedBitVector &rhs)
+  {
+    return combine(rhs, OP_AND);
+  }
+  
+  CompressedBitVector &operator^=(const CompressedBitVector &rhs)
+  {
+    return combine(rhs, OP_XOR);
+  }
+  
+  /**
+   * \brief Clears the bits that are set in rhs
+   */
+  CompressedBitVector &andNot(const CompressedBitVector &rhs)
+  {
+    return combine(rhs, OP_ANDNOT);
+  }
+  
+  CompressedBitVector &operator|=(const ConstBitSpan &rhs)
+  {
+    return combine(rhs, OP_OR);
+  }
+  
+  CompressedBitVector &operator&=(const ConstBitSpan &rhs)
+  {
+    return combine(rhs, OP_AND);
+  }
+  
+  CompressedBitVector &operator^=(const ConstBitSpan &rhs)
+  {
+    return combine(rhs, OP_XOR);
+  }
+  
+  CompressedBitVector &andNot(const ConstBitSpan &rhs)
+  {
+    return combine(rhs, OP_ANDNOT);
+  }
+  
+  friend CompressedBitVector operator|(CompressedBitVector lhs,
+    const CompressedBitVector &rhs)
+  {
+    return std::move(lhs |= rhs);
+  }
+  
+  friend CompressedBitVector operator&(CompressedBitVector lhs,
+    const CompressedBitVector &rhs)
+  {
+    return std::move(lhs &= rhs);
+  }
+  
+  friend CompressedBitVector operator^(CompressedBitVector lhs,
+    const CompressedBitVector &rhs)
+  {
+    return std::move(lhs ^= rhs);
+  }
+  
+  /**
+   * \brief Computes dst |= *this for a span or BitVector of the same width
+   */
+  void orInto(BitSpan dst) const
+  {
+    applyTo(dst, OP_OR);
+  }
+  
+  /**
+   * \brief Computes dst &= *this
+   */
+  void andInto(BitSpan dst) const
+  {
+    applyTo(dst, OP_AND);
+  }
+  
+  /**
+   * \brief Computes dst ^= *this
+   */
+  void xorInto(BitSpan dst) const
+  {
+    applyTo(dst, OP_XOR);
+  }
+  
+  /**
+   * \brief Computes dst &= ~*this
+   */
+  void andNotInto(BitSpan dst) const
+  {
+    applyTo(dst, OP_ANDNOT);
+  }
+  
+  bool operator==(const CompressedBitVector &rhs) const
+  {
+    if (length != rhs.length || chunks.size() != rhs.chunks.size())
+      return false;
+    
+    word_t x[COMPRESSED_CHUNK_WORDS], y[COMPRESSED_CHUNK_WORDS];
+    for (size_t i = 0; i < chunks.size(); i ++)
+    {
+      const Container &a = chunks[i].container;
+      const Container &b = rhs.chunks[i].container;
+      if (chunks[i].key != rhs.chunks[i].key ||
+        a.cardinality != b.cardinality)
+        return false;
+      if (a.type == b.type)
+      {
+        if (a.values != b.values || a.bits != b.bits)
+          return false;
+        continue;
+      }
+      
+      if (!wordKernels().equalWords(bitmapOf(a, x), bitmapOf(b, y),
+        COMPRESSED_CHUNK_WORDS))
+        return false;
+    }
+    return true;
+  }
+  
+  bool operator!=(const CompressedBitVector &rhs) const
+  {
+    return !(*this == rhs);
+  }
+  
+  /**
+   * SetBitIterator
+   *
+   * \brief A forward iterator over the indices of the set bits, in
+   * increasing order
+   *
+   * It is invalidated when the CompressedBitVector is modified.
+   */
+  class SetBitIterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef size_t value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const size_t *pointer;
+    typedef size_t reference;
+    
+    size_t operator*() const
+    {
+      return current;
+    }
+    
+    SetBitIterator &operator++()
+    {
+      advance();
+      return *this;
+    }
+    
+    SetBitIterator operator++(int)
+    {
+      SetBitIterator old = *this;
+      ++ *this;
+      return old;
+    }
+    
+    bool operator==(const SetBitIterator &other) const
+    {
+      return chunk == other.chunk && current == other.current;
+    }
+    
+    bool operator!=(const SetBitIterator &other) const
+    {
+      return !(*this == other);
+    }
+  
+  private:
+    friend class CompressedBitVector;
+    
+    /**
+     * \brief Positions the iterator at the first set bit of the i-th chunk
+     * that has any
+     */
+    SetBitIterator(const CompressedBitVector &CBV, size_t i)
+      : cbv(&CBV), chunk(i), container(NULL), base(0)
+    {
+      enter();
+    }
+    
+    /**
+     * \brief Moves to the first set bit of the current chunk, or to the end
+     * if there are no more chunks
+     */
+    void enter()
+    {
+      pos = 0;
+      remaining = 0;
+      current = runEnd = 0;
+      if (chunk >= cbv->chunks.size())
+      {
+        chunk = cbv->chunks.size();
+        return;
+      }
+      
+      container = &cbv->chunks[chunk].container;
+      base = cbv->chunks[chunk].key * COMPRESSED_CHUNK_BITS;
+      const Container &c = *container;
+      if (c.type == BITMAP_CONTAINER)
+      {
+        while (c.bits[pos] == 0)
+          pos ++;
+        remaining = c.bits[pos];
+        current = base + WORDS_TO_BITS(pos) + countTrailingZeros(remaining);
+      }
+      else
+      {
+        current = base + c.values[0];
+        if (c.type == RUN_CONTAINER)
+          runEnd = current + c.values[1];
+      }
+    }
+    
+    void advance()
+    {
+      if (current < runEnd)
+      {
+        current ++;
+        return;
+      }
+      
+      const Container &c = *container;
+      switch (c.type)
+      {
+      case ARRAY_CONTAINER:
+        if (++ pos < c.values.size())
+        {
+          current = base + c.values[pos];
+          return;
+        }
+        break;
+      
+      case RUN_CONTAINER:
+        if (2 * (++ pos) < c.values.size())
+        {
+          current = base + c.values[2 * pos];
+          runEnd = current + c.values[2 * pos + 1];
+          return;
+        }
+        break;
+      
+      default:
+        remaining &= remaining - 1;
+        while (remaining == 0 && ++ pos < COMPRESSED_CHUNK_WORDS)
+          remaining = c.bits[pos];
+        if (remaining != 0)
+        {
+          current = base + WORDS_TO_BITS(pos) +
+            countTrailingZeros(remaining);
+          return;
+        }
+        break;
+      }
+      
+      chunk ++;
+      enter();
+    }
+    
+    /**
+     * \brief The CompressedBitVector being iterated over
+     */
+    const CompressedBitVector *cbv;
+    
+    /**
+     * \brief The index of the current chunk, or the number of chunks at the
+     * end
+     */
+    size_t chunk;
+    
+    /**
+     * \brief The current chunk's container
+     */
+    const Container *container;
+    
+    /**
+     * \brief The index of the first bit of the current chunk
+     */
+    size_t base;
+    
+    /**
+     * \brief The index of the current position, run or word in the chunk
+     */
+    size_t pos;
+    
+    /**
+     * \brief The index of the last bit of the current run, or 0 outside a
+     * run container
+     */
+    size_t runEnd;
+    
+    /**
+     * \brief The bits of the current bitmap word not visited yet
+     */
+    word_t remaining;
+    
+    /**
+     * \brief The index of the current bit
+     */
+    size_t current;
+  };
+  
+  /**
+   * SetBitRange
+   *
+   * \brief The indices of the set bits, for use in range-based for loops
+   */
+  class SetBitRange
+  {
+  public:
+    SetBitIterator begin() const
+    {
+      return SetBitIterator(cbv, 0);
+    }
+    
+    SetBitIterator end() const
+    {
+      return SetBitIterator(cbv, cbv.chunks.size());
+    }
+  
+  private:
+    friend class CompressedBitVector;
+    
+    SetBitRange(const CompressedBitVector &CBV) : cbv(CBV) { }
+    
+    /**
+     * \brief The CompressedBitVector whose set bits are listed
+     */
+    const CompressedBitVector &cbv;
+  };
+  
+  /**
+   * \returns the indices of the set bits in increasing order, as in
+   *
+   *     for (size_t i : v.setBitIndices())
+   *       ...
+   */
+  SetBitRange setBitIndices() const
+  {
+    return SetBitRange(*this);
+  }
+
+protected:
+  /**
+   * \brief The set bits of one chunk
+   */
+  struct Container
+  {
+    /**
+     * \brief A ContainerType
+     */
+    unsigned char type;
+    
+    /**
+     * \brief The number of set bits, never 0
+     */
+    uint32_t cardinality;
+    
+    /**
+     * \brief The sorted positions of an array container, or the
+     * (start, length - 1) pairs of a run container
+     */
+    std::vector<uint16_t> values;
+    
+    /**
+     * \brief The words of a bitmap container
+     */
+    std::vector<word_t> bits;
+  };
+  
+  struct Chunk
+  {
+    /**
+     * \brief The index of the chunk, i.e. its first bit divided by
+     * COMPRESSED_CHUNK_BITS
+     */
+    size_t key;
+    
+    Container container;
+  };
+  
+  enum Operation
+  {
+    OP_OR,
+    OP_AND,
+    OP_XOR,
+    OP_ANDNOT
+  };
+  
+  const Chunk *findChunk(size_t key) const
+  {
+    std::vector<Chunk>::const_iterator it = std::lower_bound(chunks.begin(),
+      chunks.end(), key, [](const Chunk &c, size_t k) { return c.key < k; });
+    return (it != chunks.end() && it->key == key) ? &*it : NULL;
+  }
+  
+  std::vector<Chunk>::iterator lowerBound(size_t key)
+  {
+    return std::lower_bound(chunks.begin(), chunks.end(), key,
+      [](const Chunk &c, size_t k) { return c.key < k; });
+  }
+  
+  /**
+   * \brief Calls f(w, j) for each word w of a span that falls in a chunk,
+   * where j is the index of the word within the chunk
+   */
+  template<typename F>
+  static void forChunkWords(const ConstBitSpan &span, size_t key, F f)
+  {
+    size_t begin = key * COMPRESSED_CHUNK_WORDS;
+    size_t end = std::min(begin + COMPRESSED_CHUNK_WORDS, span.wordCount());
+    for (size_t w = begin; w < end; w ++)
+      f(w, w - begin);
+  }
+  
+  /**
+   * \brief Copies the words of a chunk of a span, clearing the bits beyond
+   * its end
+   */
+  static void loadChunk(const ConstBitSpan &span, size_t key, word_t *buffer)
+  {
+    memset(buffer, 0, WORDS_TO_BYTES(COMPRESSED_CHUNK_WORDS));
+    forChunkWords(span, key, [&](size_t w, size_t j)
+    {
+      buffer[j] = span.word(w);
+    });
+    
+    size_t end = span.width() - key * COMPRESSED_CHUNK_BITS;
+    if (end < COMPRESSED_CHUNK_BITS)
+      buffer[WORD_INDEX_FOR_BIT_IN_ARRAY(end - 1)] &=
+        MASK_FOR_MOST_SIGNIFICANT_WORD(end);
+  }
+  
+  /**
+   * \returns true if the bit at pos of the chunk is set
+   */
+  static bool contains(const Container &c, uint16_t pos)
+  {
+    if (c.type == BITMAP_CONTAINER)
+      return (c.bits[pos / BITS_PER_WORD] &
+        MASK_WITH_BIT(pos % BITS_PER_WORD)) != 0;
+    if (c.type == ARRAY_CONTAINER)
+      return std::binary_search(c.values.begin(), c.values.end(), pos);
+    
+    // Find the last run starting at or before pos
+    size_t lo = 0, hi = c.values.size() / 2;
+    while (lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      if (c.values[2 * mid] <= pos)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo > 0 &&
+      pos - c.values[2 * (lo - 1)] <= c.values[2 * (lo - 1) + 1];
+  }
+  
+  /**
+   * \brief Writes the bits of a chunk to COMPRESSED_CHUNK_WORDS words
+   */
+  static void toBitmap(const Container &c, word_t *buffer)
+  {
+    if (c.type == BITMAP_CONTAINER)
+    {
+      memcpy(buffer, c.bits.data(), WORDS_TO_BYTES(COMPRESSED_CHUNK_WORDS));
+      return;
+    }
+    
+    memset(buffer, 0, WORDS_TO_BYTES(COMPRESSED_CHUNK_WORDS));
+    if (c.type == ARRAY_CONTAINER)
+    {
+      for (size_t i = 0; i < c.values.size(); i ++)
+        buffer[c.values[i] / BITS_PER_WORD] |=
+          MASK_WITH_BIT(c.values[i] % BITS_PER_WORD);
+      return;
+    }
+    
+    for (size_t i = 0; i < c.values.size(); i += 2)
+    {
+      size_t begin = c.values[i], end = begin + c.values[i + 1] + 1;
+      size_t first = begin / BITS_PER_WORD, last = (end - 1) / BITS_PER_WORD;
+      word_t head = ~(word_t)0 << (begin % BITS_PER_WORD);
+      word_t tail = MASK_FOR_MOST_SIGNIFICANT_WORD(end);
+      if (first == last)
+      {
+        buffer[first] |= head & tail;
+        continue;
+      }
+      buffer[first] |= head;
+      for (size_t w = first + 1; w < last; w ++)
+        buffer[w] = ~(word_t)0;
+      buffer[last] |= tail;
+    }
+  }
+  
+  /**
+   * \returns the words of a chunk: its own if it is a bitmap, and otherwise
+   *   buffer after writing them there
+   */
+  static word_t *bitmapOf(Container &c, word_t *buffer)
+  {
+    if (c.type == BITMAP_CONTAINER)
+      return c.bits.data();
+    toBitmap(c, buffer);
+    return buffer;
+  }
+  
+  static const word_t *bitmapOf(const Container &c, word_t *buffer)
+  {
+    if (c.type == BITMAP_CONTAINER)
+      return c.bits.data();
+    toBitmap(c, buffer);
+    return buffer;
+  }
+  
+  /**
+   * \brief Stores a chunk in bitmap form
+   */
+  static void makeBitmap(const word_t *buffer, size_t cardinality,
+    Container &c)
+  {
+    c.type = BITMAP_CONTAINER;
+    c.cardinality = (uint32_t)cardinality;
+    if (buffer != c.bits.data())
+      c.bits.assign(buffer, buffer + COMPRESSED_CHUNK_WORDS);
+    std::vector<uint16_t>().swap(c.values);
+  }
+  
+  /**
+   * \brief Stores a chunk in whichever form is smallest
+   *
+   * The cardinality is 0 if the chunk is empty, and the caller must drop it.
+   * The buffer may be the chunk's own bitmap.
+   */
+  static void fromBitmap(const word_t *buffer, Container &c)
+  {
+    // Sizes in 16-bit units, counting runs only as far as could matter
+    size_t cardinality = popcountWords(buffer, COMPRESSED_CHUNK_WORDS);
+    size_t arraySize = cardinality, bitmapSize = COMPRESSED_CHUNK_BITS / 16;
+    size_t runSize =
+      2 * countRuns(buffer, (std::min(arraySize, bitmapSize) + 1) / 2);
+    c.cardinality = (uint32_t)cardinality;
+    if (runSize < bitmapSize && runSize < arraySize)
+    {
+      c.type = RUN_CONTAINER;
+      c.values.clear();
+      c.values.reserve(runSize);
+      for (size_t i = 0; i < COMPRESSED_CHUNK_BITS; )
+      {
+        i = skipBits(buffer, i, 0);
+        if (i == COMPRESSED_CHUNK_BITS)
+          break;
+        size_t end = skipBits(buffer, i, ~(word_t)0);
+        c.values.push_back((uint16_t)i);
+        c.values.push_back((uint16_t)(end - i - 1));
+        i = end;
+      }
+      std::vector<word_t>().swap(c.bits);
+    }
+    else if (arraySize <= COMPRESSED_ARRAY_MAX)
+    {
+      c.type = ARRAY_CONTAINER;
+      c.values.clear();
+      c.values.reserve(cardinality);
+      for (size_t i = 0; i < COMPRESSED_CHUNK_WORDS; i ++)
+      {
+        for (word_t w = buffer[i]; w != 0; w &= w - 1)
+          c.values.push_back(
+            (uint16_t)(WORDS_TO_BITS(i) + countTrailingZeros(w)));
+      }
+      std::vector<word_t>().swap(c.bits);
+    }
+    else
+    {
+      makeBitmap(buffer, cardinality, c);
+    }
+  }
+  
+  /**
+   * \returns the number of runs of set bits in a chunk, or a number at least
+   *   limit if there are that many
+   */
+  static size_t countRuns(const word_t *buffer, size_t limit)
+  {
+    // The first bit of each run, counted a block at a time
+    word_t starts[64];
+    size_t runs = 0;
+    word_t carry = 0;
+    for (size_t i = 0; i < COMPRESSED_CHUNK_WORDS && runs < limit; i += 64)
+    {
+      for (size_t j = 0; j < 64; j ++)
+      {
+        word_t w = buffer[i + j];
+        starts[j] = w & ~((w << 1) | carry);
+        carry = w >> (BITS_PER_WORD - 1);
+      }
+      runs += popcountWords(starts, 64);
+    }
+    return runs;
+  }
+  
+  /**
+   * \brief Chooses between array and run form for a chunk in array form
+   */
+  static void fromArray(Container &c)
+  {
+    size_t runs = 0;
+    for (size_t i = 0; i < c.values.size(); i ++)
+      runs += (i == 0 || c.values[i] != c.values[i - 1] + 1);
+    if (2 * runs >= c.values.size())
+      return;
+    
+    std::vector<uint16_t> pairs;
+    pairs.reserve(2 * runs);
+    for (size_t i = 0; i < c.values.size(); )
+    {
+      size_t j = i + 1;
+      while (j < c.values.size() && c.values[j] == c.values[j - 1] + 1)
+        j ++;
+      pairs.push_back(c.values[i]);
+      pairs.push_back((uint16_t)(j - i - 1));
+      i = j;
+    }
+    c.type = RUN_CONTAINER;
+    c.values.swap(pairs);
+  }
+  
+  /**
+   * \returns the index of the first bit at or after i in a chunk that
+   *   differs from fill, or COMPRESSED_CHUNK_BITS
+   */
+  static size_t skipBits(const word_t *buffer, size_t i, word_t fill)
+  {
+    size_t w = i / BITS_PER_WORD;
+    word_t x = (buffer[w] ^ fill) & (~(word_t)0 << (i % BITS_PER_WORD));
+    while (x == 0)
+    {
+      if (++ w == COMPRESSED_CHUNK_WORDS)
+        return COMPRESSED_CHUNK_BITS;
+      x = buffer[w] ^ fill;
+    }
+    return WORDS_TO_BITS(w) + countTrailingZeros(x);
+  }
+  
+  /**
+   * \brief Computes x = x op y over a chunk of words
+   */
+  static void applyWords(word_t *x, const word_t *y, Operation op)
+  {
+    const WordKernels &K = wordKernels();
+    switch (op)
+    {
+    case OP_OR:
+      K.orWords(x, y, COMPRESSED_CHUNK_WORDS);
+      break;
+    case OP_AND:
+      K.andWords(x, y, COMPRESSED_CHUNK_WORDS);
+      break;
+    case OP_XOR:
+      K.xorWords(x, y, COMPRESSED_CHUNK_WORDS);
+      break;
+    case OP_ANDNOT:
+      for (size_t i = 0; i < COMPRESSED_CHUNK_WORDS; i ++)
+        x[i] &= ~y[i];
+      break;
+    }
+  }
+  
+  /**
+   * \brief Computes a = a op b for two chunks
+   */
+  static void combine(Container &a, const Container &b, Operation op)
+  {
+    // An array filtered by membership in the other chunk
+    if (a.type == ARRAY_CONTAINER && (op == OP_AND || op == OP_ANDNOT))
+    {
+      filter(a, [&](uint16_t pos)
+      {
+        return contains(b, pos) == (op == OP_AND);
+      });
+      return;
+    }
+    if (b.type == ARRAY_CONTAINER && op == OP_AND)
+    {
+      Container result = b;
+      filter(result, [&](uint16_t pos) { return contains(a, pos); });
+      a = std::move(result);
+      return;
+    }
+    
+    // Two small arrays merged
+    if (a.type == ARRAY_CONTAINER && b.type == ARRAY_CONTAINER &&
+      a.cardinality + b.cardinality <= COMPRESSED_ARRAY_MAX)
+    {
+      std::vector<uint16_t> merged(a.cardinality + b.cardinality);
+      std::vector<uint16_t>::iterator end = (op == OP_OR)
+        ? std::set_union(a.values.begin(), a.values.end(), b.values.begin(),
+            b.values.end(), merged.begin())
+        : std::set_symmetric_difference(a.values.begin(), a.values.end(),
+            b.values.begin(), b.values.end(), merged.begin());
+      merged.resize(end - merged.begin());
+      a.values.swap(merged);
+      a.cardinality = (uint32_t)a.values.size();
+      fromArray(a);
+      return;
+    }
+    
+    word_t x[COMPRESSED_CHUNK_WORDS], y[COMPRESSED_CHUNK_WORDS];
+    word_t *lhs = bitmapOf(a, x);
+    applyWords(lhs, bitmapOf(b, y), op);
+    fromBitmap(lhs, a);
+  }
+  
+  /**
+   * \brief Keeps the positions of an array chunk for which keep(pos) is true
+   */
+  template<typename F>
+  static void filter(Container &c, F keep)
+  {
+    std::vector<uint16_t>::iterator end =
+      std::remove_if(c.values.begin(), c.values.end(),
+        [&](uint16_t pos) { return !keep(pos); });
+    c.values.erase(end, c.values.end());
+    c.cardinality = (uint32_t)c.values.size();
+  }
+  
+  CompressedBitVector &combine(const CompressedBitVector &rhs, Operation op)
+  {
+    assert(length == rhs.length && "Operands must have equal widths");
+    
+    std::vector<Chunk> result;
+    result.reserve(op == OP_AND ? std::min(chunks.size(), rhs.chunks.size())
+      : chunks.size() + (op == OP_ANDNOT ? 0 : rhs.chunks.size()));
+    size_t i = 0, j = 0;
+    while (i < chunks.size() || j < rhs.chunks.size())
+    {
+      if (j == rhs.chunks.size() ||
+        (i < chunks.size() && chunks[i].key < rhs.chunks[j].key))
+      {
+        // Only in this vector
+        if (op != OP_AND)
+          result.push_back(std::move(chunks[i]));
+        i ++;
+      }
+      else if (i == chunks.size() || rhs.chunks[j].key < chunks[i].key)
+      {
+        // Only in rhs
+        if (op == OP_OR || op == OP_XOR)
+          result.push_back(rhs.chunks[j]);
+        j ++;
+      }
+      else
+      {
+        combine(chunks[i].container, rhs.chunks[j].container, op);
+        if (chunks[i].container.cardinality != 0)
+          result.push_back(std::move(chunks[i]));
+        i ++;
+        j ++;
+      }
+    }
+    chunks.swap(result);
+    return *this;
+  }
+  
+  CompressedBitVector &combine(const ConstBitSpan &rhs, Operation op)
+  {
+    assert(length == rhs.width() && "Operands must have equal widths");
+    
+    word_t x[COMPRESSED_CHUNK_WORDS], y[COMPRESSED_CHUNK_WORDS];
+    std::vector<Chunk> result;
+    size_t i = 0;
+    
+    // AND and ANDNOT only change the chunks this vector has; OR and XOR
+    // visit every chunk of rhs with a set bit, too
+    bool visitRhs = (op == OP_OR || op == OP_XOR);
+    size_t key = 0, keys = CEILDIV(length, COMPRESSED_CHUNK_BITS);
+    while (key < keys)
+    {
+      bool here = (i < chunks.size() && chunks[i].key == key);
+      if (here && chunks[i].container.type == ARRAY_CONTAINER &&
+        (op == OP_AND || op == OP_ANDNOT))
+      {
+        size_t base = key * COMPRESSED_CHUNK_BITS;
+        filter(chunks[i].container, [&](uint16_t pos)
+        {
+          return rhs.getBit(base + pos) == (op == OP_AND);
+        });
+      }
+      else if (here || visitRhs)
+      {
+        loadChunk(rhs, key, y);
+        if (here)
+        {
+          word_t *lhs = bitmapOf(chunks[i].container, x);
+          applyWords(lhs, y, op);
+          fromBitmap(lhs, chunks[i].container);
+        }
+        else if (!wordKernels().equalWords(y, zeroChunk(),
+          COMPRESSED_CHUNK_WORDS))
+        {
+          Chunk chunk;
+          chunk.key = key;
+          fromBitmap(y, chunk.container);
+          result.push_back(std::move(chunk));
+        }
+      }
+      
+      if (here)
+      {
+        if (chunks[i].container.cardinality != 0)
+          result.push_back(std::move(chunks[i]));
+        i ++;
+      }
+      
+      // Jump to the next chunk that either operand has
+      size_t next = (i < chunks.size()) ? chunks[i].key : keys;
+      if (visitRhs && key + 1 < next)
+      {
+        size_t pos = rhs.findNextSet((key + 1) * COMPRESSED_CHUNK_BITS);
+        next = std::min(next, pos / COMPRESSED_CHUNK_BITS);
+      }
+      key = std::max(key + 1, next);
+    }
+    chunks.swap(result);
+    return *this;
+  }
+  
+  /**
+   * \brief Computes dst = dst op *this
+   */
+  void applyTo(BitSpan dst, Operation op) const
+  {
+    assert(dst.width() == length && "Operands must have equal widths");
+    
+    word_t buffer[COMPRESSED_CHUNK_WORDS];
+    size_t next = 0;
+    for (size_t i = 0; i <= chunks.size(); i ++)
+    {
+      size_t key = (i < chunks.size()) ? chunks[i].key
+        : CEILDIV(length, COMPRESSED_CHUNK_BITS);
+      
+      // AND clears the chunks this vector doesn't have
+      if (op == OP_AND)
+      {
+        size_t end = std::min(key * COMPRESSED_CHUNK_WORDS, dst.wordCount());
+        for (size_t w = next * COMPRESSED_CHUNK_WORDS; w < end; w ++)
+          dst.setWord(w, 0);
+      }
+      if (i == chunks.size())
+        break;
+      next = key + 1;
+      
+      const Container &c = chunks[i].container;
+      size_t base = key * COMPRESSED_CHUNK_BITS;
+      if (c.type == ARRAY_CONTAINER && op != OP_AND)
+      {
+        for (size_t k = 0; k < c.values.size(); k ++)
+        {
+          if (op == OP_XOR)
+            dst.flipBit(base + c.values[k]);
+          else
+            dst.setBit(base + c.values[k], op == OP_OR);
+        }
+        continue;
+      }
+      
+      const word_t *words = bitmapOf(c, buffer);
+      forChunkWords(dst, key, [&](size_t w, size_t j)
+      {
+        word_t x = dst.word(w);
+        switch (op)
+        {
+        case OP_OR:
+          x |= words[j];
+          break;
+        case OP_AND:
+          x &= words[j];
+          break;
+        case OP_XOR:
+          x ^= words[j];
+          break;
+        case OP_ANDNOT:
+          x &= ~words[j];
+          break;
+        }
+        dst.setWord(w, x);
+      });
+    }
+  }
+  
+  /**
+   * \returns COMPRESSED_CHUNK_WORDS zero words
+   */
+  static const word_t *zeroChunk()
+  {
+    static const word_t zeros[COMPRESSED_CHUNK_WORDS] = { 0 };
+    return zeros;
+  }
+  
+  /**
+   * \brief The number of bits
+   */
+  size_t length;
+  
+  /**
+   * \brief The chunks that have set bits, in increasing order of key
+   */
+  std::vector<Chunk> chunks;
+};
+
+/**
+ * \brief Computes dst |= src for a BitVector and a CompressedBitVector of the
+ * same width
+ */
+template<size_t N, typename A>
+BitVector<N, A> &operator|=(BitVector<N, A> &dst,
+  const CompressedBitVector &src)
+{
+  src.orInto(dst);
+  return dst;
+}
+
+template<size_t N, typename A>
+BitVector<N, A> &operator&=(BitVector<N, A> &dst,
+  const CompressedBitVector &src)
+{
+  src.andInto(dst);
+  return dst;
+}
+
+template<size_t N, typename A>
+BitVector<N, A> &operator^=(BitVector<N, A> &dst,
+  const CompressedBitVector &src)
+{
+  src.xorInto(dst);
+  return dst;
+}
+
+#endif // COMPRESSEDBITVECTOR_HPP
@@ -0,0 +1,862 @@
+/**
+ * \file
+ * \brief Implements FixedBitVector, a bit vector whose width is a template
+ * constant, for values like 128- or 256-bit integers whose width never
+ * changes.
+ *
+ * A FixedBitVector holds nothing but its words: there is no length field and
+ * no storage pointer, and every loop runs a constant number of times, so the
+ * compiler unrolls them. All operations are constexpr as of C++14, so
+ * constants, masks and tables can be computed at compile time. Widths of up
+ * to 64 and 128 bits are computed on word_t and unsigned __int128 directly.
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FIXEDBITVECTOR_HPP
+#define FIXEDBITVECTOR_HPP
+
+#include "BitVector.hpp"
+
+
+/**
+ * \def BITVECTOR_UNROLL
+ * \brief Asks the compiler to unroll the following loop completely
+ *
+ * The loops over the words of a FixedBitVector have constant trip counts, but
+ * without the hint GCC only unrolls them at -O3.
+ */
+#if defined(__clang__)
+#define BITVECTOR_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__) && __GNUC__ >= 8
+#define BITVECTOR_UNROLL _Pragma("GCC unroll 16")
+#else
+#define BITVECTOR_UNROLL
+#endif
+
+
+/**
+ * FixedWordOps
+ *
+ * \brief The arithmetic of FixedBitVector on a constant number of words
+ *
+ * Destinations may be the same as sources. Shift counts are less than the
+ * number of bits in the words.
+ */
+template<size_t Words>
+struct FixedWordOps
+{
+  /**
+   * \brief Computes d = a + b, discarding the outgoing carry
+   *
+   * At runtime this is an adc chain; constant evaluation uses the portable
+   * carry computation.
+   */
+  static BITVECTOR_CONSTEXPR void add(word_t *d, const word_t *a,
+    const word_t *b)
+  {
+    if (!BITVECTOR_IS_CONSTANT_EVALUATED())
+    {
+      unsigned char carry = 0;
+      BITVECTOR_UNROLL
+      for (size_t i = 0; i < Words; i ++)
+      {
+#ifdef BITVECTOR_X86_64_CARRY
+        // The intrinsic is used directly: through addWithCarry(), GCC keeps
+        // a dead store of every word to the stack
+        unsigned long long s = 0;
+        carry = _addcarry_u64(carry, a[i], b[i], &s);
+        d[i] = s;
+#else
+        carry = addWithCarry(a[i], b[i], carry, &d[i]);
+#endif
+      }
+      return;
+    }
+    
+    word_t carry = 0;
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < Words; i ++)
+    {
+      word_t y = b[i];
+      word_t s = a[i] + carry;
+      carry = s < carry;
+      s += y;
+      carry |= s < y;
+      d[i] = s;
+    }
+  }
+  
+  /**
+   * \brief Computes d = a - b, discarding the outgoing borrow
+   */
+  static BITVECTOR_CONSTEXPR void subtract(word_t *d, const word_t *a,
+    const word_t *b)
+  {
+    if (!BITVECTOR_IS_CONSTANT_EVALUATED())
+    {
+      unsigned char borrow = 0;
+      BITVECTOR_UNROLL
+      for (size_t i = 0; i < Words; i ++)
+      {
+#ifdef BITVECTOR_X86_64_CARRY
+        unsigned long long s = 0;
+        borrow = _subborrow_u64(borrow, a[i], b[i], &s);
+        d[i] = s;
+#else
+        borrow = subtractWithBorrow(a[i], b[i], borrow, &d[i]);
+#endif
+      }
+      return;
+    }
+    
+    word_t borrow = 0;
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < Words; i ++)
+    {
+      word_t x = a[i], y = b[i];
+      word_t s = x - y;
+      word_t b2 = s < borrow;
+      d[i] = s - borrow;
+      borrow = (x < y) | b2;
+    }
+  }
+  
+  /**
+   * \brief Computes the low Words words of a * b into d
+   *
+   * Products that only affect words above the result are skipped.
+   */
+  static BITVECTOR_CONSTEXPR void multiply(word_t *d, const word_t *a,
+    const word_t *b)
+  {
+    word_t r[Words] = {};
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < Words; i ++)
+    {
+      word_t carry = 0;
+      BITVECTOR_UNROLL
+      for (size_t j = 0; i + j < Words; j ++)
+      {
+        word_t hi = 0;
+        word_t lo = mulWide(a[i], b[j], &hi);
+        lo += carry;
+        hi += lo < carry;
+        r[i + j] += lo;
+        hi += r[i + j] < lo;
+        carry = hi;
+      }
+    }
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < Words; i ++)
+      d[i] = r[i];
+  }
+  
+  /**
+   * \returns true if a < b as unsigned integers
+   */
+  static BITVECTOR_CONSTEXPR bool less(const word_t *a, const word_t *b)
+  {
+    BITVECTOR_UNROLL
+    for (size_t j = 0; j < Words; j ++)
+    {
+      size_t i = Words - 1 - j;
+      if (a[i] != b[i])
+        return a[i] < b[i];
+    }
+    return false;
+  }
+  
+  /**
+   * \brief Computes d = a << count
+   */
+  static BITVECTOR_CONSTEXPR void shiftLeft(word_t *d, const word_t *a,
+    size_t count)
+  {
+    size_t w = count / BITS_PER_WORD;
+    unsigned b = count % BITS_PER_WORD;
+    
+    // From the top down, so that no word is overwritten before it is read
+    BITVECTOR_UNROLL
+    for (size_t j = 0; j < Words; j ++)
+    {
+      size_t i = Words - 1 - j;
+      word_t x = 0;
+      if (i >= w)
+      {
+        x = a[i - w] << b;
+        if (b != 0 && i > w)
+          x |= a[i - w - 1] >> (BITS_PER_WORD - b);
+      }
+      d[i] = x;
+    }
+  }
+  
+  /**
+   * \brief Computes d = a >> count
+   */
+  static BITVECTOR_CONSTEXPR void shiftRight(word_t *d, const word_t *a,
+    size_t count)
+  {
+    size_t w = count / BITS_PER_WORD;
+    unsigned b = count % BITS_PER_WORD;
+    
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < Words; i ++)
+    {
+      word_t x = 0;
+      if (i + w < Words)
+      {
+        x = a[i + w] >> b;
+        if (b != 0 && i + w + 1 < Words)
+          x |= a[i + w + 1] << (BITS_PER_WORD - b);
+      }
+      d[i] = x;
+    }
+  }
+};
+
+/**
+ * \brief A single word is computed as a word_t
+ */
+template<>
+struct FixedWordOps<1>
+{
+  static BITVECTOR_CONSTEXPR void add(word_t *d, const word_t *a,
+    const word_t *b)
+  {
+    d[0] = a[0] + b[0];
+  }
+  
+  static BITVECTOR_CONSTEXPR void subtract(word_t *d, const word_t *a,
+    const word_t *b)
+  {
+    d[0] = a[0] - b[0];
+  }
+  
+  static BITVECTOR_CONSTEXPR void multiply(word_t *d, const word_t *a,
+    const word_t *b)
+  {
+    d[0] = a[0] * b[0];
+  }
+  
+  static BITVECTOR_CONSTEXPR bool less(const word_t *a, const word_t *b)
+  {
+    return a[0] < b[0];
+  }
+  
+  static BITVECTOR_CONSTEXPR void shiftLeft(word_t *d, const word_t *a,
+    size_t count)
+  {
+    d[0] = a[0] << count;
+  }
+  
+  static BITVECTOR_CONSTEXPR void shiftRight(word_t *d, const word_t *a,
+    size_t count)
+  {
+    d[0] = a[0] >> count;
+  }
+};
+
+#ifdef BITVECTOR_HAS_INT128
+
+/**
+ * \brief Two words are computed as an unsigned __int128, for which the
+ * compiler emits adc, sbb, shld and three-multiply sequences itself
+ */
+template<>
+struct FixedWordOps<2>
+{
+  typedef unsigned __int128 dword_t;
+  
+  static constexpr dword_t load(const word_t *a)
+  {
+    return ((dword_t)a[1] << BITS_PER_WORD) | a[0];
+  }
+  
+  static BITVECTOR_CONSTEXPR void store(word_t *d, dword_t x)
+  {
+    d[0] = (word_t)x;
+    d[1] = (word_t)(x >> BITS_PER_WORD);
+  }
+  
+  static BITVECTOR_CONSTEXPR void add(word_t *d, const word_t *a,
+    const word_t *b)
+  {
+    store(d, load(a) + load(b));
+  }
+  
+  static BITVECTOR_CONSTEXPR void subtract(word_t *d, const word_t *a,
+    const word_t *b)
+  {
+    store(d, load(a) - load(b));
+  }
+  
+  static BITVECTOR_CONSTEXPR void multiply(word_t *d, const word_t *a,
+    const word_t *b)
+  {
+    store(d, load(a) * load(b));
+  }
+  
+  static BITVECTOR_CONSTEXPR bool less(const word_t *a, const word_t *b)
+  {
+    return load(a) < load(b);
+  }
+  
+  static BITVECTOR_CONSTEXPR void shiftLeft(word_t *d, const word_t *a,
+    size_t count)
+  {
+    store(d, load(a) << count);
+  }
+  
+  static BITVECTOR_CONSTEXPR void shiftRight(word_t *d, const word_t *a,
+    size_t count)
+  {
+    store(d, load(a) >> count);
+  }
+};
+
+#endif // BITVECTOR_HAS_INT128
+
+
+/**
+ * FixedBitVector
+ *
+ * \brief An integer of exactly Bits bits, held in-object
+ *
+ * The interface follows BitVector, with arithmetic modulo 2^Bits. Unlike
+ * BitVector, the unused bits of the most significant word are always clear;
+ * code writing through data() must keep them that way. sizeof is the size of
+ * the words, and the type is trivially copyable.
+ *
+ * Use toBitVector() and the BitVector constructor for operations that only
+ * BitVector provides, such as division and string conversion.
+ */
+template<size_t Bits>
+class FixedBitVector
+{
+  static_assert(Bits > 0, "FixedBitVector must have at least one bit");
+
+public:
+  /**
+   * \brief The number of words
+   */
+  static const size_t WORDS = BITS_TO_WORDS(Bits);
+  
+  /**
+   * \brief Creates a FixedBitVector with every bit clear
+   */
+  constexpr FixedBitVector()
+    : words()
+  {
+  }
+  
+  /**
+   * \brief Creates a FixedBitVector holding x modulo 2^Bits
+   */
+  explicit BITVECTOR_CONSTEXPR FixedBitVector(word_t x)
+    : words()
+  {
+    words[0] = x;
+    normalize();
+  }
+  
+  /**
+   * \brief Copies a BitVector of width Bits
+   */
+  template<size_t N, typename A>
+  explicit FixedBitVector(const BitVector<N, A> &v)
+    : words()
+  {
+    assert(v.width() == Bits && "Operands must have equal widths");
+    
+    memcpy(words, v.data(), WORDS_TO_BYTES(WORDS));
+    normalize();
+  }
+
+#ifdef BITVECTOR_HAS_INT128
+  /**
+   * \returns a FixedBitVector holding x modulo 2^Bits
+   */
+  static BITVECTOR_CONSTEXPR FixedBitVector fromUint128(unsigned __int128 x)
+  {
+    FixedBitVector result;
+    result.words[0] = (word_t)x;
+    if (WORDS > 1)
+      result.words[WORDS > 1 ? 1 : 0] = (word_t)(x >> BITS_PER_WORD);
+    result.normalize();
+    return result;
+  }
+  
+  /**
+   * \returns the low 128 bits
+   */
+  BITVECTOR_CONSTEXPR unsigned __int128 toUint128() const
+  {
+    unsigned __int128 x = words[0];
+    if (WORDS > 1)
+      x |= (unsigned __int128)words[WORDS > 1 ? 1 : 0] << BITS_PER_WORD;
+    return x;
+  }
+#endif
+  
+  /**
+   * \returns the low 64 bits
+   */
+  BITVECTOR_CONSTEXPR word_t toWord() const
+  {
+    return words[0];
+  }
+  
+  /**
+   * \returns a BitVector of width Bits with the same value
+   */
+  BitVector<Bits> toBitVector() const
+  {
+    BitVector<Bits> v(Bits, false);
+    memcpy(v.data(), words, WORDS_TO_BYTES(WORDS));
+    return v;
+  }
+  
+  /**
+   * \returns the number of bits
+   */
+  static constexpr size_t width()
+  {
+    return Bits;
+  }
+  
+  /**
+   * \returns the number of words
+   */
+  static constexpr size_t wordCount()
+  {
+    return WORDS;
+  }
+  
+  /**
+   * \returns the words, least significant first
+   */
+  BITVECTOR_CONSTEXPR word_t *data()
+  {
+    return words;
+  }
+  
+  BITVECTOR_CONSTEXPR const word_t *data() const
+  {
+    return words;
+  }
+  
+  /**
+   * \param index - the index of the bit
+   * \returns true if the bit is 1, false otherwise
+   */
+  BITVECTOR_CONSTEXPR bool getBit(size_t index) const
+  {
+    return (words[WORD_INDEX_FOR_BIT_IN_ARRAY(index)] &
+      MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index))) != 0;
+  }
+  
+  /**
+   * \param index - the index of the bit
+   * \param x - true if the bit should be set to 1, false otherwise
+   */
+  BITVECTOR_CONSTEXPR void setBit(size_t index, bool x)
+  {
+    word_t mask = MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index));
+    if (x)
+      words[WORD_INDEX_FOR_BIT_IN_ARRAY(index)] |= mask;
+    else
+      words[WORD_INDEX_FOR_BIT_IN_ARRAY(index)] &= ~mask;
+  }
+  
+  /**
+   * \param index - the index of the bit
+   */
+  BITVECTOR_CONSTEXPR void flipBit(size_t index)
+  {
+    words[WORD_INDEX_FOR_BIT_IN_ARRAY(index)] ^=
+      MASK_WITH_BIT(BIT_POSITION_FOR_BIT_IN_WORD(index));
+  }
+  
+  /**
+   * \returns the truth value of the specified bit
+   */
+  BITVECTOR_CONSTEXPR bool operator[](size_t index) const
+  {
+    return getBit(index);
+  }
+  
+  /**
+   * \returns the index of the lowest set bit, or width() if there is none
+   */
+  BITVECTOR_CONSTEXPR size_t findFirstSet() const
+  {
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < WORDS; i ++)
+      if (words[i] != 0)
+        return i * BITS_PER_WORD + countTrailingZeros(words[i]);
+    return Bits;
+  }
+  
+  /**
+   * \returns the index of the highest set bit, or width() if there is none
+   */
+  BITVECTOR_CONSTEXPR size_t findLastSet() const
+  {
+    size_t length = bitLength();
+    return length ? length - 1 : Bits;
+  }
+  
+  /**
+   * \returns the number of bits needed to represent the value, i.e. one more
+   *   than the index of the highest set bit, or 0 if the value is zero
+   */
+  BITVECTOR_CONSTEXPR size_t bitLength() const
+  {
+    BITVECTOR_UNROLL
+    for (size_t j = 0; j < WORDS; j ++)
+    {
+      size_t i = WORDS - 1 - j;
+      if (words[i] != 0)
+        return (i + 1) * BITS_PER_WORD - countLeadingZeros(words[i]);
+    }
+    return 0;
+  }
+  
+  /**
+   * \returns the number of set bits
+   */
+  BITVECTOR_CONSTEXPR size_t popcount() const
+  {
+    size_t count = 0;
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < WORDS; i ++)
+      count += countOnes(words[i]);
+    return count;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator|=(const FixedBitVector &rhs)
+  {
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < WORDS; i ++)
+      words[i] |= rhs.words[i];
+    return *this;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator&=(const FixedBitVector &rhs)
+  {
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < WORDS; i ++)
+      words[i] &= rhs.words[i];
+    return *this;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator^=(const FixedBitVector &rhs)
+  {
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < WORDS; i ++)
+      words[i] ^= rhs.words[i];
+    return *this;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator|(const FixedBitVector &rhs)
+    const
+  {
+    FixedBitVector result(*this);
+    result |= rhs;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator&(const FixedBitVector &rhs)
+    const
+  {
+    FixedBitVector result(*this);
+    result &= rhs;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator^(const FixedBitVector &rhs)
+    const
+  {
+    FixedBitVector result(*this);
+    result ^= rhs;
+    return result;
+  }
+  
+  /**
+   * \brief Computes the one's complement in-object
+   * \returns a reference to the same FixedBitVector
+   */
+  BITVECTOR_CONSTEXPR FixedBitVector &complement()
+  {
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < WORDS; i ++)
+      words[i] = ~words[i];
+    return normalize();
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator~() const
+  {
+    FixedBitVector result(*this);
+    return result.complement();
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator<<=(size_t count)
+  {
+    if (count >= Bits)
+      return *this = FixedBitVector();
+    FixedWordOps<WORDS>::shiftLeft(words, words, count);
+    return normalize();
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator>>=(size_t count)
+  {
+    if (count >= Bits)
+      return *this = FixedBitVector();
+    FixedWordOps<WORDS>::shiftRight(words, words, count);
+    return *this;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator<<(size_t count) const
+  {
+    FixedBitVector result(*this);
+    result <<= count;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator>>(size_t count) const
+  {
+    FixedBitVector result(*this);
+    result >>= count;
+    return result;
+  }
+  
+  /**
+   * \brief Rotates left by count bits, in place
+   */
+  BITVECTOR_CONSTEXPR FixedBitVector &rotateLeft(size_t count)
+  {
+    if ((count %= Bits) == 0)
+      return *this;
+    FixedBitVector wrapped = *this >> (Bits - count);
+    *this <<= count;
+    return *this |= wrapped;
+  }
+  
+  /**
+   * \brief Rotates right by count bits, in place
+   */
+  BITVECTOR_CONSTEXPR FixedBitVector &rotateRight(size_t count)
+  {
+    count %= Bits;
+    return rotateLeft(count ? Bits - count : 0);
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector rotl(size_t count) const
+  {
+    FixedBitVector result(*this);
+    return result.rotateLeft(count);
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector rotr(size_t count) const
+  {
+    FixedBitVector result(*this);
+    return result.rotateRight(count);
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator+=(const FixedBitVector &rhs)
+  {
+    FixedWordOps<WORDS>::add(words, words, rhs.words);
+    return normalize();
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator+=(word_t rhs)
+  {
+    return *this += FixedBitVector(rhs);
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator-=(const FixedBitVector &rhs)
+  {
+    FixedWordOps<WORDS>::subtract(words, words, rhs.words);
+    return normalize();
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator-=(word_t rhs)
+  {
+    return *this -= FixedBitVector(rhs);
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator*=(const FixedBitVector &rhs)
+  {
+    FixedWordOps<WORDS>::multiply(words, words, rhs.words);
+    return normalize();
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator*=(word_t rhs)
+  {
+    return *this *= FixedBitVector(rhs);
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator+(const FixedBitVector &rhs)
+    const
+  {
+    FixedBitVector result(*this);
+    result += rhs;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator+(word_t rhs) const
+  {
+    FixedBitVector result(*this);
+    result += rhs;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator-(const FixedBitVector &rhs)
+    const
+  {
+    FixedBitVector result(*this);
+    result -= rhs;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator-(word_t rhs) const
+  {
+    FixedBitVector result(*this);
+    result -= rhs;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator*(const FixedBitVector &rhs)
+    const
+  {
+    FixedBitVector result(*this);
+    result *= rhs;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator*(word_t rhs) const
+  {
+    FixedBitVector result(*this);
+    result *= rhs;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator++()
+  {
+    return *this += (word_t)1;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator++(int)
+  {
+    FixedBitVector result(*this);
+    ++ *this;
+    return result;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector &operator--()
+  {
+    return *this -= (word_t)1;
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator--(int)
+  {
+    FixedBitVector result(*this);
+    -- *this;
+    return result;
+  }
+  
+  /**
+   * \brief Computes the two's complement in-object
+   * \returns a reference to the same FixedBitVector
+   */
+  BITVECTOR_CONSTEXPR FixedBitVector &negate()
+  {
+    return ++ complement();
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator-() const
+  {
+    FixedBitVector result(*this);
+    return result.negate();
+  }
+  
+  BITVECTOR_CONSTEXPR FixedBitVector operator+() const
+  {
+    return *this;
+  }
+  
+  BITVECTOR_CONSTEXPR bool operator==(const FixedBitVector &rhs) const
+  {
+    BITVECTOR_UNROLL
+    for (size_t i = 0; i < WORDS; i ++)
+      if (words[i] != rhs.words[i])
+        return false;
+    return true;
+  }
+  
+  BITVECTOR_CONSTEXPR bool operator!=(const FixedBitVector &rhs) const
+  {
+    return !(*this == rhs);
+  }
+  
+  BITVECTOR_CONSTEXPR bool operator<(const FixedBitVector &rhs) const
+  {
+    return FixedWordOps<WORDS>::less(words, rhs.words);
+  }
+  
+  BITVECTOR_CONSTEXPR bool operator<=(const FixedBitVector &rhs) const
+  {
+    return !(rhs < *this);
+  }
+  
+  BITVECTOR_CONSTEXPR bool operator>(const FixedBitVector &rhs) const
+  {
+    return rhs < *this;
+  }
+  
+  BITVECTOR_CONSTEXPR bool operator>=(const FixedBitVector &rhs) const
+  {
+    return !(*this < rhs);
+  }
+
+protected:
+  /**
+   * \brief Clears the unused bits of the most significant word
+   */
+  BITVECTOR_CONSTEXPR FixedBitVector &normalize()
+  {
+    words[WORDS - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(Bits);
+    return *this;
+  }
+  
+  /**
+   * \brief The words, least significant first
+   */
+  word_t words[WORDS];
+};
+
+template<size_t Bits>
+const size_t FixedBitVector<Bits>::WORDS;
+
+#endif // FIXEDBITVECTOR_HPP
@@ -0,0 +1,664 @@
+/**
+ * \file
+ * \brief Implements MontgomeryContext, for multiplication and exponentiation
+ * modulo an odd number, and the modPow() function.
+ *
+ * Montgomery's method keeps each residue x as x * R mod m, where R = B^k for
+ * a k-word modulus m. The product of two such residues is then reduced by
+ * adding a multiple of m that clears the low word, k times, and dropping
+ * those words, which takes no division. Multiplication adds each row of the
+ * product and the multiple of m that clears its low word in the same pass
+ * (finely integrated operand scanning, FIOS). Squaring computes each cross
+ * product once and doubles them, then reduces, for about 1.5 k^2 word
+ * products instead of 2 k^2.
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef MONTGOMERY_HPP
+#define MONTGOMERY_HPP
+
+#include "BitVector.hpp"
+
+
+/**
+ * \def MONTGOMERY_CONSTANT_TIME_WINDOW
+ * \brief Number of exponent bits consumed per multiplication by
+ * MontgomeryContext::modPowConstantTime()
+ */
+#ifndef MONTGOMERY_CONSTANT_TIME_WINDOW
+#define MONTGOMERY_CONSTANT_TIME_WINDOW 5
+#endif
+
+/**
+ * \returns the sliding window width that minimizes the multiplications of an
+ * exponentiation by an exponent of the given bit length
+ */
+inline unsigned slidingWindowBits(size_t exponentBits)
+{
+  return exponentBits > 671 ? 6 : exponentBits > 239 ? 5 :
+    exponentBits > 79 ? 4 : exponentBits > 23 ? 3 : 1;
+}
+
+/**
+ * \returns -1 / x mod B, for odd x
+ */
+inline word_t negativeInverseWord(word_t x)
+{
+  // x * x = 1 mod 8, and each Newton step doubles the correct bits
+  word_t inverse = x;
+  for (int i = 0; i < 5; i ++)
+    inverse *= 2 - x * inverse;
+  return (word_t)0 - inverse;
+}
+
+/**
+ * \brief Computes the double-width x * y + c + d, which always fits
+ *
+ * \param hi - receives the high word
+ * \returns the low word
+ */
+inline word_t mulAddAdd(word_t x, word_t y, word_t c, word_t d, word_t *hi)
+{
+  word_t lo = mulWide(x, y, hi);
+  lo += c;
+  *hi += lo < c;
+  lo += d;
+  *hi += lo < d;
+  return lo;
+}
+
+/**
+ * \brief Computes t = a * b / B^k mod m, up to one multiple of m
+ *
+ * Each row adds a * b[i] and the multiple u * m of the modulus that clears
+ * the low word, in one pass with two independent carry chains, and drops
+ * the low word (finely integrated operand scanning). a and b must be below
+ * m.
+ *
+ * \param t - receives k + 1 words, below 2m
+ * \param inverse - -1 / m mod B
+ */
+inline void montgomeryMultiplyWords(word_t *t, const word_t *a,
+  const word_t *b, const word_t *m, size_t k, word_t inverse)
+{
+  memset(t, 0, WORDS_TO_BYTES(k + 1));
+  for (size_t i = 0; i < k; i ++)
+  {
+    word_t carryA, carryB;
+    word_t lo = mulAddAdd(a[0], b[i], 0, t[0], &carryA);
+    word_t u = lo * inverse;
+    mulAddAdd(u, m[0], lo, 0, &carryB);
+    for (size_t j = 1; j < k; j ++)
+    {
+      lo = mulAddAdd(a[j], b[i], carryA, t[j], &carryA);
+      t[j - 1] = mulAddAdd(u, m[j], carryB, lo, &carryB);
+    }
+    
+    // t stays below 2m, so the top word is 0 or 1
+    unsigned char c = addWithCarry(t[k], carryA, 0, &t[k - 1]);
+    c += addWithCarry(t[k - 1], carryB, 0, &t[k - 1]);
+    t[k] = c;
+  }
+}
+
+/**
+ * \brief Computes the 2k-word square t = a * a
+ *
+ * Each cross product a[i] * a[j], i < j, is computed once and their sum
+ * doubled. Two rows of cross products are added per pass, so that their
+ * carry chains overlap.
+ */
+inline void squareWords(word_t *t, const word_t *a, size_t k)
+{
+  memset(t, 0, WORDS_TO_BYTES(2 * k));
+  size_t i = 0;
+  for (; i + 2 < k; i += 2)
+  {
+    // Row i + 1 starts two words to the left of row i
+    word_t x = a[i], y = a[i + 1], carryA, carryB = 0;
+    t[2 * i + 1] = mulAddAdd(a[i + 1], x, 0, t[2 * i + 1], &carryA);
+    t[2 * i + 2] = mulAddAdd(a[i + 2], x, carryA, t[2 * i + 2], &carryA);
+    for (size_t j = i + 3; j < k; j ++)
+    {
+      word_t lo = mulAddAdd(a[j], x, carryA, t[i + j], &carryA);
+      t[i + j] = mulAddAdd(a[j - 1], y, carryB, lo, &carryB);
+    }
+    t[i + k] = mulAddAdd(a[k - 1], y, carryB, carryA, &carryB);
+    t[i + k + 1] = carryB;
+  }
+  if (i + 1 < k)
+    t[i + k] = addMulWord(t + 2 * i + 1, a + i + 1, k - i - 1, a[i]);
+  
+  // Doubled, plus the squares of the words on the diagonal
+  shiftLeftWords(t, t, 2 * k, 1);
+  unsigned char carry = 0;
+  for (i = 0; i < k; i ++)
+  {
+    word_t hi;
+    word_t lo = mulWide(a[i], a[i], &hi);
+    carry = addWithCarry(t[2 * i], lo, carry, &t[2 * i]);
+    carry = addWithCarry(t[2 * i + 1], hi, carry, &t[2 * i + 1]);
+  }
+}
+
+/**
+ * \brief Computes t / B^k mod m, up to one multiple of m, for t below
+ * m * B^k (Montgomery reduction)
+ *
+ * A multiple of m that clears each low word is added in turn. Two words are
+ * cleared per pass, so that the carry chains of their multiples overlap.
+ *
+ * \param t - 2k words, which receive the result in the high k words
+ * \param inverse - -1 / m mod B
+ * \returns the word above the result, 0 or 1
+ */
+inline word_t montgomeryReduceWords(word_t *t, const word_t *m, size_t k,
+  word_t inverse)
+{
+  unsigned char over = 0;
+  size_t i = 0;
+  for (; i + 1 < k; i += 2)
+  {
+    // u1 clears word i + 1 once u0 * m has cleared word i
+    word_t carryA, carryB;
+    word_t u0 = t[i] * inverse;
+    mulAddAdd(u0, m[0], t[i], 0, &carryA);
+    word_t lo = mulAddAdd(u0, m[1], carryA, t[i + 1], &carryA);
+    word_t u1 = lo * inverse;
+    mulAddAdd(u1, m[0], lo, 0, &carryB);
+    for (size_t j = 2; j < k; j ++)
+    {
+      lo = mulAddAdd(u0, m[j], carryA, t[i + j], &carryA);
+      t[i + j] = mulAddAdd(u1, m[j - 1], carryB, lo, &carryB);
+    }
+    lo = mulAddAdd(u1, m[k - 1], carryB, carryA, &carryB);
+    over = addWithCarry(t[i + k], lo, over, &t[i + k]);
+    over = addWithCarry(t[i + k + 1], carryB, over, &t[i + k + 1]);
+  }
+  if (i < k)
+  {
+    word_t carry = addMulWord(t + i, m, k, t[i] * inverse);
+    over = addWithCarry(t[i + k], carry, over, &t[i + k]);
+  }
+  return over;
+}
+
+
+/**
+ * MontgomeryContext
+ *
+ * \brief An odd modulus prepared for repeated multiplication and
+ * exponentiation
+ *
+ * The context holds R mod m, R^2 mod m and -1 / m mod B. Values passed to
+ * multiply() and square() are in Montgomery form, from toMontgomery(); keep
+ * intermediate results in that form and convert back once with
+ * fromMontgomery(). modPow() takes and returns ordinary values.
+ *
+ * The word-level functions take k = wordCount() words per operand, fully
+ * reduced below m, and a scratch buffer of scratchSize() words. Results may
+ * be written over the operands.
+ *
+ * The cost is quadratic in k, which suits moduli of a few thousand bits;
+ * for much larger moduli, BarrettReducer with subquadratic multiplication
+ * wins.
+ */
+class MontgomeryContext
+{
+public:
+  /**
+   * \param m - the modulus, n words, which must be odd
+   */
+  MontgomeryContext(const word_t *m, size_t n)
+    : reducer(m, n)
+  {
+    init(m, n, WORDS_TO_BITS(n));
+  }
+  
+  /**
+   * \param m - the modulus, which must be odd
+   */
+  template<size_t N, typename A>
+  explicit MontgomeryContext(const BitVector<N, A> &m)
+    : reducer(m)
+  {
+    std::vector<word_t> words(m.data(), m.data() + m.wordCount());
+    if (!words.empty())
+      words.back() &= MASK_FOR_MOST_SIGNIFICANT_WORD(m.width());
+    init(words.data(), words.size(), m.width());
+  }
+  
+  /**
+   * \returns the number of significant words of the modulus
+   */
+  size_t wordCount() const
+  {
+    return modulus.size();
+  }
+  
+  /**
+   * \returns the number of words of scratch space the word-level functions
+   *   need
+   */
+  size_t scratchSize() const
+  {
+    return 2 * wordCount() + 1;
+  }
+  
+  /**
+   * \brief Computes dst = a * b / R mod m, by FIOS
+   *
+   * With both operands in Montgomery form, the result is the Montgomery form
+   * of their product.
+   */
+  void multiply(word_t *dst, const word_t *a, const word_t *b,
+    word_t *scratch) const
+  {
+    multiply(dst, a, b, scratch, false);
+  }
+  
+  /**
+   * \brief Computes dst = a * a / R mod m, computing each cross product once
+   */
+  void square(word_t *dst, const word_t *a, word_t *scratch) const
+  {
+    square(dst, a, scratch, false);
+  }
+  
+  /**
+   * \brief Computes dst = x * R mod m, where x is below m
+   */
+  void toMontgomery(word_t *dst, const word_t *x, word_t *scratch) const
+  {
+    multiply(dst, x, rSquared.data(), scratch);
+  }
+  
+  /**
+   * \brief Computes dst = x / R mod m
+   */
+  void fromMontgomery(word_t *dst, const word_t *x, word_t *scratch) const
+  {
+    size_t k = wordCount();
+    word_t *t = scratch;
+    memcpy(t, x, WORDS_TO_BYTES(k));
+    memset(t + k, 0, WORDS_TO_BYTES(k));
+    reduce(dst, t, false);
+  }
+  
+  /**
+   * \returns the Montgomery form of x mod m, with the width of the modulus
+   */
+  template<size_t N, typename A>
+  BitVector<N, A> toMontgomery(const BitVector<N, A> &x) const
+  {
+    std::vector<word_t> w(wordCount()), scratch(scratchSize());
+    load(w.data(), x);
+    toMontgomery(w.data(), w.data(), scratch.data());
+    return store<N, A>(w.data());
+  }
+  
+  /**
+   * \returns the value of x in Montgomery form, with the width of the
+   *   modulus
+   */
+  template<size_t N, typename A>
+  BitVector<N, A> fromMontgomery(const BitVector<N, A> &x) const
+  {
+    std::vector<word_t> w(wordCount()), scratch(scratchSize());
+    load(w.data(), x);
+    fromMontgomery(w.data(), w.data(), scratch.data());
+    return store<N, A>(w.data());
+  }
+  
+  /**
+   * \returns a * b / R mod m, the Montgomery form of the product of two
+   *   values in Montgomery form
+   */
+  template<size_t N, typename A>
+  BitVector<N, A> multiply(const BitVector<N, A> &a,
+    const BitVector<N, A> &b) const
+  {
+    std::vector<word_t> x(wordCount()), y(wordCount());
+    std::vector<word_t> scratch(scratchSize());
+    load(x.data(), a);
+    load(y.data(), b);
+    multiply(x.data(), x.data(), y.data(), scratch.data());
+    return store<N, A>(x.data());
+  }
+  
+  /**
+   * \returns a * a / R mod m
+   */
+  template<size_t N, typename A>
+  BitVector<N, A> square(const BitVector<N, A> &a) const
+  {
+    std::vector<word_t> x(wordCount()), scratch(scratchSize());
+    load(x.data(), a);
+    square(x.data(), x.data(), scratch.data());
+    return store<N, A>(x.data());
+  }
+  
+  /**
+   * \returns base^exponent mod m, with the width of the modulus
+   *
+   * The exponent is scanned from the top in windows of up to
+   * slidingWindowBits() bits that start and end with a 1, so only the odd
+   * powers of the base are precomputed and runs of zeros cost squarings
+   * alone. Timing depends on the exponent; see modPowConstantTime().
+   */
+  template<size_t N, typename A, size_t NE, typename AE>
+  BitVector<N, A> modPow(const BitVector<N, A> &base,
+    const BitVector<NE, AE> &exponent) const
+  {
+    size_t k = wordCount();
+    size_t bits = exponent.bitLength();
+    unsigned window = slidingWindowBits(bits);
+    std::vector<word_t> scratch(scratchSize()), acc(one);
+    
+    // The odd powers g, g^3, ..., g^(2^window - 1)
+    std::vector<word_t> table(k << (window - 1)), g2(k);
+    load(table.data(), base);
+    toMontgomery(table.data(), table.data(), scratch.data());
+    square(g2.data(), table.data(), scratch.data());
+    for (size_t i = 1; i < ((size_t)1 << (window - 1)); i ++)
+      multiply(&table[i * k], &table[(i - 1) * k], g2.data(), scratch.data());
+    
+    bool first = true;
+    for (size_t i = bits; i > 0; )
+    {
+      if (!exponent.getBit(i - 1))
+      {
+        square(acc.data(), acc.data(), scratch.data());
+        i --;
+        continue;
+      }
+      
+      // The window is bits [j, i), ending at its lowest set bit
+      size_t j = (i > window) ? i - window : 0;
+      while (!exponent.getBit(j))
+        j ++;
+      size_t value = 0;
+      for (size_t b = i; b > j; b --)
+        value = (value << 1) | exponent.getBit(b - 1);
+      
+      const word_t *power = &table[(value >> 1) * k];
+      if (first)
+      {
+        memcpy(acc.data(), power, WORDS_TO_BYTES(k));
+        first = false;
+      }
+      else
+      {
+        for (size_t s = j; s < i; s ++)
+          square(acc.data(), acc.data(), scratch.data());
+        multiply(acc.data(), acc.data(), power, scratch.data());
+      }
+      i = j;
+    }
+    
+    fromMontgomery(acc.data(), acc.data(), scratch.data());
+    return store<N, A>(acc.data());
+  }
+  
+  /**
+   * \returns base^exponent mod m, with the width of the modulus
+   *
+   * Unlike modPow(), the sequence of operations and memory accesses depends
+   * only on the widths of the operands, not on the value of the exponent:
+   * every window of MONTGOMERY_CONSTANT_TIME_WINDOW bits costs the same
+   * squarings and one multiplication, table entries are selected by reading
+   * all of them under a mask, and the final subtraction of each reduction
+   * is always made. The compiler may still introduce branches, so check the
+   * generated code where this matters.
+   */
+  template<size_t N, typename A, size_t NE, typename AE>
+  BitVector<N, A> modPowConstantTime(const BitVector<N, A> &base,
+    const BitVector<NE, AE> &exponent) const
+  {
+    const unsigned window = MONTGOMERY_CONSTANT_TIME_WINDOW;
+    const size_t entries = (size_t)1 << window;
+    size_t k = wordCount();
+    std::vector<word_t> scratch(scratchSize()), acc(k), power(k);
+    
+    // All powers g^0, ..., g^(2^window - 1)
+    std::vector<word_t> table(k * entries);
+    memcpy(table.data(), one.data(), WORDS_TO_BYTES(k));
+    load(&table[k], base);
+    toMontgomery(&table[k], &table[k], scratch.data());
+    for (size_t i = 2; i < entries; i ++)
+      multiply(&table[i * k], &table[(i - 1) * k], &table[k],
+        scratch.data(), true);
+    
+    std::vector<word_t> e(exponent.data(),
+      exponent.data() + exponent.wordCount());
+    if (!e.empty())
+      e.back() &= MASK_FOR_MOST_SIGNIFICANT_WORD(exponent.width());
+    
+    size_t digits = CEILDIV(exponent.width(), window);
+    memcpy(acc.data(), one.data(), WORDS_TO_BYTES(k));
+    for (size_t d = digits; d > 0; d --)
+    {
+      for (unsigned s = 0; s < window; s ++)
+        square(acc.data(), acc.data(), scratch.data(), true);
+      
+      // Bits beyond the exponent's words read as zero
+      size_t pos = (d - 1) * window;
+      word_t digit = extractWord(e.data(), WORDS_TO_BITS(e.size()), pos) &
+        MASK_WITH_LOWER_BITS(window);
+      memset(power.data(), 0, WORDS_TO_BYTES(k));
+      for (size_t i = 0; i < entries; i ++)
+      {
+        word_t mask = (word_t)0 - (word_t)(i == digit);
+        for (size_t w = 0; w < k; w ++)
+          power[w] |= table[i * k + w] & mask;
+      }
+      multiply(acc.data(), acc.data(), power.data(), scratch.data(), true);
+    }
+    
+    fromMontgomery(acc.data(), acc.data(), scratch.data());
+    return store<N, A>(acc.data());
+  }
+
+protected:
+  void init(const word_t *m, size_t n, size_t width)
+  {
+    while (n > 0 && m[n - 1] == 0)
+      -- n;
+    assert(n > 0 && (m[0] & 1) && "The modulus must be odd");
+    
+    length = width;
+    modulus.assign(m, m + n);
+    inverse = negativeInverseWord(m[0]);
+    
+    // R mod m and R^2 mod m, dividing B^k and B^(2k)
+    std::vector<word_t> power(2 * n + 1, 0);
+    power[n] = 1;
+    one.resize(n);
+    reducer.divide(NULL, one.data(), power.data(), n + 1);
+    power[n] = 0;
+    power[2 * n] = 1;
+    rSquared.resize(n);
+    reducer.divide(NULL, rSquared.data(), power.data(), 2 * n + 1);
+  }
+  
+  /**
+   * \brief FIOS multiplication, with an unconditional final subtraction if
+   * constantTime is set
+   */
+  void multiply(word_t *dst, const word_t *a, const word_t *b,
+    word_t *scratch, bool constantTime) const
+  {
+    size_t k = wordCount();
+    montgomeryMultiplyWords(scratch, a, b, modulus.data(), k, inverse);
+    subtractModulus(dst, scratch, scratch[k], scratch + k + 1, constantTime);
+  }
+  
+  /**
+   * \brief Squaring followed by a separate reduction
+   */
+  void square(word_t *dst, const word_t *a, word_t *scratch,
+    bool constantTime) const
+  {
+    squareWords(scratch, a, wordCount());
+    reduce(dst, scratch, constantTime);
+  }
+  
+  /**
+   * \brief Computes dst = t / R mod m for t below m * R
+   *
+   * \param t - 2k words, which are overwritten
+   */
+  void reduce(word_t *dst, word_t *t, bool constantTime) const
+  {
+    size_t k = wordCount();
+    word_t top = montgomeryReduceWords(t, modulus.data(), k, inverse);
+    
+    // The low k words are free for the final subtraction
+    subtractModulus(dst, t + k, top, t, constantTime);
+  }
+  
+  /**
+   * \brief Computes dst = t mod m for t below 2m, given as k words and a
+   * top word of 0 or 1
+   *
+   * \param spare - k words of scratch space, used if constantTime is set
+   */
+  void subtractModulus(word_t *dst, const word_t *t, word_t top,
+    word_t *spare, bool constantTime) const
+  {
+    size_t k = wordCount();
+    if (!constantTime)
+    {
+      if (top != 0 || compareWords(t, modulus.data(), k) >= 0)
+        subtractWords(dst, t, modulus.data(), k);
+      else if (dst != t)
+        memcpy(dst, t, WORDS_TO_BYTES(k));
+      return;
+    }
+    
+    // The difference is kept unless it borrowed more than the top word
+    word_t borrow = subtractWords(spare, t, modulus.data(), k);
+    word_t mask = (word_t)0 - (1 ^ top ^ borrow);
+    for (size_t i = 0; i < k; i ++)
+      dst[i] = (spare[i] & mask) | (t[i] & ~mask);
+  }
+  
+  /**
+   * \brief Copies x mod m to k words
+   */
+  template<size_t N, typename A>
+  void load(word_t *dst, const BitVector<N, A> &x) const
+  {
+    std::vector<word_t> words(x.data(), x.data() + x.wordCount());
+    if (!words.empty())
+      words.back() &= MASK_FOR_MOST_SIGNIFICANT_WORD(x.width());
+    reducer.divide(NULL, dst, words.data(), words.size());
+  }
+  
+  /**
+   * \returns a BitVector with the width of the modulus holding k words
+   */
+  template<size_t N, typename A>
+  BitVector<N, A> store(const word_t *x) const
+  {
+    BitVector<N, A> v(length);
+    memcpy(v.data(), x, WORDS_TO_BYTES(wordCount()));
+    return v;
+  }
+  
+  /**
+   * \brief The width of the BitVector the modulus came from
+   */
+  size_t length;
+  
+  /**
+   * \brief The significant words of the modulus
+   */
+  std::vector<word_t> modulus;
+  
+  /**
+   * \brief -1 / m mod B
+   */
+  word_t inverse;
+  
+  /**
+   * \brief R mod m, the Montgomery form of 1
+   */
+  std::vector<word_t> one;
+  
+  /**
+   * \brief R^2 mod m, which toMontgomery() multiplies by
+   */
+  std::vector<word_t> rSquared;
+  
+  /**
+   * \brief The modulus prepared for reducing the operands
+   */
+  BarrettReducer reducer;
+};
+
+
+/**
+ * \returns base^exponent mod modulus, with the width of the modulus
+ *
+ * Odd moduli use MontgomeryContext::modPow(); prepare a MontgomeryContext to
+ * reuse its precomputation. Even moduli fall back to squaring and
+ * multiplying with BarrettReducer.
+ */
+template<size_t N, typename A, size_t NE, typename AE, size_t NM,
+  typename AM>
+BitVector<N, A> modPow(const BitVector<N, A> &base,
+  const BitVector<NE, AE> &exponent, const BitVector<NM, AM> &modulus)
+{
+  if (modulus.getBit(0))
+    return MontgomeryContext(modulus).modPow(base, exponent);
+  
+  BarrettReducer reducer(modulus);
+  size_t k = reducer.wordCount();
+  std::vector<word_t> acc(k, 0), g(k), product(2 * k);
+  std::vector<word_t> scratch(multiplyScratchSize(k));
+  
+  std::vector<word_t> words(base.data(), base.data() + base.wordCount());
+  if (!words.empty())
+    words.back() &= MASK_FOR_MOST_SIGNIFICANT_WORD(base.width());
+  reducer.divide(NULL, g.data(), words.data(), words.size());
+  
+  acc[0] = 1;
+  reducer.divide(NULL, acc.data(), acc.data(), k);
+  for (size_t i = exponent.bitLength(); i > 0; i --)
+  {
+    multiplyWords(product.data(), acc.data(), acc.data(), k, scratch.data());
+    reducer.divide(NULL, acc.data(), product.data(), 2 * k);
+    if (exponent.getBit(i - 1))
+    {
+      multiplyWords(product.data(), acc.data(), g.data(), k, scratch.data());
+      reducer.divide(NULL, acc.data(), product.data(), 2 * k);
+    }
+  }
+  
+  BitVector<N, A> result(modulus.width());
+  memcpy(result.data(), acc.data(), WORDS_TO_BYTES(k));
+  return result;
+}
+
+#endif // MONTGOMERY_HPP
@@ -0,0 +1,464 @@
+/**
+ * \file
+ * \brief Implements multi-threaded versions of the bulk operations on
+ * BitVectors, for vectors large enough that one core can't saturate the
+ * memory bandwidth.
+ *
+ * The words are split into chunks that fit in the cache of one core and
+ * handed out to the threads of a ThreadPool. Below a size threshold the
+ * functions do the same work as the BitVector operators on the calling
+ * thread.
+ *
+ * Addition splits the carry chain with carry-select: each chunk is added
+ * with no incoming carry while recording whether it produces a carry and
+ * whether it would pass an incoming one on. A serial pass over the chunks
+ * resolves the actual carries, and a second parallel pass adds them in, which
+ * usually only touches one word per chunk.
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include "BitVector.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+/**
+ * \def BITVECTOR_PARALLEL_THRESHOLD
+ * \brief Default word count from which the parallel functions use more than
+ * one thread
+ */
+#ifndef BITVECTOR_PARALLEL_THRESHOLD
+#define BITVECTOR_PARALLEL_THRESHOLD (1 << 17)
+#endif
+
+/**
+ * \def BITVECTOR_PARALLEL_CHUNK
+ * \brief Default number of words in the chunks handed to each thread
+ */
+#ifndef BITVECTOR_PARALLEL_CHUNK
+#define BITVECTOR_PARALLEL_CHUNK (1 << 14)
+#endif
+
+/**
+ * ParallelThresholds
+ *
+ * \brief Word counts that decide how the parallel functions split their work
+ *
+ * The defaults come from the BITVECTOR_PARALLEL_* macros. The fields must
+ * not change while a parallel function is running.
+ */
+struct ParallelThresholds
+{
+  /**
+   * \brief The word count below which the work stays on the calling thread
+   */
+  size_t serial;
+  
+  /**
+   * \brief The number of words in a chunk
+   */
+  size_t chunk;
+};
+
+/**
+ * \returns the thresholds used by the parallel functions
+ */
+inline ParallelThresholds &parallelThresholds()
+{
+  static ParallelThresholds thresholds = {
+    BITVECTOR_PARALLEL_THRESHOLD,
+    BITVECTOR_PARALLEL_CHUNK
+  };
+  return thresholds;
+}
+
+
+/**
+ * ThreadPool
+ *
+ * \brief A fixed set of threads that run the tasks of one job at a time
+ *
+ * The thread that submits a job works on it too, so a pool of n threads
+ * starts n - 1 of its own. Jobs submitted from several threads run one after
+ * another. A task must not submit a job to the pool it runs on, nor throw.
+ */
+class ThreadPool
+{
+public:
+  /**
+   * \param threads - the number of threads working on each job, including
+   *   the one submitting it; 0 for one per hardware thread
+   */
+  explicit ThreadPool(size_t threads = 0)
+    : job(NULL), tasks(0), next(0), active(0), generation(0), stopping(false)
+  {
+    if (threads == 0)
+      threads = std::thread::hardware_concurrency();
+    for (size_t i = 1; i < threads; i ++)
+      workers.push_back(std::thread(&ThreadPool::work, this));
+  }
+  
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i ++)
+      workers[i].join();
+  }
+  
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  
+  /**
+   * \returns the number of threads working on each job
+   */
+  size_t size() const
+  {
+    return workers.size() + 1;
+  }
+  
+  /**
+   * \brief Calls f(i) for each i < count, spread over the threads of the
+   * pool, and returns when all calls have returned
+   */
+  template<typename F>
+  void run(size_t count, F f)
+  {
+    if (count <= 1 || workers.empty())
+    {
+      for (size_t i = 0; i < count; i ++)
+        f(i);
+      return;
+    }
+    
+    std::lock_guard<std::mutex> submitting(submit);
+    std::function<void(size_t)> task(f);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &task;
+      tasks = count;
+      next = 0;
+      active = workers.size();
+      generation ++;
+    }
+    wake.notify_all();
+    
+    runTasks(task);
+    
+    // Every worker checks in, even if the tasks ran out before it woke up,
+    // so that none of them still refers to the job afterwards
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return active == 0; });
+    job = NULL;
+  }
+  
+  /**
+   * \returns a pool with one thread per hardware thread, started on first use
+   */
+  static ThreadPool &shared()
+  {
+    static ThreadPool pool;
+    return pool;
+  }
+
+protected:
+  /**
+   * \brief Claims and runs tasks of the current job until there are none left
+   */
+  void runTasks(const std::function<void(size_t)> &task)
+  {
+    for (size_t i = next ++; i < tasks; i = next ++)
+      task(i);
+  }
+  
+  /**
+   * \brief The loop of each worker thread
+   */
+  void work()
+  {
+    size_t seen = 0;
+    for (;;)
+    {
+      const std::function<void(size_t)> *task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping)
+          return;
+        seen = generation;
+        task = job;
+      }
+      
+      runTasks(*task);
+      
+      std::lock_guard<std::mutex> lock(mutex);
+      if (-- active == 0)
+        done.notify_one();
+    }
+  }
+  
+  std::vector<std::thread> workers;
+  
+  /**
+   * \brief Held by the thread submitting a job until it completes
+   */
+  std::mutex submit;
+  
+  /**
+   * \brief Guards the fields describing the current job
+   */
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  
+  /**
+   * \brief The current job, its number of tasks and the next unclaimed task
+   */
+  const std::function<void(size_t)> *job;
+  size_t tasks;
+  std::atomic<size_t> next;
+  
+  /**
+   * \brief The number of workers that haven't finished the current job
+   */
+  size_t active;
+  
+  /**
+   * \brief Counts the jobs, so that workers can tell a new one from the last
+   */
+  size_t generation;
+  
+  bool stopping;
+};
+
+
+/**
+ * \brief Splits n words into chunks and runs f(begin, end) for each chunk on
+ * the pool, or once for all words if n is below the serial threshold
+ *
+ * \returns the number of chunks
+ */
+template<typename F>
+size_t parallelForEachChunk(ThreadPool &pool, size_t n, F f)
+{
+  const ParallelThresholds &t = parallelThresholds();
+  if (n < t.serial || pool.size() == 1)
+  {
+    f(0, n);
+    return 1;
+  }
+  
+  size_t chunk = t.chunk;
+  size_t count = CEILDIV(n, chunk);
+  pool.run(count, [&](size_t i)
+  {
+    size_t begin = i * chunk;
+    f(begin, (begin + chunk < n) ? begin + chunk : n);
+  });
+  return count;
+}
+
+/**
+ * \brief Computes dst |= src using the threads of pool
+ */
+template<size_t N, typename A>
+BitVector<N, A> &parallelOr(BitVector<N, A> &dst, const BitVector<N, A> &src,
+  ThreadPool &pool = ThreadPool::shared())
+{
+  assert(dst.width() == src.width() && "Operands must have equal widths");
+  
+  word_t *d = dst.data();
+  const word_t *s = src.data();
+  parallelForEachChunk(pool, dst.wordCount(), [=](size_t begin, size_t end)
+  {
+    wordKernels().orWords(d + begin, s + begin, end - begin);
+  });
+  return dst;
+}
+
+/**
+ * \brief Computes dst &= src using the threads of pool
+ */
+template<size_t N, typename A>
+BitVector<N, A> &parallelAnd(BitVector<N, A> &dst, const BitVector<N, A> &src,
+  ThreadPool &pool = ThreadPool::shared())
+{
+  assert(dst.width() == src.width() && "Operands must have equal widths");
+  
+  word_t *d = dst.data();
+  const word_t *s = src.data();
+  parallelForEachChunk(pool, dst.wordCount(), [=](size_t begin, size_t end)
+  {
+    wordKernels().andWords(d + begin, s + begin, end - begin);
+  });
+  return dst;
+}
+
+/**
+ * \brief Computes dst ^= src using the threads of pool
+ */
+template<size_t N, typename A>
+BitVector<N, A> &parallelXor(BitVector<N, A> &dst, const BitVector<N, A> &src,
+  ThreadPool &pool = ThreadPool::shared())
+{
+  assert(dst.width() == src.width() && "Operands must have equal widths");
+  
+  word_t *d = dst.data();
+  const word_t *s = src.data();
+  parallelForEachChunk(pool, dst.wordCount(), [=](size_t begin, size_t end)
+  {
+    wordKernels().xorWords(d + begin, s + begin, end - begin);
+  });
+  return dst;
+}
+
+/**
+ * \brief Computes the one's complement of v in-object using the threads of
+ * pool
+ */
+template<size_t N, typename A>
+BitVector<N, A> &parallelComplement(BitVector<N, A> &v,
+  ThreadPool &pool = ThreadPool::shared())
+{
+  word_t *d = v.data();
+  parallelForEachChunk(pool, v.wordCount(), [=](size_t begin, size_t end)
+  {
+    wordKernels().notWords(d + begin, end - begin);
+  });
+  return v;
+}
+
+/**
+ * \returns the number of set bits of v, counted by the threads of pool
+ */
+template<size_t N, typename A>
+size_t parallelPopcount(const BitVector<N, A> &v,
+  ThreadPool &pool = ThreadPool::shared())
+{
+  // Count whole words, then add the used bits of the last one
+  size_t n = v.wordCount();
+  if (n == 0)
+    return 0;
+  
+  const word_t *w = v.data();
+  std::atomic<size_t> total(0);
+  parallelForEachChunk(pool, n - 1, [&](size_t begin, size_t end)
+  {
+    total += popcountWords(w + begin, end - begin);
+  });
+  return total + countOnes(w[n - 1] &
+    MASK_FOR_MOST_SIGNIFICANT_WORD(v.width()));
+}
+
+/**
+ * \returns true if a and b are equal, compared by the threads of pool
+ *
+ * Chunks that start after a difference is found are skipped.
+ */
+template<size_t N, typename A>
+bool parallelEqual(const BitVector<N, A> &a, const BitVector<N, A> &b,
+  ThreadPool &pool = ThreadPool::shared())
+{
+  assert(a.width() == b.width() && "Operands must have equal widths");
+  
+  size_t n = a.wordCount();
+  if (n == 0)
+    return true;
+  
+  const word_t *x = a.data();
+  const word_t *y = b.data();
+  word_t mask = MASK_FOR_MOST_SIGNIFICANT_WORD(a.width());
+  if ((x[n - 1] & mask) != (y[n - 1] & mask))
+    return false;
+  
+  std::atomic<bool> differ(false);
+  parallelForEachChunk(pool, n - 1, [&](size_t begin, size_t end)
+  {
+    if (!differ.load(std::memory_order_relaxed) &&
+      !wordKernels().equalWords(x + begin, y + begin, end - begin))
+      differ.store(true, std::memory_order_relaxed);
+  });
+  return !differ;
+}
+
+/**
+ * \brief Computes dst += src modulo 2^width() using the threads of pool
+ */
+template<size_t N, typename A>
+BitVector<N, A> &parallelAdd(BitVector<N, A> &dst, const BitVector<N, A> &src,
+  ThreadPool &pool = ThreadPool::shared())
+{
+  assert(dst.width() == src.width() && "Operands must have equal widths");
+  
+  size_t n = dst.wordCount();
+  word_t *d = dst.data();
+  const word_t *s = src.data();
+  const ParallelThresholds &t = parallelThresholds();
+  if (n < t.serial || pool.size() == 1)
+  {
+    addWords(d, d, s, n);
+    return dst;
+  }
+  
+  // Add each chunk with no incoming carry, noting whether it carries out
+  // and whether its sum is all ones, so that an incoming carry would go
+  // through
+  size_t count = CEILDIV(n, t.chunk);
+  std::vector<unsigned char> generate(count), propagate(count);
+  pool.run(count, [&](size_t i)
+  {
+    size_t begin = i * t.chunk;
+    size_t len = (begin + t.chunk < n) ? t.chunk : n - begin;
+    generate[i] = (unsigned char)addWords(d + begin, d + begin, s + begin,
+      len);
+    propagate[i] = wordKernels().skipFillForward(d + begin, len,
+      ~(word_t)0) == len;
+  });
+  
+  // Resolve the carry into each chunk, then add it in
+  std::vector<unsigned char> carry(count);
+  for (size_t i = 1; i < count; i ++)
+    carry[i] = generate[i - 1] | (propagate[i - 1] & carry[i - 1]);
+  pool.run(count, [&](size_t i)
+  {
+    if (carry[i])
+    {
+      size_t begin = i * t.chunk;
+      size_t len = (begin + t.chunk < n) ? t.chunk : n - begin;
+      addWord(d + begin, d + begin, len, 1);
+    }
+  });
+  return dst;
+}
+
+#endif // PARALLEL_HPP
@@ -0,0 +1,689 @@
+/**
+ * \file
+ * \brief Implements the RankSelect class, a succinct index answering rank and
+ * select queries over the bits of a BitVector.
+ *
+ * The layout follows the "poppy" structure of Zhou, Andersen and Kaminsky.
+ * The bits are divided into 2048-bit blocks, and each block has one 64-bit
+ * entry holding the number of set bits before the block together with the
+ * counts of its first three 512-bit sub-blocks. Because the two levels share
+ * a word, a rank query touches one index entry and at most one cache line of
+ * the bits. Every 8192nd set bit is sampled to narrow down the blocks a
+ * select query has to search. All in all the index takes about 3.2% of the
+ * space of the bits, plus up to 0.8% for the samples.
+ *
+ * \license
+ * Copyright (c) 2013 Ryan Govostes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef RANKSELECT_HPP
+#define RANKSELECT_HPP
+
+#include "BitVector.hpp"
+
+
+/**
+ * \def RANK_SELECT_SUBBLOCK_WORDS
+ * \brief Number of words in a sub-block, the unit scanned by a query
+ */
+#define RANK_SELECT_SUBBLOCK_WORDS 8
+
+/**
+ * \def RANK_SELECT_BLOCK_WORDS
+ * \brief Number of words covered by one index entry
+ */
+#define RANK_SELECT_BLOCK_WORDS (4 * RANK_SELECT_SUBBLOCK_WORDS)
+
+/**
+ * \def RANK_SELECT_BLOCK_BITS
+ * \brief Number of bits covered by one index entry
+ */
+#define RANK_SELECT_BLOCK_BITS WORDS_TO_BITS(RANK_SELECT_BLOCK_WORDS)
+
+/**
+ * \def RANK_SELECT_UPPER_SHIFT
+ * \brief Log2 of the number of blocks sharing one 64-bit upper count
+ *
+ * The count stored in an entry is relative to the upper count, and must fit
+ * in 32 bits.
+ */
+#define RANK_SELECT_UPPER_SHIFT 21
+
+/**
+ * \def RANK_SELECT_SAMPLE_RATE
+ * \brief Number of set bits between two select samples
+ */
+#define RANK_SELECT_SAMPLE_RATE 8192
+
+/**
+ * \def RANK_SELECT_LAYOUT
+ * \brief Identifies the parameters above in saved tables, which can only be
+ * read back with the same parameters
+ */
+#define RANK_SELECT_LAYOUT \
+  ((word_t)RANK_SELECT_SUBBLOCK_WORDS | \
+    ((word_t)RANK_SELECT_UPPER_SHIFT << 16) | \
+    ((word_t)RANK_SELECT_SAMPLE_RATE << 32))
+
+/**
+ * \def RANK_SELECT_TABLE_HEADER_WORDS
+ * \brief Number of words before the tables in saved tables: the layout, the
+ * width and the number of set bits
+ */
+#define RANK_SELECT_TABLE_HEADER_WORDS 3
+
+/**
+ * \def RANK_SELECT_SUBBLOCK_COUNT(entry, i)
+ * \brief Extracts the count of sub-block i < 3 from a block entry
+ */
+#define RANK_SELECT_SUBBLOCK_COUNT(entry, i) \
+  (((entry) >> (32 + 10 * (i))) & MASK_WITH_LOWER_BITS(10))
+
+
+/**
+ * \brief Finds the position of a set bit of a word from its rank
+ *
+ * \param x - the word
+ * \param r - the number of set bits below the one to find; must be less than
+ *   countOnes(x)
+ */
+inline unsigned selectWordGeneric(word_t x, unsigned r)
+{
+  // Skip whole bytes, then clear the lower set bits of the remaining one
+  unsigned shift = 0;
+  for (;;)
+  {
+    unsigned n = countOnes((x >> shift) & 0xff);
+    if (r < n)
+      break;
+    r -= n;
+    shift += BITS_PER_BYTE;
+  }
+  
+  x >>= shift;
+  for (; r > 0; r --)
+    x &= x - 1;
+  return shift + countTrailingZeros(x);
+}
+
+#if defined(BITVECTOR_X86_KERNELS) && defined(__x86_64__)
+#define RANK_SELECT_BMI2 1
+
+/**
+ * \brief Finds the position of a set bit of a word from its rank, by
+ * depositing a single bit into the r-th set position of x
+ */
+__attribute__((target("bmi2,popcnt")))
+inline unsigned selectWordBMI2(word_t x, unsigned r)
+{
+  return countTrailingZeros(_pdep_u64(MASK_WITH_BIT(r), x));
+}
+#endif
+
+
+/**
+ * RankSelect
+ *
+ * \brief A succinct index for rank and select queries over a BitVector
+ *
+ * The index refers to the words of the BitVector rather than copying them.
+ * After modifying the bits, call update() for the range that changed, or
+ * rebuild() if most of it did. After the BitVector is resized, moved or
+ * destroyed, call rebuild(v) before the next query.
+ */
+class RankSelect
+{
+public:
+  /**
+   * \brief Constructs an index over an empty bit vector
+   */
+  RankSelect() : bits(NULL), length(0), ones(0), bmi2(hasBMI2()),
+    mapped(false)
+  {
+    rebuild();
+  }
+  
+  /**
+   * \brief Constructs the index over the bits of a BitVector
+   */
+  template<size_t N, typename A>
+  explicit RankSelect(const BitVector<N, A> &v)
+    : bits(v.data()), length(v.width()), ones(0), bmi2(hasBMI2()),
+      mapped(false)
+  {
+    rebuild();
+  }
+  
+  RankSelect(const RankSelect &other)
+    : bits(other.bits), length(other.length), ones(other.ones),
+      bmi2(other.bmi2), mapped(other.mapped), blocks(other.blocks),
+      upper(other.upper), samples(other.samples)
+  {
+    if (mapped)
+      attachTables(other.blockTable, other.upperTable, other.sampleTable);
+    else
+      useOwnTables();
+  }
+  
+  RankSelect &operator=(const RankSelect &other)
+  {
+    if (this != &other)
+    {
+      RankSelect copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+  
+  /**
+   * \brief Exchanges two indexes
+   */
+  void swap(RankSelect &other)
+  {
+    std::swap(bits, other.bits);
+    std::swap(length, other.length);
+    std::swap(ones, other.ones);
+    std::swap(bmi2, other.bmi2);
+    std::swap(mapped, other.mapped);
+    std::swap(blockTable, other.blockTable);
+    std::swap(upperTable, other.upperTable);
+    std::swap(sampleTable, other.sampleTable);
+    blocks.swap(other.blocks);
+    upper.swap(other.upper);
+    samples.swap(other.samples);
+  }
+  
+  /**
+   * \brief Rebuilds the index from scratch over the bits of a BitVector
+   */
+  template<size_t N, typename A>
+  void rebuild(const BitVector<N, A> &v)
+  {
+    bits = v.data();
+    length = v.width();
+    rebuild();
+  }
+  
+  /**
+   * \brief Rebuilds the index from scratch after many bits changed
+   */
+  void rebuild()
+  {
+    mapped = false;
+    blocks.assign(blockCount(), 0);
+    upper.assign(upperCount(), 0);
+    samples.assign(1, 0);
+    ones = 0;
+    update(0, length);
+  }
+  
+  /**
+   * \brief Brings the index up to date after the bits in [begin, end) changed
+   *
+   * Only the blocks overlapping the range are counted again. The counts of the
+   * later blocks are shifted through the index alone, without reading their
+   * bits, and not at all if the number of set bits in the range is unchanged.
+   * An index whose tables were read with readTables() copies them first.
+   */
+  void update(size_t begin, size_t end)
+  {
+    assert(begin <= end && end <= length);
+    ownTables();
+    size_t n = blocks.size();
+    size_t first = begin / RANK_SELECT_BLOCK_BITS;
+    size_t last = (begin == end) ? first : CEILDIV(end, RANK_SELECT_BLOCK_BITS);
+    if (first >= n)
+      return;
+    
+    // Walk the blocks from the first changed one, counting the changed blocks
+    // again and deriving the sizes of the others from their old ranks. The
+    // walk stops at the first unchanged block whose rank did not move.
+    const size_t group = (size_t)1 << RANK_SELECT_UPPER_SHIFT;
+    size_t rank = blockRank(first);
+    size_t oldRank = rank;
+    word_t oldUpper = upper[first >> RANK_SELECT_UPPER_SHIFT];
+    size_t b = first;
+    for (; b < n; b ++)
+    {
+      if (b >= last && rank == oldRank)
+        break;
+      
+      size_t u = b >> RANK_SELECT_UPPER_SHIFT;
+      if (b % group == 0)
+      {
+        oldUpper = upper[u];
+        upper[u] = rank;
+      }
+      
+      size_t oldNext;
+      if (b + 1 == n)
+        oldNext = ones;
+      else if ((b + 1) % group == 0)
+        oldNext = upper[u + 1] + (uint32_t)blocks[b + 1];
+      else
+        oldNext = oldUpper + (uint32_t)blocks[b + 1];
+      
+      size_t total = (b < last) ? countBlock(b) : oldNext - oldRank;
+      blocks[b] = (blocks[b] & ~(word_t)0xffffffff) | (rank - upper[u]);
+      rank += total;
+      oldRank = oldNext;
+    }
+    if (b == n)
+      ones = rank;
+    
+    // Sample again the set bits that fall in the blocks just walked
+    size_t sample = CEILDIV(blockRank(first), RANK_SELECT_SAMPLE_RATE);
+    samples.resize(CEILDIV(ones, RANK_SELECT_SAMPLE_RATE) + 1);
+    for (size_t c = first; c < b; c ++)
+    {
+      size_t next = (c + 1 < n) ? blockRank(c + 1) : ones;
+      for (; sample * RANK_SELECT_SAMPLE_RATE < next; sample ++)
+        samples[sample] = c;
+    }
+    samples.back() = n ? n - 1 : 0;
+    useOwnTables();
+  }
+  
+  /**
+   * \returns the number of bits covered by the index
+   */
+  size_t width() const
+  {
+    return length;
+  }
+  
+  /**
+   * \returns the total number of set bits
+   */
+  size_t count() const
+  {
+    return ones;
+  }
+  
+  /**
+   * \returns the number of bytes taken by the index, excluding the bits
+   */
+  size_t indexBytes() const
+  {
+    return WORDS_TO_BYTES(blockCount() + upperCount() + sampleCount());
+  }
+  
+  /**
+   * \returns the number of words writeTables() passes on
+   */
+  size_t tableWords() const
+  {
+    return RANK_SELECT_TABLE_HEADER_WORDS + blockCount() + upperCount() +
+      sampleCount();
+  }
+  
+  /**
+   * \brief Passes the tables of the index to write(const word_t *, size_t n)
+   * in pieces, for saving them along with the bits
+   */
+  template<typename Write>
+  void writeTables(Write write) const
+  {
+    const word_t header[RANK_SELECT_TABLE_HEADER_WORDS] = {
+      RANK_SELECT_LAYOUT, length, ones
+    };
+    write(header, RANK_SELECT_TABLE_HEADER_WORDS);
+    write(blockTable, blockCount());
+    write(upperTable, upperCount());
+    write(sampleTable, sampleCount());
+  }
+  
+  /**
+   * \brief Restores an index from the words passed on by writeTables()
+   *
+   * \param words - the indexed bits
+   * \param width - the number of indexed bits
+   * \param tables - the n words of the tables, which the index refers to
+   *   rather than copying if copy is false; they must then outlive it
+   * \returns false if the tables are not an index over width bits
+   */
+  bool readTables(const word_t *words, size_t width, const word_t *tables,
+    size_t n, bool copy)
+  {
+    if (n < RANK_SELECT_TABLE_HEADER_WORDS ||
+      tables[0] != RANK_SELECT_LAYOUT || tables[1] != width)
+      return false;
+    
+    RankSelect index;
+    index.bits = words;
+    index.length = width;
+    index.ones = tables[2];
+    if (index.ones > width || n != index.tableWords())
+      return false;
+    
+    const word_t *b = tables + RANK_SELECT_TABLE_HEADER_WORDS;
+    const word_t *u = b + index.blockCount();
+    index.mapped = true;
+    index.attachTables(b, u, u + index.upperCount());
+    if (copy)
+      index.ownTables();
+    swap(index);
+    return true;
+  }
+  
+  /**
+   * \returns the name of the instruction set the queries use, for
+   *   diagnostics and benchmarks
+   */
+  const char *instructionSet() const
+  {
+    return bmi2 ? "bmi2" : "generic";
+  }
+  
+  /**
+   * \returns the number of set bits below position i, where i <= width()
+   */
+  size_t rank1(size_t i) const
+  {
+#ifdef RANK_SELECT_BMI2
+    if (bmi2)
+      return rank1BMI2(i);
+#endif
+    return rank1Generic(i);
+  }
+  
+  /**
+   * \returns the number of clear bits below position i, where i <= width()
+   */
+  size_t rank0(size_t i) const
+  {
+    return (i < length ? i : length) - rank1(i);
+  }
+  
+  /**
+   * \returns the position of the set bit with k set bits below it, or width()
+   *   if k >= count()
+   */
+  size_t select1(size_t k) const
+  {
+#ifdef RANK_SELECT_BMI2
+    if (bmi2)
+      return select1BMI2(k);
+#endif
+    return select1Generic(k);
+  }
+
+protected:
+  /**
+   * \def DEFINE_RANK_SELECT(isa, attributes)
+   * \brief Defines the queries for one instruction set
+   *
+   * \param isa - suffix of the generated function names
+   * \param attributes - attributes the functions are compiled with
+   */
+#define DEFINE_RANK_SELECT(isa, attributes) \
+  \
+  attributes \
+  size_t rank1##isa(size_t i) const \
+  { \
+    if (i >= length) \
+      return ones; \
+    \
+    /* Add the counts of the preceding sub-blocks to the rank of the block */ \
+    size_t b = i / RANK_SELECT_BLOCK_BITS; \
+    word_t entry = blockTable[b]; \
+    word_t preceding = (entry >> 32) & \
+      MASK_WITH_LOWER_BITS(10 * (i / (RANK_SELECT_BLOCK_BITS / 4) % 4)); \
+    size_t rank = upperTable[b >> RANK_SELECT_UPPER_SHIFT] + \
+      (uint32_t)entry + \
+      (preceding & 0x3ff) + ((preceding >> 10) & 0x3ff) + (preceding >> 20); \
+    \
+    /* Then count the words of the sub-block up to the position */ \
+    size_t w = WORD_INDEX_FOR_BIT_IN_ARRAY(i); \
+    for (size_t j = w & ~(size_t)(RANK_SELECT_SUBBLOCK_WORDS - 1); j < w; \
+      j ++) \
+      rank += countOnes(bits[j]); \
+    return rank + countOnes(bits[w] & \
+      MASK_WITH_LOWER_BITS(BIT_POSITION_FOR_BIT_IN_WORD(i))); \
+  } \
+  \
+  attributes \
+  size_t select1##isa(size_t k) const \
+  { \
+    if (k >= ones) \
+      return length; \
+    \
+    /* The block holding the bit lies between the neighboring samples */ \
+    size_t lo = sampleTable[k / RANK_SELECT_SAMPLE_RATE]; \
+    size_t hi = sampleTable[k / RANK_SELECT_SAMPLE_RATE + 1]; \
+    while (hi - lo > 8) \
+    { \
+      size_t mid = lo + (hi - lo + 1) / 2; \
+      if (blockRank(mid) <= k) \
+        lo = mid; \
+      else \
+        hi = mid - 1; \
+    } \
+    while (lo < hi && blockRank(lo + 1) <= k) \
+      lo ++; \
+    \
+    /* Narrow it down to a sub-block, then to a word */ \
+    size_t r = k - blockRank(lo); \
+    word_t entry = blockTable[lo]; \
+    size_t w = lo * RANK_SELECT_BLOCK_WORDS; \
+    for (size_t s = 0; s < 3; s ++) \
+    { \
+      size_t c = RANK_SELECT_SUBBLOCK_COUNT(entry, s); \
+      if (r < c) \
+        break; \
+      r -= c; \
+      w += RANK_SELECT_SUBBLOCK_WORDS; \
+    } \
+    for (;; w ++) \
+    { \
+      size_t c = countOnes(bits[w]); \
+      if (r < c) \
+        break; \
+      r -= c; \
+    } \
+    return WORDS_TO_BITS(w) + selectWord##isa(bits[w], (unsigned)r); \
+  } \
+  \
+  attributes \
+  size_t countBlock##isa(size_t b) \
+  { \
+    /* Words from full on hold bits beyond the width, if any */ \
+    size_t n = BITS_TO_WORDS(length); \
+    size_t full = length / BITS_PER_WORD; \
+    size_t total = 0; \
+    word_t entry = (uint32_t)blocks[b]; \
+    for (size_t s = 0; s < 4; s ++) \
+    { \
+      size_t from = (4 * b + s) * RANK_SELECT_SUBBLOCK_WORDS; \
+      size_t to = from + RANK_SELECT_SUBBLOCK_WORDS; \
+      to = (to < n) ? to : n; \
+      size_t count = 0; \
+      for (size_t w = from; w < to && w < full; w ++) \
+        count += countOnes(bits[w]); \
+      if (full >= from && full < to) \
+        count += countOnes(bits[full] & \
+          MASK_WITH_LOWER_BITS(BIT_POSITION_FOR_BIT_IN_WORD(length))); \
+      if (s < 3) \
+        entry |= (word_t)count << (32 + 10 * s); \
+      total += count; \
+    } \
+    blocks[b] = entry; \
+    return total; \
+  }
+  
+  DEFINE_RANK_SELECT(Generic, )
+
+#ifdef RANK_SELECT_BMI2
+  DEFINE_RANK_SELECT(BMI2, __attribute__((target("bmi2,popcnt"))))
+#endif
+  
+  /**
+   * \brief Counts the set bits of block b again and stores the counts of its
+   * sub-blocks into its entry
+   *
+   * \returns the number of set bits in the block
+   */
+  size_t countBlock(size_t b)
+  {
+#ifdef RANK_SELECT_BMI2
+    if (bmi2)
+      return countBlockBMI2(b);
+#endif
+    return countBlockGeneric(b);
+  }
+  
+  /**
+   * \returns the number of set bits before block b
+   */
+  size_t blockRank(size_t b) const
+  {
+    return upperTable[b >> RANK_SELECT_UPPER_SHIFT] + (uint32_t)blockTable[b];
+  }
+  
+  /**
+   * \returns the number of block entries
+   */
+  size_t blockCount() const
+  {
+    return CEILDIV(length, RANK_SELECT_BLOCK_BITS);
+  }
+  
+  /**
+   * \returns the number of upper counts
+   */
+  size_t upperCount() const
+  {
+    return CEILDIV(blockCount(), (size_t)1 << RANK_SELECT_UPPER_SHIFT);
+  }
+  
+  /**
+   * \returns the number of select samples
+   */
+  size_t sampleCount() const
+  {
+    return CEILDIV(ones, RANK_SELECT_SAMPLE_RATE) + 1;
+  }
+  
+  /**
+   * \brief Points the queries at tables held elsewhere
+   */
+  void attachTables(const word_t *b, const word_t *u, const word_t *s)
+  {
+    blockTable = b;
+    upperTable = u;
+    sampleTable = s;
+  }
+  
+  /**
+   * \brief Points the queries at the tables held by the index
+   */
+  void useOwnTables()
+  {
+    attachTables(blocks.data(), upper.data(), samples.data());
+  }
+  
+  /**
+   * \brief Copies tables held elsewhere into the index, so that it can
+   * change them
+   */
+  void ownTables()
+  {
+    if (mapped)
+    {
+      blocks.assign(blockTable, blockTable + blockCount());
+      upper.assign(upperTable, upperTable + upperCount());
+      samples.assign(sampleTable, sampleTable + sampleCount());
+      mapped = false;
+    }
+    useOwnTables();
+  }
+  
+  /**
+   * \returns true if the running CPU supports the BMI2 queries
+   */
+  static bool hasBMI2()
+  {
+#ifdef RANK_SELECT_BMI2
+    static const bool supported = []()
+    {
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt");
+    }();
+    return supported;
+#else
+    return false;
+#endif
+  }
+  
+  /**
+   * \brief The words of the indexed bits
+   */
+  const word_t *bits;
+  
+  /**
+   * \brief The number of indexed bits
+   */
+  size_t length;
+  
+  /**
+   * \brief The total number of set bits
+   */
+  size_t ones;
+  
+  /**
+   * \brief Whether to use the BMI2 queries
+   */
+  bool bmi2;
+  
+  /**
+   * \brief Whether the queries use tables held elsewhere, such as in a
+   * mapped file, rather than the ones below
+   */
+  bool mapped;
+  
+  /**
+   * \brief The tables the queries read
+   */
+  const word_t *blockTable;
+  const word_t *upperTable;
+  const word_t *sampleTable;
+  
+  /**
+   * \brief One entry per block: the low 32 bits hold the number of set bits
+   * before the block relative to its upper count, and the next three 10-bit
+   * fields hold the counts of its first three sub-blocks
+   */
+  std::vector<word_t> blocks;
+  
+  /**
+   * \brief The number of set bits before each group of
+   * 2^RANK_SELECT_UPPER_SHIFT blocks
+   */
+  std::vector<word_t> upper;
+  
+  /**
+   * \brief The block holding set bit i * RANK_SELECT_SAMPLE_RATE for each i,
+   * followed by the index of the last block
+   */
+  std::vector<word_t> samples;
+};
+
+#endif // RANKSELECT_HPP
@@ -0,0 +1,123 @@
+/**
+ * \file
+ * \brief Compares AtomicBitSpan with a BitVector behind a mutex, as a bitmap
+ * of visited or claimed bits shared by 1 to 64 threads
+ */
+
+#include "../AtomicBitSpan.hpp"
+#include "Harness.hpp"
+
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+
+/**
+ * \brief The number of bits tested or claimed per run, split between the
+ * threads
+ */
+const size_t OPERATIONS = 1 << 22;
+
+/**
+ * \brief Runs f(t) on threads t = 0, ..., threads - 1 and waits for them
+ */
+template<typename F>
+void runThreads(size_t threads, F f)
+{
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; t ++)
+    workers.push_back(std::thread(f, t));
+  for (size_t t = 0; t < threads; t ++)
+    workers[t].join();
+}
+
+
+int main(int argc, char **argv)
+{
+  size_t bits = (argc > 1) ? strtoull(argv[1], NULL, 0) : (size_t)1 << 26;
+  size_t maxThreads = (argc > 2) ? strtoull(argv[2], NULL, 0) : 64;
+  char width[32];
+  printf("%s bits, %u hardware threads\n\n", formatBits(bits, width,
+    sizeof(width)), std::thread::hardware_concurrency());
+  printf("%-8s %-12s %14s %14s %10s\n", "threads", "operation",
+    "mutex (Mop/s)", "atomic (Mop/s)", "speedup");
+  
+  BitVector<64> v(bits);
+  AtomicBitSpan span(v);
+  std::mutex mutex;
+  
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    size_t perThread = OPERATIONS / threads;
+    auto compare = [&](const char *name, const Measurement &locked,
+      const Measurement &atomic)
+    {
+      double operations = (double)(perThread * threads);
+      printf("%-8zu %-12s %14.2f %14.2f %9.2fx\n", threads, name,
+        operations * 1e3 / locked.nanoseconds,
+        operations * 1e3 / atomic.nanoseconds,
+        locked.nanoseconds / atomic.nanoseconds);
+    };
+    
+    // Marks pseudo-random bits as visited, starting from an empty bitmap each
+    // run, so that about one test in 16 finds its bit already set
+    compare("testAndSet",
+      measure([&]() {
+        memset(v.data(), 0, WORDS_TO_BYTES(v.wordCount()));
+        runThreads(threads, [&](size_t t) {
+          word_t state = 88172645463325252ULL + t;
+          for (size_t i = 0; i < perThread; i ++)
+          {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t index = state % bits;
+            bool visited = v.getBit(index);
+            v.setBit(index, true);
+            doNotOptimize(visited);
+          }
+        });
+      }, 0.1, 1),
+      measure([&]() {
+        memset(v.data(), 0, WORDS_TO_BYTES(v.wordCount()));
+        runThreads(threads, [&](size_t t) {
+          word_t state = 88172645463325252ULL + t;
+          for (size_t i = 0; i < perThread; i ++)
+          {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            doNotOptimize(span.testAndSet(state % bits));
+          }
+        });
+      }, 0.1, 1));
+    
+    // Claims bits in increasing order, every thread starting from the bottom
+    // of the bitmap, so that the threads compete for the same words
+    compare("claim",
+      measure([&]() {
+        memset(v.data(), 0, WORDS_TO_BYTES(v.wordCount()));
+        runThreads(threads, [&](size_t) {
+          size_t from = 0;
+          for (size_t i = 0; i < perThread; i ++)
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            from = v.findNextClear(from);
+            if (from == bits)
+              break;
+            v.setBit(from, true);
+          }
+        });
+      }, 0.1, 1),
+      measure([&]() {
+        memset(v.data(), 0, WORDS_TO_BYTES(v.wordCount()));
+        runThreads(threads, [&](size_t) {
+          size_t from = 0;
+          for (size_t i = 0; i < perThread && from < bits; i ++)
+            from = span.claimNextFree(from);
+        });
+      }, 0.1, 1));
+  }
+  return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * \file
+ * \brief Compares BitVectorBatch with a loop over separate BitVector objects
+ * for one million 256-bit values
+ */
+
+#include "../BitVectorBatch.hpp"
+#include "Harness.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+
+int main(int argc, char **argv)
+{
+  const size_t WIDTH = 256;
+  size_t count = (argc > 1) ? strtoull(argv[1], NULL, 0) : (size_t)1 << 20;
+  printf("%zu values of %zu bits, %s kernels\n\n", count, WIDTH,
+    batchKernels().name);
+  
+  BitVectorBatch<WIDTH> a(count), b(count);
+  std::vector<BitVector<WIDTH> > u, v;
+  u.reserve(count);
+  v.reserve(count);
+  word_t state = 88172645463325252ULL;
+  for (size_t i = 0; i < count; i ++)
+  {
+    BitVector<WIDTH> x(WIDTH, false), y(WIDTH, false);
+    for (size_t k = 0; k < x.wordCount(); k ++)
+    {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      x.data()[k] = state;
+      y.data()[k] = ~state >> (i & 1);
+    }
+    a.set(i, x);
+    b.set(i, y);
+    u.push_back(x);
+    v.push_back(y);
+  }
+  BitVector<WIDTH> threshold(u[count / 2]);
+  
+  printf("%-10s %16s %16s %10s\n", "operation", "objects (ns/op)",
+    "batch (ns/op)", "speedup");
+  auto compare = [&](const char *name, const Measurement &objects,
+    const Measurement &batch)
+  {
+    printf("%-10s %16.3f %16.3f %9.2fx\n", name, objects.nanoseconds / count,
+      batch.nanoseconds / count, objects.nanoseconds / batch.nanoseconds);
+  };
+  
+  compare("xor",
+    measure([&]() {
+      for (size_t i = 0; i < count; i ++)
+        u[i] ^= v[i];
+    }),
+    measure([&]() { a ^= b; }));
+  compare("add",
+    measure([&]() {
+      for (size_t i = 0; i < count; i ++)
+        u[i] += v[i];
+    }),
+    measure([&]() { a += b; }));
+  compare("subtract",
+    measure([&]() {
+      for (size_t i = 0; i < count; i ++)
+        u[i] -= v[i];
+    }),
+    measure([&]() { a -= b; }));
+  
+  BitVector<64> less(count);
+  compare("less",
+    measure([&]() {
+      for (size_t i = 0; i < count; i ++)
+        less.setBit(i, u[i] < threshold);
+    }),
+    measure([&]() { a.compare(threshold, less); }));
+  doNotOptimize(less);
+  
+  std::vector<unsigned> counts(count);
+  compare("popcount",
+    measure([&]() {
+      for (size_t i = 0; i < count; i ++)
+        counts[i] = (unsigned)u[i].popcount();
+    }),
+    measure([&]() { a.popcount(counts.data()); }));
+  doNotOptimize(counts);
+  return 0;
+}
@@ -0,0 +1,250 @@
+/**
+ * \file
+ * \brief Times every public BitVector operation at widths that fit in-object,
+ * at the boundary where storage moves to the heap, and up to 64 Mbit
+ *
+ * Throughput is reported in bytes of operand per nanosecond (GB/s). With
+ * --json the results are printed as a JSON document instead of a table, for
+ * comparison between releases.
+ *
+ * Usage: bitvector_bench [--json] [--filter=substring] [--max-bits=n]
+ *   [--min-time=seconds]
+ */
+
+#include "../BitVector.hpp"
+#include "Harness.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+
+/**
+ * \brief The in-object capacity of the benchmarked BitVector
+ */
+const size_t INLINE_BITS = 256;
+
+/**
+ * \brief The widest operands of the quadratic and subquadratic operations,
+ * beyond which a run takes too long
+ */
+const size_t MULTIPLY_BITS = 64 << 10;
+const size_t DECIMAL_BITS = 64 << 10;
+
+/**
+ * \brief The widest vectors built one bit at a time
+ */
+const size_t APPEND_BITS = 1 << 20;
+
+typedef BitVector<INLINE_BITS> Vector;
+
+struct Options
+{
+  bool json;
+  const char *filter;
+  size_t maxBits;
+  double minSeconds;
+};
+
+/**
+ * \brief Parses the command line
+ *
+ * \returns false if an argument isn't recognized
+ */
+bool parseOptions(int argc, char **argv, Options &options)
+{
+  options.json = false;
+  options.filter = "";
+  options.maxBits = (size_t)64 << 20;
+  options.minSeconds = 0.01;
+  
+  for (int i = 1; i < argc; i ++)
+  {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--json") == 0)
+      options.json = true;
+    else if (strncmp(arg, "--filter=", 9) == 0)
+      options.filter = arg + 9;
+    else if (strncmp(arg, "--max-bits=", 11) == 0)
+      options.maxBits = strtoull(arg + 11, NULL, 0);
+    else if (strncmp(arg, "--min-time=", 11) == 0)
+      options.minSeconds = strtod(arg + 11, NULL);
+    else
+      return false;
+  }
+  return true;
+}
+
+/**
+ * \brief Fills a BitVector with pseudo-random bits
+ */
+void fillRandom(Vector &v, word_t seed)
+{
+  word_t state = seed;
+  for (size_t i = 0; i < v.wordCount(); i ++)
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    v.data()[i] = state;
+  }
+}
+
+
+/**
+ * \brief Times operations at one width and prints the results
+ */
+struct Runner
+{
+  Runner(const Options &options, size_t bits, bool &first)
+    : options(options), bits(bits), first(first)
+  {
+  }
+  
+  /**
+   * \brief Times f if its name passes the filter and the width is at most
+   * maxBits
+   */
+  template<typename F>
+  void operator()(const char *name, size_t maxBits, F f)
+  {
+    if (bits > maxBits || !strstr(name, options.filter))
+      return;
+    
+    Measurement m = measure(f, options.minSeconds);
+    double bytes = (double)BITS_TO_BYTES(bits);
+    const char *storage = (bits <= INLINE_BITS) ? "inline" : "heap";
+    if (options.json)
+    {
+      printf("%s\n    {\"name\": \"%s\", \"bits\": %zu, \"storage\": "
+        "\"%s\", \"ns_per_op\": %.3f, \"gb_per_s\": %.3f, "
+        "\"cycles_per_op\": %.1f}", first ? "" : ",", name, bits, storage,
+        m.nanoseconds, bytes / m.nanoseconds, m.cycles);
+    }
+    else
+    {
+      char width[32];
+      printf("%-12s %10s %8s %14.2f %10.2f\n", name,
+        formatBits(bits, width, sizeof(width)), storage, m.nanoseconds,
+        bytes / m.nanoseconds);
+    }
+    fflush(stdout);
+    first = false;
+  }
+  
+  const Options &options;
+  size_t bits;
+  bool &first;
+};
+
+
+int main(int argc, char **argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, options))
+  {
+    fprintf(stderr, "usage: %s [--json] [--filter=substring] "
+      "[--max-bits=n] [--min-time=seconds]\n", argv[0]);
+    return 1;
+  }
+  
+  // In-object, either side of the heap boundary, and heap-heavy
+  const size_t widths[] = {
+    64, INLINE_BITS, INLINE_BITS + 1, 1 << 10, 64 << 10, 1 << 20, 64 << 20
+  };
+  
+  bool first = true;
+  if (options.json)
+    printf("{\n  \"context\": {\"word_kernels\": \"%s\", \"inline_bits\": "
+      "%zu},\n  \"benchmarks\": [", wordKernels().name, INLINE_BITS);
+  else
+    printf("%-12s %10s %8s %14s %10s\n", "operation", "bits", "storage",
+      "ns/op", "GB/s");
+  
+  for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w ++)
+  {
+    size_t bits = widths[w];
+    if (bits > options.maxBits)
+      continue;
+    
+    Vector a(bits, false), b(bits, false);
+    fillRandom(a, 88172645463325252ULL);
+    fillRandom(b, 0x9e3779b97f4a7c15ULL);
+    Vector c(a);
+    Vector half = b.extract(0, bits / 2);
+    std::string binary = a.toString(2), hex = a.toString(16);
+    std::string decimal = (bits <= DECIMAL_BITS) ? a.toString(10) : "";
+    
+    Runner run(options, bits, first);
+    const size_t ALL = ~(size_t)0;
+    
+    // c is a copy of a, which or and and leave unchanged. The other in-place
+    // operations leave a with random bits, or return it to the same bits on
+    // every other call.
+    run("or", ALL, [&]() { c |= a; });
+    run("and", ALL, [&]() { c &= a; });
+    run("xor", ALL, [&]() { a ^= b; });
+    run("not", ALL, [&]() { a.complement(); });
+    run("expression", ALL, [&]() { c = (a & b) | ~a; });
+    run("add", ALL, [&]() { a += b; });
+    run("subtract", ALL, [&]() { a -= b; });
+    run("increment", ALL, [&]() { ++ a; });
+    run("negate", ALL, [&]() { a.negate(); });
+    run("multiply", MULTIPLY_BITS, [&]() { doNotOptimize(a * b); });
+    run("shl", ALL, [&]() { c = a; c <<= 13; });
+    run("shr", ALL, [&]() { c = a; c >>= 13; });
+    run("rotl", ALL, [&]() { a.rotateLeft(13); });
+    run("extract", ALL, [&]() { doNotOptimize(a.extract(13, bits / 2)); });
+    run("insert", ALL, [&]() { c.insert(13, half); });
+    run("getBits", ALL, [&]() { doNotOptimize(a.getBits(bits / 3, 37)); });
+    run("copy", ALL, [&]() { Vector d(a); doNotOptimize(d); });
+    run("assign", ALL, [&]() { c = a; });
+    
+    // Assigning a wider vector and back resizes c twice; after the first run
+    // both widths fit in the heap storage it keeps, even at INLINE_BITS
+    Vector wider(bits + 64);
+    run("reassign", ALL, [&]() { c = wider; c = a; });
+    
+    // Building a vector from nothing, so that the capacity grows as it would
+    // in a bitstream writer
+    run("pushBack", APPEND_BITS, [&]() {
+      Vector d(0);
+      for (size_t i = 0; i < bits; i ++)
+        d.pushBack(a.getBit(i));
+      doNotOptimize(d);
+    });
+    run("appendWord", ALL, [&]() {
+      Vector d(0);
+      for (size_t i = 0; i < a.wordCount(); i ++)
+        d.appendWord(a.data()[i]);
+      doNotOptimize(d);
+    });
+    
+    // Equal operands, so that the comparison scans every word
+    c = a;
+    run("equal", ALL, [&]() { doNotOptimize(a == c); });
+    run("less", ALL, [&]() { doNotOptimize(a < c); });
+    run("popcount", ALL, [&]() { doNotOptimize(a.popcount()); });
+    run("hash", ALL, [&]() { doNotOptimize(a.hash()); });
+    run("findLastSet", ALL, [&]() { doNotOptimize(a.findLastSet()); });
+    
+    run("toString2", ALL, [&]() { a.toString(binary, 2); });
+    run("toString16", ALL, [&]() { a.toString(hex, 16); });
+    run("toString10", DECIMAL_BITS, [&]() {
+      doNotOptimize(a.toString(10));
+    });
+    run("fromString2", ALL, [&]() {
+      doNotOptimize(c.fromString(binary.data(), binary.size(), 2));
+    });
+    run("fromString16", ALL, [&]() {
+      doNotOptimize(c.fromString(hex.data(), hex.size(), 16));
+    });
+    run("fromString10", DECIMAL_BITS, [&]() {
+      doNotOptimize(c.fromString(decimal.data(), decimal.size(), 10));
+    });
+  }
+  
+  if (options.json)
+    printf("\n  ]\n}\n");
+  return 0;
+}
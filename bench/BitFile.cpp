@@ -0,0 +1,79 @@
+/**
+ * \file
+ * \brief Times saving, loading and mapping a 1-Gbit file with a RankSelect
+ * index
+ *
+ * The file is written to the working directory, or to the path given as the
+ * second argument, and removed afterwards. Loading reads from the page cache,
+ * as the file was just written.
+ */
+
+#include "../BitFile.hpp"
+#include "Harness.hpp"
+
+#include <cstdlib>
+#include <fstream>
+
+
+int main(int argc, char **argv)
+{
+  size_t bits = (argc > 1) ? strtoull(argv[1], NULL, 0) : (size_t)1 << 30;
+  const char *path = (argc > 2) ? argv[2] : "bitvector_file_bench.bits";
+  char width[32];
+  printf("%s bits\n\n", formatBits(bits, width, sizeof(width)));
+  
+  BitVector<64> v(bits, false);
+  word_t state = 88172645463325252ULL;
+  word_t *w = v.data();
+  for (size_t i = 0; i < v.wordCount(); i ++)
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    w[i] = state;
+  }
+  RankSelect index(v);
+  
+  printf("%-10s %12s %12s\n", "operation", "time (ms)", "GB/s");
+  double bytes = (double)BITS_TO_BYTES(bits);
+  auto report = [&](const char *name, const Measurement &m)
+  {
+    printf("%-10s %12.3f %12.2f\n", name, m.nanoseconds / 1e6,
+      bytes / m.nanoseconds);
+  };
+  
+  report("save", measure([&]() {
+    std::ofstream out(path, std::ios::binary);
+    if (!save(out, v, &index))
+      abort();
+  }, 0.5, 1));
+  
+  report("load", measure([&]() {
+    std::ifstream in(path, std::ios::binary);
+    BitVector<64> u(0);
+    RankSelect r;
+    if (!load(in, u, &r))
+      abort();
+    doNotOptimize(u);
+  }, 0.5, 1));
+
+#ifndef _WIN32
+  // Opening includes one rank query, so that the index is in use
+  report("mmapOpen", measure([&]() {
+    MappedBitFile file = mmapOpen(path);
+    if (!file.isOpen())
+      abort();
+    size_t rank = file.index().rank1(bits / 2);
+    doNotOptimize(rank);
+  }));
+  
+  MappedBitFile file = mmapOpen(path);
+  report("verify", measure([&]() {
+    if (!file.verify())
+      abort();
+  }, 0.5, 1));
+#endif
+  
+  remove(path);
+  return 0;
+}
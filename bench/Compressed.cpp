@@ -0,0 +1,126 @@
+/**
+ * \file
+ * \brief Compares CompressedBitVector with BitVector on 256-Mbit operands
+ * that are sparse, made of long runs, or dense
+ */
+
+#include "../CompressedBitVector.hpp"
+#include "Harness.hpp"
+
+#include <cstdlib>
+
+
+/**
+ * \brief Returns the next pseudo-random word
+ */
+word_t nextRandom(word_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+/**
+ * \brief Fills two BitVectors with bits of the named kind
+ */
+void fill(const char *kind, BitVector<64> &a, BitVector<64> &b)
+{
+  word_t state = 88172645463325252ULL;
+  size_t bits = a.width();
+  if (kind[0] == 's')
+  {
+    // About one bit in 4096
+    for (size_t i = 0; i < bits / 4096; i ++)
+    {
+      a.setBit(nextRandom(state) % bits, true);
+      b.setBit(nextRandom(state) % bits, true);
+    }
+  }
+  else if (kind[0] == 'r')
+  {
+    // Runs of up to 64K bits separated by gaps of up to 64K bits
+    BitVector<64> *v[] = { &a, &b };
+    for (size_t k = 0; k < 2; k ++)
+    {
+      for (size_t i = nextRandom(state) % 65536; i < bits; )
+      {
+        size_t end = std::min(bits, i + nextRandom(state) % 65536);
+        for (; i < end; i ++)
+          v[k]->setBit(i, true);
+        i += nextRandom(state) % 65536;
+      }
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < a.wordCount(); i ++)
+    {
+      a.data()[i] = nextRandom(state);
+      b.data()[i] = nextRandom(state);
+    }
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  size_t bits = (argc > 1) ? strtoull(argv[1], NULL, 0) : (size_t)1 << 28;
+  char width[32];
+  printf("%s bits\n", formatBits(bits, width, sizeof(width)));
+  
+  const char *kinds[] = { "sparse", "runs", "dense" };
+  for (size_t k = 0; k < 3; k ++)
+  {
+    BitVector<64> a(bits), b(bits);
+    fill(kinds[k], a, b);
+    CompressedBitVector ca(a), cb(b);
+    
+    printf("\n%s: %zu set bits, %zu chunks\n", kinds[k], ca.popcount(),
+      ca.containerCount());
+    printf("  memory: dense %zu KiB, compressed %zu KiB\n\n",
+      BITS_TO_BYTES(bits) >> 10, ca.storageBytes() >> 10);
+    printf("  %-12s %14s %14s %10s\n", "operation", "dense (ms)",
+      "compressed (ms)", "speedup");
+    
+    auto compare = [&](const char *name, const Measurement &dense,
+      const Measurement &compressed)
+    {
+      printf("  %-12s %14.3f %14.3f %9.2fx\n", name, dense.nanoseconds / 1e6,
+        compressed.nanoseconds / 1e6,
+        dense.nanoseconds / compressed.nanoseconds);
+    };
+    
+    size_t count = 0;
+    compare("popcount",
+      measure([&]() { count += a.popcount(); }),
+      measure([&]() { count += ca.popcount(); }));
+    compare("or",
+      measure([&]() { doNotOptimize(BitVector<64>(a | b)); }),
+      measure([&]() { doNotOptimize(ca | cb); }));
+    compare("and",
+      measure([&]() { doNotOptimize(BitVector<64>(a & b)); }),
+      measure([&]() { doNotOptimize(ca & cb); }));
+    compare("xor",
+      measure([&]() { doNotOptimize(BitVector<64>(a ^ b)); }),
+      measure([&]() { doNotOptimize(ca ^ cb); }));
+    compare("iterate",
+      measure([&]() { for (size_t i : a.setBitIndices()) count += i; }),
+      measure([&]() { for (size_t i : ca.setBitIndices()) count += i; }));
+    
+    // Against a dense operand
+    BitVector<64> c(bits);
+    compare("and dense",
+      measure([&]() { c = a; c &= b; }),
+      measure([&]() { CompressedBitVector t(ca); t &= b; doNotOptimize(t); }));
+    doNotOptimize(count);
+    
+    Measurement compress = measure([&]() {
+      doNotOptimize(CompressedBitVector(a));
+    });
+    Measurement decompress = measure([&]() { ca.copyTo(c); });
+    printf("\n  compress %.3f ms, decompress %.3f ms\n",
+      compress.nanoseconds / 1e6, decompress.nanoseconds / 1e6);
+  }
+  return 0;
+}
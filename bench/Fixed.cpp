@@ -0,0 +1,83 @@
+/**
+ * \file
+ * \brief Compares FixedBitVector with BitVector of the same width, and
+ * 256-bit addition with a loop written directly on _addcarry_u64
+ */
+
+#include "../FixedBitVector.hpp"
+#include "Harness.hpp"
+
+
+/**
+ * \brief Runs a dependent chain of count additions and multiplications
+ */
+template<typename T>
+void chain(T &x, const T &y, size_t count)
+{
+  for (size_t i = 0; i < count; i ++)
+  {
+    x += y;
+    x *= y;
+  }
+  doNotOptimize(x);
+}
+
+template<size_t Bits>
+void compare(size_t count)
+{
+  FixedBitVector<Bits> fx((word_t)3), fy((word_t)0x9e3779b97f4a7c15ULL);
+  fy.rotateLeft(Bits / 3);
+  BitVector<Bits> bx(fx.toBitVector()), by(fy.toBitVector());
+  
+  Measurement fixed = measure([&]() { chain(fx, fy, count); });
+  Measurement dynamic = measure([&]() { chain(bx, by, count); });
+  printf("%-10zu %16.2f %16.2f %9.2fx\n", Bits, fixed.nanoseconds / count,
+    dynamic.nanoseconds / count, dynamic.nanoseconds / fixed.nanoseconds);
+}
+
+
+int main()
+{
+  const size_t count = 1 << 16;
+  printf("add and multiply, %zu dependent steps\n\n", count);
+  printf("%-10s %16s %16s %10s\n", "bits", "fixed (ns/op)", "dynamic (ns/op)",
+    "speedup");
+  compare<64>(count);
+  compare<128>(count);
+  compare<256>(count);
+  compare<512>(count);
+
+#ifdef BITVECTOR_X86_64_CARRY
+  // Independent additions into a buffer, so that the throughput of the carry
+  // chains is measured rather than their latency
+  const size_t n = 1024;
+  std::vector<FixedBitVector<256> > xs(n), ys(n);
+  for (size_t i = 0; i < n; i ++)
+  {
+    xs[i] = FixedBitVector<256>((word_t)i).rotl(i) - FixedBitVector<256>(1);
+    ys[i] = ~xs[i].rotr(i);
+  }
+  
+  Measurement fixed = measure([&]() {
+    for (size_t i = 0; i < n; i ++)
+      xs[i] += ys[i];
+    doNotOptimize(xs);
+  });
+  Measurement intrinsics = measure([&]() {
+    for (size_t i = 0; i < n; i ++)
+    {
+      unsigned long long *x = (unsigned long long *)xs[i].data();
+      const unsigned long long *y =
+        (const unsigned long long *)ys[i].data();
+      unsigned char c = _addcarry_u64(0, x[0], y[0], &x[0]);
+      c = _addcarry_u64(c, x[1], y[1], &x[1]);
+      c = _addcarry_u64(c, x[2], y[2], &x[2]);
+      _addcarry_u64(c, x[3], y[3], &x[3]);
+    }
+    doNotOptimize(xs);
+  });
+  printf("\n256-bit add  fixed %.2f ns/op, _addcarry_u64 %.2f ns/op\n",
+    fixed.nanoseconds / n, intrinsics.nanoseconds / n);
+#endif
+  return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * \file
+ * \brief A minimal timing harness shared by the BitVector benchmarks
+ *
+ * Each measurement repeats the operation until a minimum amount of time has
+ * passed, and the best of several such runs is reported to filter out noise
+ * from the rest of the system.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define HARNESS_HAS_CYCLE_COUNTER 1
+#endif
+
+
+/**
+ * \brief The result of timing an operation
+ */
+struct Measurement
+{
+  /**
+   * \brief Average nanoseconds per call
+   */
+  double nanoseconds;
+  
+  /**
+   * \brief Average reference cycles per call, or 0 if there is no cycle
+   *   counter on this platform
+   */
+  double cycles;
+};
+
+/**
+ * \brief Defeats dead code elimination of a computed value
+ */
+template<typename T>
+inline void doNotOptimize(const T &value)
+{
+#ifdef __GNUC__
+  __asm__ __volatile__("" : : "r,m"(value) : "memory");
+#else
+  static volatile const T *sink;
+  sink = &value;
+#endif
+}
+
+inline uint64_t readCycleCounter()
+{
+#ifdef HARNESS_HAS_CYCLE_COUNTER
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * \brief Times repeated calls of f
+ *
+ * \param f - the operation to time
+ * \param minSeconds - the minimum duration of each run
+ * \param runs - the number of runs, of which the fastest is reported
+ */
+template<typename F>
+Measurement measure(F f, double minSeconds = 0.02, int runs = 3)
+{
+  typedef std::chrono::steady_clock clock;
+  
+  // Warm up caches and find how many calls make up one run
+  size_t iterations = 1;
+  for (;;)
+  {
+    clock::time_point start = clock::now();
+    for (size_t i = 0; i < iterations; i ++)
+      f();
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    if (elapsed >= minSeconds)
+      break;
+    iterations *= (elapsed <= minSeconds / 16 ? 16 : 2);
+  }
+  
+  Measurement best = { 0, 0 };
+  for (int run = 0; run < runs; run ++)
+  {
+    clock::time_point start = clock::now();
+    uint64_t startCycles = readCycleCounter();
+    for (size_t i = 0; i < iterations; i ++)
+      f();
+    uint64_t cycles = readCycleCounter() - startCycles;
+    double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    
+    Measurement m = { elapsed * 1e9 / iterations, (double)cycles / iterations };
+    if (run == 0 || m.nanoseconds < best.nanoseconds)
+      best = m;
+  }
+  return best;
+}
+
+/**
+ * \brief Formats a width in bits with a binary unit suffix, e.g. 64M
+ */
+inline const char *formatBits(size_t bits, char *buf, size_t size)
+{
+  if (bits >= ((size_t)1 << 20) && bits % ((size_t)1 << 20) == 0)
+    snprintf(buf, size, "%zuM", bits >> 20);
+  else if (bits >= ((size_t)1 << 10) && bits % ((size_t)1 << 10) == 0)
+    snprintf(buf, size, "%zuK", bits >> 10);
+  else
+    snprintf(buf, size, "%zu", bits);
+  return buf;
+}
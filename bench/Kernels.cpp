@@ -0,0 +1,79 @@
+/**
+ * \file
+ * \brief Measures the throughput of every WordKernels table supported by the
+ * running CPU, from 128-bit to 64-Mbit operands
+ *
+ * Throughput is reported in bytes of operand per reference cycle, so a binary
+ * operation on two 1 KiB operands that takes 256 cycles runs at 4 B/cycle.
+ */
+
+#include "../BitVector.hpp"
+#include "Harness.hpp"
+
+#include <cstdlib>
+
+
+int main()
+{
+  std::vector<const WordKernels *> kernels = supportedWordKernels();
+  
+  printf("%-8s %-8s %10s %12s %12s\n",
+    "kernel", "op", "bits", "ns/op", "bytes/cycle");
+  
+  const size_t widths[] = {
+    128, 1 << 10, 8 << 10, 64 << 10, 512 << 10, 4 << 20, 64 << 20
+  };
+  for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w ++)
+  {
+    size_t bits = widths[w];
+    BitVector<128> a(bits), b(bits), zero(bits);
+    for (size_t i = 0; i < a.wordCount(); i ++)
+      a.data()[i] = b.data()[i] = ((word_t)rand() << 32) ^ rand();
+    
+    word_t *x = a.data();
+    const word_t *y = b.data();
+    const word_t *z = zero.data();
+    size_t n = a.wordCount();
+    double bytes = (double)WORDS_TO_BYTES(n);
+    
+    for (size_t k = 0; k < kernels.size(); k ++)
+    {
+      const WordKernels &K = *kernels[k];
+      
+      // The and/or kernels leave x unchanged when x == y, and applying the
+      // xor and not kernels an even number of times does, too, so the
+      // comparisons below always scan every word. The skip scans a vector of
+      // zeros for a nonzero word, and the hash covers the whole stripes.
+      Measurement results[] = {
+        measure([&]() { K.orWords(x, y, n); }),
+        measure([&]() { K.andWords(x, y, n); }),
+        measure([&]() { K.xorWords(x, y, n); K.xorWords(x, y, n); }),
+        measure([&]() { K.notWords(x, n); K.notWords(x, n); }),
+        measure([&]() { doNotOptimize(K.equalWords(x, y, n)); }),
+        measure([&]() { doNotOptimize(K.lastDifference(x, y, n)); }),
+        measure([&]() { doNotOptimize(K.skipFillForward(z, n, 0)); }),
+        measure([&]() {
+          word_t acc[HASH_STRIPE_WORDS] = { 0 };
+          K.hashStripes(acc, y, n / HASH_STRIPE_WORDS, 0);
+          doNotOptimize(acc);
+        }),
+      };
+      const char *names[] = {
+        "or", "and", "xor", "not", "equal", "compare", "skip", "hash"
+      };
+      const int callsPerRun[] = { 1, 1, 2, 2, 1, 1, 1, 1 };
+      
+      for (size_t op = 0; op < sizeof(names) / sizeof(names[0]); op ++)
+      {
+        char width[32];
+        Measurement &m = results[op];
+        printf("%-8s %-8s %10s %12.1f %12.2f\n", K.name, names[op],
+          formatBits(bits, width, sizeof(width)),
+          m.nanoseconds / callsPerRun[op],
+          m.cycles > 0 ? bytes * callsPerRun[op] / m.cycles : 0.0);
+      }
+    }
+  }
+  
+  return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * \file
+ * \brief Compares Montgomery multiplication and exponentiation with the same
+ * operations built on multiplyWords() and BarrettReducer, for 2048- to
+ * 8192-bit odd moduli
+ */
+
+#include "../Montgomery.hpp"
+#include "Harness.hpp"
+
+
+/**
+ * \brief Fills a BitVector with pseudo-random bits
+ */
+void fillRandom(BitVector<64> &v, word_t seed)
+{
+  word_t state = seed;
+  for (size_t i = 0; i < v.wordCount(); i ++)
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    v.data()[i] = state;
+  }
+}
+
+/**
+ * \brief Computes base^exponent mod m by left-to-right square and multiply,
+ * reducing each product with a BarrettReducer
+ */
+void barrettModPow(word_t *acc, const word_t *base, const BitVector<64> &e,
+  const BarrettReducer &reducer)
+{
+  size_t k = reducer.wordCount();
+  std::vector<word_t> product(2 * k), scratch(multiplyScratchSize(k));
+  memset(acc, 0, WORDS_TO_BYTES(k));
+  acc[0] = 1;
+  for (size_t i = e.bitLength(); i > 0; i --)
+  {
+    multiplyWords(product.data(), acc, acc, k, scratch.data());
+    reducer.divide(NULL, acc, product.data(), 2 * k);
+    if (e.getBit(i - 1))
+    {
+      multiplyWords(product.data(), acc, base, k, scratch.data());
+      reducer.divide(NULL, acc, product.data(), 2 * k);
+    }
+  }
+}
+
+
+int main()
+{
+  printf("%-6s %-20s %14s %14s %9s\n", "bits", "operation", "barrett (us)",
+    "montgomery (us)", "speedup");
+  
+  const size_t sizes[] = { 2048, 4096, 8192 };
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s ++)
+  {
+    size_t bits = sizes[s];
+    BitVector<64> m(bits), a(bits), b(bits), e(bits);
+    fillRandom(m, 88172645463325252ULL);
+    fillRandom(a, 0x9e3779b97f4a7c15ULL);
+    fillRandom(b, 0x2545f4914f6cdd1dULL);
+    fillRandom(e, 0x853c49e6748fea9bULL);
+    m.setBit(0, true);
+    m.setBit(bits - 1, true);
+    a.setBit(bits - 1, false);
+    b.setBit(bits - 1, false);
+    
+    BarrettReducer reducer(m);
+    MontgomeryContext ctx(m);
+    size_t k = ctx.wordCount();
+    std::vector<word_t> product(2 * k), scratch(multiplyScratchSize(k));
+    std::vector<word_t> x(a.data(), a.data() + k), y(b.data(), b.data() + k);
+    std::vector<word_t> mx(k), my(k), r(k);
+    std::vector<word_t> montgomeryScratch(ctx.scratchSize());
+    ctx.toMontgomery(mx.data(), x.data(), montgomeryScratch.data());
+    ctx.toMontgomery(my.data(), y.data(), montgomeryScratch.data());
+    
+    auto compare = [&](const char *name, const Measurement &barrett,
+      const Measurement &montgomery)
+    {
+      printf("%-6zu %-20s %14.2f %14.2f %8.2fx\n", bits, name,
+        barrett.nanoseconds / 1e3, montgomery.nanoseconds / 1e3,
+        barrett.nanoseconds / montgomery.nanoseconds);
+    };
+    
+    compare("multiply",
+      measure([&]() {
+        multiplyWords(product.data(), x.data(), y.data(), k, scratch.data());
+        reducer.divide(NULL, r.data(), product.data(), 2 * k);
+      }),
+      measure([&]() {
+        ctx.multiply(r.data(), mx.data(), my.data(),
+          montgomeryScratch.data());
+      }));
+    compare("square",
+      measure([&]() {
+        multiplyWords(product.data(), x.data(), x.data(), k, scratch.data());
+        reducer.divide(NULL, r.data(), product.data(), 2 * k);
+      }),
+      measure([&]() {
+        ctx.square(r.data(), mx.data(), montgomeryScratch.data());
+      }));
+    
+    Measurement barrett = measure([&]() {
+      barrettModPow(r.data(), x.data(), e, reducer);
+    }, 0.2, 1);
+    compare("modPow", barrett, measure([&]() {
+      doNotOptimize(ctx.modPow(a, e));
+    }, 0.2, 1));
+    compare("modPowConstantTime", barrett, measure([&]() {
+      doNotOptimize(ctx.modPowConstantTime(a, e));
+    }, 0.2, 1));
+    doNotOptimize(r);
+  }
+  return 0;
+}
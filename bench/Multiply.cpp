@@ -0,0 +1,129 @@
+/**
+ * \file
+ * \brief Times each multiplication algorithm from 4-Kbit to 1-Mbit operands
+ * and searches for the crossover points between them
+ *
+ * The suggested thresholds at the end can be passed to the compiler as the
+ * BITVECTOR_*_THRESHOLD macros, or assigned to multiplyThresholds().
+ */
+
+#include "../BitVector.hpp"
+#include "Harness.hpp"
+
+#include <cstdlib>
+
+
+static const size_t NEVER = (size_t)-1;
+
+/**
+ * \brief Times multiplyWords() on n-word operands with the given thresholds
+ */
+static double timeMultiply(size_t n, size_t karatsuba, size_t toom3,
+  size_t ntt)
+{
+  MultiplyThresholds &t = multiplyThresholds();
+  MultiplyThresholds saved = t;
+  t.karatsuba = karatsuba;
+  t.toom3 = toom3;
+  t.ntt = ntt;
+  
+  std::vector<word_t> a(n), b(n), product(2 * n);
+  for (size_t i = 0; i < n; i ++)
+  {
+    a[i] = ((word_t)rand() << 32) ^ rand();
+    b[i] = ((word_t)rand() << 32) ^ rand();
+  }
+  std::vector<word_t> scratch(multiplyScratchSize(n));
+  
+  Measurement m = measure([&]() {
+    multiplyWords(product.data(), a.data(), b.data(), n, scratch.data());
+    doNotOptimize(product[0]);
+  });
+  
+  t = saved;
+  return m.nanoseconds;
+}
+
+/**
+ * \brief Finds the smallest of the candidate word counts from which on the
+ * higher algorithm always wins
+ *
+ * \param time - times n-word operands with the higher algorithm used from
+ *   the given word count on
+ */
+template<typename F>
+static size_t findThreshold(const char *name, const size_t *sizes,
+  size_t count, F time)
+{
+  printf("\n%-10s %10s %14s %14s\n", name, "words", "below (ns)", "above (ns)");
+  
+  size_t threshold = NEVER;
+  for (size_t i = 0; i < count; i ++)
+  {
+    size_t n = sizes[i];
+    double below = time(n, n + 1);
+    double above = time(n, n);
+    printf("%-10s %10zu %14.0f %14.0f\n", "", n, below, above);
+    
+    if (above < below)
+    {
+      if (threshold == NEVER)
+        threshold = n;
+    }
+    else
+    {
+      threshold = NEVER;
+    }
+  }
+  return threshold;
+}
+
+int main()
+{
+  printf("basecase: %s\n\n", multiplyKernels().name);
+  
+  // Each column allows the algorithms up to and including the named one
+  printf("%10s %12s %12s %12s %12s\n",
+    "bits", "basecase", "karatsuba", "toom3", "ntt");
+  for (size_t bits = 4 << 10; bits <= (1 << 20); bits *= 2)
+  {
+    size_t n = BITS_TO_WORDS(bits);
+    const MultiplyThresholds &d = multiplyThresholds();
+    char width[32];
+    printf("%10s %12.0f %12.0f %12.0f %12.0f\n",
+      formatBits(bits, width, sizeof(width)),
+      timeMultiply(n, NEVER, NEVER, NEVER),
+      timeMultiply(n, d.karatsuba, NEVER, NEVER),
+      timeMultiply(n, d.karatsuba, d.toom3, NEVER),
+      timeMultiply(n, d.karatsuba, d.toom3, 0));
+  }
+  
+  // Tune the thresholds one after another, each building on the last
+  const size_t karatsubaSizes[] = { 8, 12, 16, 20, 24, 28, 32, 40, 48, 64 };
+  size_t karatsuba = findThreshold("karatsuba", karatsubaSizes,
+    sizeof(karatsubaSizes) / sizeof(karatsubaSizes[0]),
+    [](size_t n, size_t k) { return timeMultiply(n, k, NEVER, NEVER); });
+  if (karatsuba == NEVER)
+    karatsuba = multiplyThresholds().karatsuba;
+  
+  const size_t toom3Sizes[] = { 64, 96, 128, 160, 192, 256, 320, 384, 512 };
+  size_t toom3 = findThreshold("toom3", toom3Sizes,
+    sizeof(toom3Sizes) / sizeof(toom3Sizes[0]),
+    [=](size_t n, size_t k) { return timeMultiply(n, karatsuba, k, NEVER); });
+  if (toom3 == NEVER)
+    toom3 = multiplyThresholds().toom3;
+  
+  const size_t nttSizes[] = { 4096, 8192, 12288, 16384, 24576, 32768, 49152,
+    65536 };
+  size_t ntt = findThreshold("ntt", nttSizes,
+    sizeof(nttSizes) / sizeof(nttSizes[0]),
+    [=](size_t n, size_t k) { return timeMultiply(n, karatsuba, toom3, k); });
+  if (ntt == NEVER)
+    ntt = multiplyThresholds().ntt;
+  
+  printf("\nsuggested thresholds:\n");
+  printf("  -DBITVECTOR_KARATSUBA_THRESHOLD=%zu\n", karatsuba);
+  printf("  -DBITVECTOR_TOOM3_THRESHOLD=%zu\n", toom3);
+  printf("  -DBITVECTOR_NTT_THRESHOLD=%zu\n", ntt);
+  return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * \file
+ * \brief Compares the serial BitVector operators with the parallel functions
+ * on 1-Gbit operands, using one thread per hardware thread
+ */
+
+#include "../Parallel.hpp"
+#include "Harness.hpp"
+
+#include <cstdlib>
+
+
+int main(int argc, char **argv)
+{
+  size_t bits = (argc > 1) ? strtoull(argv[1], NULL, 0) : (size_t)1 << 30;
+  ThreadPool &pool = ThreadPool::shared();
+  char width[32];
+  printf("%s bits, %zu threads\n\n", formatBits(bits, width, sizeof(width)),
+    pool.size());
+  
+  BitVector<64> a(bits, false), b(bits, false);
+  word_t state = 88172645463325252ULL;
+  for (size_t i = 0; i < a.wordCount(); i ++)
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    a.data()[i] = state;
+    b.data()[i] = ~state;
+  }
+  BitVector<64> c(b);
+  
+  printf("%-12s %14s %14s %10s\n", "operation", "serial (GB/s)",
+    "parallel (GB/s)", "speedup");
+  double bytes = (double)BITS_TO_BYTES(bits);
+  auto compare = [&](const char *name, const Measurement &serial,
+    const Measurement &parallel)
+  {
+    printf("%-12s %14.2f %14.2f %9.2fx\n", name, bytes / serial.nanoseconds,
+      bytes / parallel.nanoseconds, serial.nanoseconds / parallel.nanoseconds);
+  };
+  
+  compare("or",
+    measure([&]() { a |= b; }, 0.2),
+    measure([&]() { parallelOr(a, b, pool); }, 0.2));
+  compare("xor",
+    measure([&]() { a ^= b; }, 0.2),
+    measure([&]() { parallelXor(a, b, pool); }, 0.2));
+  compare("complement",
+    measure([&]() { a.complement(); }, 0.2),
+    measure([&]() { parallelComplement(a, pool); }, 0.2));
+  compare("add",
+    measure([&]() { a += b; }, 0.2),
+    measure([&]() { parallelAdd(a, b, pool); }, 0.2));
+  
+  size_t count = 0;
+  compare("popcount",
+    measure([&]() { count += a.popcount(); }, 0.2),
+    measure([&]() { count += parallelPopcount(a, pool); }, 0.2));
+  doNotOptimize(count);
+  
+  // Equal operands, so that neither version can stop early
+  bool equal = true;
+  compare("equal",
+    measure([&]() { equal &= (b == c); }, 0.2),
+    measure([&]() { equal &= parallelEqual(b, c, pool); }, 0.2));
+  doNotOptimize(equal);
+  return 0;
+}
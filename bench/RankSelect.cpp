@@ -0,0 +1,91 @@
+/**
+ * \file
+ * \brief Times rank and select queries on a 1-Gbit RankSelect index at
+ * several densities, along with building and updating the index
+ */
+
+#include "../RankSelect.hpp"
+#include "Harness.hpp"
+
+#include <cstdlib>
+
+
+/**
+ * \brief A fast generator for filling the bits and drawing query positions
+ */
+static word_t nextRandom(word_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+int main(int argc, char **argv)
+{
+  size_t bits = (argc > 1) ? strtoull(argv[1], NULL, 0) : (size_t)1 << 30;
+  const size_t queryCount = 1 << 20;
+  char width[32];
+  printf("%s bits, %s queries\n\n", formatBits(bits, width, sizeof(width)),
+    RankSelect().instructionSet());
+  
+  printf("%8s %10s %12s %12s %12s %12s\n", "density", "overhead",
+    "build (ms)", "update (us)", "rank (ns)", "select (ns)");
+  
+  BitVector<64> v(bits, false);
+  const int densities[] = { 1, 10, 50, 90 };
+  for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d ++)
+  {
+    // Set each bit with the given percentage of probability
+    word_t state = 88172645463325252ULL;
+    word_t *w = v.data();
+    for (size_t i = 0; i < v.wordCount(); i ++)
+    {
+      word_t x = 0;
+      for (size_t j = 0; j < BITS_PER_WORD; j ++)
+        if (nextRandom(state) % 100 < (word_t)densities[d])
+          x |= MASK_WITH_BIT(j);
+      w[i] = x;
+    }
+    
+    RankSelect index;
+    Measurement build = measure([&]() {
+      index.rebuild(v);
+      doNotOptimize(index);
+    }, 0.1, 1);
+    
+    // Flip a 64-Kbit range in the middle, which moves every later rank
+    size_t begin = bits / 2, end = begin + (64 << 10);
+    if (end > bits)
+      end = bits;
+    Measurement update = measure([&]() {
+      for (size_t i = begin / BITS_PER_WORD; i < end / BITS_PER_WORD; i ++)
+        w[i] = ~w[i];
+      index.update(begin, end);
+    });
+    
+    std::vector<size_t> positions(queryCount), ranks(queryCount);
+    for (size_t i = 0; i < queryCount; i ++)
+    {
+      positions[i] = nextRandom(state) % bits;
+      ranks[i] = index.count() ? nextRandom(state) % index.count() : 0;
+    }
+    
+    size_t sum = 0;
+    Measurement rank = measure([&]() {
+      for (size_t i = 0; i < queryCount; i ++)
+        sum += index.rank1(positions[i]);
+    });
+    Measurement select = measure([&]() {
+      for (size_t i = 0; i < queryCount; i ++)
+        sum += index.select1(ranks[i]);
+    });
+    doNotOptimize(sum);
+    
+    printf("%7d%% %9.2f%% %12.1f %12.1f %12.1f %12.1f\n", densities[d],
+      100.0 * index.indexBytes() / BITS_TO_BYTES(bits),
+      build.nanoseconds / 1e6, update.nanoseconds / 1e3,
+      rank.nanoseconds / queryCount, select.nanoseconds / queryCount);
+  }
+  return 0;
+}
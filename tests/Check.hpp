@@ -0,0 +1,49 @@
+/**
+ * \file
+ * \brief A minimal checking harness shared by the BitVector tests
+ *
+ * A failed CHECK prints where it is and what it tested, and the test goes on
+ * so that one run reports every failure. finishChecks() turns the count of
+ * failures into the exit status that ctest looks at.
+ */
+
+#include <cstddef>
+#include <cstdio>
+
+
+/**
+ * \brief The number of failed checks
+ */
+static size_t failures = 0;
+
+/**
+ * \brief Records a failed check, with where it is and what it tested
+ */
+#define CHECK(condition) \
+  check((condition), #condition, __FILE__, __LINE__)
+
+inline void check(bool passed, const char *condition, const char *file,
+  int line)
+{
+  if (passed)
+    return;
+  
+  failures ++;
+  fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+}
+
+/**
+ * \brief Reports the number of failed checks
+ *
+ * \returns the exit status of the test: 0 if every check passed
+ */
+inline int finishChecks()
+{
+  if (failures)
+  {
+    fprintf(stderr, "%zu checks failed\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * \file
+ * \brief Checks the counters of BITVECTOR_STATS over a known sequence of
+ * allocations, spills, copies and moves
+ *
+ * The instrumentation changes BitVector itself, so this test is a separate
+ * program built with BITVECTOR_STATS defined.
+ *
+ * Usage: bitvector_stats_tests
+ */
+
+#include "../BitVector.hpp"
+#include "Check.hpp"
+
+#include <thread>
+
+
+#ifndef BITVECTOR_STATS
+#error "bitvector_stats_tests must be built with BITVECTOR_STATS defined"
+#endif
+
+typedef BitVector<128> Vector;
+
+/**
+ * \brief The number of calls to countEvent(), and the words they reported
+ */
+static size_t hookCalls = 0;
+static size_t hookWords = 0;
+
+static void countEvent(BitVectorEvent, size_t words)
+{
+  hookCalls ++;
+  hookWords += words;
+}
+
+/**
+ * \brief Checks the event counters of the calling thread
+ */
+static bool hasCounts(uint64_t allocations, uint64_t reallocations,
+  uint64_t frees, uint64_t copies, uint64_t moves, uint64_t spills)
+{
+  BitVectorStats s = bitVectorStats();
+  return s.allocations == allocations && s.reallocations == reallocations &&
+    s.frees == frees && s.copies == copies && s.moves == moves &&
+    s.spills == spills;
+}
+
+static void testSequence()
+{
+  // 1000 bits are 16 words, 3000 bits 47 and 5000 bits 79; up to 128 bits
+  // fit in the object
+  resetBitVectorStats();
+  setBitVectorStatsHook(countEvent);
+  {
+    Vector a(100);
+    CHECK(hasCounts(0, 0, 0, 0, 0, 0));
+    
+    Vector b(1000);
+    CHECK(hasCounts(1, 0, 0, 0, 0, 1));
+    CHECK(bitVectorStats().liveHeapWords == 16);
+    
+    Vector c(b);
+    CHECK(hasCounts(2, 0, 0, 1, 0, 2));
+    
+    Vector d(std::move(c));
+    CHECK(hasCounts(2, 0, 0, 1, 1, 2));
+    CHECK(bitVectorStats().liveHeapWords == 32);
+    
+    // Assigning a wide value spills the in-object vector
+    a = b;
+    CHECK(hasCounts(3, 0, 0, 2, 1, 3));
+    
+    // Copying into heap storage that is large enough allocates nothing
+    Vector e(5000);
+    e = b;
+    CHECK(hasCounts(4, 0, 0, 3, 1, 4));
+    CHECK(bitVectorStats().liveHeapWords == 127);
+    
+    // Growing heap storage allocates the new words before freeing the old
+    b.reserve(3000);
+    CHECK(hasCounts(5, 1, 1, 3, 1, 4));
+    CHECK(bitVectorStats().liveHeapWords == 158);
+    CHECK(bitVectorStats().peakHeapWords == 174);
+    
+    // Moving into a vector frees the storage it had
+    a = std::move(d);
+    CHECK(hasCounts(5, 1, 2, 3, 2, 4));
+    CHECK(bitVectorStats().liveHeapWords == 142);
+  }
+  CHECK(hasCounts(5, 1, 5, 3, 2, 4));
+  CHECK(bitVectorStats().liveHeapWords == 0);
+  CHECK(bitVectorStats().peakHeapWords == 174);
+  
+  // The widths given to the constructors: 100, 1000 four times and 5000
+  BitVectorStats s = bitVectorStats();
+  CHECK(s.widths[7] == 1 && s.widths[10] == 4 && s.widths[13] == 1);
+  
+  // The hook saw every event with its words: 174 allocated, 47 of them
+  // replacing heap storage and 127 spilling, 174 freed, 48 copied and 32
+  // moved
+  setBitVectorStatsHook(NULL);
+  CHECK(hookCalls == 5 + 1 + 5 + 3 + 2 + 4);
+  CHECK(hookWords == 174 + 47 + 127 + 174 + 48 + 32);
+  Vector f(1000);
+  CHECK(hookCalls == 20);
+}
+
+static void testReset()
+{
+  Vector kept(1000);
+  resetBitVectorStats();
+  CHECK(hasCounts(0, 0, 0, 0, 0, 0));
+  CHECK(bitVectorStats().liveHeapWords == 16);
+  CHECK(bitVectorStats().peakHeapWords == 16);
+}
+
+static void testThreads()
+{
+  resetBitVectorStats();
+  size_t allocations = 0;
+  std::thread worker([&]()
+  {
+    Vector v(1000), w(v);
+    allocations = bitVectorStats().allocations;
+  });
+  worker.join();
+  CHECK(allocations == 2);
+  CHECK(hasCounts(0, 0, 0, 0, 0, 0));
+}
+
+
+int main()
+{
+  testSequence();
+  testReset();
+  testThreads();
+  return finishChecks();
+}
@@ -0,0 +1,2314 @@
+/**
+ * \file
+ * \brief Checks BitVector and the headers built on it against bit-by-bit
+ * reference implementations
+ *
+ * Each test computes its expected result one bit at a time, or checks an
+ * identity such as q * d + r == x, at widths on both sides of the word size
+ * and of the in-object capacity. The process exits with a nonzero status if
+ * any check fails, so that ctest reports it.
+ *
+ * Usage: bitvector_tests
+ */
+
+#include "../Allocators.hpp"
+#include "../AtomicBitSpan.hpp"
+#include "../BitFile.hpp"
+#include "../BitSpan.hpp"
+#include "../BitVector.hpp"
+#include "../BitVectorBatch.hpp"
+#include "../CompressedBitVector.hpp"
+#include "../FixedBitVector.hpp"
+#include "../Montgomery.hpp"
+#include "../Parallel.hpp"
+#include "../RankSelect.hpp"
+#include "Check.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * \brief Widths at and around the word size, the in-object capacity of
+ * Vector, and several words
+ */
+static const size_t WIDTHS[] = { 1, 7, 63, 64, 65, 127, 128, 129, 200, 1000 };
+
+typedef BitVector<128> Vector;
+
+/**
+ * \brief A bit-by-bit copy of a value, least significant bit first
+ */
+typedef std::vector<bool> Bits;
+
+
+/**
+ * \brief A xorshift generator, so that every run checks the same values
+ */
+class Random
+{
+public:
+  explicit Random(word_t seed = 88172645463325252ULL) : state(seed) { }
+  
+  word_t next()
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+  
+  /**
+   * \returns a number in [0, n)
+   */
+  size_t below(size_t n)
+  {
+    return (size_t)(next() % n);
+  }
+
+private:
+  word_t state;
+};
+
+/**
+ * \brief Fills every word of v, including the unused bits of the most
+ * significant word, which the operations must ignore
+ *
+ * \param density - one in density bits is set, or every bit is random if
+ *   density is 0
+ */
+template<typename V>
+void randomize(V &v, Random &random, unsigned density = 0)
+{
+  for (size_t i = 0; i < v.wordCount(); i ++)
+  {
+    word_t x = random.next();
+    for (unsigned j = 1; j < density; j *= 2)
+      x &= random.next();
+    v.data()[i] = x;
+  }
+}
+
+template<typename V>
+V randomVector(size_t width, Random &random, unsigned density = 0)
+{
+  V v(width);
+  randomize(v, random, density);
+  return v;
+}
+
+template<typename V>
+Bits toBits(const V &v)
+{
+  Bits bits(v.width());
+  for (size_t i = 0; i < bits.size(); i ++)
+    bits[i] = v.getBit(i);
+  return bits;
+}
+
+template<typename V>
+V fromBits(const Bits &bits)
+{
+  V v(bits.size());
+  for (size_t i = 0; i < bits.size(); i ++)
+    v.setBit(i, bits[i]);
+  return v;
+}
+
+/**
+ * \returns the low width bits of a word
+ */
+static Bits wordBits(word_t x, size_t width)
+{
+  Bits bits(width);
+  for (size_t i = 0; i < width && i < BITS_PER_WORD; i ++)
+    bits[i] = (x >> i) & 1;
+  return bits;
+}
+
+/**
+ * \returns the low width bits of n words
+ */
+static Bits wordsBits(const word_t *w, size_t n, size_t width)
+{
+  Bits bits(width);
+  for (size_t i = 0; i < width && i < WORDS_TO_BITS(n); i ++)
+    bits[i] = (w[i / BITS_PER_WORD] >> (i % BITS_PER_WORD)) & 1;
+  return bits;
+}
+
+/**
+ * \returns bits zero-extended or truncated to width
+ */
+static Bits resized(Bits bits, size_t width)
+{
+  bits.resize(width, false);
+  return bits;
+}
+
+static Bits addBits(const Bits &a, const Bits &b, bool carry = false)
+{
+  Bits sum(a.size());
+  for (size_t i = 0; i < a.size(); i ++)
+  {
+    bool x = a[i], y = b[i];
+    sum[i] = x ^ y ^ carry;
+    carry = (x && y) || (carry && (x ^ y));
+  }
+  return sum;
+}
+
+static Bits subtractBits(const Bits &a, const Bits &b)
+{
+  Bits notB(b.size());
+  for (size_t i = 0; i < b.size(); i ++)
+    notB[i] = !b[i];
+  return addBits(a, notB, true);
+}
+
+/**
+ * \returns a * b modulo 2^a.size(), by shifting and adding
+ */
+static Bits multiplyBits(const Bits &a, const Bits &b)
+{
+  size_t n = a.size();
+  Bits product(n), shifted(a);
+  for (size_t i = 0; i < n; i ++)
+  {
+    if (b[i])
+      product = addBits(product, shifted);
+    shifted.insert(shifted.begin(), false);
+    shifted.pop_back();
+  }
+  return product;
+}
+
+/**
+ * \returns whether a < b as unsigned numbers of equal width
+ */
+static bool lessBits(const Bits &a, const Bits &b)
+{
+  for (size_t i = a.size(); i -- > 0; )
+  {
+    if (a[i] != b[i])
+      return b[i];
+  }
+  return false;
+}
+
+/**
+ * \brief Checks that q * d + r == x and r < d, at a width that cannot
+ * overflow
+ */
+static bool isDivision(const Bits &x, const Bits &d, const Bits &q,
+  const Bits &r)
+{
+  size_t n = x.size() + d.size() + 1;
+  Bits lhs = addBits(multiplyBits(resized(q, n), resized(d, n)),
+    resized(r, n));
+  return lhs == resized(x, n) && lessBits(resized(r, n), resized(d, n));
+}
+
+/**
+ * \returns the digits of bits in radix 2, 8 or 16, most significant first,
+ *   with leading zeros
+ */
+static std::string digitsOfBits(const Bits &bits, unsigned bitsPerDigit)
+{
+  size_t count = (bits.size() + bitsPerDigit - 1) / bitsPerDigit;
+  std::string digits(count, '0');
+  for (size_t i = 0; i < count; i ++)
+  {
+    unsigned digit = 0;
+    for (unsigned j = 0; j < bitsPerDigit; j ++)
+    {
+      size_t k = i * bitsPerDigit + j;
+      if (k < bits.size() && bits[k])
+        digit |= 1u << j;
+    }
+    digits[count - 1 - i] = "0123456789abcdef"[digit];
+  }
+  return digits;
+}
+
+/**
+ * \returns the decimal digits of bits, by doubling a decimal string and
+ *   adding each bit from the most significant down
+ */
+static std::string decimalOfBits(const Bits &bits)
+{
+  std::string digits = "0";
+  for (size_t i = bits.size(); i -- > 0; )
+  {
+    int carry = bits[i];
+    for (size_t j = digits.size(); j -- > 0; )
+    {
+      int d = 2 * (digits[j] - '0') + carry;
+      digits[j] = (char)('0' + d % 10);
+      carry = d / 10;
+    }
+    if (carry)
+      digits.insert(digits.begin(), (char)('0' + carry));
+  }
+  return digits;
+}
+
+
+static void testBitRef()
+{
+  Random random;
+  for (size_t width : WIDTHS)
+  {
+    Vector v(width), w = randomVector<Vector>(width, random);
+    Bits expected(width);
+    for (size_t i = 0; i < width; i ++)
+    {
+      bool x = (random.next() & 1) != 0;
+      v[i] = x;
+      expected[i] = x;
+    }
+    CHECK(toBits(v) == expected);
+    
+    // Assignments chain, and a reference to a bit of another vector copies
+    // the bit rather than the reference
+    for (size_t i = 0; i < width; i ++)
+      v[i] = w[width - 1 - i];
+    for (size_t i = 0; i < width; i ++)
+      CHECK(v[i] == w.getBit(width - 1 - i));
+    
+    Vector u(width);
+    u[0] = v[width - 1] = true;
+    CHECK(u.getBit(0) && v.getBit(width - 1));
+    u[width - 1] = v[0] = false;
+    CHECK(!u.getBit(width - 1) && !v.getBit(0));
+    
+    v[0].flip();
+    CHECK(v.getBit(0));
+  }
+}
+
+/**
+ * \brief The number of calls to CountingAllocator::allocate()
+ */
+static size_t allocations = 0;
+
+/**
+ * \brief The number of calls to the global operator new, which catches the
+ * allocations that do not go through the allocator of a BitVector
+ */
+static std::atomic<size_t> heapAllocations(0);
+
+// Not inlined, so that the compiler does not pair the malloc() and free()
+// inside with allocations it cannot see
+__attribute__((noinline)) void *operator new(size_t size)
+{
+  heapAllocations ++;
+  void *p = malloc(size != 0 ? size : 1);
+  if (p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+/**
+ * CountingAllocator
+ *
+ * \brief A standard allocator that counts its allocations
+ */
+template<typename T>
+class CountingAllocator
+{
+public:
+  typedef T value_type;
+  
+  CountingAllocator() { }
+  
+  template<typename U>
+  CountingAllocator(const CountingAllocator<U> &) { }
+  
+  T *allocate(size_t n)
+  {
+    allocations ++;
+    return std::allocator<T>().allocate(n);
+  }
+  
+  void deallocate(T *p, size_t n)
+  {
+    std::allocator<T>().deallocate(p, n);
+  }
+};
+
+template<typename T, typename U>
+bool operator==(const CountingAllocator<T> &, const CountingAllocator<U> &)
+{
+  return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const CountingAllocator<T> &, const CountingAllocator<U> &)
+{
+  return false;
+}
+
+static void testAllocationCount()
+{
+  typedef BitVector<128, CountingAllocator<word_t> > Counted;
+  const size_t width = 10000;
+  
+  Random random;
+  Counted a = randomVector<Counted>(width, random);
+  Counted b = randomVector<Counted>(width, random);
+  Counted c = randomVector<Counted>(width, random);
+  Counted d = randomVector<Counted>(width, random);
+  Bits w = toBits(a), x = toBits(b), y = toBits(c), z = toBits(d);
+  
+  // Choosing the kernels for the CPU allocates once per program, so do it
+  // before counting
+  wordKernels();
+  multiplyKernels();
+  
+  // A bitwise expression is evaluated into the result in one pass. Every
+  // count below is also checked against the global operator new, so that
+  // no temporary bypasses the allocator
+  allocations = heapAllocations = 0;
+  Counted bitwise(a | (b & (c ^ d)));
+  CHECK(allocations == 1 && heapAllocations == 1);
+  for (size_t i = 0; i < width; i ++)
+    CHECK(bitwise.getBit(i) == (w[i] || (x[i] && (y[i] != z[i]))));
+  
+  // Each operator after the first reuses the storage of the temporary
+  allocations = heapAllocations = 0;
+  Counted sum = a + b - c + d;
+  CHECK(allocations == 1 && heapAllocations == 1);
+  CHECK(toBits(sum) == addBits(subtractBits(addBits(w, x), y), z));
+  
+  // At this width the product is computed by Karatsuba, whose scratch space
+  // also comes from the allocator; at basecase widths it is on the stack
+  allocations = heapAllocations = 0;
+  Counted product = a * b + c;
+  CHECK(allocations == 2 && heapAllocations == 2);
+  CHECK(toBits(product) == addBits(multiplyBits(w, x), y));
+  
+  // Multiplying in place takes its scratch space from the stack at basecase
+  // widths, and otherwise allocates it once from the allocator
+  Counted narrow = randomVector<Counted>(1000, random);
+  Counted factor = randomVector<Counted>(1000, random);
+  Bits u = toBits(narrow), v = toBits(factor);
+  allocations = heapAllocations = 0;
+  narrow *= factor;
+  CHECK(allocations == 0 && heapAllocations == 0);
+  CHECK(toBits(narrow) == multiplyBits(u, v));
+  Counted wide(a);
+  allocations = heapAllocations = 0;
+  wide *= b;
+  CHECK(allocations == 1 && heapAllocations == 1);
+  CHECK(toBits(wide) == multiplyBits(w, x));
+  
+  // An expiring operand lends its storage to the result, so the copy made
+  // here is the only allocation
+  allocations = heapAllocations = 0;
+  Counted e(a);
+  Counted difference = std::move(e) + b - c;
+  CHECK(allocations == 1 && heapAllocations == 1);
+  CHECK(toBits(difference) == subtractBits(addBits(w, x), y));
+  
+  allocations = heapAllocations = 0;
+  Counted moved(std::move(difference));
+  moved = std::move(sum);
+  CHECK(allocations == 0 && heapAllocations == 0);
+  CHECK(toBits(moved) == addBits(subtractBits(addBits(w, x), y), z));
+}
+
+/**
+ * \brief Runs each kernel that the CPU supports on the same words as the
+ * scalar kernel, at every length up to a few vectors and from unaligned
+ * addresses
+ */
+static void testKernels()
+{
+  std::vector<const WordKernels *> kernels = supportedWordKernels();
+  const WordKernels &scalar = *kernels.front();
+  CHECK(&wordKernels() == kernels.back());
+  
+  Random random;
+  for (size_t k = 1; k < kernels.size(); k ++)
+  {
+    const WordKernels &kernel = *kernels[k];
+    for (size_t n = 0; n <= 70; n ++)
+    {
+      // One word of offset, so that vector loads are not aligned
+      std::vector<word_t> a(n + 1), b(n + 1);
+      for (size_t i = 0; i <= n; i ++)
+      {
+        a[i] = random.next();
+        b[i] = random.next();
+      }
+      
+      void (*binary[][2])(word_t *, const word_t *, size_t) = {
+        { scalar.orWords, kernel.orWords },
+        { scalar.andWords, kernel.andWords },
+        { scalar.xorWords, kernel.xorWords }
+      };
+      for (size_t op = 0; op < 3; op ++)
+      {
+        std::vector<word_t> expected(a), actual(a);
+        binary[op][0](&expected[1], &b[1], n);
+        binary[op][1](&actual[1], &b[1], n);
+        CHECK(actual == expected);
+      }
+      
+      std::vector<word_t> expected(a), actual(a);
+      scalar.notWords(&expected[1], n);
+      kernel.notWords(&actual[1], n);
+      CHECK(actual == expected);
+      
+      // Equal words, then one difference at each position
+      std::vector<word_t> c(a);
+      CHECK(kernel.equalWords(&a[1], &c[1], n));
+      CHECK(kernel.lastDifference(&a[1], &c[1], n) == 0);
+      for (size_t i = 1; i <= n; i ++)
+      {
+        c[i] ^= MASK_WITH_BIT(random.below(BITS_PER_WORD));
+        CHECK(!kernel.equalWords(&a[1], &c[1], n));
+        CHECK(kernel.lastDifference(&a[1], &c[1], n) == i);
+        CHECK(kernel.lastDifference(&a[1], &c[1], n) ==
+          scalar.lastDifference(&a[1], &c[1], n));
+        c[i] = a[i];
+      }
+      
+      // Runs of fill words broken by one other word at each position
+      word_t fills[] = { 0, ~(word_t)0 };
+      for (word_t fill : fills)
+      {
+        std::vector<word_t> w(n + 1, fill);
+        CHECK(kernel.skipFillForward(&w[1], n, fill) == n);
+        CHECK(kernel.skipFillBackward(&w[1], n, fill) == 0);
+        for (size_t i = 1; i <= n; i ++)
+        {
+          w[i] = fill ^ MASK_WITH_BIT(random.below(BITS_PER_WORD));
+          CHECK(kernel.skipFillForward(&w[1], n, fill) == i - 1);
+          CHECK(kernel.skipFillBackward(&w[1], n, fill) == i);
+          CHECK(kernel.skipFillForward(&w[1], n, fill) ==
+            scalar.skipFillForward(&w[1], n, fill));
+          CHECK(kernel.skipFillBackward(&w[1], n, fill) ==
+            scalar.skipFillBackward(&w[1], n, fill));
+          w[i] = fill;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * \brief Evaluates the same operations with an allocator as with the default
+ * one, and checks that results share the allocator of their operands
+ */
+template<typename V>
+void checkAllocator(const typename V::allocator_type &allocator)
+{
+  // Widths past the in-object capacity, so that the words are on the heap
+  Random random;
+  const size_t widths[] = { 129, 1000, 5000 };
+  for (size_t width : widths)
+  {
+    Vector a = randomVector<Vector>(width, random);
+    Vector b = randomVector<Vector>(width, random);
+    V x(width, true, allocator), y(width, true, allocator);
+    memcpy(x.data(), a.data(), WORDS_TO_BYTES(a.wordCount()));
+    memcpy(y.data(), b.data(), WORDS_TO_BYTES(b.wordCount()));
+    CHECK((uintptr_t)x.data() % BITVECTOR_CACHE_LINE == 0);
+    
+    V sum = x + y, product = x * y, mixed(x ^ (x & y));
+    CHECK(toBits(sum) == toBits(Vector(a + b)));
+    CHECK(toBits(product) == toBits(Vector(a * b)));
+    CHECK(toBits(mixed) == toBits(Vector(a ^ (a & b))));
+    CHECK(toBits(V(x << 77)) == toBits(Vector(a << 77)));
+    CHECK(sum.get_allocator() == allocator);
+    CHECK(mixed.get_allocator() == allocator);
+    
+    // Moving between vectors of one resource hands the storage over
+    const word_t *storage = sum.data();
+    V moved(std::move(sum));
+    CHECK(moved.data() == storage);
+    V assigned(width, true, allocator);
+    assigned = std::move(moved);
+    CHECK(assigned.data() == storage);
+    CHECK(toBits(assigned) == toBits(Vector(a + b)));
+  }
+}
+
+/**
+ * \brief Runs BitVectors on arenas and pools
+ */
+static void testAllocators()
+{
+  typedef BitVector<128, ArenaAllocator<word_t> > ArenaVector;
+  typedef BitVector<128, PoolAllocator<word_t> > PoolVector;
+  
+  checkAllocator<Vector>(CacheAlignedAllocator<word_t>());
+  
+  Arena arena(1024);
+  checkAllocator<ArenaVector>(ArenaAllocator<word_t>(arena));
+  arena.reset();
+  checkAllocator<ArenaVector>(ArenaAllocator<word_t>(arena));
+  
+  WordPool pool;
+  checkAllocator<PoolVector>(PoolAllocator<word_t>(pool));
+  
+  // A freed block is handed out again for the same size class
+  const word_t *first;
+  {
+    PoolVector v(3000, true, PoolAllocator<word_t>(pool));
+    first = v.data();
+  }
+  PoolVector w(2900, true, PoolAllocator<word_t>(pool));
+  CHECK(w.data() == first);
+  
+  // Assigning between resources copies the words, leaving each vector with
+  // storage from its own resource
+  WordPool other;
+  PoolVector u(3000, true, PoolAllocator<word_t>(other));
+  u.setBit(2999, true);
+  w.setBit(17, true);
+  const word_t *storage = u.data();
+  u = std::move(w);
+  CHECK(u.get_allocator() == PoolAllocator<word_t>(other));
+  CHECK(u.data() == storage);
+  CHECK(u.width() == 2900 && u.getBit(17) && u.popcount() == 1);
+}
+
+/**
+ * \brief Checks the carry and borrow chains word by word against the
+ * references one bit wider, with words that make carries run through
+ */
+static void testCarryChains()
+{
+  const word_t edges[] = { 0, 1, 2, MASK_WITH_BIT(BITS_PER_WORD - 1),
+    ~(word_t)0 - 1, ~(word_t)0 };
+  for (word_t x : edges)
+  {
+    for (word_t y : edges)
+    {
+      for (unsigned char c = 0; c <= 1; c ++)
+      {
+        Bits a = wordBits(x, BITS_PER_WORD + 1);
+        Bits b = wordBits(y, BITS_PER_WORD + 1);
+        Bits sum = addBits(a, b, c != 0);
+        Bits difference = subtractBits(subtractBits(a, b),
+          wordBits(c, BITS_PER_WORD + 1));
+        
+        word_t low;
+        unsigned char out = addWithCarry(x, y, c, &low);
+        CHECK(wordBits(low, BITS_PER_WORD + 1) == resized(
+          resized(sum, BITS_PER_WORD), BITS_PER_WORD + 1));
+        CHECK(out == sum[BITS_PER_WORD]);
+        
+        out = subtractWithBorrow(x, y, c, &low);
+        CHECK(wordBits(low, BITS_PER_WORD + 1) == resized(
+          resized(difference, BITS_PER_WORD), BITS_PER_WORD + 1));
+        CHECK(out == difference[BITS_PER_WORD]);
+      }
+    }
+  }
+  
+  Random random;
+  for (size_t n = 1; n <= 13; n ++)
+  {
+    for (int trial = 0; trial < 20; trial ++)
+    {
+      // Words of b that complement a, or that are all ones, make a carry or
+      // borrow run on
+      std::vector<word_t> a(n), b(n), dst(n);
+      for (size_t i = 0; i < n; i ++)
+      {
+        a[i] = random.next();
+        unsigned kind = random.below(4);
+        b[i] = (kind == 0) ? ~a[i] : (kind == 1) ? ~(word_t)0 :
+          (kind == 2) ? a[i] : random.next();
+      }
+      size_t width = WORDS_TO_BITS(n);
+      Bits x = wordsBits(a.data(), n, width + 1);
+      Bits y = wordsBits(b.data(), n, width + 1);
+      word_t c = trial & 1;
+      
+      Bits sum = addBits(x, y, c != 0);
+      word_t carry = addWords(dst.data(), a.data(), b.data(), n, c);
+      CHECK(wordsBits(dst.data(), n, width) == resized(sum, width));
+      CHECK(carry == sum[width]);
+      
+      Bits difference = subtractBits(subtractBits(x, y),
+        wordBits(c, width + 1));
+      word_t borrow = subtractWords(dst.data(), a.data(), b.data(), n, c);
+      CHECK(wordsBits(dst.data(), n, width) == resized(difference, width));
+      CHECK(borrow == difference[width]);
+      
+      // In place, as the BitVector operators use them
+      std::vector<word_t> w(a);
+      addWords(w.data(), w.data(), b.data(), n);
+      CHECK(wordsBits(w.data(), n, width) ==
+        resized(addBits(x, y), width));
+      
+      int order = compareWords(a.data(), b.data(), n);
+      CHECK((order < 0) == lessBits(x, y));
+      CHECK((order == 0) == (x == y));
+    }
+    
+    std::vector<word_t> ones(n, ~(word_t)0), zeros(n, 0);
+    CHECK(incrementWords(ones.data(), n) == 1 && ones == zeros);
+    CHECK(decrementWords(ones.data(), n) == 1);
+    CHECK(ones == std::vector<word_t>(n, ~(word_t)0));
+  }
+}
+
+static void testAddSubtract()
+{
+  Random random;
+  for (size_t width : WIDTHS)
+  {
+    for (int trial = 0; trial < 20; trial ++)
+    {
+      Vector a = randomVector<Vector>(width, random);
+      Vector b = randomVector<Vector>(width, random);
+      Bits x = toBits(a), y = toBits(b);
+      
+      CHECK(toBits(Vector(a + b)) == addBits(x, y));
+      CHECK(toBits(Vector(a - b)) == subtractBits(x, y));
+      
+      Vector c(a);
+      c += b;
+      CHECK(toBits(c) == addBits(x, y));
+      c -= b;
+      CHECK(c == a);
+      
+      word_t w = random.next();
+      Bits z = wordBits(w, width);
+      CHECK(toBits(Vector(a + w)) == addBits(x, z));
+      CHECK(toBits(Vector(a - w)) == subtractBits(x, z));
+    }
+    
+    // Carries and borrows that run through every word
+    Vector ones = ~Vector(width);
+    Vector zero(width);
+    Vector v(ones);
+    CHECK(++ v == zero);
+    CHECK(-- v == ones);
+    CHECK(Vector(zero - 1) == ones);
+    CHECK(-ones == Vector(width) + 1);
+  }
+}
+
+static void testMultiply()
+{
+  Random random;
+  for (size_t width : WIDTHS)
+  {
+    for (int trial = 0; trial < 5; trial ++)
+    {
+      Vector a = randomVector<Vector>(width, random);
+      Vector b = randomVector<Vector>(width, random);
+      Bits x = toBits(a), y = toBits(b);
+      
+      CHECK(toBits(Vector(a * b)) == multiplyBits(x, y));
+      CHECK(toBits(a.mulFull(b)) ==
+        multiplyBits(resized(x, 2 * width), resized(y, 2 * width)));
+      CHECK(toBits(a.mulFull(a)) ==
+        multiplyBits(resized(x, 2 * width), resized(x, 2 * width)));
+      
+      word_t w = random.next();
+      Bits z = wordBits(w, width);
+      CHECK(toBits(Vector(a * w)) == multiplyBits(x, z));
+    }
+  }
+}
+
+/**
+ * \brief Lowers multiplyThresholds() so that each algorithm runs on small
+ * operands, and checks its products against the basecase
+ */
+static void testMultiplyTiers()
+{
+  const MultiplyThresholds defaults = multiplyThresholds();
+  const size_t never = ~(size_t)0;
+  const MultiplyThresholds tiers[] = {
+    { 0, never, never },
+    { 0, 0, never },
+    { 0, 0, 0 }
+  };
+  const MultiplyAlgorithm algorithms[] = {
+    MULTIPLY_KARATSUBA, MULTIPLY_TOOM3, MULTIPLY_NTT
+  };
+  const size_t sizes[] = { 2, 3, 5, 7, 8, 9, 16, 17, 31, 64, 100, 257, 600 };
+  
+  Random random;
+  for (size_t t = 0; t < 3; t ++)
+  {
+    multiplyThresholds() = tiers[t];
+    for (size_t n : sizes)
+    {
+      // Below seven words Toom-3 can't split, so neither tier above it runs
+      if (n < 7 && algorithms[t] != MULTIPLY_KARATSUBA)
+        continue;
+      CHECK(multiplyAlgorithm(n) == algorithms[t]);
+      
+      // Random words, all ones for the longest carries, and a square
+      for (int pattern = 0; pattern < 3; pattern ++)
+      {
+        std::vector<word_t> a(n), b(n);
+        for (size_t i = 0; i < n; i ++)
+        {
+          a[i] = (pattern == 1) ? ~(word_t)0 : random.next();
+          b[i] = (pattern == 1) ? ~(word_t)0 : random.next();
+        }
+        if (pattern == 2)
+          b = a;
+        
+        std::vector<word_t> expected(2 * n), actual(2 * n);
+        multiplyBasecaseGeneric(expected.data(), a.data(), n, b.data(), n);
+        multiplyWords(actual.data(), a.data(), b.data(), n);
+        CHECK(actual == expected);
+        
+        multiplyLowWords(actual.data(), a.data(), b.data(), n);
+        CHECK(std::equal(actual.begin(), actual.begin() + n,
+          expected.begin()));
+      }
+    }
+    
+    // Through BitVector, at widths that aren't whole words
+    for (size_t width : WIDTHS)
+    {
+      Vector a = randomVector<Vector>(width, random);
+      Vector b = randomVector<Vector>(width, random);
+      Bits x = resized(toBits(a), 2 * width);
+      Bits y = resized(toBits(b), 2 * width);
+      CHECK(toBits(a.mulFull(b)) == multiplyBits(x, y));
+      CHECK(toBits(a.mulFull(a)) == multiplyBits(x, x));
+      CHECK(toBits(Vector(a * b)) ==
+        multiplyBits(toBits(a), toBits(b)));
+    }
+  }
+  multiplyThresholds() = defaults;
+  
+  // The basecase kernel chosen for the CPU against the generic one, with
+  // operands of different lengths
+  for (size_t an = 1; an <= 12; an ++)
+  {
+    for (size_t bn = 1; bn <= an; bn ++)
+    {
+      std::vector<word_t> a(an), b(bn);
+      for (size_t i = 0; i < an; i ++)
+        a[i] = random.next();
+      for (size_t i = 0; i < bn; i ++)
+        b[i] = random.next();
+      std::vector<word_t> expected(an + bn), actual(an + bn);
+      multiplyBasecaseGeneric(expected.data(), a.data(), an, b.data(), bn);
+      multiplyKernels().multiply(actual.data(), a.data(), an, b.data(), bn);
+      CHECK(actual == expected);
+    }
+  }
+}
+
+static void testDivide()
+{
+  Random random;
+  for (size_t width : WIDTHS)
+  {
+    for (int trial = 0; trial < 10; trial ++)
+    {
+      Vector x = randomVector<Vector>(width, random);
+      
+      // By a word, including 1 and the largest word
+      word_t w = (trial == 0) ? 1 : (trial == 1) ? ~(word_t)0 :
+        (random.next() >> random.below(BITS_PER_WORD)) | 1;
+      Bits d = wordBits(w, BITS_PER_WORD);
+      CHECK(isDivision(toBits(x), d, toBits(Vector(x / w)),
+        resized(toBits(Vector(x % w)), BITS_PER_WORD)));
+      
+      // By a divisor of up to the same width
+      size_t divisorWidth = 1 + random.below(width);
+      Vector divisor = randomVector<Vector>(divisorWidth, random);
+      if (divisor.bitLength() == 0)
+        divisor.setBit(0, true);
+      BarrettReducer reducer(divisor);
+      Vector q(width), r(width);
+      x.divMod(reducer, q, r);
+      CHECK(isDivision(toBits(x), toBits(divisor), toBits(q), toBits(r)));
+      CHECK(Vector(x / reducer) == q);
+      CHECK(Vector(x % reducer) == r);
+    }
+  }
+}
+
+/**
+ * \brief Divides x by d with a BarrettReducer, and checks that q * d + r == x
+ * and r < d
+ */
+static bool checkDivision(const std::vector<word_t> &x,
+  const std::vector<word_t> &d)
+{
+  size_t xn = x.size(), dn = d.size();
+  BarrettReducer reducer(d.data(), dn);
+  std::vector<word_t> q(xn), r(dn);
+  reducer.divide(q.data(), r.data(), x.data(), xn);
+  
+  // The quotient may also overwrite the dividend
+  std::vector<word_t> inPlace(x);
+  reducer.divide(inPlace.data(), NULL, inPlace.data(), xn);
+  if (inPlace != q)
+    return false;
+  
+  std::vector<word_t> product(xn + dn), padded(x);
+  padded.resize(xn + dn, 0);
+  r.resize(xn + dn, 0);
+  multiplyUnbalancedWords(product.data(), q.data(), xn, d.data(), dn);
+  addWords(product.data(), product.data(), r.data(), xn + dn);
+  return product == padded && compareWords(r.data(), d.data(), dn) < 0;
+}
+
+/**
+ * \brief Divides by divisors on both sides of BITVECTOR_BARRETT_THRESHOLD,
+ * whose top words need the largest and smallest normalizing shifts
+ */
+static void testDivisionPaths()
+{
+  const size_t divisorSizes[] = { 2, 3, 5, 17, 100, BITVECTOR_BARRETT_THRESHOLD,
+    BITVECTOR_BARRETT_THRESHOLD + 37 };
+  const word_t tops[] = { 1, ~(word_t)0, 0 };
+  
+  Random random;
+  for (size_t dn : divisorSizes)
+  {
+    for (word_t top : tops)
+    {
+      std::vector<word_t> d(dn);
+      for (size_t i = 0; i < dn; i ++)
+        d[i] = random.next();
+      d[dn - 1] = top ? top : random.next() | 1;
+      
+      // Dividends as long as the divisor, a little longer, and spanning
+      // several chunks of the Barrett path; then all ones, which makes every
+      // quotient word large
+      const size_t extra[] = { 0, 1, dn + 3, 2 * dn + 5 };
+      for (size_t e : extra)
+      {
+        std::vector<word_t> x(dn + e);
+        for (size_t i = 0; i < x.size(); i ++)
+          x[i] = random.next();
+        CHECK(checkDivision(x, d));
+        CHECK(checkDivision(std::vector<word_t>(x.size(), ~(word_t)0), d));
+      }
+      
+      // Divisors whose words are all ones, or one followed by zeros
+      CHECK(checkDivision(std::vector<word_t>(2 * dn + 1, ~(word_t)0),
+        std::vector<word_t>(dn, ~(word_t)0)));
+      std::vector<word_t> power(dn, 0);
+      power[dn - 1] = 1;
+      std::vector<word_t> x(2 * dn + 1);
+      for (size_t i = 0; i < x.size(); i ++)
+        x[i] = random.next();
+      CHECK(checkDivision(x, power));
+    }
+  }
+  
+  // Through BitVector, on the Barrett path
+  size_t width = WORDS_TO_BITS(2 * BITVECTOR_BARRETT_THRESHOLD) + 17;
+  Vector x = randomVector<Vector>(width, random);
+  Vector m = randomVector<Vector>(
+    WORDS_TO_BITS(BITVECTOR_BARRETT_THRESHOLD) + 3, random);
+  BarrettReducer reducer(m);
+  Vector q(width), r(width);
+  x.divMod(reducer, q, r);
+  CHECK(Vector(x / m) == q);
+  CHECK(Vector(x % m) == r);
+  CHECK(r < m.zeroExtend(width));
+  CHECK(Vector(q * m.zeroExtend(width) + r) == x);
+}
+
+/**
+ * \brief Compares every shift and rotation of v by count with bit-by-bit
+ * results
+ */
+static void checkShiftRotate(const Vector &v, size_t count)
+{
+  size_t width = v.width();
+  Bits bits = toBits(v);
+  Bits left(width), right(width), ashr(width), rotl(width), rotr(width);
+  for (size_t i = 0; i < width; i ++)
+  {
+    left[i] = i >= count && bits[i - count];
+    right[i] = count < width - i && bits[i + count];
+    ashr[i] = (count < width - i) ? bits[i + count] : bits[width - 1];
+    rotl[(i + count) % width] = bits[i];
+    rotr[i] = bits[(i + count) % width];
+  }
+  
+  CHECK(toBits(v << count) == left);
+  CHECK(toBits(v >> count) == right);
+  CHECK(toBits(v.ashr(count)) == ashr);
+  CHECK(toBits(v.rotl(count)) == rotl);
+  CHECK(toBits(v.rotr(count)) == rotr);
+  CHECK(toBits(Vector(v) << count) == left);
+  CHECK(toBits(Vector(v) >> count) == right);
+  
+  Vector w(v);
+  CHECK(toBits(w <<= count) == left);
+  w = v;
+  CHECK(toBits(w >>= count) == right);
+  w = v;
+  CHECK(toBits(w.arithmeticShiftRight(count)) == ashr);
+  w = v;
+  CHECK(toBits(w.rotateLeft(count)) == rotl);
+  CHECK(w.rotateRight(count) == v);
+}
+
+static void testShiftRotate()
+{
+  // Whole words and parts of words, in-object and on the heap
+  const size_t widths[] = { 1, 7, 63, 64, 65, 127, 128, 129, 192, 200, 256,
+    320, 999, 1000, 1024, 1025, 4097, 20000 };
+  
+  Random random;
+  for (size_t width : widths)
+  {
+    size_t counts[] = { 0, 1, 13, 63, 64, 65, 127, 128, 129, width / 2,
+      width - 1, width, width + 1, 3 * width + 5, random.below(width) };
+    for (size_t count : counts)
+    {
+      checkShiftRotate(randomVector<Vector>(width, random), count);
+      
+      // A sign bit of each value for the arithmetic shift
+      Vector v = randomVector<Vector>(width, random);
+      v.setBit(width - 1, !v.getBit(width - 1));
+      checkShiftRotate(v, count);
+    }
+  }
+  
+  // Rotating in place sets the wrapped bits aside on the stack, unless
+  // there are more than BITVECTOR_SCRATCH_WORDS words of them
+  typedef BitVector<128, CountingAllocator<word_t> > Counted;
+  Counted small = randomVector<Counted>(100, random);
+  Counted large = randomVector<Counted>(20000, random);
+  Bits smallBits = toBits(small), largeBits = toBits(large);
+  allocations = heapAllocations = 0;
+  for (size_t count = 1; count < 100; count ++)
+  {
+    small.rotateLeft(count);
+    small.rotateRight(count);
+    large.rotateLeft(count * 37);
+    large.rotateRight(count * 37);
+  }
+  CHECK(allocations == 0 && heapAllocations == 0);
+  CHECK(toBits(small) == smallBits && toBits(large) == largeBits);
+  
+  allocations = heapAllocations = 0;
+  large.rotateLeft(9000);
+  CHECK(allocations == 1 && heapAllocations == 1);
+  large.rotateRight(9000);
+  CHECK(toBits(large) == largeBits);
+}
+
+static void testRadix()
+{
+  Random random;
+  for (size_t width : WIDTHS)
+  {
+    for (int trial = 0; trial < 5; trial ++)
+    {
+      Vector v = randomVector<Vector>(width, random);
+      Bits bits = toBits(v);
+      
+      CHECK(v.toString(2) == digitsOfBits(bits, 1));
+      CHECK(v.toString(8) == digitsOfBits(bits, 3));
+      CHECK(v.toString(16) == digitsOfBits(bits, 4));
+      CHECK(v.toString(10) == decimalOfBits(bits));
+      
+      int radixes[] = { 2, 8, 10, 16 };
+      for (int radix : radixes)
+      {
+        std::string s = v.toString(radix);
+        CHECK(s.size() <= v.stringLength(radix));
+        
+        Vector u(width);
+        CHECK(u.fromString(s.c_str(), radix));
+        CHECK(u == v);
+      }
+    }
+  }
+  
+  Vector v(64);
+  CHECK(!v.fromString("12a", 10));
+  CHECK(!v.fromString("8", 8));
+  CHECK(v.fromString("FfFfFfFfFfFfFfFf", 16) && v == ~Vector(64));
+  
+  // Radixes other than 2, 8, 10 and 16 are rejected, not read as decimal
+  Vector before(v);
+  CHECK(!v.fromString("123", 3, 4));
+  CHECK(!v.fromString("z", 1, 36));
+  CHECK(!v.fromString("0", 1, 1));
+  CHECK(!v.fromString("10", 0));
+  CHECK(v == before);
+  
+  char buffer[8] = "x";
+  CHECK(v.stringLength(3) == 0 && v.toString(3).empty());
+  CHECK(v.toChars(buffer, sizeof(buffer), 36) == 0 && buffer[0] == '\0');
+  std::string out = "unchanged";
+  v.toString(out, -2);
+  CHECK(out.empty());
+}
+
+/**
+ * \brief Round-trips values wide enough for the divide-and-conquer
+ * conversions, BITVECTOR_TO_DECIMAL_THRESHOLD and
+ * BITVECTOR_FROM_DECIMAL_THRESHOLD words
+ */
+static void testRadixLarge()
+{
+  const size_t toDecimal = WORDS_TO_BITS(BITVECTOR_TO_DECIMAL_THRESHOLD);
+  
+  // About 63000 digits, above the threshold of 3072 words of 19 digits
+  const size_t fromDecimal =
+    WORDS_TO_BITS(BITVECTOR_FROM_DECIMAL_THRESHOLD) / 14 * 15;
+  const size_t widths[] = { toDecimal + 1, 3 * toDecimal - 5, fromDecimal };
+  const int radixes[] = { 2, 8, 10, 16 };
+  
+  Random random;
+  for (size_t width : widths)
+  {
+    // A full value, and one whose top words are zero
+    for (int trial = 0; trial < 2; trial ++)
+    {
+      Vector v = randomVector<Vector>(width, random);
+      if (trial == 1)
+        v >>= width / 3;
+      
+      std::string decimal = v.toString(10);
+      if (width < fromDecimal)
+        CHECK(decimal == decimalOfBits(toBits(v)));
+      
+      for (int radix : radixes)
+      {
+        std::string s = (radix == 10) ? decimal : v.toString(radix);
+        Vector u(width);
+        CHECK(u.fromString(s.c_str(), s.size(), radix));
+        CHECK(u == v);
+      }
+    }
+  }
+}
+
+static void testFind()
+{
+  Random random;
+  unsigned densities[] = { 0, 8, 256 };
+  for (size_t width : WIDTHS)
+  {
+    for (unsigned density : densities)
+    {
+      Vector v = randomVector<Vector>(width, random, density);
+      Bits bits = toBits(v);
+      
+      std::vector<size_t> set, clear;
+      for (size_t i = 0; i < width; i ++)
+        (bits[i] ? set : clear).push_back(i);
+      
+      CHECK(v.popcount() == set.size());
+      CHECK(v.findFirstSet() == (set.empty() ? width : set.front()));
+      CHECK(v.findLastSet() == (set.empty() ? width : set.back()));
+      CHECK(v.findFirstClear() == (clear.empty() ? width : clear.front()));
+      CHECK(v.findLastClear() == (clear.empty() ? width : clear.back()));
+      CHECK(v.bitLength() == (set.empty() ? 0 : set.back() + 1));
+      
+      for (size_t pos = 0; pos <= width; pos ++)
+      {
+        size_t nextSet = pos, nextClear = pos;
+        while (nextSet < width && !bits[nextSet])
+          nextSet ++;
+        while (nextClear < width && bits[nextClear])
+          nextClear ++;
+        CHECK(v.findNextSet(pos) == nextSet);
+        CHECK(v.findNextClear(pos) == nextClear);
+      }
+      
+      std::vector<size_t> visited;
+      for (size_t i : v.setBitIndices())
+        visited.push_back(i);
+      CHECK(visited == set);
+    }
+  }
+}
+
+/**
+ * \brief Searches long runs of zeros or ones that are broken by a single bit,
+ * where the kernels skip whole words, with the unused bits of the most
+ * significant word set the opposite way
+ */
+static void testFindRuns()
+{
+  const size_t widths[] = { 65, 128, 1000, 4096, 10001 };
+  
+  for (size_t width : widths)
+  {
+    size_t positions[] = { 0, 1, 63, 64, width / 2, width - 65, width - 2,
+      width - 1 };
+    for (size_t pos : positions)
+    {
+      // One set bit among zeros; garbage ones above the width
+      Vector v(width);
+      v.data()[v.wordCount() - 1] = ~MASK_FOR_MOST_SIGNIFICANT_WORD(width);
+      v.setBit(pos, true);
+      CHECK(v.findFirstSet() == pos);
+      CHECK(v.findLastSet() == pos);
+      CHECK(v.findNextSet(pos) == pos);
+      CHECK(v.findNextSet(pos + 1) == width);
+      CHECK(v.findNextSet(pos / 2) == pos);
+      CHECK(v.bitLength() == pos + 1);
+      CHECK(v.popcount() == 1);
+      
+      std::vector<size_t> visited;
+      for (size_t i : v.setBitIndices())
+        visited.push_back(i);
+      CHECK(visited == std::vector<size_t>(1, pos));
+      
+      // One clear bit among ones; garbage zeros above the width
+      Vector w = ~Vector(width);
+      w.data()[w.wordCount() - 1] &= MASK_FOR_MOST_SIGNIFICANT_WORD(width);
+      w.setBit(pos, false);
+      CHECK(w.findFirstClear() == pos);
+      CHECK(w.findLastClear() == pos);
+      CHECK(w.findNextClear(pos) == pos);
+      CHECK(w.findNextClear(pos + 1) == width);
+      CHECK(w.findNextClear(pos / 2) == pos);
+      CHECK(w.popcount() == width - 1);
+    }
+    
+    Vector zero(width);
+    CHECK(zero.findFirstSet() == width && zero.findLastSet() == width);
+    CHECK(zero.bitLength() == 0);
+    CHECK(zero.setBitIndices().begin() == zero.setBitIndices().end());
+    Vector ones = ~Vector(width);
+    CHECK(ones.findFirstClear() == width && ones.findLastClear() == width);
+  }
+}
+
+/**
+ * \brief Checks every rank and select query of index over v against counts
+ * made one bit at a time
+ */
+template<typename V>
+bool isRankSelect(const RankSelect &index, const V &v)
+{
+  size_t width = v.width(), rank = 0;
+  if (index.width() != width || index.count() != v.popcount())
+    return false;
+  for (size_t i = 0; i < width; i ++)
+  {
+    if (index.rank1(i) != rank || index.rank0(i) != i - rank)
+      return false;
+    if (v.getBit(i) && index.select1(rank ++) != i)
+      return false;
+  }
+  return index.rank1(width) == rank && index.select1(rank) == width;
+}
+
+/**
+ * \brief Builds, updates, copies and restores indices over vectors around
+ * the block and sample sizes, at densities from sparse to full
+ */
+static void testRankSelect()
+{
+  const size_t widths[] = { 0, 1, 63, 64, 65, RANK_SELECT_BLOCK_BITS - 1,
+    RANK_SELECT_BLOCK_BITS, RANK_SELECT_BLOCK_BITS + 1, 20000, 100000 };
+  const unsigned densities[] = { 0, 2, 64 };
+  
+  Random random;
+  for (size_t width : widths)
+  {
+    for (unsigned density : densities)
+    {
+      Vector v = randomVector<Vector>(width, random, density);
+      RankSelect index(v);
+      CHECK(isRankSelect(index, v));
+      if (width == 0)
+        continue;
+      
+      // Flips within one block, then across several, then every bit set
+      for (int trial = 0; trial < 3; trial ++)
+      {
+        size_t begin = random.below(width);
+        size_t end = begin + 1 + random.below(trial ? width - begin :
+          std::min<size_t>(width - begin, 100));
+        for (size_t i = begin; i < end; i += 1 + random.below(7))
+          v.flipBit(i);
+        index.update(begin, end);
+        CHECK(isRankSelect(index, v));
+      }
+      
+      RankSelect copy(index);
+      CHECK(isRankSelect(copy, v));
+      
+      // Tables written out and read back, referred to and copied
+      std::vector<word_t> tables;
+      index.writeTables([&](const word_t *w, size_t n) {
+        tables.insert(tables.end(), w, w + n);
+      });
+      CHECK(tables.size() == index.tableWords());
+      RankSelect mapped, owned;
+      CHECK(mapped.readTables(v.data(), width, tables.data(), tables.size(),
+        false));
+      CHECK(owned.readTables(v.data(), width, tables.data(), tables.size(),
+        true));
+      CHECK(isRankSelect(mapped, v));
+      CHECK(isRankSelect(owned, v));
+      CHECK(!owned.readTables(v.data(), width + 1, tables.data(),
+        tables.size(), true));
+      
+      v = ~Vector(width);
+      index.rebuild(v);
+      CHECK(isRankSelect(index, v));
+    }
+  }
+}
+
+/**
+ * \returns bits [offset, offset + length) of n words
+ */
+static Bits spanBits(const word_t *w, size_t offset, size_t length)
+{
+  Bits bits(length);
+  for (size_t i = 0; i < length; i ++)
+    bits[i] = (w[(offset + i) / BITS_PER_WORD] >>
+      ((offset + i) % BITS_PER_WORD)) & 1;
+  return bits;
+}
+
+/**
+ * \brief Runs each span operation at bit offsets inside a word, against
+ * the same operation on the bits of the whole buffer, so that a change to a
+ * bit outside the span is caught
+ */
+static void testBitSpan()
+{
+  const size_t offsets[] = { 0, 1, 13, 63, 64, 65, 130 };
+  const size_t lengths[] = { 0, 1, 5, 63, 64, 65, 200, 1000 };
+  const size_t words = 24;
+  const size_t bufferBits = WORDS_TO_BITS(words);
+  
+  Random random;
+  for (size_t offset : offsets)
+  {
+    for (size_t length : lengths)
+    {
+      if (offset + length > bufferBits - 130)
+        continue;
+      
+      // The source is at a different offset in its word than the span
+      size_t srcOffset = offset ? 130 - offset : 7;
+      
+      std::vector<word_t> buffer(words), source(words);
+      for (size_t i = 0; i < words; i ++)
+      {
+        buffer[i] = random.next();
+        source[i] = random.next();
+      }
+      Bits before = spanBits(buffer.data(), 0, bufferBits);
+      Bits src = spanBits(source.data(), srcOffset, length);
+      ConstBitSpan rhs(source.data(), srcOffset, length);
+      
+      // Reads
+      ConstBitSpan view(buffer.data(), offset, length);
+      Bits bits = spanBits(buffer.data(), offset, length);
+      CHECK(view.width() == length);
+      size_t ones = 0, first = length, last = length, firstClear = length,
+        lastClear = length;
+      for (size_t i = 0; i < length; i ++)
+      {
+        CHECK(view.getBit(i) == bits[i]);
+        if (bits[i])
+        {
+          ones ++;
+          first = std::min(first, i);
+          last = i;
+        }
+        else
+        {
+          firstClear = std::min(firstClear, i);
+          lastClear = i;
+        }
+      }
+      for (size_t i = 0; i < view.wordCount(); i ++)
+      {
+        size_t valid = std::min<size_t>(BITS_PER_WORD,
+          length - WORDS_TO_BITS(i));
+        CHECK(wordBits(view.word(i), valid) ==
+          Bits(bits.begin() + WORDS_TO_BITS(i),
+            bits.begin() + WORDS_TO_BITS(i) + valid));
+      }
+      CHECK(view.popcount() == ones);
+      CHECK(view.findFirstSet() == first && view.findLastSet() == last);
+      CHECK(view.findFirstClear() == firstClear);
+      CHECK(view.findLastClear() == lastClear);
+      CHECK(view.bitLength() == (ones ? last + 1 : 0));
+      CHECK((view == rhs) == (bits == src));
+      CHECK((view < rhs) == lessBits(bits, src));
+      CHECK(ConstBitSpan((const char *)buffer.data() + 3, offset, length) ==
+        ConstBitSpan(buffer.data(), offset + 24, length));
+      if (length > 10)
+        CHECK(view.subspan(3, length - 10) == ConstBitSpan(buffer.data(),
+          offset + 3, length - 10));
+      
+      // Writes, each on a fresh copy of the buffer
+      for (int op = 0; op < 8; op ++)
+      {
+        std::vector<word_t> w(buffer);
+        BitSpan span(w.data(), offset, length);
+        Bits expected(before);
+        size_t index = length ? random.below(length) : 0;
+        word_t x = random.next();
+        switch (op)
+        {
+        case 0:
+          span.assign(rhs);
+          break;
+        case 1:
+          span |= rhs;
+          break;
+        case 2:
+          span &= rhs;
+          break;
+        case 3:
+          span ^= rhs;
+          break;
+        case 4:
+          span.complement();
+          break;
+        case 5:
+          if (length)
+            span.setBit(index, true);
+          break;
+        case 6:
+          if (length)
+            span.flipBit(index);
+          break;
+        case 7:
+          for (size_t i = 0; i < span.wordCount(); i ++)
+            span.setWord(i, x ^ i);
+          break;
+        }
+        for (size_t i = 0; i < length; i ++)
+        {
+          bool y = expected[offset + i], z = src[i];
+          bool setWordBit = ((x ^ (i / BITS_PER_WORD)) >>
+            (i % BITS_PER_WORD)) & 1;
+          bool results[] = { z, y || z, y && z, y != z, !y,
+            i == index || y, (i == index) != y, setWordBit };
+          expected[offset + i] = results[op];
+        }
+        CHECK(spanBits(w.data(), 0, bufferBits) == expected);
+      }
+    }
+  }
+  
+  // A span over a whole BitVector
+  Vector v = randomVector<Vector>(1000, random);
+  Vector u = randomVector<Vector>(1000, random);
+  Vector expected(v ^ u);
+  BitSpan(v) ^= ConstBitSpan(u);
+  CHECK(v == expected);
+}
+
+/**
+ * \returns the bytes save() writes for bits and index
+ */
+static std::string saved(ConstBitSpan bits, const RankSelect *index = NULL)
+{
+  std::ostringstream out;
+  CHECK(save(out, bits, index));
+  return out.str();
+}
+
+/**
+ * \brief Writes bytes to a new file in the working directory
+ *
+ * \returns the path of the file
+ */
+static std::string writeTemporary(const std::string &bytes)
+{
+  char path[] = "bitvector_tests.XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  CHECK(write(fd, bytes.data(), bytes.size()) == (ssize_t)bytes.size());
+  close(fd);
+  return path;
+}
+
+/**
+ * \brief Saves and loads vectors through streams and maps them, with and
+ * without an index, and damages each section of a file
+ */
+static void testBitFile()
+{
+  const size_t widths[] = { 0, 1, 100, 1000, 70000 };
+  
+  Random random;
+  for (size_t width : widths)
+  {
+    Vector v = randomVector<Vector>(width, random);
+    RankSelect index(v);
+    std::string plain = saved(v), indexed = saved(v, &index);
+    
+    Vector loaded(3);
+    RankSelect loadedIndex;
+    std::istringstream in(plain);
+    CHECK(load(in, loaded) && loaded == v);
+    std::istringstream inIndexed(indexed);
+    CHECK(load(inIndexed, loaded, &loadedIndex) && loaded == v);
+    CHECK(isRankSelect(loadedIndex, loaded));
+    
+    // A file without an index gets one built
+    std::istringstream rebuilt(plain);
+    CHECK(load(rebuilt, loaded, &loadedIndex) && loaded == v);
+    CHECK(isRankSelect(loadedIndex, loaded));
+    
+    // A span at a bit offset is saved as if it started on a word
+    if (width > 5)
+    {
+      std::istringstream span(saved(ConstBitSpan(v.data(), 5, width - 5)));
+      CHECK(load(span, loaded));
+      CHECK(toBits(loaded) == spanBits(v.data(), 5, width - 5));
+    }
+    
+    // Mapped files read the same bits and index as loaded ones
+    std::string path = writeTemporary(indexed);
+    {
+      MappedBitFile file = mmapOpen(path.c_str());
+      CHECK(file.isOpen() && file.verify());
+      CHECK(file.width() == width && file.hasIndex());
+      CHECK(file.bits() == ConstBitSpan(v));
+      CHECK(isRankSelect(file.index(), v));
+    }
+    unlink(path.c_str());
+    
+    // A flipped byte in the header, the bits or the index is rejected
+    BitFileHeader header;
+    memcpy(&header, indexed.data(), sizeof(header));
+    std::vector<size_t> positions(1, 8 + random.below(sizeof(header) - 8));
+    if (header.payloadWords)
+      positions.push_back(header.payloadOffset +
+        random.below(WORDS_TO_BYTES(header.payloadWords)));
+    positions.push_back(header.indexOffset +
+      random.below(WORDS_TO_BYTES(header.indexWords)));
+    for (size_t pos : positions)
+    {
+      std::string damaged(indexed);
+      damaged[pos] ^= 0x10;
+      
+      Vector unchanged(7);
+      unchanged.setBit(3, true);
+      std::istringstream in(damaged);
+      CHECK(!load(in, unchanged, &loadedIndex));
+      CHECK(unchanged.width() == 7 && unchanged.popcount() == 1);
+      
+      std::string path = writeTemporary(damaged);
+      {
+        MappedBitFile file = mmapOpen(path.c_str());
+        CHECK(!file.isOpen() || !file.verify());
+      }
+      unlink(path.c_str());
+    }
+  }
+}
+
+/**
+ * \brief Runs the parallel functions with chunks of a few words, so that
+ * every vector is split between the threads and carries cross chunks, and
+ * compares them with the serial operators
+ */
+static void testParallel()
+{
+  const ParallelThresholds defaults = parallelThresholds();
+  ParallelThresholds tiny = { 0, 3 };
+  parallelThresholds() = tiny;
+  ThreadPool pool(4);
+  const size_t widths[] = { 1, 65, 192, 1000, 10000 };
+  
+  Random random;
+  for (size_t width : widths)
+  {
+    for (int pattern = 0; pattern < 3; pattern ++)
+    {
+      // Random words; all ones plus one, which carries through every chunk;
+      // and words that are all ones in some chunks only
+      Vector a = randomVector<Vector>(width, random);
+      Vector b = randomVector<Vector>(width, random);
+      if (pattern == 1)
+      {
+        a = ~Vector(width);
+        b = Vector(width) + 1;
+      }
+      else if (pattern == 2)
+      {
+        for (size_t i = 0; i < a.wordCount(); i ++)
+        {
+          if (i / 3 % 2)
+            a.data()[i] = ~(word_t)0;
+          b.data()[i] = (i % 3) ? 0 : random.next();
+        }
+      }
+      
+      Vector x(a);
+      CHECK(parallelAdd(x, b, pool) == Vector(a + b));
+      x = a;
+      CHECK(parallelOr(x, b, pool) == Vector(a | b));
+      x = a;
+      CHECK(parallelAnd(x, b, pool) == Vector(a & b));
+      x = a;
+      CHECK(parallelXor(x, b, pool) == Vector(a ^ b));
+      x = a;
+      CHECK(parallelComplement(x, pool) == Vector(~a));
+      CHECK(parallelPopcount(a, pool) == a.popcount());
+      
+      // Equal up to one bit, which is tried in each chunk, and equal with
+      // different unused bits
+      x = a;
+      CHECK(parallelEqual(a, x, pool));
+      for (size_t i = 0; i < width; i += 1 + random.below(200))
+      {
+        x.flipBit(i);
+        CHECK(!parallelEqual(a, x, pool));
+        x.flipBit(i);
+      }
+      x.data()[x.wordCount() - 1] ^= ~MASK_FOR_MOST_SIGNIFICANT_WORD(width);
+      CHECK(parallelEqual(a, x, pool));
+    }
+  }
+  parallelThresholds() = defaults;
+}
+
+/**
+ * \brief Compares each batch operation with the same operation on every
+ * element as a BitVector
+ */
+template<size_t Width>
+void checkBatch(size_t count, Random &random)
+{
+  typedef BitVectorBatch<Width> Batch;
+  typedef BitVector<Width> Element;
+  
+  // Random values, the largest value plus one for carries through every
+  // row, and pairs equal in all but the lowest word for the comparisons
+  std::vector<Element> a, b;
+  Batch x(count), y(count);
+  for (size_t i = 0; i < count; i ++)
+  {
+    a.push_back(randomVector<Element>(Width, random));
+    b.push_back(randomVector<Element>(Width, random));
+    if (i % 4 == 1)
+    {
+      a[i] = ~Element(Width);
+      b[i] = Element(Width) + 1;
+    }
+    else if (i % 4 >= 2)
+    {
+      b[i] = a[i];
+      if (i % 4 == 3)
+        b[i].data()[0] ^= random.next();
+    }
+    x.set(i, a[i]);
+    y.set(i, b[i]);
+  }
+  
+  Batch sum(x), difference(x), disjunction(x), conjunction(x), parity(x),
+    complement(x);
+  sum += y;
+  difference -= y;
+  disjunction |= y;
+  conjunction &= y;
+  parity ^= y;
+  complement.complement();
+  
+  std::vector<unsigned> counts(count);
+  x.popcount(counts.data());
+  Vector less(count), equal(count), lessThreshold(count),
+    equalThreshold(count);
+  x.compare(y, less, &equal);
+  x.compare(b[0], lessThreshold, &equalThreshold);
+  
+  for (size_t i = 0; i < count; i ++)
+  {
+    CHECK(x.get(i) == a[i]);
+    CHECK(sum.get(i) == Element(a[i] + b[i]));
+    CHECK(difference.get(i) == Element(a[i] - b[i]));
+    CHECK(disjunction.get(i) == Element(a[i] | b[i]));
+    CHECK(conjunction.get(i) == Element(a[i] & b[i]));
+    CHECK(parity.get(i) == Element(a[i] ^ b[i]));
+    CHECK(complement.get(i) == Element(~a[i]));
+    CHECK(counts[i] == a[i].popcount());
+    CHECK(less.getBit(i) == (a[i] < b[i]));
+    CHECK(equal.getBit(i) == (a[i] == b[i]));
+    CHECK(lessThreshold.getBit(i) == (a[i] < b[0]));
+    CHECK(equalThreshold.getBit(i) == (a[i] == b[0]));
+  }
+}
+
+static void testBatch()
+{
+  const size_t counts[] = { 1, 7, 33, 300 };
+  Random random;
+  for (size_t count : counts)
+  {
+    checkBatch<64>(count, random);
+    checkBatch<100>(count, random);
+    checkBatch<256>(count, random);
+    checkBatch<1000>(count, random);
+  }
+}
+
+/**
+ * \brief Compares each FixedBitVector operation with the same operation on
+ * BitVector
+ */
+template<size_t Bits>
+void checkFixed(Random &random)
+{
+  typedef FixedBitVector<Bits> Fixed;
+  typedef BitVector<Bits> Dynamic;
+  
+  for (int trial = 0; trial < 50; trial ++)
+  {
+    Dynamic a = randomVector<Dynamic>(Bits, random);
+    Dynamic b = randomVector<Dynamic>(Bits, random);
+    if (trial == 0)
+    {
+      a = ~Dynamic(Bits);
+      b = Dynamic(Bits) + 1;
+    }
+    Fixed x(a), y(b);
+    word_t w = random.next();
+    size_t count = random.below(2 * Bits);
+    
+    CHECK(x.toBitVector() == a);
+    CHECK((x + y).toBitVector() == Dynamic(a + b));
+    CHECK((x - y).toBitVector() == Dynamic(a - b));
+    CHECK((x * y).toBitVector() == Dynamic(a * b));
+    CHECK((x + w).toBitVector() == Dynamic(a + w));
+    CHECK((x - w).toBitVector() == Dynamic(a - w));
+    CHECK((x * w).toBitVector() == Dynamic(a * w));
+    CHECK((x | y).toBitVector() == Dynamic(a | b));
+    CHECK((x & y).toBitVector() == Dynamic(a & b));
+    CHECK((x ^ y).toBitVector() == Dynamic(a ^ b));
+    CHECK((~x).toBitVector() == Dynamic(~a));
+    CHECK((-x).toBitVector() == Dynamic(-a));
+    CHECK((x << count).toBitVector() == Dynamic(a << count));
+    CHECK((x >> count).toBitVector() == Dynamic(a >> count));
+    CHECK(x.rotl(count).toBitVector() == a.rotl(count));
+    CHECK(x.rotr(count).toBitVector() == a.rotr(count));
+    
+    Fixed z(x);
+    Dynamic c(a);
+    CHECK((++ z).toBitVector() == ++ c);
+    CHECK((-- z).toBitVector() == -- c);
+    
+    CHECK((x == y) == (a == b) && (x != y) == (a != b));
+    CHECK((x < y) == (a < b) && (x <= y) == (a <= b));
+    CHECK((x > y) == (a > b) && (x >= y) == (a >= b));
+    CHECK(x.popcount() == a.popcount());
+    CHECK(x.findFirstSet() == a.findFirstSet());
+    CHECK(x.findLastSet() == a.findLastSet());
+    CHECK(x.bitLength() == a.bitLength());
+  }
+}
+
+#if __cplusplus >= 201402L
+// Evaluated at compile time, where the intrinsics are not used
+static_assert((FixedBitVector<64>(~(word_t)0) + FixedBitVector<64>(2)) ==
+  FixedBitVector<64>(1), "64-bit addition wraps");
+static_assert((FixedBitVector<128>(~(word_t)0) + FixedBitVector<128>(1))
+  .findFirstSet() == 64, "128-bit addition carries into the high word");
+static_assert((FixedBitVector<128>(~(word_t)0) *
+  FixedBitVector<128>(~(word_t)0)).popcount() == 64,
+  "128-bit product of the largest words is 2^128 - 2^65 + 1");
+static_assert((FixedBitVector<256>(3) << 200).findLastSet() == 201,
+  "256-bit shift crosses words");
+static_assert((FixedBitVector<256>() - FixedBitVector<256>(1)).popcount() ==
+  256, "256-bit subtraction borrows through every word");
+static_assert(FixedBitVector<256>(5).rotr(1).getBit(255) &&
+  FixedBitVector<256>(5) < FixedBitVector<256>(6),
+  "256-bit rotation and comparison");
+#endif
+
+static void testFixed()
+{
+  Random random;
+  checkFixed<64>(random);
+  checkFixed<128>(random);
+  checkFixed<256>(random);
+  checkFixed<100>(random);
+}
+
+/**
+ * \brief Fills v with runs of ones and zeros of random lengths up to maxRun
+ */
+template<typename V>
+void randomizeRuns(V &v, Random &random, size_t maxRun)
+{
+  bool x = random.next() & 1;
+  for (size_t i = 0; i < v.width(); x = !x)
+  {
+    size_t end = std::min(v.width(), i + 1 + random.below(maxRun));
+    for (; i < end; i ++)
+      v.setBit(i, x);
+  }
+}
+
+/**
+ * \brief Checks that c holds the same bits as v
+ */
+static bool sameBits(const CompressedBitVector &c, const Vector &v)
+{
+  if (c.width() != v.width() || c.popcount() != v.popcount())
+    return false;
+  Vector copy(v.width());
+  c.copyTo(copy);
+  return copy == v && c.toBitVector<128>() == v;
+}
+
+static void testCompressed()
+{
+  // Sparse inputs make array containers, runs make run containers and
+  // random bits make bitmaps; the widths cross the chunk size
+  const size_t widths[] = { 1, 1000, 70000, 200000 };
+  const unsigned densities[] = { 256, 0 };
+  Random random;
+  for (size_t width : widths)
+  {
+    std::vector<Vector> inputs;
+    for (unsigned density : densities)
+      inputs.push_back(randomVector<Vector>(width, random, density));
+    Vector runs(width);
+    randomizeRuns(runs, random, 3000);
+    inputs.push_back(runs);
+    
+    for (const Vector &a : inputs)
+    {
+      CompressedBitVector ca(a);
+      CHECK(sameBits(ca, a));
+      for (size_t i = 0; i < width; i += 1 + random.below(97))
+        CHECK(ca.getBit(i) == a.getBit(i) && ca[i] == a[i]);
+      
+      std::vector<size_t> indices;
+      for (size_t i : ca.setBitIndices())
+        indices.push_back(i);
+      bool indicesMatch = (indices.size() == a.popcount());
+      for (size_t i : indices)
+        indicesMatch &= a.getBit(i);
+      CHECK(indicesMatch);
+      
+      for (const Vector &b : inputs)
+      {
+        CompressedBitVector cb(b);
+        CHECK(sameBits(ca & cb, Vector(a & b)));
+        CHECK(sameBits(ca | cb, Vector(a | b)));
+        CHECK(sameBits(ca ^ cb, Vector(a ^ b)));
+        CHECK(sameBits(CompressedBitVector(ca).andNot(cb), Vector(a & ~b)));
+        CHECK(sameBits(CompressedBitVector(ca) &= b, Vector(a & b)));
+        CHECK(sameBits(CompressedBitVector(ca) |= b, Vector(a | b)));
+        CHECK(sameBits(CompressedBitVector(ca) ^= b, Vector(a ^ b)));
+        CHECK((ca == cb) == (a == b) && (ca != cb) == (a != b));
+        
+        Vector dst(b);
+        dst &= ca;
+        CHECK(dst == Vector(a & b));
+        dst = b;
+        dst |= ca;
+        CHECK(dst == Vector(a | b));
+        dst = b;
+        dst ^= ca;
+        CHECK(dst == Vector(a ^ b));
+        dst = b;
+        ca.andNotInto(dst);
+        CHECK(dst == Vector(b & ~a));
+      }
+      
+      // Random updates, which move chunks between forms, then optimize()
+      Vector expected(a);
+      for (size_t k = 0; k < 3000 && width > 0; k ++)
+      {
+        size_t i = random.below(width);
+        bool x = random.next() & 1;
+        ca.setBit(i, x);
+        expected.setBit(i, x);
+      }
+      CHECK(sameBits(ca, expected));
+      ca.optimize();
+      CHECK(sameBits(ca, expected));
+      CHECK(ca == CompressedBitVector(expected));
+    }
+  }
+}
+
+/**
+ * \returns x mod m, with the width of m
+ */
+static Vector reduced(const Vector &x, const BarrettReducer &reducer,
+  size_t width)
+{
+  Vector padded(x.zeroExtend(std::max(x.width(), width)));
+  Vector q(padded.width()), r(padded.width());
+  padded.divMod(reducer, q, r);
+  return r.truncate(width);
+}
+
+/**
+ * \returns a * b mod m, through the double-width product
+ */
+static Vector multiplyMod(const Vector &a, const Vector &b,
+  const BarrettReducer &reducer, size_t width)
+{
+  return reduced(Vector(a.zeroExtend(2 * width) * b.zeroExtend(2 * width)),
+    reducer, width);
+}
+
+/**
+ * \returns base^exponent mod m by squaring and multiplying, one exponent bit
+ *   at a time
+ */
+static Vector powerMod(const Vector &base, const Vector &exponent,
+  const Vector &m)
+{
+  BarrettReducer reducer(m);
+  size_t width = m.width();
+  Vector g = reduced(base, reducer, width);
+  Vector acc(width);
+  acc.setBit(0, true);
+  acc = reduced(acc, reducer, width);
+  for (size_t i = exponent.width(); i > 0; i --)
+  {
+    acc = multiplyMod(acc, acc, reducer, width);
+    if (exponent.getBit(i - 1))
+      acc = multiplyMod(acc, g, reducer, width);
+  }
+  return acc;
+}
+
+static void testModPow()
+{
+  const size_t widths[] = { 1, 2, 63, 64, 65, 128, 200, 520 };
+  Random random;
+  for (size_t width : widths)
+  {
+    for (int trial = 0; trial < 6; trial ++)
+    {
+      // Odd moduli go through MontgomeryContext and even ones fall back to
+      // BarrettReducer; the top bit is set so that the modulus is full width
+      Vector m = randomVector<Vector>(width, random);
+      m.setBit(width - 1, true);
+      bool odd = (trial % 2 == 0) || width == 1;
+      m.setBit(0, odd);
+      if (trial == 4)
+      {
+        for (size_t i = 0; i < width; i ++)
+          m.setBit(i, true);
+      }
+      
+      Vector base = randomVector<Vector>(width + (trial == 1 ? 100 : 0),
+        random);
+      Vector exponent = randomVector<Vector>(trial < 2 ? 150 : width, random);
+      Vector expected = powerMod(base, exponent, m);
+      CHECK(modPow(base, exponent, m) == expected);
+      
+      // A zero exponent gives 1 mod m
+      CHECK(modPow(base, Vector(5), m) == powerMod(base, Vector(5), m));
+      if (!odd)
+        continue;
+      
+      MontgomeryContext context(m);
+      CHECK(context.modPow(base, exponent) == expected);
+      CHECK(context.modPowConstantTime(base, exponent) == expected);
+      
+      // Products and squares in Montgomery form
+      BarrettReducer reducer(m);
+      Vector a = randomVector<Vector>(width, random);
+      Vector b = randomVector<Vector>(width, random);
+      Vector ma = context.toMontgomery(a), mb = context.toMontgomery(b);
+      Vector a1 = reduced(a, reducer, width);
+      Vector b1 = reduced(b, reducer, width);
+      CHECK(context.fromMontgomery(ma) == a1);
+      CHECK(context.fromMontgomery(context.multiply(ma, mb)) ==
+        multiplyMod(a1, b1, reducer, width));
+      CHECK(context.fromMontgomery(context.square(ma)) ==
+        multiplyMod(a1, a1, reducer, width));
+    }
+  }
+}
+
+static void testRanges()
+{
+  Random random;
+  for (size_t width : WIDTHS)
+  {
+    for (int trial = 0; trial < 20; trial ++)
+    {
+      Vector v = randomVector<Vector>(width, random);
+      Bits bits = toBits(v);
+      size_t pos = random.below(width + 1);
+      size_t len = random.below(width - pos + 1);
+      Bits range(bits.begin() + pos, bits.begin() + pos + len);
+      CHECK(toBits(v.extract(pos, len)) == range);
+      CHECK(toBits(v.slice(pos, pos + len)) == range);
+      
+      // The source has unused bits set, which must not be copied
+      Vector src = randomVector<Vector>(len, random);
+      Bits inserted(bits);
+      for (size_t i = 0; i < len; i ++)
+        inserted[pos + i] = src.getBit(i);
+      Vector dst(v);
+      dst.insert(pos, src);
+      CHECK(toBits(dst) == inserted);
+      
+      size_t fieldLength = std::min(len, (size_t)BITS_PER_WORD);
+      word_t field = random.next();
+      word_t expected = 0;
+      Bits set(bits);
+      for (size_t i = 0; i < fieldLength; i ++)
+      {
+        expected |= (word_t)bits[pos + i] << i;
+        set[pos + i] = (field >> i) & 1;
+      }
+      CHECK(v.getBits(pos, fieldLength) == expected);
+      dst = v;
+      dst.setBits(pos, fieldLength, field);
+      CHECK(toBits(dst) == set);
+      
+      // Widening and narrowing
+      size_t wider = width + random.below(200);
+      Bits zeros(bits), signs(bits);
+      zeros.resize(wider, false);
+      signs.resize(wider, bits.back());
+      CHECK(toBits(v.zeroExtend(wider)) == zeros);
+      CHECK(toBits(v.signExtend(wider)) == signs);
+      CHECK(toBits(v.truncate(pos)) == Bits(bits.begin(), bits.begin() + pos));
+      
+      // concat puts low in the least significant bits
+      Vector low = randomVector<Vector>(1 + random.below(300), random);
+      Bits joined = toBits(low);
+      joined.insert(joined.end(), bits.begin(), bits.end());
+      CHECK(toBits(concat(v, low)) == joined);
+    }
+  }
+}
+
+static void testAppend()
+{
+  Random random;
+  for (size_t width : WIDTHS)
+  {
+    // Appends mixed at random, starting from a vector with unused bits set
+    Vector v = randomVector<Vector>(width, random);
+    Bits bits = toBits(v);
+    size_t capacity = v.capacity(), growths = 0;
+    for (int k = 0; k < 20000; k ++)
+    {
+      size_t op = random.below(10);
+      word_t value = random.next();
+      size_t count = (op < 7) ? 1 : (op < 9) ? random.below(65) :
+        BITS_PER_WORD;
+      if (op < 7)
+      {
+        v.pushBack(value & 1);
+      }
+      else if (op < 9)
+      {
+        v.appendBits(value, count);
+      }
+      else
+      {
+        v.appendWord(value);
+      }
+      for (size_t i = 0; i < count; i ++)
+        bits.push_back((value >> i) & 1);
+      
+      if (v.capacity() != capacity)
+      {
+        growths ++;
+        capacity = v.capacity();
+      }
+    }
+    CHECK(toBits(v) == bits);
+    CHECK(v.capacity() >= v.width());
+    
+    // The capacity grows geometrically, so a few hundred thousand bits take
+    // a few dozen reallocations at most
+    CHECK(growths < 40);
+  }
+  
+  // In-object storage has the capacity N
+  Vector v(100);
+  CHECK(v.capacity() == 128);
+  v.reserve(10);
+  CHECK(v.capacity() == 128);
+  
+  // reserve() widens the capacity but not the width or the value, and
+  // appends up to the capacity keep the storage
+  randomize(v, random);
+  Bits bits = toBits(v);
+  v.reserve(5000);
+  CHECK(v.capacity() >= 5000 && v.width() == 100 && toBits(v) == bits);
+  const word_t *storage = v.data();
+  for (size_t i = 100; i < 5000; i ++)
+  {
+    v.pushBack(i % 3 == 0);
+    bits.push_back(i % 3 == 0);
+  }
+  CHECK(v.data() == storage && toBits(v) == bits);
+  
+  // reserve() never shrinks and shrink_to_fit() releases the rest
+  size_t capacity = v.capacity();
+  v.reserve(200);
+  CHECK(v.capacity() == capacity);
+  v.reserve(capacity + 10000);
+  v.shrink_to_fit();
+  CHECK(v.capacity() == WORDS_TO_BITS(v.wordCount()) && toBits(v) == bits);
+  
+  // A vector narrowed to N bits or fewer moves back in-object
+  Vector narrow(v.truncate(100));
+  narrow.reserve(3000);
+  CHECK(narrow.capacity() >= 3000);
+  narrow.shrink_to_fit();
+  CHECK(narrow.capacity() == 128);
+  CHECK(toBits(narrow) == Bits(bits.begin(), bits.begin() + 100));
+}
+
+static void testClaim()
+{
+  const size_t widths[] = { 1, 63, 65, 130, 10007 };
+  for (size_t width : widths)
+  {
+    // The unused bits of the last word are clear, so that a claim past the
+    // width would be possible if they were not masked
+    std::vector<word_t> words(BITS_TO_WORDS(width), 0);
+    AtomicBitSpan span(words.data(), width);
+    
+    // Each thread claims until none are left at or above where it starts:
+    // half from the bottom and half from a few bits up
+    const size_t threads = 8;
+    std::vector<std::vector<size_t> > claims(threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t ++)
+    {
+      workers.push_back(std::thread([&span, &claims, t]() {
+        size_t from = (t % 2) ? 0 : t;
+        for (;;)
+        {
+          size_t index = span.claimNextFree(from);
+          if (index == span.width())
+            break;
+          claims[t].push_back(index);
+        }
+      }));
+    }
+    for (std::thread &worker : workers)
+      worker.join();
+    
+    std::vector<size_t> all;
+    for (const std::vector<size_t> &c : claims)
+      all.insert(all.end(), c.begin(), c.end());
+    std::sort(all.begin(), all.end());
+    bool once = (all.size() == width);
+    for (size_t i = 0; i < all.size() && once; i ++)
+      once = (all[i] == i);
+    CHECK(once);
+    CHECK(span.claimNextFree() == width);
+    CHECK(span.claimNextFree(width - 1) == width);
+    CHECK(span.claimNextFree(width + 5) == width);
+    
+    // A single claim above from skips set bits below it
+    span.atomicClear(width / 2);
+    span.atomicClear(width - 1);
+    CHECK(span.claimNextFree(width / 2 + 1) == (width / 2 + 1 < width ?
+      width - 1 : width));
+  }
+}
+
+static void testExpressions()
+{
+  Random random;
+  for (size_t width : WIDTHS)
+  {
+    Vector a = randomVector<Vector>(width, random);
+    Vector b = randomVector<Vector>(width, random);
+    Vector c = randomVector<Vector>(width, random);
+    Vector either(a | b), both(a & b), differ(a ^ b);
+    
+    // Lazy results compared and read without first naming their type
+    CHECK((a | b) == either && either == (a | b));
+    CHECK((a & b) != differ || both == differ);
+    CHECK((a ^ b) == (b ^ a) && !((a ^ b) != (b ^ a)));
+    CHECK(((a & b) | c) == Vector(both | c));
+    CHECK((~a < a) == (Vector(~a) < a) && (a <= ~a) == (a <= Vector(~a)));
+    CHECK(((a | b) > c) == (either > c) && ((a | b) >= c) == (either >= c));
+    CHECK((a & b).popcount() == both.popcount());
+    CHECK((~(a ^ b)).popcount() == width - differ.popcount());
+    CHECK((a | b).toString(16) == either.toString(16));
+    CHECK((a ^ b).toString() == differ.toString());
+    CHECK((a & b).hash(3) == both.hash(3));
+    CHECK((a | b).bitLength() == either.bitLength());
+    CHECK((a & b).findFirstSet() == both.findFirstSet());
+    CHECK((a & b).findLastSet() == both.findLastSet());
+    bool bits = true;
+    for (size_t i = 0; i < width; i ++)
+      bits &= ((a | b).getBit(i) == either[i]) && ((a & b)[i] == both[i]);
+    CHECK(bits);
+    
+    // A stored expression reads its operands when it is used, while
+    // evaluate() keeps the value at the time of the call
+    auto lazy = a | b;
+    Vector now = (a | b).evaluate();
+    CHECK(now == either && lazy == either);
+    a.flipBit(width - 1);
+    b.setBit(width - 1, false);
+    CHECK(lazy == Vector(a | b) && now == either);
+    CHECK(lazy.getBit(width - 1) == a.getBit(width - 1));
+  }
+}
+
+static void testHash()
+{
+  Random random;
+  for (size_t width : WIDTHS)
+  {
+    Vector v = randomVector<Vector>(width, random);
+    Vector copy(v);
+    Vector rebuilt = fromBits<Vector>(toBits(v));
+    Vector parsed(width);
+    parsed.fromString(v.toString(16).c_str(), 16);
+    
+    CHECK(copy.hash() == v.hash());
+    CHECK(rebuilt.hash() == v.hash());
+    CHECK(parsed.hash() == v.hash());
+    CHECK(rebuilt.hash(12345) == v.hash(12345));
+    CHECK(std::hash<Vector>()(rebuilt) == std::hash<Vector>()(v));
+  }
+  
+  // Values that differ only in the unused bits of the most significant word,
+  // through both the short path and the striped one
+  const size_t widths[] = { 1, 63, 65, 500, 511, 513, 1000, 5000, 5055 };
+  for (size_t width : widths)
+  {
+    Vector v = randomVector<Vector>(width, random);
+    Vector garbage(v);
+    garbage.data()[garbage.wordCount() - 1] ^=
+      ~MASK_FOR_MOST_SIGNIFICANT_WORD(width);
+    CHECK(garbage == v);
+    CHECK(garbage.hash() == v.hash());
+    CHECK(garbage.hash(7) == v.hash(7));
+    
+    // A change in any bit of the value changes the hash
+    garbage.flipBit(random.below(width));
+    CHECK(garbage.hash() != v.hash());
+  }
+  
+  // Every kernel accumulates the stripes as the scalar one does, so hash()
+  // is the same whichever is selected; the stripe numbers cross a block
+  std::vector<const WordKernels *> kernels = supportedWordKernels();
+  const WordKernels &scalar = *kernels.front();
+  for (size_t k = 1; k < kernels.size(); k ++)
+  {
+    for (size_t n = 0; n <= 2 * HASH_BLOCK_STRIPES + 3; n ++)
+    {
+      for (size_t first = 0; first < HASH_BLOCK_STRIPES; first += 5)
+      {
+        // One word of offset, so that vector loads are not aligned
+        std::vector<word_t> w(n * HASH_STRIPE_WORDS + 1);
+        for (word_t &x : w)
+          x = random.next();
+        std::vector<word_t> expected(HASH_STRIPE_WORDS);
+        for (word_t &x : expected)
+          x = random.next();
+        std::vector<word_t> actual(expected);
+        scalar.hashStripes(expected.data(), &w[1], n, first);
+        kernels[k]->hashStripes(actual.data(), &w[1], n, first);
+        CHECK(actual == expected);
+      }
+    }
+  }
+  
+  // IncrementalHash updated bit by bit against a recomputation
+  for (size_t width : widths)
+  {
+    Vector v = randomVector<Vector>(width, random, 16);
+    IncrementalHash h(v, 99);
+    bool matches = true;
+    for (int k = 0; k < 200; k ++)
+    {
+      size_t i = random.below(width);
+      if (k % 3 == 0)
+      {
+        h.flipBit(v, i);
+      }
+      else
+      {
+        h.setBit(v, i, random.next() & 1);
+      }
+      matches &= (h.value() == IncrementalHash(v, 99).value());
+    }
+    CHECK(matches);
+    
+    // Changes made directly to the words
+    size_t i = random.below(v.wordCount());
+    word_t changed = random.next();
+    if (i == v.wordCount() - 1)
+      changed &= MASK_FOR_MOST_SIGNIFICANT_WORD(width);
+    v.data()[i] ^= changed;
+    h.xorWord(i, changed);
+    CHECK(h.value() == IncrementalHash(v, 99).value());
+    CHECK(IncrementalHash(Vector(width), 99).value() == 0);
+  }
+}
+
+int main()
+{
+  testBitRef();
+  testAllocationCount();
+  testAllocators();
+  testKernels();
+  testCarryChains();
+  testExpressions();
+  testAddSubtract();
+  testMultiply();
+  testMultiplyTiers();
+  testDivide();
+  testDivisionPaths();
+  testShiftRotate();
+  testRadix();
+  testRadixLarge();
+  testFind();
+  testFindRuns();
+  testRankSelect();
+  testBitSpan();
+  testBitFile();
+  testParallel();
+  testBatch();
+  testFixed();
+  testCompressed();
+  testModPow();
+  testRanges();
+  testAppend();
+  testClaim();
+  testHash();
+  return finishChecks();
+}